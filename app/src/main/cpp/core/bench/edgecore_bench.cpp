@@ -0,0 +1,1641 @@
+/**
+ * edgecore_bench - Google Benchmark suite for the native pipeline
+ *
+ * Covers every stage on its own (color conversions, blur, Canny, the row kernels of
+ * each instruction set), every blur + Canny engine, the strip-parallel engine from one
+ * thread up to all cores, the whole pipeline from an NV21 frame to the edge mask, its
+ * cost against the area of a region of interest, 1 to 8 concurrent streams sharing one
+ * pool (aggregate frames per second), the compact edge formats, edge linking into
+ * polylines from one thread up to all cores, the display transform of every rotation,
+ * mirroring and view shape, threshold sweeps on shared gradients against full runs per
+ * threshold pair, frames processed while other threads hammer the session parameters
+ * (and the parameter handoff on its own), and gradient planes and edge density grids
+ * kept from edge detection against a second pass. The
+ * engine cases fail unless every engine finds exactly the OpenCV engine's edges, the
+ * fused footprint cases fail unless the fused engine gives exactly the edges of
+ * GaussianBlur + cv::Canny with every row kernel implementation and at odd sizes, the
+ * thread scaling cases fail unless the strip-parallel engine gives exactly the edges
+ * of GaussianBlur + cv::Canny for every aperture and uneven strip layouts, the
+ * row kernel cases fail unless every implementation reproduces the scalar reference,
+ * cv::GaussianBlur and cv::Sobel exactly on random and saturating rows of every width
+ * around the vector widths, the
+ * steady-state case fails if the pipeline still allocates buffers after warm-up or
+ * calls operator new more often than the OpenCV calls it makes do on their own, the
+ * format cases fail unless the format round-trips the edge mask exactly, the linking
+ * cases fail unless every thread count yields the single-thread polylines, the sweep
+ * cases fail unless shared gradients give the edges of a full run for every pair, the
+ * parameter cases fail if a frame sees a torn parameter change or one staged for a
+ * later frame, or if a change waiting for a later frame is lost, the gradient and
+ * density cases fail unless what they keep matches a separate pass, the luma-only
+ * pipeline cases fail unless every engine finds the fused engine's edges along the
+ * bottom border, and the display transform cases fail unless the mask lands where
+ * rotating, mirroring and letterboxing the frame puts it.
+ * Cases run at 720p, 1080p and 4K on a synthetic scene; set EDGECORE_BENCH_IMAGE to an
+ * image file to also run them on a real photo (resized to each resolution).
+ *
+ * Throughput is reported as pixels per second (items_per_second). Typical use:
+ *
+ *   ./edgecore_bench --benchmark_filter=Engine --benchmark_format=json > engines.json
+ */
+
+#include <benchmark/benchmark.h>
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "buffer_pool.h"
+#include "display_transform.h"
+#include "edge_detector.h"
+#include "edge_formats.h"
+#include "edge_linker.h"
+#include "frame_trace.h"
+#include "fused_canny.h"
+#include "heap_counter.h"
+#include "logger.h"
+#include "parallel_canny.h"
+#include "row_kernels.h"
+#include "session_engine.h"
+#include "stage_stats.h"
+#include "staged_snapshots.h"
+#include "thread_pool.h"
+
+namespace {
+
+struct Resolution {
+    int width;
+    int height;
+    const char* name;
+};
+
+constexpr Resolution kResolutions[] = {
+    {1280, 720, "720p"},
+    {1920, 1080, "1080p"},
+    {3840, 2160, "4K"}
+};
+
+constexpr int kResolutionCount = sizeof(kResolutions) / sizeof(kResolutions[0]);
+
+enum Source {
+    SOURCE_SYNTHETIC = 0,
+    SOURCE_REAL = 1
+};
+
+const char* kSourceNames[] = {"synthetic", "real"};
+
+// Low thresholds swept by the threshold-dependent cases (high = 3 * low)
+const std::vector<int64_t> kLowThresholds = {20, 50, 100};
+
+// Scene with smooth gradients, hard-edged shapes and sensor-like noise. Seeded, so
+// every run and every machine benchmarks the same pixels.
+cv::Mat syntheticFrame(int width, int height) {
+    cv::Mat frame(height, width, CV_8UC1);
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = frame.ptr<uint8_t>(y);
+        for (int x = 0; x < width; x++) {
+            row[x] = static_cast<uint8_t>(64 + (x * 96) / width + (y * 64) / height);
+        }
+    }
+
+    cv::RNG rng(0x5eed);
+    const int shapes = 40;
+    for (int i = 0; i < shapes; i++) {
+        cv::Point center(rng.uniform(0, width), rng.uniform(0, height));
+        int size = rng.uniform(height / 40, height / 6);
+        cv::Scalar shade(rng.uniform(0, 256));
+        switch (i % 3) {
+            case 0:
+                cv::circle(frame, center, size, shade, cv::FILLED);
+                break;
+            case 1:
+                cv::rectangle(frame, cv::Rect(center.x, center.y, size, size / 2), shade, cv::FILLED);
+                break;
+            default:
+                cv::line(frame, center, cv::Point(center.x + size, center.y + size / 3), shade, 3);
+                break;
+        }
+    }
+
+    cv::Mat noise(height, width, CV_8SC1);
+    rng.fill(noise, cv::RNG::NORMAL, 0, 4);
+    cv::add(frame, noise, frame, cv::noArray(), CV_8UC1);
+    return frame;
+}
+
+// The image named by EDGECORE_BENCH_IMAGE in gray, resized, or an empty Mat
+cv::Mat realFrame(int width, int height) {
+    const char* path = std::getenv("EDGECORE_BENCH_IMAGE");
+    if (!path || !*path) {
+        return cv::Mat();
+    }
+    cv::Mat image = cv::imread(path, cv::IMREAD_GRAYSCALE);
+    if (image.empty()) {
+        return cv::Mat();
+    }
+    cv::Mat resized;
+    cv::resize(image, resized, cv::Size(width, height), 0, 0,
+               image.cols > width ? cv::INTER_AREA : cv::INTER_LINEAR);
+    return resized;
+}
+
+// Gray frames are built once per resolution and source and shared by all cases
+const cv::Mat& grayFrame(int resolution, int source) {
+    static std::map<std::pair<int, int>, cv::Mat> cache;
+    auto key = std::make_pair(resolution, source);
+    auto found = cache.find(key);
+    if (found == cache.end()) {
+        const Resolution& size = kResolutions[resolution];
+        cv::Mat frame = source == SOURCE_REAL ? realFrame(size.width, size.height)
+                                              : syntheticFrame(size.width, size.height);
+        found = cache.emplace(key, frame).first;
+    }
+    return found->second;
+}
+
+// NV21 frame whose Y plane is the gray frame, with mildly varying chroma
+cv::Mat nv21Frame(const cv::Mat& gray) {
+    cv::Mat nv21(gray.rows + gray.rows / 2, gray.cols, CV_8UC1);
+    cv::Mat luma = nv21.rowRange(0, gray.rows);
+    gray.copyTo(luma);
+    cv::Mat chroma = nv21.rowRange(gray.rows, nv21.rows);
+    for (int y = 0; y < chroma.rows; y++) {
+        uint8_t* row = chroma.ptr<uint8_t>(y);
+        for (int x = 0; x < chroma.cols; x++) {
+            row[x] = static_cast<uint8_t>(128 + ((x / 2 + y) % 32) - 16);
+        }
+    }
+    return nv21;
+}
+
+// Fetch the frame of a case, or mark the case skipped when it is not available
+const cv::Mat* caseFrame(benchmark::State& state, int resolution, int source) {
+    const cv::Mat& frame = grayFrame(resolution, source);
+    if (frame.empty()) {
+        state.SkipWithError("set EDGECORE_BENCH_IMAGE to an image file to run real-image cases");
+        return nullptr;
+    }
+    state.SetLabel(std::string(kResolutions[resolution].name) + "/" + kSourceNames[source]);
+    return &frame;
+}
+
+void setPixelsProcessed(benchmark::State& state, const cv::Mat& frame) {
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * frame.rows * frame.cols);
+}
+
+// ---------------------------------------------------------------------------------
+// Individual stages
+// ---------------------------------------------------------------------------------
+
+// Args: resolution
+void BM_YuvToRgba(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    cv::Mat nv21 = nv21Frame(*gray);
+    cv::Mat rgba;
+    for (auto _ : state) {
+        cv::cvtColor(nv21, rgba, cv::COLOR_YUV2RGBA_NV21);
+        benchmark::DoNotOptimize(rgba.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_YuvToRgba)->DenseRange(0, kResolutionCount - 1)->Unit(benchmark::kMillisecond);
+
+// Args: resolution
+void BM_RgbaToGray(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    cv::Mat rgba;
+    cv::cvtColor(*gray, rgba, cv::COLOR_GRAY2RGBA);
+    cv::Mat out;
+    for (auto _ : state) {
+        cv::cvtColor(rgba, out, cv::COLOR_RGBA2GRAY);
+        benchmark::DoNotOptimize(out.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_RgbaToGray)->DenseRange(0, kResolutionCount - 1)->Unit(benchmark::kMillisecond);
+
+// Args: resolution, source
+void BM_GaussianBlur(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), state.range(1));
+    if (!gray) {
+        return;
+    }
+    cv::Mat blur;
+    for (auto _ : state) {
+        cv::GaussianBlur(*gray, blur, cv::Size(5, 5), 1.5, 1.5);
+        benchmark::DoNotOptimize(blur.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_GaussianBlur)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {SOURCE_SYNTHETIC, SOURCE_REAL}})
+    ->Unit(benchmark::kMillisecond);
+
+// Args: resolution, source, low threshold
+void BM_Canny(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), state.range(1));
+    if (!gray) {
+        return;
+    }
+    cv::Mat blur;
+    cv::GaussianBlur(*gray, blur, cv::Size(5, 5), 1.5, 1.5);
+    cv::Mat edges;
+    double low = static_cast<double>(state.range(2));
+    for (auto _ : state) {
+        cv::Canny(blur, edges, low, low * 3, 3);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_Canny)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, kResolutionCount - 1, 1),
+                   {SOURCE_SYNTHETIC, SOURCE_REAL}, kLowThresholds})
+    ->Unit(benchmark::kMillisecond);
+
+// Widths of the row kernel checks: below, at and around every vector width
+constexpr int kKernelWidths[] = {1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 47, 63, 64, 65, 127, 129};
+
+// Test images for the row kernel checks: random, black, white, a 0 / 255 checkerboard
+// and random 0 / 255 noise, the last three driving every sum to saturation
+constexpr int kKernelPatterns = 5;
+
+cv::Mat kernelPattern(int pattern, int rows, int cols, cv::RNG& rng) {
+    cv::Mat image(rows, cols, CV_8UC1);
+    switch (pattern) {
+        case 0:
+            rng.fill(image, cv::RNG::UNIFORM, 0, 256);
+            break;
+        case 1:
+            image.setTo(0);
+            break;
+        case 2:
+            image.setTo(255);
+            break;
+        case 3:
+            for (int y = 0; y < rows; y++) {
+                for (int x = 0; x < cols; x++) {
+                    image.at<uint8_t>(y, x) = ((x + y) & 1) ? 255 : 0;
+                }
+            }
+            break;
+        default:
+            rng.fill(image, cv::RNG::UNIFORM, 0, 2);
+            image *= 255;
+            break;
+    }
+    return image;
+}
+
+// Blur a whole image with the row kernels, borders reflected as GaussianBlur does
+void kernelGaussian(const RowKernels& kernels, const cv::Mat& src, cv::Mat& dst) {
+    const int cols = src.cols;
+    std::vector<uint8_t> padded(cols + 4);
+    std::vector<uint16_t> horizontal(5 * cols);
+    dst.create(src.rows, cols, CV_8UC1);
+    for (int y = 0; y < src.rows; y++) {
+        const uint16_t* rows[5];
+        for (int k = 0; k < 5; k++) {
+            const uint8_t* row = src.ptr<uint8_t>(cv::borderInterpolate(y + k - 2, src.rows, cv::BORDER_REFLECT_101));
+            for (int x = -2; x < cols + 2; x++) {
+                padded[x + 2] = row[cv::borderInterpolate(x, cols, cv::BORDER_REFLECT_101)];
+            }
+            kernels.gaussianHorizontal(padded.data() + 2, &horizontal[k * cols], cols);
+            rows[k] = &horizontal[k * cols];
+        }
+        kernels.gaussianVertical(rows, dst.ptr<uint8_t>(y), cols);
+    }
+}
+
+// Differentiate a whole image with the row kernels, borders replicated as cv::Canny does
+void kernelSobel(const RowKernels& kernels, const cv::Mat& src, cv::Mat& dx, cv::Mat& dy) {
+    const int cols = src.cols;
+    std::vector<uint8_t> padded(3 * (cols + 2));
+    dx.create(src.rows, cols, CV_16SC1);
+    dy.create(src.rows, cols, CV_16SC1);
+    for (int y = 0; y < src.rows; y++) {
+        for (int k = 0; k < 3; k++) {
+            const uint8_t* row = src.ptr<uint8_t>(std::min(std::max(y + k - 1, 0), src.rows - 1));
+            for (int x = -1; x < cols + 1; x++) {
+                padded[k * (cols + 2) + x + 1] = row[std::min(std::max(x, 0), cols - 1)];
+            }
+        }
+        kernels.sobel3(&padded[1], &padded[cols + 3], &padded[2 * cols + 5],
+                       dx.ptr<int16_t>(y), dy.ptr<int16_t>(y), cols);
+    }
+}
+
+bool sameImage(const cv::Mat& a, const cv::Mat& b) {
+    return a.size() == b.size() && a.type() == b.type() && cv::countNonZero((a != b).reshape(1)) == 0;
+}
+
+// Check an implementation against the scalar reference on every kernel, and its blur
+// and Sobel against cv::GaussianBlur and cv::Sobel, all on every width and pattern.
+// Returns what differs first, or nullptr if nothing does.
+const char* rowKernelMismatch(const RowKernels& kernels) {
+    const RowKernels& scalar = RowKernels::scalar();
+    cv::RNG rng(0x5eed);
+    for (int width : kKernelWidths) {
+        for (int pattern = 0; pattern < kKernelPatterns; pattern++) {
+            // Seven rows: the Gaussian's five plus two to tell the vertical borders apart
+            cv::Mat image = kernelPattern(pattern, 7, width, rng);
+            cv::Mat padded = kernelPattern(pattern, 5, width + 4, rng);
+
+            std::vector<uint16_t> horizontal(5 * width);
+            std::vector<uint16_t> expectedHorizontal(5 * width);
+            const uint16_t* rows[5];
+            for (int k = 0; k < 5; k++) {
+                kernels.gaussianHorizontal(padded.ptr<uint8_t>(k) + 2, &horizontal[k * width], width);
+                scalar.gaussianHorizontal(padded.ptr<uint8_t>(k) + 2, &expectedHorizontal[k * width], width);
+                rows[k] = &expectedHorizontal[k * width];
+            }
+            if (horizontal != expectedHorizontal) {
+                return "horizontal Gaussian differs from the scalar reference";
+            }
+
+            std::vector<uint8_t> blurred(width);
+            std::vector<uint8_t> expectedBlurred(width);
+            kernels.gaussianVertical(rows, blurred.data(), width);
+            scalar.gaussianVertical(rows, expectedBlurred.data(), width);
+            if (blurred != expectedBlurred) {
+                return "vertical Gaussian differs from the scalar reference";
+            }
+
+            std::vector<int16_t> dx(width);
+            std::vector<int16_t> dy(width);
+            std::vector<int16_t> expectedDx(width);
+            std::vector<int16_t> expectedDy(width);
+            kernels.sobel3(padded.ptr<uint8_t>(0) + 1, padded.ptr<uint8_t>(1) + 1, padded.ptr<uint8_t>(2) + 1,
+                           dx.data(), dy.data(), width);
+            scalar.sobel3(padded.ptr<uint8_t>(0) + 1, padded.ptr<uint8_t>(1) + 1, padded.ptr<uint8_t>(2) + 1,
+                          expectedDx.data(), expectedDy.data(), width);
+            if (dx != expectedDx || dy != expectedDy) {
+                return "Sobel differs from the scalar reference";
+            }
+
+            if (kernels.sad(image.ptr<uint8_t>(0), image.ptr<uint8_t>(1), width) !=
+                scalar.sad(image.ptr<uint8_t>(0), image.ptr<uint8_t>(1), width)) {
+                return "SAD differs from the scalar reference";
+            }
+
+            std::vector<uint8_t> bits((width + 7) / 8);
+            std::vector<uint8_t> expectedBits((width + 7) / 8);
+            kernels.packBits(image.ptr<uint8_t>(0), bits.data(), width);
+            scalar.packBits(image.ptr<uint8_t>(0), expectedBits.data(), width);
+            std::vector<uint8_t> mask(width);
+            std::vector<uint8_t> expectedMask(width);
+            kernels.unpackBits(expectedBits.data(), mask.data(), width);
+            scalar.unpackBits(expectedBits.data(), expectedMask.data(), width);
+            if (bits != expectedBits || mask != expectedMask) {
+                return "bit packing differs from the scalar reference";
+            }
+
+            cv::Mat blur;
+            cv::Mat expectedBlur;
+            kernelGaussian(kernels, image, blur);
+            cv::GaussianBlur(image, expectedBlur, cv::Size(5, 5), 1.5, 1.5);
+            if (!sameImage(blur, expectedBlur)) {
+                return "Gaussian differs from cv::GaussianBlur";
+            }
+
+            cv::Mat sobelX;
+            cv::Mat sobelY;
+            cv::Mat expectedX;
+            cv::Mat expectedY;
+            kernelSobel(kernels, image, sobelX, sobelY);
+            cv::Sobel(image, expectedX, CV_16S, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+            cv::Sobel(image, expectedY, CV_16S, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+            if (!sameImage(sobelX, expectedX) || !sameImage(sobelY, expectedY)) {
+                return "Sobel differs from cv::Sobel";
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Gaussian (horizontal + vertical) and Sobel row kernels over a whole frame, with the
+// padding the fused engine uses. Registered once per implementation the CPU supports;
+// fails unless the implementation reproduces the scalar reference and OpenCV exactly.
+void rowKernelsCase(benchmark::State& state, const RowKernels* kernels) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    if (const char* mismatch = rowKernelMismatch(*kernels)) {
+        state.SkipWithError(mismatch);
+        return;
+    }
+    const int cols = gray->cols;
+    std::vector<uint8_t> padded(cols + 4);
+    std::vector<uint16_t> horizontal(5 * cols);
+    std::vector<uint8_t> blurred(3 * (cols + 2));
+    std::vector<int16_t> dx(cols);
+    std::vector<int16_t> dy(cols);
+
+    for (auto _ : state) {
+        for (int y = 0; y < gray->rows; y++) {
+            const uint8_t* row = gray->ptr<uint8_t>(y);
+            std::copy(row, row + cols, padded.begin() + 2);
+            kernels->gaussianHorizontal(padded.data() + 2, &horizontal[(y % 5) * cols], cols);
+            const uint16_t* rows[5] = {&horizontal[0], &horizontal[cols], &horizontal[2 * cols],
+                                       &horizontal[3 * cols], &horizontal[4 * cols]};
+            uint8_t* out = &blurred[(y % 3) * (cols + 2) + 1];
+            kernels->gaussianVertical(rows, out, cols);
+            kernels->sobel3(&blurred[1], &blurred[cols + 3], &blurred[2 * cols + 5],
+                            dx.data(), dy.data(), cols);
+        }
+        benchmark::DoNotOptimize(dx.data());
+        benchmark::DoNotOptimize(dy.data());
+    }
+    setPixelsProcessed(state, *gray);
+}
+
+// Cost of one timed scope, what EDGE_STAGE_TIMER adds to every instrumented stage,
+// without and with the frame trace recording it as well
+// Args: tracing
+void BM_StageTimer(benchmark::State& state) {
+    StageStats stats;
+    FrameTrace::global().setEnabled(state.range(0) != 0);
+    for (auto _ : state) {
+        ScopedStageTimer timer(Stage::Frame, stats);
+    }
+    FrameTrace::global().setEnabled(false);
+    state.counters["recorded"] = static_cast<double>(stats.histogram(Stage::Frame).count());
+}
+BENCHMARK(BM_StageTimer)->Arg(0)->Arg(1);
+
+// Views the display transform cases draw a 640x480 mask into: portrait, landscape,
+// square, and no viewport size yet (rotate and mirror only)
+const int kViews[][2] = {{1080, 2400}, {2400, 1080}, {1000, 1000}, {0, 0}};
+
+// Where the mask pixel (u, v) of a width x height mask should land in normalized device
+// coordinates, derived pixel by pixel: rotate the frame clockwise, mirror the upright
+// image, then center it in the view at the largest scale that fits
+void expectedPlacement(float u, float v, int width, int height, int rotation, bool mirror,
+                       int viewWidth, int viewHeight, float& ndcX, float& ndcY) {
+    float x = u;
+    float y = v;
+    float uprightWidth = static_cast<float>(width);
+    float uprightHeight = static_cast<float>(height);
+    if (rotation == 90) {
+        x = height - v;
+        y = u;
+    } else if (rotation == 180) {
+        x = width - u;
+        y = height - v;
+    } else if (rotation == 270) {
+        x = v;
+        y = width - u;
+    }
+    if (rotation == 90 || rotation == 270) {
+        std::swap(uprightWidth, uprightHeight);
+    }
+    if (mirror) {
+        x = uprightWidth - x;
+    }
+
+    float viewW = viewWidth > 0 ? static_cast<float>(viewWidth) : uprightWidth;
+    float viewH = viewHeight > 0 ? static_cast<float>(viewHeight) : uprightHeight;
+    float fit = std::min(viewW / uprightWidth, viewH / uprightHeight);
+    float screenX = (viewW - uprightWidth * fit) / 2 + x * fit;
+    float screenY = (viewH - uprightHeight * fit) / 2 + y * fit;
+    ndcX = 2 * screenX / viewW - 1;
+    ndcY = 1 - 2 * screenY / viewH;
+}
+
+// Matrix the renderer draws the edge mask with, for every rotation, mirroring and view
+// shape. The case fails unless the corners and an inner point of the mask land where
+// rotating, mirroring and letterboxing the frame puts them.
+// Args: rotation, mirror, view (see kViews)
+void BM_DisplayTransform(benchmark::State& state) {
+    const int width = 640;
+    const int height = 480;
+    const int rotation = static_cast<int>(state.range(0));
+    const bool mirror = state.range(1) != 0;
+    const int* view = kViews[state.range(2)];
+
+    // Rotations that are not a multiple of 90 degrees round to the nearest one
+    if (DisplayTransform::normalizeRotation(rotation + 44) != rotation ||
+        DisplayTransform::normalizeRotation(rotation - 44 - 360) != rotation) {
+        state.SkipWithError("a rotation did not round to the nearest quarter turn");
+        return;
+    }
+
+    DisplayTransform transform = DisplayTransform::compute(width, height, rotation, mirror,
+                                                           view[0], view[1]);
+    const float points[][2] = {{0, 0}, {width, 0}, {0, height}, {width, height}, {160, 60}};
+    for (const float* point : points) {
+        // The quad spans -1..1 with the first mask row at the top
+        float quadX = 2 * point[0] / width - 1;
+        float quadY = 1 - 2 * point[1] / height;
+        float x = 0.0f;
+        float y = 0.0f;
+        float expectedX = 0.0f;
+        float expectedY = 0.0f;
+        transform.apply(quadX, quadY, x, y);
+        expectedPlacement(point[0], point[1], width, height, rotation, mirror, view[0], view[1],
+                          expectedX, expectedY);
+        if (std::fabs(x - expectedX) > 1e-5f || std::fabs(y - expectedY) > 1e-5f) {
+            state.SkipWithError("the mask is not rotated, mirrored or letterboxed as expected");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        transform = DisplayTransform::compute(width, height, rotation, mirror, view[0], view[1]);
+        benchmark::DoNotOptimize(transform.matrix);
+    }
+}
+BENCHMARK(BM_DisplayTransform)
+    ->ArgsProduct({{0, 90, 180, 270}, {0, 1}, {0, 1, 2, 3}});
+
+// ---------------------------------------------------------------------------------
+// Engines and the full pipeline
+// ---------------------------------------------------------------------------------
+
+// Args: engine, resolution, source, low threshold
+void BM_Engine(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(1), state.range(2));
+    if (!gray) {
+        return;
+    }
+    static const char* kEngineNames[] = {"opencv", "parallel", "fused"};
+    state.SetLabel(std::string(kEngineNames[state.range(0)]) + "/" +
+                   kResolutions[state.range(1)].name + "/" + kSourceNames[state.range(2)]);
+
+    EdgeDetector detector;
+    detector.setEngine(static_cast<EdgeDetector::Engine>(state.range(0)));
+    detector.updateParameters(static_cast<int>(state.range(3)), 3, 3);
+    cv::Mat edges;
+
+    // Every engine must find exactly the OpenCV engine's edges
+    EdgeDetector reference;
+    reference.setEngine(EdgeDetector::ENGINE_OPENCV);
+    reference.updateParameters(static_cast<int>(state.range(3)), 3, 3);
+    cv::Mat expected;
+    reference.processLuma(*gray, expected);
+    detector.processLuma(*gray, edges);
+    if (cv::countNonZero(edges != expected) != 0) {
+        state.SkipWithError("edges differ from the OpenCV engine's");
+        return;
+    }
+
+    for (auto _ : state) {
+        detector.processLuma(*gray, edges);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_Engine)
+    ->ArgsProduct({{EdgeDetector::ENGINE_OPENCV, EdgeDetector::ENGINE_PARALLEL, EdgeDetector::ENGINE_FUSED},
+                   benchmark::CreateDenseRange(0, kResolutionCount - 1, 1),
+                   {SOURCE_SYNTHETIC, SOURCE_REAL}, kLowThresholds})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// The strip-parallel engine must give exactly the edges of GaussianBlur + cv::Canny on
+// the whole frame, for every aperture and on frames whose height splits unevenly into
+// strips or fits in a single one. Only the L1 gradient norm is checked, the only one the
+// engine implements.
+bool parallelMatchesOpenCv(ParallelCanny& canny, const cv::Mat& gray) {
+    const cv::Size sizes[] = {
+        gray.size(), {gray.cols - 7, gray.rows - 13}, {gray.cols / 3 + 1, gray.rows / 5 + 3}, {61, 23}
+    };
+    cv::Mat edges;
+    cv::Mat blur;
+    cv::Mat expected;
+    for (const cv::Size& size : sizes) {
+        cv::Mat frame = gray(cv::Rect(0, 0, size.width, size.height)).clone();
+        cv::GaussianBlur(frame, blur, cv::Size(5, 5), 1.5, 1.5);
+        for (int aperture : {3, 5, 7}) {
+            for (double low : {20.0, 50.0}) {
+                canny.process(frame, edges, low, low * 3, aperture);
+                cv::Canny(blur, expected, low, low * 3, aperture);
+                if (cv::countNonZero(edges != expected) != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Args: resolution, threads (registered in main up to the core count)
+void BM_ParallelCannyThreads(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    ThreadPool pool(static_cast<int>(state.range(1)));
+    ParallelCanny canny(pool);
+    if (!parallelMatchesOpenCv(canny, *gray)) {
+        state.SkipWithError("strip-parallel edges differ from GaussianBlur + cv::Canny");
+        return;
+    }
+    cv::Mat edges;
+    for (auto _ : state) {
+        canny.process(*gray, edges, 50, 150, 3);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    state.counters["threads"] = static_cast<double>(pool.threadCount());
+    state.counters["strips"] = static_cast<double>(canny.stripCount());
+    setPixelsProcessed(state, *gray);
+}
+
+// Luma-only detection of an NV21 frame must treat the last Y row as the bottom border
+// of the image, not read on into the chroma rows. The fused engine only ever sees the
+// rows it is given, so every engine's bottom rows must match its edges on the bare
+// gray frame.
+bool bottomRowsMatchFused(const cv::Mat& nv21, const cv::Mat& gray) {
+    const int rows = 8;
+    EdgeDetector fused;
+    fused.setEngine(EdgeDetector::ENGINE_FUSED);
+    cv::Mat expected;
+    fused.processLuma(gray, expected);
+
+    const EdgeDetector::Engine engines[] = {
+        EdgeDetector::ENGINE_OPENCV, EdgeDetector::ENGINE_PARALLEL, EdgeDetector::ENGINE_FUSED
+    };
+    for (EdgeDetector::Engine engine : engines) {
+        EdgeDetector detector;
+        detector.setLumaOnly(true);
+        detector.setEngine(engine);
+        cv::Mat edges;
+        detector.processNv21(nv21, edges);
+        if (edges.size() != expected.size()) {
+            return false;
+        }
+        const int top = gray.rows - rows;
+        if (cv::countNonZero(edges.rowRange(top, gray.rows) != expected.rowRange(top, gray.rows)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// From an NV21 camera frame to the edge mask. Args: resolution, luma-only
+void BM_Pipeline(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    state.SetLabel(std::string(kResolutions[state.range(0)].name) +
+                   (state.range(1) ? "/luma" : "/rgba"));
+
+    cv::Mat nv21 = nv21Frame(*gray);
+    EdgeDetector detector;
+    detector.setLumaOnly(state.range(1) != 0);
+    cv::Mat edges;
+    if (state.range(1) && !bottomRowsMatchFused(nv21, *gray)) {
+        state.SkipWithError("luma-only edges near the bottom border differ from the fused engine");
+        return;
+    }
+    for (auto _ : state) {
+        detector.processNv21(nv21, edges);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_Pipeline)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Several streams at once, each a session of one SessionEngine driven by its own
+// thread, all sharing the pool. Items are frames, so items_per_second is the aggregate
+// frame rate over all streams. Args: resolution, streams
+void BM_MultiStream(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const int streams = static_cast<int>(state.range(1));
+    const int framesPerStream = 4;
+
+    SessionEngine engine;
+    std::vector<SessionEngine::Handle> sessions;
+    std::vector<cv::Mat> edges(streams);
+    for (int i = 0; i < streams; i++) {
+        sessions.push_back(engine.create());
+    }
+
+    for (auto _ : state) {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < streams; i++) {
+            threads.emplace_back([&, i]() {
+                for (int frame = 0; frame < framesPerStream; frame++) {
+                    engine.process(sessions[i], *gray, edges[i]);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        benchmark::DoNotOptimize(edges.data());
+    }
+
+    state.counters["streams"] = streams;
+    state.counters["pool_threads"] = static_cast<double>(ThreadPool::shared().threadCount());
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * streams * framesPerStream);
+}
+BENCHMARK(BM_MultiStream)
+    ->ArgsProduct({{0, 1}, benchmark::CreateDenseRange(1, 8, 1)})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Cost against the area of one centered region of interest, from an NV21 frame (only
+// the region plus its halo is converted and detected). Items are full-frame pixels, so
+// items_per_second compares directly with BM_Pipeline.
+// Args: resolution, luma-only, region area in percent of the frame
+void BM_RegionOfInterest(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    state.SetLabel(std::string(kResolutions[state.range(0)].name) +
+                   (state.range(1) ? "/luma" : "/rgba"));
+
+    const double side = std::sqrt(state.range(2) / 100.0);
+    const int width = static_cast<int>(gray->cols * side);
+    const int height = static_cast<int>(gray->rows * side);
+    const cv::Rect region((gray->cols - width) / 2, (gray->rows - height) / 2, width, height);
+
+    cv::Mat nv21 = nv21Frame(*gray);
+    EdgeDetector detector;
+    detector.setLumaOnly(state.range(1) != 0);
+    detector.setRegions(&region, 1);
+    cv::Mat edges;
+    for (auto _ : state) {
+        detector.processNv21(nv21, edges);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    state.counters["roi_percent"] = static_cast<double>(state.range(2));
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_RegionOfInterest)
+    ->ArgsProduct({{0, 1}, {0, 1}, {100, 50, 25, 10, 5, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Most operator new calls of one call of fn, over a few calls after a warm-up call that
+// allocates its outputs
+template <typename Fn>
+uint64_t callAllocations(Fn&& fn) {
+    fn();
+    uint64_t most = 0;
+    for (int i = 0; i < 3; i++) {
+        uint64_t before = heapAllocationCount();
+        fn();
+        most = std::max(most, heapAllocationCount() - before);
+    }
+    return most;
+}
+
+// Operator new calls per frame that the OpenCV calls of a pipeline make on their own,
+// measured by making the same calls on the same data outside the pipeline: the color
+// conversions of the RGBA pipeline, then blur and Canny on the whole frame for the
+// OpenCV engine, or blur and both Sobel derivatives of every strip on the shared pool
+// for the parallel engine. The fused engine makes no OpenCV calls at this size.
+uint64_t openCvAllocationsPerFrame(int engine, bool lumaOnly, const cv::Mat& nv21,
+                                   const cv::Mat& gray, int low, int ratio) {
+    uint64_t total = 0;
+    cv::Mat rgba;
+    cv::Mat converted;
+    if (!lumaOnly) {
+        total += callAllocations([&] { cv::cvtColor(nv21, rgba, cv::COLOR_YUV2RGBA_NV21); });
+        total += callAllocations([&] { cv::cvtColor(rgba, converted, cv::COLOR_RGBA2GRAY); });
+    }
+    const cv::Mat& source = lumaOnly ? gray : converted;
+    const double scale = lumaOnly ? EdgeDetector::kLumaGradientScale : 1.0;
+
+    cv::Mat blur;
+    cv::Mat edges;
+    if (engine == EdgeDetector::ENGINE_OPENCV) {
+        total += callAllocations([&] { cv::GaussianBlur(source, blur, cv::Size(5, 5), 1.5, 1.5); });
+        total += callAllocations([&] { cv::Canny(blur, edges, low * scale, low * scale * ratio, 3); });
+    } else if (engine == EdgeDetector::ENGINE_PARALLEL) {
+        // Same strips as the pipeline's, each with its blur and Sobel halo
+        ParallelCanny canny;
+        canny.process(source, edges, low * scale, low * scale * ratio, 3);
+        const int count = canny.stripCount();
+        const int rows = source.rows;
+        std::vector<cv::Mat> blurs(count);
+        std::vector<cv::Mat> dx(count);
+        std::vector<cv::Mat> dy(count);
+        total += callAllocations([&] {
+            ThreadPool::shared().parallelFor(count, [&](int k) {
+                const int gradBegin = std::max(0, static_cast<int>(static_cast<long>(rows) * k / count) - 1);
+                const int gradEnd = std::min(rows, static_cast<int>(static_cast<long>(rows) * (k + 1) / count) + 1);
+                const int blurBegin = std::max(0, gradBegin - 1);
+                const int blurEnd = std::min(rows, gradEnd + 1);
+                cv::GaussianBlur(source.rowRange(blurBegin, blurEnd), blurs[k], cv::Size(5, 5), 1.5, 1.5);
+                cv::Mat gradSrc = blurs[k].rowRange(gradBegin - blurBegin, gradEnd - blurBegin);
+                cv::Sobel(gradSrc, dx[k], CV_16S, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+                cv::Sobel(gradSrc, dy[k], CV_16S, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+            });
+        });
+    }
+    return total;
+}
+
+// Steady state of the pipeline: after a warm-up frame every buffer must come back out
+// of the pool, so the case fails if the pool had to allocate while timing. What still
+// calls operator new per frame is inside OpenCV (temporary buffers and filter objects of
+// the calls above), so the case also fails if the pipeline makes more operator new
+// calls per frame than its OpenCV calls make on their own; for the fused engine in
+// luma-only mode that means none at all. Reports both per frame.
+// Args: engine, luma-only
+void BM_SteadyStateAllocations(benchmark::State& state) {
+    const int resolution = 1;
+    const int low = 50;
+    const int ratio = 3;
+    const cv::Mat* gray = caseFrame(state, resolution, SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    cv::Mat nv21 = nv21Frame(*gray);
+    const int engine = static_cast<int>(state.range(0));
+    const bool lumaOnly = state.range(1) != 0;
+    const uint64_t openCvAllocations = openCvAllocationsPerFrame(engine, lumaOnly, nv21, *gray, low, ratio);
+    EdgeDetector detector;
+    detector.setEngine(static_cast<EdgeDetector::Engine>(engine));
+    detector.setLumaOnly(lumaOnly);
+    detector.updateParameters(low, ratio, 3);
+    cv::Mat edges = BufferPool::shared().create(gray->rows, gray->cols, CV_8UC1);
+
+    // Warm-up: the first frame fills the pool
+    detector.processNv21(nv21, edges);
+
+    BufferPool::Stats before = BufferPool::shared().stats();
+    uint64_t heapBefore = heapAllocationCount();
+    for (auto _ : state) {
+        detector.processNv21(nv21, edges);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    uint64_t heapAllocations = heapAllocationCount() - heapBefore;
+    BufferPool::Stats after = BufferPool::shared().stats();
+
+    if (after.allocations != before.allocations) {
+        state.SkipWithError("pipeline buffers were allocated after warm-up");
+        return;
+    }
+    if (heapAllocations > openCvAllocations * state.iterations()) {
+        state.SkipWithError("the pipeline called operator new beyond its OpenCV calls");
+        return;
+    }
+    state.counters["pool_allocations"] = static_cast<double>(after.allocations - before.allocations);
+    state.counters["pool_reuses_per_frame"] =
+        benchmark::Counter(static_cast<double>(after.reuses - before.reuses),
+                           benchmark::Counter::kAvgIterations);
+    state.counters["heap_allocs_per_frame"] =
+        benchmark::Counter(static_cast<double>(heapAllocations), benchmark::Counter::kAvgIterations);
+    state.counters["opencv_allocs_per_frame"] = static_cast<double>(openCvAllocations);
+    state.counters["pool_peak_MB"] = after.peakBytes / (1024.0 * 1024.0);
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_SteadyStateAllocations)
+    ->ArgsProduct({{EdgeDetector::ENGINE_OPENCV, EdgeDetector::ENGINE_PARALLEL, EdgeDetector::ENGINE_FUSED},
+                   {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// The fused engine must give exactly the edges of GaussianBlur + cv::Canny on the whole
+// frame with every row kernel implementation the CPU supports, also on widths that are
+// no multiple of any vector width and on frames of a few rows and columns
+bool fusedMatchesOpenCv(const cv::Mat& gray) {
+    const cv::Size sizes[] = {
+        gray.size(), {gray.cols - 5, gray.rows - 3}, {gray.cols / 7, gray.rows / 9}, {65, 9}, {33, 17},
+        {7, 5}, {3, 3}
+    };
+    const RowKernels* implementations[] = {&RowKernels::scalar(), RowKernels::neon(),
+                                           RowKernels::sse41(), RowKernels::avx2()};
+    cv::Mat edges;
+    cv::Mat blur;
+    cv::Mat expected;
+    for (const cv::Size& size : sizes) {
+        cv::Mat frame = gray(cv::Rect(0, 0, size.width, size.height)).clone();
+        cv::GaussianBlur(frame, blur, cv::Size(5, 5), 1.5, 1.5);
+        for (const RowKernels* kernels : implementations) {
+            if (!kernels) {
+                continue;
+            }
+            FusedCanny fused(*kernels);
+            for (double low : {20.0, 50.0}) {
+                fused.process(frame, edges, low, low * 3);
+                cv::Canny(blur, expected, low, low * 3, 3);
+                if (cv::countNonZero(edges != expected) != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Fused engine with its memory footprint next to the three-pass path's; fails unless
+// its edges match GaussianBlur + cv::Canny. Args: resolution
+void BM_FusedFootprint(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    if (!fusedMatchesOpenCv(*gray)) {
+        state.SkipWithError("fused edges differ from GaussianBlur + cv::Canny");
+        return;
+    }
+    FusedCanny fused;
+    cv::Mat edges;
+    for (auto _ : state) {
+        fused.process(*gray, edges, 50, 150);
+        benchmark::DoNotOptimize(edges.data);
+    }
+    FusedCanny::MemoryReport fusedReport = fused.footprint();
+    FusedCanny::MemoryReport threePass = FusedCanny::threePassFootprint(gray->cols, gray->rows);
+    state.counters["fused_working_set_KB"] = fusedReport.workingSetBytes / 1024.0;
+    state.counters["fused_traffic_MB"] = fusedReport.trafficBytes / (1024.0 * 1024.0);
+    state.counters["3pass_working_set_KB"] = threePass.workingSetBytes / 1024.0;
+    state.counters["3pass_traffic_MB"] = threePass.trafficBytes / (1024.0 * 1024.0);
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_FusedFootprint)->DenseRange(0, kResolutionCount - 1)->Unit(benchmark::kMillisecond);
+
+// ---------------------------------------------------------------------------------
+// Compact output formats
+// ---------------------------------------------------------------------------------
+
+enum EdgeFormat {
+    FORMAT_PACKED = 0,
+    FORMAT_RUNS = 1,
+    FORMAT_POINTS = 2
+};
+
+// Encoding or decoding the edge mask of a frame in one of the compact formats. The case
+// fails unless the format round-trips the mask exactly, and reports its size next to
+// the mask's and the RGBA expansion's. Args: format, resolution, decode
+void BM_EdgeFormat(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(1), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    static const char* kFormatNames[] = {"packed", "runs", "points"};
+    const int format = static_cast<int>(state.range(0));
+    const bool decode = state.range(2) != 0;
+    state.SetLabel(std::string(kFormatNames[format]) + "/" + kResolutions[state.range(1)].name +
+                   (decode ? "/decode" : "/encode"));
+
+    EdgeDetector detector;
+    cv::Mat mask;
+    detector.processLuma(*gray, mask);
+
+    EdgeFormats formats;
+    PackedEdges packed;
+    EdgeRuns runs;
+    EdgePoints points;
+    cv::Mat decoded;
+    auto encode = [&]() {
+        switch (format) {
+            case FORMAT_PACKED:
+                formats.pack(mask, packed);
+                break;
+            case FORMAT_RUNS:
+                formats.encodeRuns(mask, runs);
+                break;
+            default:
+                formats.listPoints(mask, points);
+                break;
+        }
+    };
+    auto expand = [&]() {
+        switch (format) {
+            case FORMAT_PACKED:
+                formats.unpack(packed, decoded);
+                break;
+            case FORMAT_RUNS:
+                formats.decodeRuns(runs, decoded);
+                break;
+            default:
+                formats.drawPoints(points, decoded);
+                break;
+        }
+    };
+
+    encode();
+    expand();
+    if (cv::countNonZero(decoded != mask) != 0) {
+        state.SkipWithError("format does not round-trip the edge mask");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (decode) {
+            expand();
+            benchmark::DoNotOptimize(decoded.data);
+        } else {
+            encode();
+            benchmark::ClobberMemory();
+        }
+    }
+
+    const double bytes = format == FORMAT_PACKED ? packed.bytes()
+                       : format == FORMAT_RUNS ? runs.bytes() : points.bytes();
+    const double maskBytes = static_cast<double>(mask.total());
+    state.counters["format_KB"] = bytes / 1024.0;
+    state.counters["vs_mask"] = maskBytes / bytes;
+    state.counters["vs_rgba"] = 4 * maskBytes / bytes;
+    state.counters["edge_percent"] = 100.0 * cv::countNonZero(mask) / maskBytes;
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_EdgeFormat)
+    ->ArgsProduct({{FORMAT_PACKED, FORMAT_RUNS, FORMAT_POINTS},
+                   benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Streaming delta code of an edge mask against the previous frame, where the middle of
+// the scene moved by a few pixels; arg 1 codes a keyframe instead
+void BM_EdgeDelta(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const bool keyframe = state.range(1) != 0;
+    state.SetLabel(std::string(kResolutions[state.range(0)].name) + (keyframe ? "/keyframe" : "/delta"));
+
+    cv::Mat moved = gray->clone();
+    cv::Rect middle(gray->cols / 4, gray->rows / 4, gray->cols / 2, gray->rows / 2);
+    cv::Mat shifted = moved(middle + cv::Point(3, 2));
+    (*gray)(middle).copyTo(shifted);
+
+    EdgeDetector detector;
+    cv::Mat before;
+    cv::Mat after;
+    detector.processLuma(*gray, before);
+    detector.processLuma(moved, after);
+
+    EdgeFormats formats;
+    PackedEdges previous;
+    PackedEdges current;
+    formats.pack(before, previous);
+    formats.pack(after, current);
+
+    std::vector<uint8_t> code;
+    formats.encodeDelta(current, keyframe ? nullptr : &previous, code);
+    PackedEdges decoded = previous;
+    if (keyframe) {
+        std::fill(decoded.bits.begin(), decoded.bits.end(), 0);
+    }
+    if (!formats.applyDelta(code.data(), code.size(), decoded) || decoded.bits != current.bits) {
+        state.SkipWithError("delta code does not round-trip the packed mask");
+        return;
+    }
+
+    for (auto _ : state) {
+        code.clear();
+        formats.encodeDelta(current, keyframe ? nullptr : &previous, code);
+        benchmark::DoNotOptimize(code.data());
+    }
+
+    state.counters["code_KB"] = code.size() / 1024.0;
+    state.counters["vs_packed"] = static_cast<double>(current.bytes()) / code.size();
+    state.counters["vs_mask"] = static_cast<double>(after.total()) / code.size();
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_EdgeDelta)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {0, 1}})
+    ->Unit(benchmark::kMillisecond);
+
+// Args: resolution, threads (registered in main up to the core count), Douglas-Peucker
+// epsilon in tenths of a pixel. The mask is detected with a low threshold of 20, which
+// keeps the texture of the scene as a dense tangle of short, branching edges.
+void BM_EdgeLinkThreads(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const double epsilon = state.range(2) / 10.0;
+    cv::Mat edges;
+    ParallelCanny(ThreadPool::shared()).process(*gray, edges, 20, 60, 3);
+
+    ThreadPool single(1);
+    EdgeContours expected;
+    EdgeLinker(single).link(edges, expected, epsilon);
+
+    ThreadPool pool(static_cast<int>(state.range(1)));
+    EdgeLinker linker(pool);
+    EdgeContours contours;
+    linker.link(edges, contours, epsilon);
+    if (contours.start != expected.start || contours.xy != expected.xy) {
+        state.SkipWithError("polylines depend on the thread count");
+        return;
+    }
+
+    for (auto _ : state) {
+        linker.link(edges, contours, epsilon);
+        benchmark::DoNotOptimize(contours.xy.data());
+    }
+
+    state.counters["threads"] = static_cast<double>(pool.threadCount());
+    state.counters["strips"] = static_cast<double>(linker.stripCount());
+    state.counters["components"] = static_cast<double>(linker.componentCount());
+    state.counters["contours"] = static_cast<double>(contours.contourCount());
+    state.counters["points"] = static_cast<double>(contours.pointCount());
+    state.counters["contours_KB"] = contours.bytes() / 1024.0;
+    state.counters["edge_percent"] = 100.0 * cv::countNonZero(edges) / edges.total();
+    setPixelsProcessed(state, *gray);
+}
+
+enum SweepMode {
+    SWEEP_FULL_RUNS = 0,   // blur, gradients and hysteresis for every pair
+    SWEEP_MASKS = 1,       // gradients once, one edge mask per pair
+    SWEEP_LEVELS = 2       // gradients once, one threshold level map for all pairs
+};
+
+// Args: sweep mode, resolution, number of threshold pairs (low 20, 30, ..., high 3x low)
+void BM_ThresholdSweep(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(1), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const int mode = static_cast<int>(state.range(0));
+    static const char* const kModes[] = {"full-runs", "masks", "levels"};
+    state.SetLabel(std::string(kResolutions[state.range(1)].name) + "/" + kModes[mode]);
+
+    std::vector<ParallelCanny::Thresholds> thresholds;
+    for (int i = 0; i < state.range(2); i++) {
+        thresholds.push_back({20.0 + 10 * i, 60.0 + 30 * i});
+    }
+
+    ParallelCanny canny;
+    std::vector<cv::Mat> edges(thresholds.size());
+    cv::Mat levels;
+    cv::Mat expected;
+    canny.computeGradients(*gray, thresholds.front().low, 3);
+    for (const ParallelCanny::Thresholds& pair : thresholds) {
+        canny.hysteresis(edges[0], pair.low, pair.high);
+        canny.process(*gray, expected, pair.low, pair.high, 3);
+        canny.computeGradients(*gray, thresholds.front().low, 3);
+        if (cv::countNonZero(edges[0] != expected) != 0) {
+            state.SkipWithError("shared gradients change the edges");
+            return;
+        }
+    }
+
+    for (auto _ : state) {
+        if (mode == SWEEP_FULL_RUNS) {
+            for (size_t i = 0; i < thresholds.size(); i++) {
+                canny.process(*gray, edges[i], thresholds[i].low, thresholds[i].high, 3);
+            }
+        } else {
+            canny.computeGradients(*gray, thresholds.front().low, 3);
+            if (mode == SWEEP_MASKS) {
+                for (size_t i = 0; i < thresholds.size(); i++) {
+                    canny.hysteresis(edges[i], thresholds[i].low, thresholds[i].high);
+                }
+            } else {
+                canny.thresholdLevels(thresholds, levels);
+            }
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["pairs"] = static_cast<double>(thresholds.size());
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_ThresholdSweep)
+    ->ArgsProduct({{SWEEP_FULL_RUNS, SWEEP_MASKS, SWEEP_LEVELS},
+                   benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {4, 16}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Parameters tagged with a frame number: the tag is the first frame they are staged for,
+// the thresholds derive from it, and fields that have no effect while incremental mode
+// and linking are off repeat it, so a frame running with a torn copy is detected
+SessionEngine::Parameters taggedParameters(uint64_t tag) {
+    SessionEngine::Parameters parameters;
+    parameters.lowThreshold = 20 + static_cast<int>(tag % 40);
+    parameters.changeSensitivity = static_cast<double>(tag);
+    parameters.minContourPixels = static_cast<int>(tag);
+    return parameters;
+}
+
+bool isTagged(const SessionEngine::Parameters& parameters) {
+    uint64_t tag = static_cast<uint64_t>(parameters.minContourPixels);
+    return parameters.lowThreshold == 20 + static_cast<int>(tag % 40) &&
+           parameters.changeSensitivity == static_cast<double>(tag) &&
+           parameters.ratio == 3 && !parameters.incremental && !parameters.linkEdges;
+}
+
+// Frames of one session while writer threads stage tagged parameters for the next few
+// frames and untagged edits as fast as they can; the session's frames never lock out
+// the writers or wait for them. Every frame must run with whole parameters staged for
+// it or earlier, and a change staged for a later frame must take effect exactly at that
+// frame, whatever is staged untagged meanwhile. Items are frames. Args: resolution,
+// writers
+void BM_ParameterUpdates(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(0), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const int writers = static_cast<int>(state.range(1));
+
+    SessionEngine engine;
+    SessionEngine::Handle session = engine.create();
+    cv::Mat edges;
+    SessionEngine::Parameters applied;
+
+    // Without writers: a change staged three frames ahead applies at exactly that frame,
+    // and untagged changes staged after it neither pull it forward nor drop it
+    uint64_t first = 0;
+    engine.setParameters(session, taggedParameters(0));
+    engine.process(session, *gray, edges);
+    engine.frameCount(session, first);
+    engine.setParameters(session, taggedParameters(first + 3), first + 3);
+    SessionEngine::Parameters untagged = taggedParameters(0);
+    untagged.simplifyEpsilon = 1.0;
+    engine.setParameters(session, untagged);
+    engine.modifyParameters(session, [](SessionEngine::Parameters& parameters) {
+        parameters.simplifyEpsilon = 2.0;
+    });
+    for (uint64_t frame = first; frame <= first + 3; frame++) {
+        engine.process(session, *gray, edges);
+        engine.appliedParameters(session, applied);
+        uint64_t expected = frame < first + 3 ? 0 : first + 3;
+        if (!isTagged(applied) || static_cast<uint64_t>(applied.minContourPixels) != expected ||
+            applied.simplifyEpsilon != 2.0) {
+            state.SkipWithError("a staged change took effect at the wrong frame or was lost");
+            return;
+        }
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> updates{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < writers; i++) {
+        threads.emplace_back([&, i]() {
+            uint64_t count = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                uint64_t next = 0;
+                engine.frameCount(session, next);
+                uint64_t frame = next + (count + i) % 4;
+                if (count % 2 == 0) {
+                    engine.setParameters(session, taggedParameters(frame), frame);
+                } else {
+                    // Must not carry the changes waiting for later frames into the next one
+                    engine.modifyParameters(session, [count](SessionEngine::Parameters& parameters) {
+                        parameters.simplifyEpsilon = static_cast<double>(count);
+                    });
+                }
+                count++;
+            }
+            updates.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+
+    uint64_t frames = 0;
+    for (auto _ : state) {
+        uint64_t frame = 0;
+        engine.frameCount(session, frame);
+        engine.process(session, *gray, edges);
+        engine.appliedParameters(session, applied);
+        if (!isTagged(applied) || static_cast<uint64_t>(applied.minContourPixels) > frame) {
+            state.SkipWithError("a frame saw a torn or early parameter change");
+            break;
+        }
+        frames++;
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    state.counters["writers"] = writers;
+    state.counters["updates"] = benchmark::Counter(static_cast<double>(updates.load()),
+                                                   benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(static_cast<int64_t>(frames));
+}
+BENCHMARK(BM_ParameterUpdates)
+    ->ArgsProduct({benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {1, 4}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// The parameter handoff alone, with no detection between frames, so that writers and
+// the frame loop overlap on every access: the stress case for ThreadSanitizer builds
+// (EDGECORE_TSAN). Writers mix tagged snapshots, tagged edits and untagged edits and
+// snapshots; every frame must see whole parameters staged for it or earlier. Items are
+// frames. Args: writers
+void BM_StagedSnapshots(benchmark::State& state) {
+    const int writers = static_cast<int>(state.range(0));
+    StagedSnapshots<SessionEngine::Parameters> snapshots;
+    snapshots.stage(taggedParameters(0));
+    std::atomic<uint64_t> started{0};
+
+    std::atomic<bool> running{true};
+    std::atomic<uint64_t> updates{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < writers; i++) {
+        threads.emplace_back([&, i]() {
+            uint64_t count = 0;
+            while (running.load(std::memory_order_relaxed)) {
+                const uint64_t next = started.load(std::memory_order_relaxed);
+                const uint64_t frame = next + (count + i) % 4;
+                switch (count % 4) {
+                case 0:
+                    snapshots.stage(taggedParameters(frame), frame);
+                    break;
+                case 1:
+                    snapshots.modify([frame](SessionEngine::Parameters& parameters) {
+                        parameters = taggedParameters(frame);
+                    }, frame);
+                    break;
+                case 2:
+                    snapshots.modify([count](SessionEngine::Parameters& parameters) {
+                        parameters.simplifyEpsilon = static_cast<double>(count);
+                    });
+                    break;
+                default:
+                    snapshots.stage(taggedParameters(next));
+                    break;
+                }
+                count++;
+            }
+            updates.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+
+    SessionEngine::Parameters current;
+    uint64_t frame = 0;
+    uint64_t changes = 0;
+    for (auto _ : state) {
+        if (snapshots.acquire(frame, current)) {
+            changes++;
+        }
+        if (!isTagged(current) || static_cast<uint64_t>(current.minContourPixels) > frame) {
+            state.SkipWithError("a frame saw a torn or early parameter change");
+            break;
+        }
+        frame++;
+        started.store(frame, std::memory_order_relaxed);
+    }
+
+    running.store(false, std::memory_order_relaxed);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    state.counters["writers"] = writers;
+    state.counters["changes"] = static_cast<double>(changes);
+    state.counters["updates"] = benchmark::Counter(static_cast<double>(updates.load()),
+                                                   benchmark::Counter::kIsRate);
+    state.SetItemsProcessed(static_cast<int64_t>(frame));
+}
+BENCHMARK(BM_StagedSnapshots)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+
+enum GradientMode {
+    GRADIENTS_OFF = 0,          // edges only
+    GRADIENTS_IN_PASS = 1,      // edges plus gradient planes and histograms, one Sobel pass
+    GRADIENTS_SECOND_PASS = 2   // edges, then blur and Sobel again for the same outputs
+};
+
+// Gradient planes and tile histograms the way a downstream feature computes them on
+// its own: blur and Sobel again, then magnitude, atan2 orientation and histograms
+void separateGradients(const cv::Mat& gray, ParallelCanny::Gradients& gradients, cv::Mat& blur,
+                       cv::Mat& dx, cv::Mat& dy) {
+    const int bins = ParallelCanny::kOrientationBins;
+    const int tile = gradients.tileSize;
+    cv::GaussianBlur(gray, blur, cv::Size(5, 5), 1.5, 1.5);
+    cv::Sobel(blur, dx, CV_16S, 1, 0, 3, 1, 0, cv::BORDER_REPLICATE);
+    cv::Sobel(blur, dy, CV_16S, 0, 1, 3, 1, 0, cv::BORDER_REPLICATE);
+
+    gradients.magnitude.create(gray.size(), CV_16SC1);
+    gradients.orientation.create(gray.size(), CV_8UC1);
+    gradients.histograms.create((gray.rows + tile - 1) / tile,
+                                (gray.cols + tile - 1) / tile * bins, CV_32SC1);
+    gradients.histograms.setTo(0);
+    for (int y = 0; y < gray.rows; y++) {
+        const short* gx = dx.ptr<short>(y);
+        const short* gy = dy.ptr<short>(y);
+        short* magnitude = gradients.magnitude.ptr<short>(y);
+        uchar* orientation = gradients.orientation.ptr<uchar>(y);
+        int* histogram = gradients.histograms.ptr<int>(y / tile);
+        for (int x = 0; x < gray.cols; x++) {
+            float angle = cv::fastAtan2(gy[x], gx[x]);
+            angle = angle >= 180.0f ? angle - 180.0f : angle;
+            const int bin = std::min(bins - 1, static_cast<int>(angle / 20.0f));
+            magnitude[x] = static_cast<short>(std::abs(gx[x]) + std::abs(gy[x]));
+            orientation[x] = static_cast<uchar>(bin);
+            histogram[x / tile * bins + bin] += magnitude[x];
+        }
+    }
+}
+
+// Gradient planes and histograms from the Sobel pass of edge detection, against edges
+// alone and against computing them in a second pass. The case fails unless the
+// magnitudes match a separate Sobel pass, every orientation bin is the one of the exact
+// atan2 angle (or the gradient lies within a hundredth of a degree of the bin border)
+// and the histograms sum up the planes.
+// Args: gradient mode, resolution, tile size
+void BM_GradientOutput(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(1), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const int mode = static_cast<int>(state.range(0));
+    static const char* const kModes[] = {"off", "in-pass", "second-pass"};
+    state.SetLabel(std::string(kResolutions[state.range(1)].name) + "/" + kModes[mode]);
+
+    const int bins = ParallelCanny::kOrientationBins;
+    ParallelCanny canny;
+    ParallelCanny::Gradients gradients;
+    ParallelCanny::Gradients reference;
+    gradients.tileSize = static_cast<int>(state.range(2));
+    reference.tileSize = gradients.tileSize;
+    cv::Mat edges;
+    cv::Mat blur;
+    cv::Mat dx;
+    cv::Mat dy;
+
+    canny.process(*gray, edges, 50, 150, 3, &gradients);
+    separateGradients(*gray, reference, blur, dx, dy);
+    cv::Mat sums = cv::Mat::zeros(gradients.histograms.size(), CV_32SC1);
+    for (int y = 0; y < gray->rows; y++) {
+        for (int x = 0; x < gray->cols; x++) {
+            const int bin = gradients.orientation.at<uchar>(y, x);
+            sums.at<int>(y / gradients.tileSize, x / gradients.tileSize * bins + bin) +=
+                gradients.magnitude.at<short>(y, x);
+            double angle = std::atan2(dy.at<short>(y, x), dx.at<short>(y, x)) * 180.0 / CV_PI;
+            angle = angle < 0.0 ? angle + 180.0 : angle >= 180.0 ? angle - 180.0 : angle;
+            if (bin != std::min(bins - 1, static_cast<int>(angle / 20.0)) &&
+                std::abs(angle - 20.0 * std::round(angle / 20.0)) > 0.01) {
+                state.SkipWithError("in-pass orientations differ from a separate Sobel pass");
+                return;
+            }
+        }
+    }
+    if (cv::countNonZero(gradients.magnitude != reference.magnitude) != 0 ||
+        cv::countNonZero(sums != gradients.histograms) != 0) {
+        state.SkipWithError("in-pass magnitudes or histograms differ from a second pass");
+        return;
+    }
+
+    for (auto _ : state) {
+        canny.process(*gray, edges, 50, 150, 3, mode == GRADIENTS_IN_PASS ? &gradients : nullptr);
+        if (mode == GRADIENTS_SECOND_PASS) {
+            separateGradients(*gray, reference, blur, dx, dy);
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["tiles"] = static_cast<double>(gradients.histograms.total() / bins);
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_GradientOutput)
+    ->ArgsProduct({{GRADIENTS_OFF, GRADIENTS_IN_PASS, GRADIENTS_SECOND_PASS},
+                   benchmark::CreateDenseRange(0, kResolutionCount - 1, 1), {8, 32}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Edge density per tile the way analytics compute it from the mask afterwards: edge
+// pixels per tile, and their mean magnitude from a separate blur and Sobel pass
+void separateDensity(const cv::Mat& gray, const cv::Mat& edges,
+                     ParallelCanny::EdgeDensity& density, ParallelCanny::Gradients& gradients,
+                     cv::Mat& blur, cv::Mat& dx, cv::Mat& dy) {
+    const int tile = density.tileSize;
+    separateGradients(gray, gradients, blur, dx, dy);
+    density.counts.create((edges.rows + tile - 1) / tile, (edges.cols + tile - 1) / tile,
+                          CV_32SC1);
+    density.strength.create(density.counts.size(), CV_32FC1);
+    density.counts.setTo(0);
+    density.strength.setTo(0);
+    for (int y = 0; y < edges.rows; y++) {
+        const uchar* edge = edges.ptr<uchar>(y);
+        const short* magnitude = gradients.magnitude.ptr<short>(y);
+        int* counts = density.counts.ptr<int>(y / tile);
+        float* strength = density.strength.ptr<float>(y / tile);
+        for (int x = 0; x < edges.cols; x++) {
+            if (edge[x]) {
+                counts[x / tile]++;
+                strength[x / tile] += magnitude[x];
+            }
+        }
+    }
+    for (int r = 0; r < density.counts.rows; r++) {
+        for (int c = 0; c < density.counts.cols; c++) {
+            const int count = density.counts.at<int>(r, c);
+            float& strength = density.strength.at<float>(r, c);
+            strength = count > 0 ? strength / count : 0.0f;
+        }
+    }
+}
+
+// Edge density per tile counted while the mask is written, against edges alone and
+// against counting the mask and differentiating the frame again afterwards. The case
+// fails unless the in-pass grid matches the one counted afterwards.
+// Args: density mode (off, in-pass, second pass as for BM_GradientOutput), resolution
+void BM_EdgeDensity(benchmark::State& state) {
+    const cv::Mat* gray = caseFrame(state, state.range(1), SOURCE_SYNTHETIC);
+    if (!gray) {
+        return;
+    }
+    const int mode = static_cast<int>(state.range(0));
+    static const char* const kModes[] = {"off", "in-pass", "second-pass"};
+    state.SetLabel(std::string(kResolutions[state.range(1)].name) + "/" + kModes[mode]);
+
+    ParallelCanny canny;
+    ParallelCanny::EdgeDensity density;
+    ParallelCanny::EdgeDensity reference;
+    ParallelCanny::Gradients gradients;
+    cv::Mat edges;
+    cv::Mat blur;
+    cv::Mat dx;
+    cv::Mat dy;
+
+    canny.process(*gray, edges, 50, 150, 3, nullptr, &density);
+    separateDensity(*gray, edges, reference, gradients, blur, dx, dy);
+    if (cv::countNonZero(density.counts != reference.counts) != 0) {
+        state.SkipWithError("in-pass edge counts differ from counting the mask");
+        return;
+    }
+    for (int r = 0; r < density.strength.rows; r++) {
+        for (int c = 0; c < density.strength.cols; c++) {
+            const float expected = reference.strength.at<float>(r, c);
+            if (std::abs(density.strength.at<float>(r, c) - expected) > 1e-3f * (1.0f + expected)) {
+                state.SkipWithError("in-pass edge strength differs from a second Sobel pass");
+                return;
+            }
+        }
+    }
+
+    for (auto _ : state) {
+        canny.process(*gray, edges, 50, 150, 3, nullptr,
+                      mode == GRADIENTS_IN_PASS ? &density : nullptr);
+        if (mode == GRADIENTS_SECOND_PASS) {
+            separateDensity(*gray, edges, reference, gradients, blur, dx, dy);
+        }
+        benchmark::ClobberMemory();
+    }
+
+    state.counters["tiles"] = static_cast<double>(density.counts.total());
+    setPixelsProcessed(state, *gray);
+}
+BENCHMARK(BM_EdgeDensity)
+    ->ArgsProduct({{GRADIENTS_OFF, GRADIENTS_IN_PASS, GRADIENTS_SECOND_PASS},
+                   benchmark::CreateDenseRange(0, kResolutionCount - 1, 1)})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+} // namespace
+
+int main(int argc, char** argv) {
+    // Constructor logs would interleave with the result table
+    setLogSink(nullLogSink);
+
+    const RowKernels* implementations[] = {&RowKernels::scalar(), RowKernels::neon(),
+                                           RowKernels::sse41(), RowKernels::avx2()};
+    for (const RowKernels* kernels : implementations) {
+        if (!kernels) {
+            continue;
+        }
+        std::string name = std::string("BM_RowKernels/") + kernels->name;
+        benchmark::RegisterBenchmark(name.c_str(), rowKernelsCase, kernels)
+            ->DenseRange(0, kResolutionCount - 1)
+            ->Unit(benchmark::kMillisecond);
+    }
+
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    for (int resolution = 0; resolution < kResolutionCount; resolution++) {
+        for (int threads = 1; threads <= maxThreads; threads++) {
+            benchmark::RegisterBenchmark("BM_ParallelCannyThreads", BM_ParallelCannyThreads)
+                ->Args({resolution, threads})
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+    for (int resolution = 0; resolution < kResolutionCount; resolution++) {
+        for (int threads = 1; threads <= maxThreads; threads++) {
+            benchmark::RegisterBenchmark("BM_EdgeLinkThreads", BM_EdgeLinkThreads)
+                ->ArgsProduct({{resolution}, {threads}, {0, 15}})
+                ->Unit(benchmark::kMillisecond)
+                ->UseRealTime();
+        }
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
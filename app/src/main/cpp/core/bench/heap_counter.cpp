@@ -0,0 +1,42 @@
+#include "heap_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Kept in its own translation unit, so the compiler never pairs an inlined
+// replacement new with a free() in the benchmark code
+
+static std::atomic<uint64_t> gHeapAllocations{0};
+
+uint64_t heapAllocationCount() {
+    return gHeapAllocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    gHeapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
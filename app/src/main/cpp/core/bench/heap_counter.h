@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Get the number of operator new calls of the whole process so far. The benchmark
+ * binary replaces the global operator new to count them.
+ */
+uint64_t heapAllocationCount();
@@ -0,0 +1,136 @@
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+BufferPool::BufferPool(size_t maxIdleBytes) : mMaxIdleBytes(maxIdleBytes) {}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+BufferPool& BufferPool::shared() {
+    // Never destroyed: global Mats may still give buffers back during exit
+    static BufferPool* pool = new BufferPool();
+    return *pool;
+}
+
+cv::UMatData* BufferPool::allocate(int dims, const int* sizes, int type, void* data,
+                                   size_t* step, cv::AccessFlag /*flags*/,
+                                   cv::UMatUsageFlags /*usageFlags*/) const {
+    // Same layout rules as OpenCV's default allocator
+    size_t total = CV_ELEM_SIZE(type);
+    for (int i = dims - 1; i >= 0; i--) {
+        if (step) {
+            if (data && step[i] != CV_AUTOSTEP) {
+                total = step[i];
+            } else {
+                step[i] = total;
+            }
+        }
+        total *= sizes[i];
+    }
+
+    if (data) {
+        // Wraps caller memory, nothing to pool
+        cv::UMatData* u = new cv::UMatData(this);
+        u->data = u->origdata = static_cast<uchar*>(data);
+        u->size = total;
+        u->flags |= cv::UMatData::USER_ALLOCATED;
+        return u;
+    }
+
+    std::lock_guard<std::mutex> guard(mLock);
+
+    // Exact size match, most recently idle first: it is the likeliest to be cached
+    for (int i = mIdleCount - 1; i >= 0; i--) {
+        cv::UMatData* u = mIdle[i];
+        if (u->size != total) {
+            continue;
+        }
+        std::copy(mIdle + i + 1, mIdle + mIdleCount, mIdle + i);
+        mIdleCount--;
+
+        u->refcount = 0;
+        u->urefcount = 0;
+        u->flags = static_cast<cv::UMatData::MemoryFlag>(0);
+        u->data = u->origdata;
+        mStats.reuses++;
+        mStats.idleBytes -= total;
+        mStats.liveBytes += total;
+        return u;
+    }
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kAlignment, std::max<size_t>(total, 1)) != 0) {
+        CV_Error_(cv::Error::StsNoMem, ("BufferPool failed to allocate %zu bytes", total));
+    }
+    cv::UMatData* u = new cv::UMatData(this);
+    u->data = u->origdata = static_cast<uchar*>(memory);
+    u->size = total;
+
+    mStats.allocations++;
+    mStats.liveBytes += total;
+    mStats.peakBytes = std::max(mStats.peakBytes, mStats.liveBytes + mStats.idleBytes);
+    return u;
+}
+
+bool BufferPool::allocate(cv::UMatData* data, cv::AccessFlag /*accessFlags*/,
+                          cv::UMatUsageFlags /*usageFlags*/) const {
+    // Host memory is always accessible
+    return data != nullptr;
+}
+
+void BufferPool::deallocate(cv::UMatData* u) const {
+    if (!u) {
+        return;
+    }
+    CV_Assert(u->urefcount == 0 && u->refcount == 0);
+
+    if (u->flags & cv::UMatData::USER_ALLOCATED) {
+        delete u;
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(mLock);
+    mStats.liveBytes -= u->size;
+
+    if (u->size > mMaxIdleBytes) {
+        release(u);
+        mStats.frees++;
+        return;
+    }
+    while (mIdleCount == kMaxIdleBuffers || mStats.idleBytes + u->size > mMaxIdleBytes) {
+        evictOldest();
+    }
+    mIdle[mIdleCount++] = u;
+    mStats.idleBytes += u->size;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> guard(mLock);
+    return mStats;
+}
+
+void BufferPool::trim() {
+    std::lock_guard<std::mutex> guard(mLock);
+    while (mIdleCount > 0) {
+        evictOldest();
+    }
+}
+
+void BufferPool::evictOldest() const {
+    cv::UMatData* u = mIdle[0];
+    std::copy(mIdle + 1, mIdle + mIdleCount, mIdle);
+    mIdleCount--;
+    mStats.idleBytes -= u->size;
+    mStats.frees++;
+    release(u);
+}
+
+void BufferPool::release(cv::UMatData* u) {
+    std::free(u->origdata);
+    u->origdata = nullptr;
+    u->data = nullptr;
+    delete u;
+}
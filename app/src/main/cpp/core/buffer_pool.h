@@ -0,0 +1,114 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * BufferPool - Recycles the pixel buffers of the native pipeline across frames
+ *
+ * The pool is an OpenCV MatAllocator. A Mat attached to it takes its storage from the
+ * pool whenever it is (re)created, including as the output of OpenCV calls such as
+ * cvtColor, and hands the storage back when its last reference goes away. Idle buffers
+ * are kept by exact byte size, i.e. per resolution and format, so the next frame of
+ * the same size gets the very same buffer back. After the first frame at a resolution
+ * the pipeline buffers never touch the heap again.
+ *
+ * Every buffer starts on a 64-byte boundary, a cache line and the widest SIMD vector.
+ * Idle buffers are bounded by a byte budget: when a resolution change would exceed it,
+ * the buffers idle the longest go back to the heap first.
+ *
+ * Thread safe. Scratch memory OpenCV allocates inside its own functions is not covered.
+ */
+class BufferPool : public cv::MatAllocator {
+public:
+    static constexpr size_t kAlignment = 64;
+
+    // Default budget for idle buffers, a few frames worth of 4K RGBA
+    static constexpr size_t kDefaultIdleBytes = 128u << 20;
+
+    /**
+     * Pool counters
+     */
+    struct Stats {
+        uint64_t allocations;   // buffers taken from the heap
+        uint64_t reuses;        // buffers handed out again from the pool
+        uint64_t frees;         // buffers given back to the heap (over budget or trimmed)
+        uint64_t liveBytes;     // bytes held by Mats right now
+        uint64_t idleBytes;     // bytes waiting in the pool
+        uint64_t peakBytes;     // highest liveBytes + idleBytes so far
+    };
+
+    /**
+     * Constructor
+     *
+     * @param maxIdleBytes Upper bound for the bytes kept idle between frames
+     */
+    explicit BufferPool(size_t maxIdleBytes = kDefaultIdleBytes);
+
+    /**
+     * Destructor - frees the idle buffers; Mats still using the pool must be gone
+     */
+    ~BufferPool() override;
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * Make a Mat draw its storage from the pool from its next (re)allocation on.
+     * Cheap and idempotent, so it may be called right before every use.
+     */
+    void attach(cv::Mat& mat) {
+        mat.allocator = this;
+    }
+
+    /**
+     * Get a pooled Mat of the given size and type
+     */
+    cv::Mat create(int rows, int cols, int type) {
+        cv::Mat mat;
+        attach(mat);
+        mat.create(rows, cols, type);
+        return mat;
+    }
+
+    /**
+     * Read the pool counters
+     */
+    Stats stats() const;
+
+    /**
+     * Give all idle buffers back to the heap
+     */
+    void trim();
+
+    /**
+     * Get the pool shared by the whole native pipeline
+     */
+    static BufferPool& shared();
+
+    // cv::MatAllocator
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data,
+                           size_t* step, cv::AccessFlag flags,
+                           cv::UMatUsageFlags usageFlags) const override;
+    bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override;
+    void deallocate(cv::UMatData* data) const override;
+
+private:
+    // Idle buffers are few (a handful per resolution), a flat array beats a map and
+    // never allocates itself
+    static constexpr int kMaxIdleBuffers = 64;
+
+    const size_t mMaxIdleBytes;
+
+    // MatAllocator's interface is const, the bookkeeping is not
+    mutable std::mutex mLock;
+    mutable cv::UMatData* mIdle[kMaxIdleBuffers];   // oldest first
+    mutable int mIdleCount = 0;
+    mutable Stats mStats = {};
+
+    void evictOldest() const;
+    static void release(cv::UMatData* data);
+};
@@ -0,0 +1,42 @@
+#include "display_transform.h"
+
+#include <algorithm>
+
+int DisplayTransform::normalizeRotation(int degrees) {
+    int quarter = ((degrees % 360 + 360) % 360 + 45) / 90;
+    return quarter % 4 * 90;
+}
+
+DisplayTransform DisplayTransform::compute(int frameWidth, int frameHeight, int rotation,
+                                           bool mirror, int viewWidth, int viewHeight) {
+    rotation = normalizeRotation(rotation);
+
+    // Clockwise rotation in y-up coordinates: (x, y) -> (cos x + sin y, -sin x + cos y)
+    static const float kCos[4] = {1.0f, 0.0f, -1.0f, 0.0f};
+    static const float kSin[4] = {0.0f, 1.0f, 0.0f, -1.0f};
+    float c = kCos[rotation / 90];
+    float s = kSin[rotation / 90];
+
+    // Fit the upright frame into the view, keeping its aspect ratio
+    float scaleX = 1.0f;
+    float scaleY = 1.0f;
+    if (frameWidth > 0 && frameHeight > 0 && viewWidth > 0 && viewHeight > 0) {
+        bool sideways = rotation == 90 || rotation == 270;
+        float uprightWidth = static_cast<float>(sideways ? frameHeight : frameWidth);
+        float uprightHeight = static_cast<float>(sideways ? frameWidth : frameHeight);
+        float fit = std::min(viewWidth / uprightWidth, viewHeight / uprightHeight);
+        scaleX = uprightWidth * fit / viewWidth;
+        scaleY = uprightHeight * fit / viewHeight;
+    }
+    float flip = mirror ? -1.0f : 1.0f;
+
+    // scale * mirror * rotation, as a column-major 4x4 matrix
+    DisplayTransform transform = {};
+    transform.matrix[0] = scaleX * flip * c;
+    transform.matrix[1] = -scaleY * s;
+    transform.matrix[4] = scaleX * flip * s;
+    transform.matrix[5] = scaleY * c;
+    transform.matrix[10] = 1.0f;
+    transform.matrix[15] = 1.0f;
+    return transform;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+/**
+ * DisplayTransform - Places the edge mask on screen at draw time
+ *
+ * The mask stays in the orientation of the camera sensor. Rather than rotating pixels
+ * on the CPU, the renderer draws its quad through this matrix, which
+ *   1. rotates the quad clockwise by the frame's rotation (CameraX rotationDegrees,
+ *      the rotation that turns the image upright),
+ *   2. mirrors it horizontally, for front cameras,
+ *   3. scales it to the aspect ratio of the upright frame, as large as fits the view;
+ *      the rest of the view stays clear (letterbox or pillarbox bars).
+ *
+ * The quad spans normalized device coordinates -1..1 with the first mask row at the
+ * top, so without rotation, mirroring or aspect difference the matrix is the identity.
+ */
+struct DisplayTransform {
+    float matrix[16];   // column-major, for glUniformMatrix4fv
+
+    /**
+     * Compute the transform for a frame
+     *
+     * @param frameWidth Width of the mask, as delivered by the camera
+     * @param frameHeight Height of the mask, as delivered by the camera
+     * @param rotation Clockwise rotation in degrees, rounded to a multiple of 90
+     * @param mirror Mirror the upright image horizontally
+     * @param viewWidth Width of the viewport in pixels
+     * @param viewHeight Height of the viewport in pixels
+     * @return The transform; without a frame or viewport size it only rotates and mirrors
+     */
+    static DisplayTransform compute(int frameWidth, int frameHeight, int rotation, bool mirror,
+                                    int viewWidth, int viewHeight);
+
+    /**
+     * Map a point of the quad to normalized device coordinates
+     */
+    void apply(float x, float y, float& outX, float& outY) const {
+        outX = matrix[0] * x + matrix[4] * y + matrix[12];
+        outY = matrix[1] * x + matrix[5] * y + matrix[13];
+    }
+
+    /**
+     * Reduce a rotation in degrees to 0, 90, 180 or 270, rounding to the nearest
+     */
+    static int normalizeRotation(int degrees);
+};
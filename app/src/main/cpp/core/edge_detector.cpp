@@ -0,0 +1,242 @@
+#include "edge_detector.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "buffer_pool.h"
+#include "logger.h"
+#include "stage_stats.h"
+
+#define LOG_TAG "EdgeDetector"
+
+EdgeDetector::EdgeDetector(ThreadPool& pool) : parallelCanny(pool), linker(pool) {
+    // Intermediate frames come from the shared pool and keep their buffers across frames
+    BufferPool& buffers = BufferPool::shared();
+    buffers.attach(rgbaMat);
+    buffers.attach(grayMat);
+    buffers.attach(blurMat);
+    buffers.attach(edgeMat);
+    buffers.attach(regionEdges);
+    for (cv::Mat& level : pyramid) {
+        buffers.attach(level);
+    }
+
+    CORE_LOGI(LOG_TAG, "EdgeDetector created (row kernels: %s)", RowKernels::best().name);
+}
+
+EdgeDetector::~EdgeDetector() {
+    CORE_LOGI(LOG_TAG, "EdgeDetector destroyed");
+}
+
+void EdgeDetector::detectEdges(const cv::Mat& gray, cv::Mat& edges, double scale) {
+    detectMask(gray, edges, scale);
+
+    if (linking) {
+        EDGE_STAGE_TIMER(Stage::Link);
+        linker.link(edges, contourSet, simplifyEpsilon, minContourPixels);
+    }
+}
+
+void EdgeDetector::detectMask(const cv::Mat& gray, cv::Mat& edges, double scale) {
+    EDGE_STAGE_TIMER(Stage::EdgeDetect);
+
+    const double low = lowThreshold * scale;
+    const double high = low * ratio;
+    if (!regions.empty() || incremental) {
+        levelMap.release();
+        releaseGradients();
+        releaseDensity();
+    }
+
+    if (!governor.isEnabled()) {
+        if (regions.empty()) {
+            detectLevel(gray, edges, scale);
+        } else {
+            detectRegions(gray, edges, low, high, 0);
+        }
+        return;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (regions.empty()) {
+        const cv::Mat* source = &gray;
+        for (int level = 0; level < governor.level(); level++) {
+            cv::pyrDown(*source, pyramid[level]);
+            source = &pyramid[level];
+        }
+        detectLevel(*source, edges, scale);
+    } else {
+        detectRegions(gray, edges, low, high, governor.level());
+    }
+    governor.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void EdgeDetector::detectRegions(const cv::Mat& gray, cv::Mat& edges, double low, double high,
+                                 int level) {
+    edges.create(RegionLayout::levelSize(gray.size(), level), CV_8UC1);
+    edges.setTo(0);
+
+    for (const RegionLayout::Input& input : regions.layout(gray.size(), level)) {
+        // Only the input is valid gray, the rest of the frame may not be converted. A
+        // header of its own rather than an ROI view: blur and Sobel extend the borders of
+        // a submatrix with its parent's pixels, so they would read unconverted memory.
+        // The halo keeps the reflected border out of the regions.
+        const cv::Rect& rect = input.source;
+        const cv::Mat crop(rect.height, rect.width, gray.type(),
+                           const_cast<uchar*>(gray.ptr<uchar>(rect.y) + rect.x * gray.elemSize()),
+                           gray.step);
+        const cv::Mat* source = &crop;
+        for (int step = 0; step < level; step++) {
+            cv::pyrDown(*source, pyramid[step]);
+            source = &pyramid[step];
+        }
+
+        runEngine(*source, regionEdges, low, high, false);
+        for (const cv::Rect& output : input.outputs) {
+            cv::Mat destination = edges(output);
+            regionEdges(output - input.level.tl()).copyTo(destination);
+        }
+    }
+}
+
+void EdgeDetector::detectLevel(const cv::Mat& gray, cv::Mat& edges, double scale) {
+    const double low = lowThreshold * scale;
+    const double high = low * ratio;
+
+    if (!incremental) {
+        if (!sweepThresholds.empty()) {
+            detectSweep(gray, edges, scale);
+        } else if (gradientOutput || densityOutput) {
+            // Any engine gives the same edges, only this one hands out its gradients
+            parallelCanny.process(gray, edges, low, high, kernelSize,
+                                  gradientOutput ? &gradientPlanes : nullptr,
+                                  densityOutput ? &densityGrid : nullptr);
+        } else {
+            runEngine(gray, edges, low, high, false);
+        }
+        return;
+    }
+    temporalCache.process(gray, edges, low, high, kernelSize,
+                          [&](const cv::Mat& region, cv::Mat& regionEdges) {
+        runEngine(region, regionEdges, low, high, region.size() != gray.size());
+    });
+}
+
+void EdgeDetector::detectSweep(const cv::Mat& gray, cv::Mat& edges, double scale) {
+    const double low = lowThreshold * scale;
+    double lowest = low;
+    scaledSweep.clear();
+    for (const ParallelCanny::Thresholds& pair : sweepThresholds) {
+        scaledSweep.push_back({pair.low * scale, pair.high * scale});
+        lowest = std::min(lowest, std::min(pair.low, pair.high) * scale);
+    }
+
+    // Any engine gives the same edges, the gradients are only shared through this one
+    parallelCanny.computeGradients(gray, lowest, kernelSize,
+                                   gradientOutput ? &gradientPlanes : nullptr);
+    parallelCanny.hysteresis(edges, low, low * ratio, densityOutput ? &densityGrid : nullptr);
+
+    EDGE_STAGE_TIMER(Stage::Sweep);
+    parallelCanny.thresholdLevels(scaledSweep, levelMap);
+}
+
+void EdgeDetector::sweepFrame(const cv::Mat& gray,
+                              const std::vector<ParallelCanny::Thresholds>& thresholds,
+                              std::vector<cv::Mat>& edges, double scale) {
+    EDGE_STAGE_TIMER(Stage::Sweep);
+
+    edges.resize(thresholds.size());
+    if (thresholds.empty()) {
+        return;
+    }
+
+    double lowest = std::min(thresholds[0].low, thresholds[0].high);
+    for (const ParallelCanny::Thresholds& pair : thresholds) {
+        lowest = std::min(lowest, std::min(pair.low, pair.high));
+    }
+
+    parallelCanny.computeGradients(gray, lowest * scale, kernelSize);
+    for (size_t i = 0; i < thresholds.size(); i++) {
+        parallelCanny.hysteresis(edges[i], thresholds[i].low * scale, thresholds[i].high * scale);
+    }
+}
+
+void EdgeDetector::runEngine(const cv::Mat& gray, cv::Mat& edges, double low, double high,
+                             bool band) {
+    // Bands are a few dozen rows of varying width. They stream through the fused
+    // engine, whose row buffers fit any band, instead of re-laying out strips.
+    if ((engine == ENGINE_FUSED || (band && engine == ENGINE_PARALLEL)) && kernelSize == 3) {
+        // Blur, gradients and suppression in one streaming sweep
+        fusedCanny.process(gray, edges, low, high);
+    } else if (engine != ENGINE_OPENCV) {
+        // Blur and Canny in strips on the shared thread pool
+        parallelCanny.process(gray, edges, low, high, kernelSize);
+    } else {
+        // Apply Gaussian blur to reduce noise
+        {
+            EDGE_STAGE_TIMER(Stage::Blur);
+            cv::GaussianBlur(gray, blurMat, cv::Size(5, 5), 1.5, 1.5);
+        }
+
+        // Apply Canny edge detection
+        EDGE_STAGE_TIMER(Stage::Canny);
+        cv::Canny(blurMat, edges, low, high, kernelSize);
+    }
+}
+
+void EdgeDetector::processFrame(const cv::Mat& inputFrame, cv::Mat& edges) {
+    // Convert input frame to grayscale
+    {
+        EDGE_STAGE_TIMER(Stage::Gray);
+        if (regions.empty()) {
+            cv::cvtColor(inputFrame, grayMat, cv::COLOR_RGBA2GRAY);
+        } else {
+            grayMat.create(inputFrame.rows, inputFrame.cols, CV_8UC1);
+            for (const RegionLayout::Input& input : regions.layout(inputFrame.size(), pyramidLevel())) {
+                cv::Mat target = grayMat(input.source);
+                cv::cvtColor(inputFrame(input.source), target, cv::COLOR_RGBA2GRAY);
+            }
+        }
+    }
+
+    detectEdges(grayMat, edges, 1.0);
+}
+
+void EdgeDetector::processNv21(const cv::Mat& nv21Frame, cv::Mat& edges) {
+    int height = nv21Frame.rows * 2 / 3;
+
+    if (lumaOnly) {
+        // A header of its own rather than rowRange(): blur and Sobel extend the borders
+        // of a submatrix with its parent's rows, which here are the chroma rows
+        cv::Mat luma(height, nv21Frame.cols, CV_8UC1, nv21Frame.data, nv21Frame.step);
+        processLuma(luma, edges);
+        return;
+    }
+
+    {
+        EDGE_STAGE_TIMER(Stage::YuvToRgba);
+        if (regions.empty()) {
+            cv::cvtColor(nv21Frame, rgbaMat, cv::COLOR_YUV2RGBA_NV21);
+        } else {
+            convertRegionsNv21(nv21Frame, height);
+        }
+    }
+    processFrame(rgbaMat, edges);
+}
+
+void EdgeDetector::convertRegionsNv21(const cv::Mat& nv21Frame, int height) {
+    const int width = nv21Frame.cols;
+    rgbaMat.create(height, width, CV_8UC4);
+
+    // Inputs start and end on even coordinates, so each one covers whole chroma pairs
+    for (const RegionLayout::Input& input : regions.layout(cv::Size(width, height), pyramidLevel())) {
+        const cv::Rect& rect = input.source;
+        cv::Mat luma = nv21Frame(rect);
+        cv::Mat chroma(rect.height / 2, rect.width / 2, CV_8UC2,
+                       const_cast<uint8_t*>(nv21Frame.ptr<uint8_t>(height + rect.y / 2)) + rect.x,
+                       nv21Frame.step);
+        cv::Mat target = rgbaMat(rect);
+        cv::cvtColorTwoPlane(luma, chroma, target, cv::COLOR_YUV2RGBA_NV21);
+    }
+}
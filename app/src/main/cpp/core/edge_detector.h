@@ -0,0 +1,380 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include "edge_linker.h"
+#include "fused_canny.h"
+#include "latency_governor.h"
+#include "parallel_canny.h"
+#include "region_layout.h"
+#include "temporal_edge_cache.h"
+
+/**
+ * Edge Detector class that applies Canny edge detection to camera frames using OpenCV
+ *
+ * Two pipeline modes are supported:
+ *  - RGBA mode: the caller hands in an RGBA frame which is converted to gray first.
+ *  - Luma-only mode: the caller hands in the Y plane of the NV21 frame directly. The
+ *    Y plane already is the grayscale image, so both color conversions are skipped.
+ *
+ * The RGBA path expands video-range luma (16..235) to full range when it goes through
+ * COLOR_YUV2RGBA_NV21 and back through COLOR_RGBA2GRAY, i.e. gray ~= (Y - 16) * 255 / 219.
+ * Canny only looks at gradients, which scale by the same 255/219 factor, so luma-only
+ * mode divides both thresholds by that factor instead of touching the pixels.
+ *
+ * Tolerance: the two fixed-point color conversions round each gray value by up to
+ * +-1 level and clip luma outside 16..235. Edges therefore match the RGBA path except
+ * for pixels whose gradient magnitude lies within a few units of a threshold, or that
+ * sit in clipped (crushed black / blown out) regions.
+ *
+ * Blur and Canny run through OpenCV directly, through the strip-parallel engine (the
+ * default) on the shared thread pool, or through the fused single-sweep engine that
+ * never writes a full-size blurred frame. All three produce the same edges; the fused
+ * engine only supports the 3x3 aperture and defers to the parallel engine otherwise.
+ *
+ * Incremental mode is meant for fixed cameras: only tiles that changed since the
+ * frame their edges came from are detected again, see TemporalEdgeCache.
+ *
+ * With a frame budget set, a LatencyGovernor times every detection and moves between
+ * pyramid levels to stay within it. At level n the gray frame is pyrDown'ed n times
+ * and the edge mask comes out 2^n times smaller on each side; the renderer scales it
+ * back up.
+ *
+ * With regions of interest set, only the regions plus the filter halo around them are
+ * color-converted, blurred and edge-detected (see RegionLayout); the rest of the mask
+ * is cleared. Regions take precedence over incremental mode, which only applies to
+ * full frames.
+ *
+ * With a threshold sweep set, full frames are blurred, differentiated and
+ * non-maximum suppressed once by the strip-parallel engine; the frame's own edges and
+ * a per-pixel threshold level map for all pairs of the sweep come out of hysteresis
+ * alone (see ParallelCanny::thresholdLevels). sweepGray() and sweepLuma() give one
+ * edge mask per pair for a single frame the same way.
+ *
+ * With gradient output enabled, full frames are detected by the strip-parallel engine,
+ * which also keeps the gradient magnitude and orientation planes of its Sobel pass and
+ * sums them into per-tile orientation histograms (see ParallelCanny::Gradients), in
+ * mask coordinates.
+ *
+ * With edge density enabled, full frames are detected by the strip-parallel engine as
+ * well, which counts the edge pixels of every tile and their mean gradient magnitude
+ * while it writes the mask (see ParallelCanny::EdgeDensity), in mask coordinates.
+ *
+ * With edge linking enabled, every mask is also traced into polylines by an
+ * EdgeLinker on the same pool, in mask coordinates (i.e. at the pyramid level the
+ * mask was detected at).
+ *
+ * The class is platform neutral: it only depends on OpenCV and the core modules, so
+ * it builds and benchmarks on a plain Linux host. In the live camera path it runs on
+ * the FramePipeline processing thread, never on the GL thread; the overloads taking
+ * an output Mat write into the pipeline's reused result buffers.
+ */
+class EdgeDetector {
+public:
+    enum Engine {
+        ENGINE_OPENCV = 0,
+        ENGINE_PARALLEL = 1,
+        ENGINE_FUSED = 2
+    };
+
+    // Gradient scale between full-range gray and video-range luma (219 / 255)
+    static constexpr double kLumaGradientScale = 219.0 / 255.0;
+
+private:
+    // OpenCV edge detection parameters
+    int lowThreshold = 50;
+    int ratio = 3;
+    int kernelSize = 3;
+    bool lumaOnly = true;
+    Engine engine = ENGINE_PARALLEL;
+    bool incremental = false;
+    ParallelCanny parallelCanny;
+    FusedCanny fusedCanny;
+    TemporalEdgeCache temporalCache;
+    LatencyGovernor governor;
+    RegionLayout regions;
+    std::vector<ParallelCanny::Thresholds> sweepThresholds;
+    std::vector<ParallelCanny::Thresholds> scaledSweep;
+    cv::Mat levelMap;
+    bool gradientOutput = false;
+    ParallelCanny::Gradients gradientPlanes;
+    bool densityOutput = false;
+    ParallelCanny::EdgeDensity densityGrid;
+    EdgeLinker linker;
+    EdgeContours contourSet;
+    bool linking = false;
+    double simplifyEpsilon = 0.0;
+    int minContourPixels = 2;
+    cv::Mat pyramid[LatencyGovernor::kMaxLevel];
+    cv::Mat rgbaMat;
+    cv::Mat grayMat;
+    cv::Mat blurMat;
+    cv::Mat edgeMat;
+    cv::Mat regionEdges;
+
+    // Blurs and edge-detects a single channel frame into an edge mask (CV_8UC1), with
+    // all thresholds multiplied by scale. The mask goes to the GPU as is, the fragment
+    // shader does the colorizing.
+    void detectEdges(const cv::Mat& gray, cv::Mat& edges, double scale);
+
+    // Detects edges at the current pyramid level, without linking
+    void detectMask(const cv::Mat& gray, cv::Mat& edges, double scale);
+
+    // Edge-detects the regions of interest only, at the given pyramid level
+    void detectRegions(const cv::Mat& gray, cv::Mat& edges, double low, double high, int level);
+
+    // Edge-detects one pyramid level, incrementally or in full
+    void detectLevel(const cv::Mat& gray, cv::Mat& edges, double scale);
+
+    // Computes gradients once, then the edges and the threshold level map of the sweep
+    void detectSweep(const cv::Mat& gray, cv::Mat& edges, double scale);
+
+    // Edges of a single frame for each threshold pair, thresholds multiplied by scale
+    void sweepFrame(const cv::Mat& gray, const std::vector<ParallelCanny::Thresholds>& thresholds,
+                    std::vector<cv::Mat>& edges, double scale);
+
+    // Runs the selected engine over a whole frame or one band of it
+    void runEngine(const cv::Mat& gray, cv::Mat& edges, double low, double high, bool band);
+
+    // Drops the gradient planes of the last frame
+    void releaseGradients() {
+        gradientPlanes.magnitude.release();
+        gradientPlanes.orientation.release();
+        gradientPlanes.histograms.release();
+    }
+
+    // Drops the edge density of the last frame
+    void releaseDensity() {
+        densityGrid.counts.release();
+        densityGrid.strength.release();
+    }
+
+    // Converts the NV21 pixels of the region inputs to RGBA in rgbaMat
+    void convertRegionsNv21(const cv::Mat& nv21Frame, int height);
+
+    // Pyramid level the next frame is detected at
+    int pyramidLevel() const {
+        return governor.isEnabled() ? governor.level() : 0;
+    }
+
+public:
+    // pool runs the strip-parallel engine; detectors of several streams may share one
+    explicit EdgeDetector(ThreadPool& pool = ThreadPool::shared());
+    ~EdgeDetector();
+
+    // Processes the input RGBA frame with Canny edge detection into edges
+    void processFrame(const cv::Mat& inputFrame, cv::Mat& edges);
+
+    // Processes the input RGBA frame with Canny edge detection
+    cv::Mat processFrame(const cv::Mat& inputFrame) {
+        processFrame(inputFrame, edgeMat);
+        return edgeMat;
+    }
+
+    // Processes a full-range gray frame (a decoded image or video frame converted to
+    // gray) with Canny edge detection into edges; thresholds apply unscaled
+    void processGray(const cv::Mat& grayFrame, cv::Mat& edges) {
+        detectEdges(grayFrame, edges, 1.0);
+    }
+
+    // Processes the luma (Y) plane of a YUV frame with Canny edge detection into edges.
+    // lumaFrame is only read, so it may wrap the caller's buffer, but with a header of
+    // its own: the filters read past the edges of a submatrix view into its parent.
+    void processLuma(const cv::Mat& lumaFrame, cv::Mat& edges) {
+        detectEdges(lumaFrame, edges, kLumaGradientScale);
+    }
+
+    // Processes the luma (Y) plane of a YUV frame with Canny edge detection
+    cv::Mat processLuma(const cv::Mat& lumaFrame) {
+        processLuma(lumaFrame, edgeMat);
+        return edgeMat;
+    }
+
+    // Edge-detects a full-range gray frame once per threshold pair (low, high as in
+    // updateParameters), computing blur and gradients only once; always full frame and
+    // full resolution
+    void sweepGray(const cv::Mat& grayFrame, const std::vector<ParallelCanny::Thresholds>& thresholds,
+                   std::vector<cv::Mat>& edges) {
+        sweepFrame(grayFrame, thresholds, edges, 1.0);
+    }
+
+    // Same for the luma (Y) plane of a YUV frame, with the thresholds scaled as in
+    // processLuma()
+    void sweepLuma(const cv::Mat& lumaFrame, const std::vector<ParallelCanny::Thresholds>& thresholds,
+                   std::vector<cv::Mat>& edges) {
+        sweepFrame(lumaFrame, thresholds, edges, kLumaGradientScale);
+    }
+
+    // Processes a whole NV21 frame (height * 3 / 2 rows) in the selected mode: only
+    // its Y rows in luma-only mode, through an RGBA conversion otherwise
+    void processNv21(const cv::Mat& nv21Frame, cv::Mat& edges);
+
+    // Update the edge detection parameters
+    void updateParameters(int low, int highRatio, int kernel) {
+        lowThreshold = low;
+        ratio = highRatio;
+        kernelSize = kernel;
+    }
+
+    // Select between the luma-only and the RGBA pipeline
+    void setLumaOnly(bool enabled) {
+        lumaOnly = enabled;
+    }
+
+    bool isLumaOnly() const {
+        return lumaOnly;
+    }
+
+    // Select the engine running blur and Canny
+    void setEngine(Engine selected) {
+        engine = selected;
+    }
+
+    Engine getEngine() const {
+        return engine;
+    }
+
+    // Only recompute tiles that changed since their cached edges were computed
+    void setIncremental(bool enabled) {
+        if (enabled != incremental) {
+            temporalCache.invalidate();
+        }
+        incremental = enabled;
+    }
+
+    bool isIncremental() const {
+        return incremental;
+    }
+
+    // Mean absolute difference per pixel below which a tile counts as unchanged
+    void setChangeSensitivity(double meanAbsDifference) {
+        temporalCache.setSensitivity(meanAbsDifference);
+    }
+
+    // Tile reuse counters of incremental mode; safe to call from any thread
+    TemporalEdgeCache::Stats temporalStats() const {
+        return temporalCache.stats();
+    }
+
+    // Keep each detection within budgetNanos by dropping to coarser pyramid levels,
+    // at most maxLevel; a budget of 0 always processes at full resolution
+    void setFrameBudget(int64_t budgetNanos, int maxLevel = LatencyGovernor::kMaxLevel) {
+        governor.setBudget(budgetNanos);
+        governor.setMaxLevel(maxLevel);
+    }
+
+    // Current pyramid level and timing of the governor; safe to call from any thread
+    LatencyGovernor::Stats governorStats() const {
+        return governor.stats();
+    }
+
+    // Only process these rectangles (frame coordinates, full resolution) plus the filter
+    // halo around them; count 0 goes back to full frames
+    void setRegions(const cv::Rect* rects, int count) {
+        regions.setRegions(rects, count);
+    }
+
+    void clearRegions() {
+        regions.setRegions(nullptr, 0);
+    }
+
+    const std::vector<cv::Rect>& getRegions() const {
+        return regions.regions();
+    }
+
+    // Also compute a threshold level map for these pairs (at most 255, low and high as
+    // in updateParameters) with every full frame, sharing its gradients; an empty list
+    // turns the sweep off
+    void setThresholdSweep(const std::vector<ParallelCanny::Thresholds>& thresholds) {
+        CV_Assert(thresholds.size() <= 255);
+        sweepThresholds = thresholds;
+        if (thresholds.empty()) {
+            levelMap.release();
+        }
+    }
+
+    const std::vector<ParallelCanny::Thresholds>& getThresholdSweep() const {
+        return sweepThresholds;
+    }
+
+    // Per pixel number of sweep pairs the last frame is an edge at, in mask coordinates
+    // (CV_8UC1); empty without a sweep or after a frame that was not detected in full
+    const cv::Mat& thresholdLevels() const {
+        return levelMap;
+    }
+
+    // Also keep the gradient magnitude and orientation planes of every full frame and
+    // their orientation histograms over tiles of tileSize pixels (1 to 128), from the
+    // Sobel pass of its edge detection
+    void setGradientOutput(bool enabled, int tileSize = 16) {
+        CV_Assert(tileSize >= 1 && tileSize <= 128);
+        gradientOutput = enabled;
+        gradientPlanes.tileSize = tileSize;
+        if (!enabled) {
+            releaseGradients();
+        }
+    }
+
+    bool isGradientOutput() const {
+        return gradientOutput;
+    }
+
+    // Gradient planes and tile histograms of the last frame, in mask coordinates; empty
+    // without gradient output or after a frame that was not detected in full
+    const ParallelCanny::Gradients& gradients() const {
+        return gradientPlanes;
+    }
+
+    // Also count the edge pixels of every full frame and their mean gradient magnitude
+    // over tiles of tileSize pixels (1 to 128), while its mask is written
+    void setEdgeDensity(bool enabled, int tileSize = 32) {
+        CV_Assert(tileSize >= 1 && tileSize <= 128);
+        densityOutput = enabled;
+        densityGrid.tileSize = tileSize;
+        if (!enabled) {
+            releaseDensity();
+        }
+    }
+
+    bool isEdgeDensity() const {
+        return densityOutput;
+    }
+
+    // Edge density per tile of the last frame, in mask coordinates; empty without edge
+    // density or after a frame that was not detected in full
+    const ParallelCanny::EdgeDensity& edgeDensity() const {
+        return densityGrid;
+    }
+
+    // Link the pixels of every edge mask into polylines, simplified with Douglas-Peucker
+    // to within epsilon pixels (0 keeps every pixel); chains of fewer than minPixels
+    // pixels are dropped
+    void setEdgeLinking(bool enabled, double epsilon = 0.0, int minPixels = 2) {
+        linking = enabled;
+        simplifyEpsilon = epsilon;
+        minContourPixels = minPixels;
+        if (!enabled) {
+            contourSet = EdgeContours();
+        }
+    }
+
+    bool isEdgeLinking() const {
+        return linking;
+    }
+
+    // Polylines of the last edge mask while edge linking is enabled, empty otherwise
+    const EdgeContours& contours() const {
+        return contourSet;
+    }
+
+    // Connected edge components of the last edge mask while edge linking is enabled
+    size_t componentCount() const {
+        return linking ? linker.componentCount() : 0;
+    }
+
+    // Limit how many pool workers help with each frame (-1 for all of them)
+    void setMaxHelpers(int helpers) {
+        parallelCanny.setMaxHelpers(helpers);
+        linker.setMaxHelpers(helpers);
+    }
+};
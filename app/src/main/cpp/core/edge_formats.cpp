@@ -0,0 +1,224 @@
+#include "edge_formats.h"
+
+#include <cstring>
+
+namespace {
+
+inline int lowestBit(uint64_t word) {
+    return __builtin_ctzll(word);
+}
+
+inline void checkMask(const cv::Mat& mask) {
+    CV_Assert(mask.type() == CV_8UC1);
+    CV_Assert(mask.cols <= 65535 && mask.rows <= 65535);
+}
+
+void appendCount(std::vector<uint8_t>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+bool readCount(const uint8_t*& code, const uint8_t* end, size_t& value) {
+    value = 0;
+    for (int shift = 0; code < end && shift < 64; shift += 7) {
+        uint8_t byte = *code++;
+        value |= static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+EdgeFormats::EdgeFormats(const RowKernels& kernels) : mKernels(kernels) {}
+
+int EdgeFormats::packRow(const uint8_t* row, int width) {
+    const int words = (width + 63) / 64;
+    if (static_cast<int>(mRow.size()) < words) {
+        mRow.resize(words);
+    }
+    if (words > 0) {
+        // packBits only writes whole bytes up to width, the rest of the word stays clear
+        mRow[words - 1] = 0;
+    }
+    // Bytes in little-endian order, so bit k of word i is pixel 64 * i + k
+    mKernels.packBits(row, reinterpret_cast<uint8_t*>(mRow.data()), width);
+    return words;
+}
+
+void EdgeFormats::pack(const cv::Mat& mask, PackedEdges& packed) const {
+    CV_Assert(mask.type() == CV_8UC1);
+    packed.width = mask.cols;
+    packed.height = mask.rows;
+    packed.stride = (mask.cols + 7) / 8;
+    packed.bits.resize(packed.bytes());
+    for (int y = 0; y < mask.rows; y++) {
+        mKernels.packBits(mask.ptr<uint8_t>(y), &packed.bits[static_cast<size_t>(y) * packed.stride],
+                          mask.cols);
+    }
+}
+
+void EdgeFormats::unpack(const PackedEdges& packed, cv::Mat& mask) const {
+    mask.create(packed.height, packed.width, CV_8UC1);
+    for (int y = 0; y < packed.height; y++) {
+        mKernels.unpackBits(&packed.bits[static_cast<size_t>(y) * packed.stride],
+                            mask.ptr<uint8_t>(y), packed.width);
+    }
+}
+
+void EdgeFormats::encodeRuns(const cv::Mat& mask, EdgeRuns& runs) {
+    checkMask(mask);
+    const int width = mask.cols;
+    runs.width = width;
+    runs.height = mask.rows;
+    runs.rowStart.resize(mask.rows + 1);
+    runs.runs.clear();
+
+    for (int y = 0; y < mask.rows; y++) {
+        runs.rowStart[y] = static_cast<uint32_t>(runs.runCount());
+        const int words = packRow(mask.ptr<uint8_t>(y), width);
+
+        // A set bit in changes marks a pixel that differs from its left neighbour
+        uint64_t carry = 0;
+        int start = 0;
+        for (int i = 0; i < words; i++) {
+            const uint64_t word = mRow[i];
+            uint64_t changes = word ^ ((word << 1) | carry);
+            carry = word >> 63;
+            while (changes) {
+                const int bit = lowestBit(changes);
+                const int x = i * 64 + bit;
+                if ((word >> bit) & 1) {
+                    start = x;
+                } else {
+                    runs.runs.push_back(static_cast<uint16_t>(start));
+                    runs.runs.push_back(static_cast<uint16_t>(x - start));
+                }
+                changes &= changes - 1;
+            }
+        }
+        // Padding bits are clear, so only a run touching a word-aligned right edge is open
+        if (carry) {
+            runs.runs.push_back(static_cast<uint16_t>(start));
+            runs.runs.push_back(static_cast<uint16_t>(width - start));
+        }
+    }
+    runs.rowStart[mask.rows] = static_cast<uint32_t>(runs.runCount());
+}
+
+void EdgeFormats::decodeRuns(const EdgeRuns& runs, cv::Mat& mask) const {
+    mask.create(runs.height, runs.width, CV_8UC1);
+    for (int y = 0; y < runs.height; y++) {
+        uint8_t* row = mask.ptr<uint8_t>(y);
+        memset(row, 0, runs.width);
+        for (uint32_t run = runs.rowStart[y]; run < runs.rowStart[y + 1]; run++) {
+            memset(row + runs.runs[2 * run], 255, runs.runs[2 * run + 1]);
+        }
+    }
+}
+
+void EdgeFormats::listPoints(const cv::Mat& mask, EdgePoints& points) {
+    checkMask(mask);
+    points.width = mask.cols;
+    points.height = mask.rows;
+    points.xy.clear();
+
+    for (int y = 0; y < mask.rows; y++) {
+        const int words = packRow(mask.ptr<uint8_t>(y), mask.cols);
+        for (int i = 0; i < words; i++) {
+            uint64_t word = mRow[i];
+            while (word) {
+                points.xy.push_back(static_cast<uint16_t>(i * 64 + lowestBit(word)));
+                points.xy.push_back(static_cast<uint16_t>(y));
+                word &= word - 1;
+            }
+        }
+    }
+}
+
+void EdgeFormats::drawPoints(const EdgePoints& points, cv::Mat& mask) const {
+    mask.create(points.height, points.width, CV_8UC1);
+    mask.setTo(0);
+    for (size_t i = 0; i < points.xy.size(); i += 2) {
+        mask.ptr<uint8_t>(points.xy[i + 1])[points.xy[i]] = 255;
+    }
+}
+
+void EdgeFormats::encodeDelta(const PackedEdges& current, const PackedEdges* previous,
+                              std::vector<uint8_t>& out) const {
+    const size_t size = current.bytes();
+    CV_Assert(!previous || previous->bytes() == size);
+    const uint8_t* now = current.bits.data();
+    const uint8_t* before = previous ? previous->bits.data() : nullptr;
+    auto changed = [&](size_t i) -> uint8_t {
+        return before ? now[i] ^ before[i] : now[i];
+    };
+
+    size_t i = 0;
+    while (i < size) {
+        // Unchanged bytes, a word at a time while they last
+        size_t start = i;
+        while (i + 8 <= size) {
+            uint64_t a;
+            uint64_t b = 0;
+            memcpy(&a, now + i, 8);
+            if (before) {
+                memcpy(&b, before + i, 8);
+            }
+            if (a != b) {
+                break;
+            }
+            i += 8;
+        }
+        while (i < size && changed(i) == 0) {
+            i++;
+        }
+        if (i == size) {
+            break;
+        }
+
+        // Changed bytes, up to the next run of kMinZeroRun unchanged ones
+        size_t literal = i;
+        size_t last = i;
+        while (i < size && i - last < kMinZeroRun) {
+            if (changed(i)) {
+                last = i + 1;
+            }
+            i++;
+        }
+        appendCount(out, literal - start);
+        appendCount(out, last - literal);
+        for (size_t j = literal; j < last; j++) {
+            out.push_back(changed(j));
+        }
+        i = last;
+    }
+}
+
+bool EdgeFormats::applyDelta(const uint8_t* code, size_t size, PackedEdges& frame) const {
+    const uint8_t* end = code + size;
+    uint8_t* bits = frame.bits.data();
+    const size_t frameBytes = frame.bytes();
+    size_t position = 0;
+    while (code < end) {
+        size_t zeros;
+        size_t literal;
+        if (!readCount(code, end, zeros) || !readCount(code, end, literal) ||
+            zeros > frameBytes - position || literal > frameBytes - position - zeros ||
+            literal > static_cast<size_t>(end - code)) {
+            return false;
+        }
+        position += zeros;
+        for (size_t j = 0; j < literal; j++) {
+            bits[position + j] ^= code[j];
+        }
+        code += literal;
+        position += literal;
+    }
+    return true;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "row_kernels.h"
+
+/**
+ * Compact representations of an edge mask for downstream consumers
+ *
+ * The edge mask is CV_8UC1 (one byte per pixel) and becomes four bytes per pixel once
+ * expanded to RGBA, to carry one bit of information. These formats carry the same
+ * bit in far less:
+ *  - PackedEdges: one bit per pixel, 8x smaller than the mask and 32x smaller than
+ *    RGBA regardless of content.
+ *  - EdgeRuns: the runs of edge pixels of every row, 4 bytes per run. Edge masks are
+ *    sparse and edges a few pixels wide, so this is usually smaller still.
+ *  - EdgePoints: the coordinates of every edge pixel, 4 bytes per pixel. The best fit
+ *    for consumers that iterate edge pixels (fitting, tracking, drawing).
+ * Every format round-trips losslessly for masks of 0 and 255.
+ *
+ * For streaming, a packed mask can also be delta-coded against the previous frame:
+ * consecutive edge masks differ in few bytes, so their XOR is mostly zero and a simple
+ * run-length code of it is a fraction of the packed size.
+ *
+ * Buffers are vectors that keep their capacity, so encoding into the same object every
+ * frame stops allocating once the largest frame has been seen.
+ */
+
+/**
+ * One bit per pixel, least significant bit first, rows of stride bytes
+ */
+struct PackedEdges {
+    int width = 0;
+    int height = 0;
+    int stride = 0;                  // (width + 7) / 8
+    std::vector<uint8_t> bits;
+
+    size_t bytes() const {
+        return static_cast<size_t>(stride) * height;
+    }
+};
+
+/**
+ * Runs of edge pixels, row by row
+ *
+ * The runs of row y are runs[2 * rowStart[y]] .. runs[2 * rowStart[y + 1]] as
+ * (first column, length) pairs, left to right.
+ */
+struct EdgeRuns {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> rowStart;  // height + 1 run indices
+    std::vector<uint16_t> runs;
+
+    size_t runCount() const {
+        return runs.size() / 2;
+    }
+
+    size_t bytes() const {
+        return rowStart.size() * sizeof(uint32_t) + runs.size() * sizeof(uint16_t);
+    }
+};
+
+/**
+ * Coordinates of the edge pixels as (x, y) pairs, in row-major order
+ */
+struct EdgePoints {
+    int width = 0;
+    int height = 0;
+    std::vector<uint16_t> xy;
+
+    size_t count() const {
+        return xy.size() / 2;
+    }
+
+    size_t bytes() const {
+        return xy.size() * sizeof(uint16_t);
+    }
+};
+
+/**
+ * EdgeFormats - Converts edge masks to and from the compact formats
+ *
+ * Packing and unpacking run on the SIMD bit kernels of RowKernels. Runs and points
+ * are found in the packed rows 64 pixels at a time: empty words are skipped in one
+ * compare, and runs and points are located with count-trailing-zeros instead of a
+ * per-pixel test. Frame sizes are limited to 65535 on each side.
+ *
+ * An instance keeps a scratch row, so it must not be shared between threads.
+ */
+class EdgeFormats {
+public:
+    /**
+     * Constructor
+     *
+     * @param kernels Row kernels for packing and unpacking
+     */
+    explicit EdgeFormats(const RowKernels& kernels = RowKernels::best());
+
+    /**
+     * Pack an edge mask to one bit per pixel
+     *
+     * @param mask The edge mask (CV_8UC1), any nonzero value is an edge
+     * @param packed Receives the packed mask
+     */
+    void pack(const cv::Mat& mask, PackedEdges& packed) const;
+
+    /**
+     * Expand a packed mask to an edge mask of 0 and 255
+     */
+    void unpack(const PackedEdges& packed, cv::Mat& mask) const;
+
+    /**
+     * Encode the runs of edge pixels of every row
+     */
+    void encodeRuns(const cv::Mat& mask, EdgeRuns& runs);
+
+    /**
+     * Draw runs back into an edge mask of 0 and 255
+     */
+    void decodeRuns(const EdgeRuns& runs, cv::Mat& mask) const;
+
+    /**
+     * List the coordinates of every edge pixel
+     */
+    void listPoints(const cv::Mat& mask, EdgePoints& points);
+
+    /**
+     * Draw listed points back into an edge mask of 0 and 255
+     */
+    void drawPoints(const EdgePoints& points, cv::Mat& mask) const;
+
+    /**
+     * Delta-code a packed mask against the frame the receiver already has
+     *
+     * The code is the XOR of both frames as a sequence of (zero byte count, literal
+     * byte count, literal bytes) with LEB128 counts. Zero runs shorter than
+     * kMinZeroRun stay part of the literals; trailing zeros are left out.
+     *
+     * @param current The new frame
+     * @param previous The receiver's frame, same size as current, or nullptr for a
+     *                 keyframe (coded against an empty frame)
+     * @param out The code is appended to it
+     */
+    void encodeDelta(const PackedEdges& current, const PackedEdges* previous,
+                     std::vector<uint8_t>& out) const;
+
+    /**
+     * Apply a delta code to the receiver's frame in place. For a keyframe the frame
+     * must be cleared first.
+     *
+     * @return false if the code is malformed or runs past the end of the frame
+     */
+    bool applyDelta(const uint8_t* code, size_t size, PackedEdges& frame) const;
+
+    // Shortest run of unchanged bytes worth ending a literal for
+    static constexpr size_t kMinZeroRun = 4;
+
+private:
+    const RowKernels& mKernels;
+
+    // One packed row, padded to whole 64-bit words with the padding cleared
+    std::vector<uint64_t> mRow;
+
+    // Pack one mask row into mRow and return its word count
+    int packRow(const uint8_t* row, int width);
+};
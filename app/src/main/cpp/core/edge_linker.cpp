@@ -0,0 +1,313 @@
+#include "edge_linker.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+// First column at or after x holding an edge pixel, cols if none. Skips empty
+// stretches of the (mostly empty) mask eight bytes at a time.
+inline int nextEdge(const uchar* row, int x, int cols) {
+    while (x + 8 <= cols) {
+        uint64_t word;
+        std::memcpy(&word, row + x, sizeof(word));
+        if (word != 0) {
+            break;
+        }
+        x += 8;
+    }
+    while (x < cols && row[x] == 0) {
+        x++;
+    }
+    return x;
+}
+
+} // namespace
+
+EdgeLinker::EdgeLinker(ThreadPool& pool) : mPool(pool) {
+}
+
+void EdgeLinker::link(const cv::Mat& edges, EdgeContours& contours, double epsilon,
+                      int minPixels) {
+    CV_Assert(edges.type() == CV_8UC1);
+    CV_Assert(edges.cols <= 65535 && edges.rows <= 65535);
+
+    contours.width = edges.cols;
+    contours.height = edges.rows;
+    contours.start.assign(1, 0);
+    contours.xy.clear();
+    mComponents = 0;
+    if (edges.empty()) {
+        return;
+    }
+
+    size_t pixels = static_cast<size_t>(edges.rows) * edges.cols;
+    if (mParent.size() < pixels) {
+        mParent.resize(pixels);
+        mVisited.resize(pixels);
+    }
+    layoutStrips(edges.rows);
+
+    mPool.parallelFor(stripCount(), [&](int index) {
+        labelStrip(mStrips[index], edges);
+    }, mMaxHelpers);
+
+    for (int k = 1; k < stripCount(); k++) {
+        mergeBorder(mStrips[k].begin, edges);
+    }
+
+    mPool.parallelFor(stripCount(), [&](int index) {
+        traceStrip(mStrips[index], edges, epsilon, minPixels);
+    }, mMaxHelpers);
+
+    // Concatenate in strip order, which is raster order of the component roots
+    for (const Strip& strip : mStrips) {
+        uint32_t offset = static_cast<uint32_t>(contours.pointCount());
+        for (size_t i = 1; i < strip.contours.start.size(); i++) {
+            contours.start.push_back(offset + strip.contours.start[i]);
+        }
+        contours.xy.insert(contours.xy.end(), strip.contours.xy.begin(), strip.contours.xy.end());
+        mComponents += strip.components;
+    }
+}
+
+void EdgeLinker::layoutStrips(int rows) {
+    int wanted = mPool.threadCount() * kStripsPerThread;
+    int count = std::max(1, std::min(wanted, rows / kMinStripRows));
+
+    if (static_cast<int>(mStrips.size()) == count && mStrips.back().end == rows) {
+        return;
+    }
+
+    mStrips.resize(count);
+    for (int k = 0; k < count; k++) {
+        mStrips[k].begin = static_cast<int>(static_cast<long>(rows) * k / count);
+        mStrips[k].end = static_cast<int>(static_cast<long>(rows) * (k + 1) / count);
+    }
+}
+
+int32_t EdgeLinker::find(int32_t index) {
+    // Path halving
+    while (mParent[index] != index) {
+        mParent[index] = mParent[mParent[index]];
+        index = mParent[index];
+    }
+    return index;
+}
+
+void EdgeLinker::unite(int32_t a, int32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a < b) {
+        mParent[b] = a;
+    } else if (b < a) {
+        mParent[a] = b;
+    }
+}
+
+void EdgeLinker::labelStrip(const Strip& strip, const cv::Mat& edges) {
+    const int cols = edges.cols;
+    for (int y = strip.begin; y < strip.end; y++) {
+        const uchar* row = edges.ptr<uchar>(y);
+        const uchar* above = y > strip.begin ? edges.ptr<uchar>(y - 1) : nullptr;
+        const int32_t base = y * cols;
+
+        for (int x = nextEdge(row, 0, cols); x < cols; x = nextEdge(row, x + 1, cols)) {
+            const int32_t i = base + x;
+            mParent[i] = i;
+            mVisited[i] = 0;
+
+            // The pixel above is already connected to its left and right neighbours
+            // and to the pixel on the left; otherwise look at them one by one
+            if (above && above[x]) {
+                unite(i, i - cols);
+                continue;
+            }
+            if (x > 0 && row[x - 1]) {
+                unite(i, i - 1);
+            } else if (above && x > 0 && above[x - 1]) {
+                unite(i, i - cols - 1);
+            }
+            if (above && x + 1 < cols && above[x + 1]) {
+                unite(i, i - cols + 1);
+            }
+        }
+    }
+}
+
+void EdgeLinker::mergeBorder(int y, const cv::Mat& edges) {
+    const int cols = edges.cols;
+    const uchar* row = edges.ptr<uchar>(y);
+    const uchar* above = edges.ptr<uchar>(y - 1);
+    const int32_t base = y * cols;
+
+    for (int x = nextEdge(row, 0, cols); x < cols; x = nextEdge(row, x + 1, cols)) {
+        for (int dx = -1; dx <= 1; dx++) {
+            if (x + dx >= 0 && x + dx < cols && above[x + dx]) {
+                unite(base + x, base - cols + x + dx);
+            }
+        }
+    }
+}
+
+void EdgeLinker::traceStrip(Strip& strip, const cv::Mat& edges, double epsilon,
+                            int minPixels) {
+    strip.contours.start.assign(1, 0);
+    strip.contours.xy.clear();
+    strip.components = 0;
+
+    const int cols = edges.cols;
+    for (int y = strip.begin; y < strip.end; y++) {
+        const uchar* row = edges.ptr<uchar>(y);
+        const int32_t base = y * cols;
+        for (int x = nextEdge(row, 0, cols); x < cols; x = nextEdge(row, x + 1, cols)) {
+            // Only reads parents of this strip's pixels, which no other strip writes
+            if (mParent[base + x] == base + x) {
+                traceComponent(strip, edges, base + x, epsilon, minPixels);
+            }
+        }
+    }
+}
+
+int32_t EdgeLinker::nextUnvisited(const cv::Mat& edges, int32_t index) const {
+    // 4-neighbours first, so chains do not cut corners of staircase edges
+    static const int kOffsets[8][2] = {
+        {1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1}
+    };
+    const int cols = edges.cols;
+    const int x = index % cols;
+    const int y = index / cols;
+
+    for (const auto& offset : kOffsets) {
+        int nx = x + offset[0];
+        int ny = y + offset[1];
+        if (nx < 0 || ny < 0 || nx >= cols || ny >= edges.rows) {
+            continue;
+        }
+        int32_t neighbour = ny * cols + nx;
+        if (edges.ptr<uchar>(ny)[nx] && !mVisited[neighbour]) {
+            return neighbour;
+        }
+    }
+    return -1;
+}
+
+void EdgeLinker::follow(Strip& strip, const cv::Mat& edges, int32_t from) {
+    int32_t current = from;
+    for (;;) {
+        int32_t next = nextUnvisited(edges, current);
+        if (next < 0) {
+            return;
+        }
+        mVisited[next] = 1;
+        if (nextUnvisited(edges, current) >= 0) {
+            strip.junctions.push_back(current);
+        }
+        strip.chain.push_back(next);
+        current = next;
+    }
+}
+
+void EdgeLinker::traceComponent(Strip& strip, const cv::Mat& edges, int32_t root,
+                                double epsilon, int minPixels) {
+    strip.components++;
+    strip.junctions.clear();
+    mVisited[root] = 1;
+
+    // The root is the top of its component; an arc leaves it in two directions, which
+    // become one chain through the root
+    strip.chain.assign(1, root);
+    follow(strip, edges, root);
+    if (nextUnvisited(edges, root) >= 0) {
+        std::reverse(strip.chain.begin(), strip.chain.end());
+        follow(strip, edges, root);
+    }
+    emitChain(strip, edges.cols, epsilon, minPixels);
+
+    // Branches off the chains traced so far
+    while (!strip.junctions.empty()) {
+        int32_t junction = strip.junctions.back();
+        if (nextUnvisited(edges, junction) < 0) {
+            strip.junctions.pop_back();
+            continue;
+        }
+        strip.chain.assign(1, junction);
+        follow(strip, edges, junction);
+        emitChain(strip, edges.cols, epsilon, minPixels);
+    }
+}
+
+void EdgeLinker::emitChain(Strip& strip, int cols, double epsilon, int minPixels) {
+    const std::vector<int32_t>& chain = strip.chain;
+    if (static_cast<int>(chain.size()) < minPixels) {
+        return;
+    }
+
+    std::vector<cv::Point>& points = strip.points;
+    points.resize(chain.size());
+    for (size_t i = 0; i < chain.size(); i++) {
+        points[i] = cv::Point(chain[i] % cols, chain[i] / cols);
+    }
+
+    // A chain that ends next to where it started is a closed contour
+    if (points.size() >= 3) {
+        cv::Point gap = points.back() - points.front();
+        if (std::abs(gap.x) <= 1 && std::abs(gap.y) <= 1) {
+            points.push_back(points.front());
+        }
+    }
+
+    const size_t count = points.size();
+    std::vector<uint8_t>& keep = strip.keep;
+    keep.assign(count, epsilon > 0.0 ? 0 : 1);
+    keep.front() = 1;
+    keep.back() = 1;
+
+    if (epsilon > 0.0 && count > 2) {
+        // Douglas-Peucker without recursion: split every range at its farthest point
+        // while that point is more than epsilon away from the range's chord
+        const double limit = epsilon * epsilon;
+        std::vector<int>& ranges = strip.ranges;
+        ranges.assign({0, static_cast<int>(count) - 1});
+        while (!ranges.empty()) {
+            int last = ranges.back();
+            ranges.pop_back();
+            int first = ranges.back();
+            ranges.pop_back();
+
+            const cv::Point a = points[first];
+            const cv::Point chord = points[last] - a;
+            const double length = static_cast<double>(chord.x) * chord.x +
+                                  static_cast<double>(chord.y) * chord.y;
+            double farthest = 0.0;
+            int split = -1;
+            for (int i = first + 1; i < last; i++) {
+                const cv::Point d = points[i] - a;
+                // Squared distance to the chord, scaled by its squared length; to the
+                // point itself for a closed range whose chord is empty
+                double distance = length > 0.0
+                    ? static_cast<double>(chord.x * d.y - chord.y * d.x) *
+                      (chord.x * d.y - chord.y * d.x) / length
+                    : static_cast<double>(d.x) * d.x + static_cast<double>(d.y) * d.y;
+                if (distance > farthest) {
+                    farthest = distance;
+                    split = i;
+                }
+            }
+            if (split > 0 && farthest > limit) {
+                keep[split] = 1;
+                ranges.insert(ranges.end(), {first, split, split, last});
+            }
+        }
+    }
+
+    EdgeContours& out = strip.contours;
+    for (size_t i = 0; i < count; i++) {
+        if (keep[i]) {
+            out.xy.push_back(static_cast<uint16_t>(points[i].x));
+            out.xy.push_back(static_cast<uint16_t>(points[i].y));
+        }
+    }
+    out.start.push_back(static_cast<uint32_t>(out.xy.size() / 2));
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+/**
+ * Edge chains as polylines
+ *
+ * Polyline i is xy[2 * start[i]] .. xy[2 * start[i + 1]] as (x, y) pairs in edge mask
+ * coordinates. A closed chain repeats its first point at the end. Polylines that
+ * branch off a junction start at the junction point.
+ */
+struct EdgeContours {
+    int width = 0;
+    int height = 0;
+    std::vector<uint32_t> start;     // contourCount() + 1 point indices
+    std::vector<uint16_t> xy;
+
+    size_t contourCount() const {
+        return start.empty() ? 0 : start.size() - 1;
+    }
+
+    size_t pointCount() const {
+        return xy.size() / 2;
+    }
+
+    size_t bytes() const {
+        return start.size() * sizeof(uint32_t) + xy.size() * sizeof(uint16_t);
+    }
+};
+
+/**
+ * EdgeLinker - Links the pixels of an edge mask into polylines on a ThreadPool
+ *
+ * Connected edge pixels (8-connectivity) are labelled with a parallel union-find:
+ *  1. every horizontal strip unions the pixels of its own rows, with path
+ *     compression and the smallest pixel index as the root of every set,
+ *  2. a short serial pass unions the pixels across each strip border,
+ *  3. every strip traces the components whose root lies in it.
+ * The root of a component is its first pixel in raster order, so each component is
+ * traced by exactly one strip, starting at its top. Tracing follows unvisited
+ * neighbours (4-neighbours first) and returns to junctions for their other branches,
+ * so every pixel ends up in one polyline. Strips emit polylines in raster order of
+ * their roots and are concatenated in order, so the result does not depend on the
+ * number of threads.
+ *
+ * Each polyline is optionally simplified with Douglas-Peucker: points are dropped
+ * while the chain stays within epsilon pixels of the simplified line.
+ *
+ * Scratch buffers are kept between frames; an instance must not be shared between
+ * threads. Frame sizes are limited to 65535 on each side.
+ */
+class EdgeLinker {
+public:
+    /**
+     * Constructor
+     *
+     * @param pool The pool running the strips
+     */
+    explicit EdgeLinker(ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * Link the edge pixels of a mask into polylines
+     *
+     * @param edges The edge mask (CV_8UC1, nonzero for edge pixels)
+     * @param contours Receives the polylines
+     * @param epsilon Douglas-Peucker tolerance in pixels, 0 keeps every pixel
+     * @param minPixels Chains of fewer pixels (noise specks, junction spurs) are dropped
+     */
+    void link(const cv::Mat& edges, EdgeContours& contours, double epsilon = 0.0,
+              int minPixels = 2);
+
+    /**
+     * Limit how many pool workers help with each frame, besides the calling thread
+     *
+     * @param helpers The worker limit, or -1 to use the whole pool (the default)
+     */
+    void setMaxHelpers(int helpers) {
+        mMaxHelpers = helpers;
+    }
+
+    /**
+     * Get the number of connected components of the last mask
+     */
+    size_t componentCount() const {
+        return mComponents;
+    }
+
+    /**
+     * Get the number of strips the last mask was split into
+     */
+    int stripCount() const {
+        return static_cast<int>(mStrips.size());
+    }
+
+private:
+    // Strips are never thinner than this, so the serial border pass stays short
+    static constexpr int kMinStripRows = 16;
+    // Strips per thread, lets the pool balance strips of uneven edge density
+    static constexpr int kStripsPerThread = 4;
+
+    struct Strip {
+        int begin = 0;
+        int end = 0;
+        size_t components = 0;
+        EdgeContours contours;            // polylines of the components rooted here
+        std::vector<int32_t> chain;       // pixel indices of the chain being traced
+        std::vector<int32_t> junctions;   // traced pixels that may have untraced branches
+        std::vector<cv::Point> points;    // the chain as coordinates
+        std::vector<uint8_t> keep;        // Douglas-Peucker scratch
+        std::vector<int> ranges;
+    };
+
+    ThreadPool& mPool;
+    int mMaxHelpers = -1;
+    std::vector<Strip> mStrips;
+    std::vector<int32_t> mParent;     // union-find parent per pixel index, edge pixels only
+    std::vector<uint8_t> mVisited;    // traced flag per pixel index, edge pixels only
+    size_t mComponents = 0;
+
+    void layoutStrips(int rows);
+    void labelStrip(const Strip& strip, const cv::Mat& edges);
+    void mergeBorder(int row, const cv::Mat& edges);
+    void traceStrip(Strip& strip, const cv::Mat& edges, double epsilon, int minPixels);
+    void traceComponent(Strip& strip, const cv::Mat& edges, int32_t root, double epsilon,
+                        int minPixels);
+    void follow(Strip& strip, const cv::Mat& edges, int32_t from);
+    int32_t nextUnvisited(const cv::Mat& edges, int32_t index) const;
+    void emitChain(Strip& strip, int cols, double epsilon, int minPixels);
+    int32_t find(int32_t index);
+    void unite(int32_t a, int32_t b);
+};
@@ -0,0 +1,133 @@
+#include "frame_pipeline.h"
+
+#include <utility>
+
+#include "buffer_pool.h"
+#include "frame_trace.h"
+
+FramePipeline::FramePipeline(Processor processor, Release release)
+    : mProcessor(std::move(processor)), mRelease(release) {
+}
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+void FramePipeline::start() {
+    if (mRunning.exchange(true)) {
+        return;
+    }
+    mThread = std::thread(&FramePipeline::run, this);
+}
+
+void FramePipeline::stop() {
+    bool running;
+    {
+        std::lock_guard<std::mutex> guard(mSleepLock);
+        running = mRunning.exchange(false);
+    }
+    if (running) {
+        mWake.notify_one();
+        mThread.join();
+    }
+
+    // Nobody processes a waiting frame any more, give its planes back
+    if (mInput.acquire()) {
+        releaseInput(mInput.readBuffer());
+    }
+}
+
+void FramePipeline::submit() {
+    InputFrame& frame = mInput.writeBuffer();
+    frame.sequence = mNextSequence++;
+    frame.submittedNanos = FrameTrace::global().enabled() ? FrameTrace::nowNanos() : 0;
+    mSubmitted.fetch_add(1, std::memory_order_relaxed);
+
+    if (mInput.publish()) {
+        // The slot coming back is the replaced frame, the consumer never saw it
+        mDroppedInputs.fetch_add(1, std::memory_order_relaxed);
+        releaseInput(mInput.writeBuffer());
+    }
+
+    // Pairs with the sleeping flag store in run(): either the processing thread sees
+    // the new frame before going to sleep, or this thread sees that it sleeps
+    if (mSleeping.load()) {
+        { std::lock_guard<std::mutex> guard(mSleepLock); }
+        mWake.notify_one();
+    }
+}
+
+const FramePipeline::ResultFrame* FramePipeline::acquireResult() {
+    if (!mResults.acquire()) {
+        return nullptr;
+    }
+    mDisplayed.fetch_add(1, std::memory_order_relaxed);
+
+    // The caller's thread works on this frame now; trace how long it waited
+    const ResultFrame& result = mResults.readBuffer();
+    FrameTrace::setCurrentFrame(static_cast<uint64_t>(result.timestampNanos));
+    if (result.readyNanos > 0) {
+        FrameTrace::global().record("display queue", result.readyNanos, FrameTrace::nowNanos());
+    }
+    return &result;
+}
+
+FramePipeline::Stats FramePipeline::stats() const {
+    return {
+        mSubmitted.load(std::memory_order_relaxed),
+        mDroppedInputs.load(std::memory_order_relaxed),
+        mProcessed.load(std::memory_order_relaxed),
+        mDroppedResults.load(std::memory_order_relaxed),
+        mDisplayed.load(std::memory_order_relaxed)
+    };
+}
+
+void FramePipeline::run() {
+    FrameTrace& trace = FrameTrace::global();
+    trace.nameThread("processing");
+
+    while (mRunning.load(std::memory_order_relaxed)) {
+        if (!mInput.acquire()) {
+            std::unique_lock<std::mutex> guard(mSleepLock);
+            mSleeping.store(true);
+            mWake.wait(guard, [this] {
+                return mInput.hasFresh() || !mRunning.load(std::memory_order_relaxed);
+            });
+            mSleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        InputFrame& frame = mInput.readBuffer();
+        FrameTrace::setCurrentFrame(static_cast<uint64_t>(frame.timestampNanos));
+        if (frame.submittedNanos > 0) {
+            trace.record("input queue", frame.submittedNanos, FrameTrace::nowNanos());
+        }
+
+        ResultFrame& result = mResults.writeBuffer();
+        BufferPool::shared().attach(result.mask);
+        mProcessor(frame, result.mask);
+        releaseInput(frame);
+        result.sequence = frame.sequence;
+        result.sourceWidth = frame.width;
+        result.rotation = frame.rotation;
+        result.timestampNanos = frame.timestampNanos;
+        result.readyNanos = trace.enabled() ? FrameTrace::nowNanos() : 0;
+        mProcessed.fetch_add(1, std::memory_order_relaxed);
+
+        if (mResults.publish()) {
+            mDroppedResults.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+void FramePipeline::releaseInput(InputFrame& frame) {
+    if (!frame.owner) {
+        return;
+    }
+    frame.luma.release();
+    frame.chroma.release();
+    if (mRelease) {
+        mRelease(frame.owner);
+    }
+    frame.owner = nullptr;
+}
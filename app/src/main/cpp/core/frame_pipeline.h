@@ -0,0 +1,159 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "triple_buffer.h"
+
+/**
+ * FramePipeline - Runs edge detection on its own thread between camera and renderer
+ *
+ * The camera thread copies each frame into the input slot, or lends the slot views of
+ * the camera's own planes, and returns right away; the processing thread always works
+ * on the newest frame and publishes its edge mask into a triple-buffered result; the
+ * GL thread picks up the newest mask when it draws. A lent frame goes back to its
+ * owner through the Release callback as soon as it was processed, or when a newer
+ * frame replaces it.
+ * Both handoffs are lock-free TripleBuffers, so neither the camera nor the render loop
+ * ever waits for edge detection. Frames that are overwritten before anyone looked at
+ * them are counted as dropped.
+ *
+ * The processing thread only takes a lock to sleep while no frame is pending.
+ */
+class FramePipeline {
+public:
+    /**
+     * A camera frame waiting for processing
+     */
+    struct InputFrame {
+        cv::Mat yuv;             // Y plane, followed by interleaved VU rows when hasChroma
+
+        // Instead of yuv while owner is set: views of planes borrowed from the owner
+        cv::Mat luma;            // Y plane, rows may be padded
+        cv::Mat chroma;          // CV_8UC2 interleaved chroma when hasChroma
+        bool chromaUv = false;   // chroma is ordered U, V (NV12) rather than V, U (NV21)
+        cv::Mat chromaCopy;      // planar chroma interleaved into the slot, chroma views it
+        void* owner = nullptr;   // handed to Release once the planes are no longer read
+
+        int width = 0;
+        int height = 0;
+        int rotation = 0;
+        bool hasChroma = false;  // false in luma-only mode, where chroma is never read
+        uint64_t sequence = 0;
+        int64_t timestampNanos = 0;  // camera timestamp on the steady clock, its FrameTrace id
+        int64_t submittedNanos = 0;  // when submit() queued it, while tracing
+    };
+
+    /**
+     * An edge mask ready for display
+     */
+    struct ResultFrame {
+        cv::Mat mask;            // CV_8UC1, 0 or 255
+        uint64_t sequence = 0;   // sequence of the input frame it was computed from
+        int sourceWidth = 0;     // width of that frame; wider than the mask at pyramid levels
+        int rotation = 0;        // rotation of that frame, applied when drawing
+        int64_t timestampNanos = 0;  // camera timestamp of that frame
+        int64_t readyNanos = 0;      // when the mask was published, while tracing
+    };
+
+    /**
+     * Frame counters, all monotonic
+     */
+    struct Stats {
+        uint64_t submitted;       // frames handed in by the camera thread
+        uint64_t droppedInputs;   // frames replaced by a newer one before processing
+        uint64_t processed;       // frames run through edge detection
+        uint64_t droppedResults;  // masks replaced by a newer one before display
+        uint64_t displayed;       // masks picked up by the render thread
+    };
+
+    // Computes the edge mask of a frame; runs on the processing thread
+    using Processor = std::function<void(const InputFrame& frame, cv::Mat& mask)>;
+
+    // Gives borrowed planes back to their owner; runs on the processing thread, or on
+    // the producer thread for frames dropped before processing
+    using Release = void (*)(void* owner);
+
+    /**
+     * Constructor
+     *
+     * @param processor Called for every frame the processing thread picks up
+     * @param release Called for the owner of every frame with borrowed planes
+     */
+    explicit FramePipeline(Processor processor, Release release = nullptr);
+
+    /**
+     * Destructor - stops the processing thread
+     */
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    /**
+     * Start the processing thread (no-op when already running)
+     */
+    void start();
+
+    /**
+     * Stop and join the processing thread; the frame in progress is finished first and
+     * a frame still waiting is released unprocessed
+     */
+    void stop();
+
+    /**
+     * Get the input slot to fill (producer thread only). Its buffers are reused, so
+     * write into them with create()/copyTo() rather than assigning new Mats; only the
+     * luma and chroma views of borrowed planes are assigned, together with owner.
+     */
+    InputFrame& inputBuffer() {
+        return mInput.writeBuffer();
+    }
+
+    /**
+     * Publish the filled input slot and wake the processing thread (producer thread only)
+     */
+    void submit();
+
+    /**
+     * Take the newest mask not shown yet (render thread only). Makes its frame the
+     * calling thread's current FrameTrace frame.
+     *
+     * @return The mask, valid until the next call, or nullptr if nothing new is ready
+     */
+    const ResultFrame* acquireResult();
+
+    /**
+     * Read the frame counters (any thread)
+     */
+    Stats stats() const;
+
+private:
+    Processor mProcessor;
+    Release mRelease;
+    TripleBuffer<InputFrame> mInput;
+    TripleBuffer<ResultFrame> mResults;
+    uint64_t mNextSequence = 0;
+
+    std::thread mThread;
+    std::mutex mSleepLock;
+    std::condition_variable mWake;
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mSleeping{false};
+
+    std::atomic<uint64_t> mSubmitted{0};
+    std::atomic<uint64_t> mDroppedInputs{0};
+    std::atomic<uint64_t> mProcessed{0};
+    std::atomic<uint64_t> mDroppedResults{0};
+    std::atomic<uint64_t> mDisplayed{0};
+
+    void run();
+
+    // Drop the views of a frame's borrowed planes and hand them back to their owner
+    void releaseInput(InputFrame& frame);
+};
@@ -0,0 +1,244 @@
+#include "frame_recorder.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define LOG_TAG "FrameRecorder"
+
+static_assert(kRecordingMaxRegions == SessionEngine::Parameters::kMaxRegions,
+              "Recording entries must hold every region");
+
+namespace {
+
+uint64_t roundToPage(uint64_t bytes) {
+    return (bytes + kRecordingPageBytes - 1) / kRecordingPageBytes * kRecordingPageBytes;
+}
+
+uint64_t payloadBytes(const RecordingEntry& entry) {
+    return static_cast<uint64_t>(entry.inputBytes) + entry.edgeBytes;
+}
+
+} // namespace
+
+FrameRecorder::FrameRecorder() : mKernels(RowKernels::best()) {}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+bool FrameRecorder::start(const std::string& path, uint64_t capacityBytes, int content,
+                          uint32_t maxFrames) {
+    stop();
+    if (capacityBytes == 0 || maxFrames == 0 || (content & (RECORD_INPUT | RECORD_EDGES)) == 0) {
+        CORE_LOGE(LOG_TAG, "Nothing to record");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(mLock);
+    const uint64_t indexBytes = roundToPage(static_cast<uint64_t>(maxFrames) * sizeof(RecordingEntry));
+    const uint64_t dataBytes = roundToPage(capacityBytes);
+    const uint64_t fileBytes = kRecordingPageBytes + indexBytes + dataBytes;
+
+    mFile = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFile < 0) {
+        CORE_LOGE(LOG_TAG, "Cannot create %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    // Allocate every block up front: running out of disk space inside the mapping
+    // would be a SIGBUS instead of an error
+    int error = posix_fallocate(mFile, 0, static_cast<off_t>(fileBytes));
+    if (error != 0) {
+        CORE_LOGE(LOG_TAG, "Cannot allocate %llu bytes for %s: %s",
+                  static_cast<unsigned long long>(fileBytes), path.c_str(), strerror(error));
+        unmap();
+        return false;
+    }
+    void* map = mmap(nullptr, fileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+    if (map == MAP_FAILED) {
+        CORE_LOGE(LOG_TAG, "Cannot map %s: %s", path.c_str(), strerror(errno));
+        unmap();
+        return false;
+    }
+
+    mMap = static_cast<uint8_t*>(map);
+    mMapBytes = fileBytes;
+    mHeader = reinterpret_cast<RecordingHeader*>(mMap);
+    mEntries = reinterpret_cast<RecordingEntry*>(mMap + kRecordingPageBytes);
+    mData = mMap + kRecordingPageBytes + indexBytes;
+
+    // The file starts out zeroed, so every entry is empty
+    mHeader->version = kRecordingVersion;
+    mHeader->entryBytes = sizeof(RecordingEntry);
+    mHeader->entryCount = maxFrames;
+    mHeader->indexOffset = kRecordingPageBytes;
+    mHeader->dataOffset = kRecordingPageBytes + indexBytes;
+    mHeader->dataBytes = dataBytes;
+    mHeader->nextSequence = 1;
+    memcpy(mHeader->magic, kRecordingMagic, sizeof(kRecordingMagic));
+
+    mContent = content;
+    mOldest = 1;
+    mNext = 1;
+    mHead = 0;
+    mStats = {};
+    mRecording.store(true, std::memory_order_relaxed);
+
+    CORE_LOGI(LOG_TAG, "Recording to %s (%llu KB ring, %u frames at most)", path.c_str(),
+              static_cast<unsigned long long>(dataBytes >> 10), maxFrames);
+    return true;
+}
+
+void FrameRecorder::stop() {
+    mRecording.store(false, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> guard(mLock);
+    if (mMap) {
+        msync(mMap, mMapBytes, MS_SYNC);
+        CORE_LOGI(LOG_TAG, "Recorded %llu frames, %llu overwritten",
+                  static_cast<unsigned long long>(mStats.frames),
+                  static_cast<unsigned long long>(mStats.overwritten));
+    }
+    unmap();
+}
+
+void FrameRecorder::unmap() {
+    if (mMap) {
+        munmap(mMap, mMapBytes);
+    }
+    if (mFile >= 0) {
+        close(mFile);
+    }
+    mFile = -1;
+    mMap = nullptr;
+    mMapBytes = 0;
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mData = nullptr;
+}
+
+void FrameRecorder::evictOldest() {
+    // Readers must see the entry invalid before its payload changes
+    __atomic_store_n(&entry(mOldest).sequence, 0, __ATOMIC_RELEASE);
+    mOldest++;
+    mStats.overwritten++;
+}
+
+uint64_t FrameRecorder::allocate(uint64_t bytes) {
+    if (mHead + bytes > mHeader->dataBytes) {
+        // The rest of the ring is too short. The frames past the head are the oldest
+        // ones, drop them and start over at the front.
+        while (mOldest < mNext && entry(mOldest).dataOffset >= mHead) {
+            evictOldest();
+        }
+        mHead = 0;
+    }
+
+    // The oldest frames follow the head; drop those in the way, and the one whose
+    // index entry the new frame takes over
+    while (mOldest < mNext) {
+        const RecordingEntry& oldest = entry(mOldest);
+        bool overlaps = oldest.dataOffset < mHead + bytes &&
+                        oldest.dataOffset + payloadBytes(oldest) > mHead;
+        if (!overlaps && mNext - mOldest < mHeader->entryCount) {
+            break;
+        }
+        evictOldest();
+    }
+    return mHead;
+}
+
+bool FrameRecorder::record(const cv::Mat& input, int height, const cv::Mat& edges,
+                           int64_t timestampNanos, const SessionEngine::Parameters& parameters) {
+    if (!isRecording()) {
+        return false;
+    }
+    CV_Assert(input.type() == CV_8UC1);
+    CV_Assert(edges.empty() || edges.type() == CV_8UC1);
+
+    std::lock_guard<std::mutex> guard(mLock);
+    if (!mMap) {
+        return false;
+    }
+
+    const int edgeStride = (edges.cols + 7) / 8;
+    const uint32_t inputBytes = (mContent & RECORD_INPUT)
+        ? static_cast<uint32_t>(input.cols) * input.rows : 0;
+    const uint32_t edgeBytes = (mContent & RECORD_EDGES)
+        ? static_cast<uint32_t>(edgeStride) * edges.rows : 0;
+    const uint64_t bytes = static_cast<uint64_t>(inputBytes) + edgeBytes;
+    if (bytes == 0 || bytes > mHeader->dataBytes) {
+        mStats.dropped++;
+        return false;
+    }
+
+    const uint64_t offset = allocate(bytes);
+    uint8_t* out = mData + offset;
+    if (inputBytes > 0) {
+        if (input.isContinuous()) {
+            memcpy(out, input.data, inputBytes);
+        } else {
+            for (int y = 0; y < input.rows; y++) {
+                memcpy(out + static_cast<size_t>(y) * input.cols, input.ptr<uint8_t>(y), input.cols);
+            }
+        }
+        out += inputBytes;
+    }
+    if (edgeBytes > 0) {
+        for (int y = 0; y < edges.rows; y++) {
+            mKernels.packBits(edges.ptr<uint8_t>(y), out + static_cast<size_t>(y) * edgeStride,
+                              edges.cols);
+        }
+    }
+
+    const uint64_t sequence = mNext;
+    RecordingEntry& e = entry(sequence);
+    e.timestampNanos = timestampNanos;
+    e.dataOffset = offset;
+    e.inputBytes = inputBytes;
+    e.edgeBytes = edgeBytes;
+    e.width = input.cols;
+    e.height = height;
+    e.edgeWidth = edges.cols;
+    e.edgeHeight = edges.rows;
+    e.lowThreshold = parameters.lowThreshold;
+    e.ratio = parameters.ratio;
+    e.kernelSize = parameters.kernelSize;
+    e.engine = parameters.engine;
+    e.lumaOnly = parameters.lumaOnly;
+    e.incremental = parameters.incremental;
+    e.regionCount = static_cast<uint8_t>(parameters.regionCount);
+    e.changeSensitivity = static_cast<float>(parameters.changeSensitivity);
+    e.frameBudgetNanos = parameters.frameBudgetNanos;
+    e.maxPyramidLevel = parameters.maxPyramidLevel;
+    for (int i = 0; i < parameters.regionCount; i++) {
+        const cv::Rect& region = parameters.regions[i];
+        e.regions[i][0] = region.x;
+        e.regions[i][1] = region.y;
+        e.regions[i][2] = region.width;
+        e.regions[i][3] = region.height;
+    }
+    for (int i = parameters.regionCount; i < kRecordingMaxRegions; i++) {
+        std::fill(e.regions[i], e.regions[i] + 4, 0);
+    }
+
+    // Published last: a reader that sees the sequence sees the complete frame
+    __atomic_store_n(&e.sequence, sequence, __ATOMIC_RELEASE);
+    mNext = sequence + 1;
+    mHead = offset + bytes;
+    __atomic_store_n(&mHeader->nextSequence, mNext, __ATOMIC_RELEASE);
+
+    mStats.frames++;
+    mStats.bytes += bytes;
+    return true;
+}
+
+FrameRecorder::Stats FrameRecorder::stats() const {
+    std::lock_guard<std::mutex> guard(mLock);
+    return mStats;
+}
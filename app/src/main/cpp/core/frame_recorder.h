@@ -0,0 +1,133 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "recording_format.h"
+#include "row_kernels.h"
+#include "session_engine.h"
+
+/**
+ * FrameRecorder - Records frames, edge masks and parameters into a ring file
+ *
+ * The file (see recording_format.h) is created at its full size when recording starts
+ * and mapped shared into memory. Recording a frame is then a copy of the input frame
+ * and a bit-packing of the edge mask straight into the mapping, plus one index entry:
+ * no write() or other system call per frame, the kernel writes the dirtied pages back
+ * in the background. Once the ring is full the oldest frames are overwritten, so the
+ * file always holds the most recent stretch of footage that fits, ready to be pulled
+ * off a device and replayed with RecordingReader.
+ *
+ * record() runs on the caller's thread, cheap enough for the processing thread. Start,
+ * stop and record may be called from different threads.
+ */
+class FrameRecorder {
+public:
+    /**
+     * What every frame stores, may be combined
+     */
+    enum Content {
+        RECORD_INPUT = 1,   // the input frame as processed (NV21, or Y only in luma-only mode)
+        RECORD_EDGES = 2    // the edge mask, one bit per pixel
+    };
+
+    /**
+     * Counters of the current recording
+     */
+    struct Stats {
+        uint64_t frames;        // frames recorded
+        uint64_t bytes;         // payload bytes recorded
+        uint64_t overwritten;   // older frames overwritten to make room
+        uint64_t dropped;       // frames larger than the whole ring, not recorded
+    };
+
+    FrameRecorder();
+
+    /**
+     * Destructor - stops a recording in progress
+     */
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * Create the recording file and start recording, replacing the file if it exists.
+     * A recording in progress is stopped first.
+     *
+     * @param path The recording file
+     * @param capacityBytes Size of the data ring; the file is slightly larger
+     * @param content RECORD_INPUT, RECORD_EDGES or both
+     * @param maxFrames Number of index entries, the most frames the file can hold
+     * @return false if the file cannot be created or mapped
+     */
+    bool start(const std::string& path, uint64_t capacityBytes, int content,
+               uint32_t maxFrames = 4096);
+
+    /**
+     * Stop recording, write the file back and unmap it
+     */
+    void stop();
+
+    /**
+     * Check whether a recording is in progress
+     */
+    bool isRecording() const {
+        return mRecording.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Append one processed frame. Does nothing if no recording is in progress.
+     *
+     * @param input The input frame (CV_8UC1): NV21 when it has height * 3 / 2 rows,
+     *              otherwise a Y plane of height rows
+     * @param height Height of the image in input
+     * @param edges The edge mask computed from it (CV_8UC1)
+     * @param timestampNanos Steady clock time of the frame
+     * @param parameters The parameters the frame was processed with
+     * @return true if the frame was recorded
+     */
+    bool record(const cv::Mat& input, int height, const cv::Mat& edges, int64_t timestampNanos,
+                const SessionEngine::Parameters& parameters);
+
+    /**
+     * Read the counters of the current or last recording
+     */
+    Stats stats() const;
+
+private:
+    const RowKernels& mKernels;
+
+    std::atomic<bool> mRecording{false};
+    mutable std::mutex mLock;
+
+    // Under mLock
+    int mContent = 0;
+    int mFile = -1;
+    uint8_t* mMap = nullptr;
+    size_t mMapBytes = 0;
+    RecordingHeader* mHeader = nullptr;
+    RecordingEntry* mEntries = nullptr;
+    uint8_t* mData = nullptr;
+
+    uint64_t mOldest = 1;     // sequence of the oldest frame in the ring
+    uint64_t mNext = 1;       // sequence of the next frame
+    uint64_t mHead = 0;       // data ring offset the next payload goes to
+    Stats mStats = {};
+
+    RecordingEntry& entry(uint64_t sequence) {
+        return mEntries[(sequence - 1) % mHeader->entryCount];
+    }
+
+    // Invalidate the oldest frame in the ring
+    void evictOldest();
+
+    // Make room for a payload of the given size and return its data ring offset
+    uint64_t allocate(uint64_t bytes);
+
+    void unmap();
+};
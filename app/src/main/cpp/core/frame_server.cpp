@@ -0,0 +1,615 @@
+#include "frame_server.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+#define LOG_TAG "FrameServer"
+
+namespace {
+
+constexpr char kWebSocketGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+constexpr size_t kMaxRequestBytes = 8192;
+constexpr size_t kMaxMessageBytes = 4096;
+
+constexpr int kOpcodeText = 1;
+constexpr int kOpcodeBinary = 2;
+constexpr int kOpcodeClose = 8;
+constexpr int kOpcodePing = 9;
+constexpr int kOpcodePong = 10;
+
+int64_t nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 of a short message, only used for the WebSocket handshake
+void sha1(const std::string& message, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+
+    std::string data = message;
+    data.push_back(static_cast<char>(0x80));
+    while (data.size() % 64 != 56) {
+        data.push_back(0);
+    }
+    uint64_t bits = static_cast<uint64_t>(message.size()) * 8;
+    for (int i = 7; i >= 0; i--) {
+        data.push_back(static_cast<char>(bits >> (i * 8)));
+    }
+
+    for (size_t block = 0; block < data.size(); block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data() + block + i * 4);
+            w[i] = (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotateLeft(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotateLeft(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+std::string base64(const uint8_t* data, size_t size) {
+    static const char kAlphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < size; i += 3) {
+        uint32_t chunk = uint32_t(data[i]) << 16;
+        if (i + 1 < size) {
+            chunk |= uint32_t(data[i + 1]) << 8;
+        }
+        if (i + 2 < size) {
+            chunk |= data[i + 2];
+        }
+        out.push_back(kAlphabet[(chunk >> 18) & 63]);
+        out.push_back(kAlphabet[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < size ? kAlphabet[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < size ? kAlphabet[chunk & 63] : '=');
+    }
+    return out;
+}
+
+// Value of a request header, matched case-insensitively, or empty
+std::string headerValue(const std::string& request, const char* name) {
+    const size_t length = strlen(name);
+    size_t line = request.find("\r\n");
+    while (line != std::string::npos && line + 2 < request.size()) {
+        size_t start = line + 2;
+        size_t end = request.find("\r\n", start);
+        if (end == std::string::npos) {
+            break;
+        }
+        if (end - start > length && request[start + length] == ':' &&
+            strncasecmp(request.c_str() + start, name, length) == 0) {
+            size_t value = request.find_first_not_of(' ', start + length + 1);
+            return value < end ? request.substr(value, end - value) : std::string();
+        }
+        line = end;
+    }
+    return std::string();
+}
+
+} // namespace
+
+uint32_t streamChecksum(const uint8_t* bits, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i += 4) {
+        uint32_t word = 0;
+        for (size_t j = 0; j < 4 && i + j < size; j++) {
+            word |= uint32_t(bits[i + j]) << (8 * j);
+        }
+        hash = (hash ^ word) * 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * A connected viewer. Server thread only.
+ */
+struct FrameServer::Client {
+    static constexpr int kHistory = 16;
+
+    int fd = -1;
+    bool open = false;            // WebSocket handshake done
+    bool closing = false;         // disconnect once out is flushed
+
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t outOffset = 0;
+
+    PackedEdges last;             // frame the client holds, base of the next delta
+    uint32_t lastSequence = 0;
+    bool needKeyframe = true;
+    uint32_t latencyMicros = 0;
+
+    // Sent frames not acknowledged yet, by sequence % kHistory
+    uint32_t sentSequence[kHistory] = {};
+    int64_t sentNanos[kHistory] = {};
+
+    bool pendingOutput() const {
+        return outOffset < out.size();
+    }
+
+    int inFlight() const {
+        return static_cast<int>(std::count_if(sentSequence, sentSequence + kHistory,
+                                              [](uint32_t sequence) { return sequence != 0; }));
+    }
+};
+
+FrameServer::FrameServer() = default;
+
+FrameServer::~FrameServer() {
+    stop();
+}
+
+bool FrameServer::start(int port) {
+    if (isRunning()) {
+        return false;
+    }
+
+    mListen = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (mListen < 0) {
+        CORE_LOGE(LOG_TAG, "Cannot create socket: %s", strerror(errno));
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(mListen, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    socklen_t length = sizeof(address);
+    if (bind(mListen, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        listen(mListen, kMaxClients) != 0 ||
+        getsockname(mListen, reinterpret_cast<sockaddr*>(&address), &length) != 0 ||
+        pipe2(mWake, O_NONBLOCK | O_CLOEXEC) != 0) {
+        CORE_LOGE(LOG_TAG, "Cannot listen on port %d: %s", port, strerror(errno));
+        close(mListen);
+        mListen = -1;
+        return false;
+    }
+    mPort = ntohs(address.sin_port);
+
+    mNextSequence = 0;
+    mLatest = Frame();
+    mFrame = Frame();
+    mRunning.store(true, std::memory_order_relaxed);
+    mThread = std::thread([this]() { run(); });
+
+    CORE_LOGI(LOG_TAG, "Streaming edges on ws://127.0.0.1:%d", mPort);
+    return true;
+}
+
+void FrameServer::stop() {
+    if (!mThread.joinable()) {
+        return;
+    }
+    {
+        // publish() checks under the lock, so it never writes to a closed pipe
+        std::lock_guard<std::mutex> guard(mLock);
+        mRunning.store(false, std::memory_order_relaxed);
+        char wake = 0;
+        (void)!write(mWake[1], &wake, 1);
+    }
+    mThread.join();
+
+    for (Client* client : mClients) {
+        disconnect(client);
+    }
+    mClients.clear();
+    mClientCount.store(0, std::memory_order_relaxed);
+    close(mListen);
+    close(mWake[0]);
+    close(mWake[1]);
+    mListen = -1;
+    mWake[0] = mWake[1] = -1;
+    CORE_LOGI(LOG_TAG, "Stopped streaming");
+}
+
+void FrameServer::publish(const cv::Mat& edges) {
+    if (!isRunning() || mClientCount.load(std::memory_order_relaxed) == 0 || edges.empty()) {
+        return;
+    }
+    CV_Assert(edges.cols <= 65535 && edges.rows <= 65535);
+
+    mFormats.pack(edges, mStaging.edges);
+    mStaging.checksum = streamChecksum(mStaging.edges.bits.data(), mStaging.edges.bytes());
+    mStaging.publishedNanos = nowNanos();
+    mStaging.sequence = ++mNextSequence;
+
+    // A frame the server has not picked up yet is replaced
+    std::lock_guard<std::mutex> guard(mLock);
+    if (!isRunning()) {
+        return;
+    }
+    std::swap(mStaging, mLatest);
+    mPublished.fetch_add(1, std::memory_order_relaxed);
+    char wake = 0;
+    (void)!write(mWake[1], &wake, 1);
+}
+
+FrameServer::Stats FrameServer::stats() const {
+    Stats stats;
+    stats.clients = mClientCount.load(std::memory_order_relaxed);
+    stats.published = mPublished.load(std::memory_order_relaxed);
+    stats.sent = mSent.load(std::memory_order_relaxed);
+    stats.dropped = mDropped.load(std::memory_order_relaxed);
+    stats.keyframes = mKeyframes.load(std::memory_order_relaxed);
+    stats.bytesSent = mBytesSent.load(std::memory_order_relaxed);
+    stats.maskBytes = mMaskBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void FrameServer::run() {
+    std::vector<pollfd> fds;
+    std::vector<Client*> closed;
+
+    while (isRunning()) {
+        fds.clear();
+        fds.push_back({mWake[0], POLLIN, 0});
+        fds.push_back({mListen, POLLIN, 0});
+        for (Client* client : mClients) {
+            short events = POLLIN;
+            if (client->pendingOutput()) {
+                events |= POLLOUT;
+            }
+            fds.push_back({client->fd, events, 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) {
+            CORE_LOGE(LOG_TAG, "poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if (fds[0].revents & POLLIN) {
+            char drain[64];
+            while (read(mWake[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        closed.clear();
+        for (size_t i = 0; i < mClients.size(); i++) {
+            Client* client = mClients[i];
+            short events = fds[i + 2].revents;
+            bool alive = true;
+            if (events & (POLLIN | POLLHUP | POLLERR)) {
+                alive = receive(*client);
+            }
+            if (alive && (events & POLLOUT)) {
+                alive = flush(*client);
+            }
+            if (!alive) {
+                closed.push_back(client);
+            }
+        }
+        for (Client* client : closed) {
+            mClients.erase(std::find(mClients.begin(), mClients.end(), client));
+            disconnect(client);
+        }
+
+        if (fds[1].revents & POLLIN) {
+            accept();
+        }
+        mClientCount.store(mClients.size(), std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            if (mLatest.sequence > mFrame.sequence) {
+                std::swap(mLatest, mFrame);
+            }
+        }
+        if (mFrame.sequence == 0) {
+            continue;
+        }
+
+        // Every client that is ready gets the newest frame
+        closed.clear();
+        for (Client* client : mClients) {
+            if (!client->open || client->closing || client->pendingOutput() ||
+                client->lastSequence >= mFrame.sequence || client->inFlight() >= kMaxInFlight) {
+                continue;
+            }
+            sendFrame(*client);
+            if (!flush(*client)) {
+                closed.push_back(client);
+            }
+        }
+        for (Client* client : closed) {
+            mClients.erase(std::find(mClients.begin(), mClients.end(), client));
+            disconnect(client);
+        }
+        mClientCount.store(mClients.size(), std::memory_order_relaxed);
+    }
+}
+
+void FrameServer::accept() {
+    for (;;) {
+        int fd = accept4(mListen, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if (static_cast<int>(mClients.size()) >= kMaxClients) {
+            CORE_LOGW(LOG_TAG, "Refusing viewer, %d connected already", kMaxClients);
+            close(fd);
+            continue;
+        }
+        int noDelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        Client* client = new Client();
+        client->fd = fd;
+        mClients.push_back(client);
+    }
+}
+
+void FrameServer::disconnect(Client* client) {
+    if (client->open) {
+        CORE_LOGI(LOG_TAG, "Viewer disconnected after frame %u", client->lastSequence);
+    }
+    close(client->fd);
+    delete client;
+}
+
+bool FrameServer::receive(Client& client) {
+    uint8_t buffer[4096];
+    for (;;) {
+        ssize_t count = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (count > 0) {
+            client.in.insert(client.in.end(), buffer, buffer + count);
+            if (client.in.size() > kMaxRequestBytes + kMaxMessageBytes) {
+                return false;
+            }
+            continue;
+        }
+        if (count == 0) {
+            return false;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+
+    if (!client.open) {
+        return handshake(client);
+    }
+
+    // Client messages are always masked
+    size_t position = 0;
+    while (client.in.size() - position >= 2) {
+        const uint8_t* frame = client.in.data() + position;
+        const size_t available = client.in.size() - position;
+        const int opcode = frame[0] & 0x0f;
+        if (!(frame[1] & 0x80)) {
+            return false;
+        }
+        size_t size = frame[1] & 0x7f;
+        size_t header = 2;
+        if (size == 126) {
+            if (available < 4) {
+                break;
+            }
+            size = (size_t(frame[2]) << 8) | frame[3];
+            header = 4;
+        } else if (size == 127) {
+            // Nothing a viewer sends comes close
+            return false;
+        }
+        if (size > kMaxMessageBytes) {
+            return false;
+        }
+        if (available < header + 4 + size) {
+            break;
+        }
+
+        uint8_t* payload = client.in.data() + position + header + 4;
+        const uint8_t* mask = frame + header;
+        for (size_t i = 0; i < size; i++) {
+            payload[i] ^= mask[i & 3];
+        }
+        if (!handleMessage(client, opcode, payload, size)) {
+            return false;
+        }
+        position += header + 4 + size;
+    }
+    client.in.erase(client.in.begin(), client.in.begin() + position);
+    return flush(client);
+}
+
+bool FrameServer::handshake(Client& client) {
+    std::string request(client.in.begin(), client.in.end());
+    size_t end = request.find("\r\n\r\n");
+    if (end == std::string::npos) {
+        return request.size() <= kMaxRequestBytes;
+    }
+    request.resize(end + 2);
+    client.in.erase(client.in.begin(), client.in.begin() + end + 4);
+
+    std::string key = headerValue(request, "Sec-WebSocket-Key");
+    std::string response;
+    if (request.compare(0, 4, "GET ") != 0 || key.empty()) {
+        response = "HTTP/1.1 400 Bad Request\r\n"
+                   "Content-Type: text/plain\r\n"
+                   "Connection: close\r\n\r\n"
+                   "WebSocket edge stream only\n";
+        client.closing = true;
+    } else {
+        uint8_t digest[20];
+        sha1(key + kWebSocketGuid, digest);
+        response = "HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: " + base64(digest, sizeof(digest)) + "\r\n\r\n";
+        client.open = true;
+        CORE_LOGI(LOG_TAG, "Viewer connected");
+    }
+    client.out.assign(response.begin(), response.end());
+    client.outOffset = 0;
+    return flush(client);
+}
+
+bool FrameServer::handleMessage(Client& client, int opcode, const uint8_t* payload, size_t size) {
+    switch (opcode) {
+    case kOpcodeText: {
+        std::string text(reinterpret_cast<const char*>(payload), size);
+        if (text == "key") {
+            client.needKeyframe = true;
+        } else if (text.compare(0, 4, "ack ") == 0) {
+            uint32_t sequence = static_cast<uint32_t>(strtoul(text.c_str() + 4, nullptr, 10));
+            int slot = sequence % Client::kHistory;
+            if (sequence != 0 && client.sentSequence[slot] == sequence) {
+                int64_t nanos = nowNanos() - client.sentNanos[slot];
+                mLatency.record(nanos);
+                client.latencyMicros = static_cast<uint32_t>(nanos / 1000);
+            }
+            // Acknowledges everything sent up to it
+            for (uint32_t& sent : client.sentSequence) {
+                if (sent != 0 && sent <= sequence) {
+                    sent = 0;
+                }
+            }
+        }
+        return true;
+    }
+    case kOpcodeClose:
+        queueMessage(client, kOpcodeClose, payload, std::min<size_t>(size, 2));
+        client.closing = true;
+        return true;
+    case kOpcodePing:
+        queueMessage(client, kOpcodePong, payload, size);
+        return true;
+    default:
+        return true;
+    }
+}
+
+void FrameServer::sendFrame(Client& client) {
+    const Frame& frame = mFrame;
+    const PackedEdges& edges = frame.edges;
+    const bool keyframe = client.needKeyframe || client.last.width != edges.width ||
+                          client.last.height != edges.height;
+
+    StreamFrameHeader header = {};
+    header.version = kStreamVersion;
+    header.flags = keyframe ? kStreamKeyframe : 0;
+    header.sequence = frame.sequence;
+    header.width = static_cast<uint16_t>(edges.width);
+    header.height = static_cast<uint16_t>(edges.height);
+    header.checksum = frame.checksum;
+    header.latencyMicros = client.latencyMicros;
+    header.queuedMicros = static_cast<uint32_t>((nowNanos() - frame.publishedNanos) / 1000);
+
+    mScratch.resize(sizeof(header));
+    memcpy(mScratch.data(), &header, sizeof(header));
+    mCoder.encodeDelta(edges, keyframe ? nullptr : &client.last, mScratch);
+    queueMessage(client, kOpcodeBinary, mScratch.data(), mScratch.size());
+
+    if (client.lastSequence != 0 && frame.sequence > client.lastSequence + 1) {
+        mDropped.fetch_add(frame.sequence - client.lastSequence - 1, std::memory_order_relaxed);
+    }
+    client.last.width = edges.width;
+    client.last.height = edges.height;
+    client.last.stride = edges.stride;
+    client.last.bits = edges.bits;
+    client.lastSequence = frame.sequence;
+    client.needKeyframe = false;
+
+    int slot = frame.sequence % Client::kHistory;
+    client.sentSequence[slot] = frame.sequence;
+    client.sentNanos[slot] = frame.publishedNanos;
+
+    mSent.fetch_add(1, std::memory_order_relaxed);
+    mBytesSent.fetch_add(mScratch.size(), std::memory_order_relaxed);
+    mMaskBytes.fetch_add(static_cast<uint64_t>(edges.width) * edges.height, std::memory_order_relaxed);
+    if (keyframe) {
+        mKeyframes.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void FrameServer::queueMessage(Client& client, int opcode, const uint8_t* payload, size_t size) {
+    if (!client.pendingOutput()) {
+        client.out.clear();
+        client.outOffset = 0;
+    }
+    // Server messages are unmasked and never fragmented
+    client.out.push_back(static_cast<uint8_t>(0x80 | opcode));
+    if (size < 126) {
+        client.out.push_back(static_cast<uint8_t>(size));
+    } else if (size <= 0xffff) {
+        client.out.push_back(126);
+        client.out.push_back(static_cast<uint8_t>(size >> 8));
+        client.out.push_back(static_cast<uint8_t>(size));
+    } else {
+        client.out.push_back(127);
+        for (int i = 7; i >= 0; i--) {
+            client.out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(size) >> (i * 8)));
+        }
+    }
+    client.out.insert(client.out.end(), payload, payload + size);
+}
+
+bool FrameServer::flush(Client& client) {
+    while (client.pendingOutput()) {
+        ssize_t count = send(client.fd, client.out.data() + client.outOffset,
+                             client.out.size() - client.outOffset, MSG_NOSIGNAL);
+        if (count > 0) {
+            client.outOffset += count;
+        } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return !client.closing;
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "edge_formats.h"
+#include "stage_stats.h"
+
+/**
+ * Wire format of the edge stream (see FrameServer)
+ *
+ * Every edge mask is one binary WebSocket message: a StreamFrameHeader followed by the
+ * mask packed to one bit per pixel (PackedEdges), delta-coded with
+ * EdgeFormats::encodeDelta against the last frame sent to the same client, or against
+ * an empty frame for a keyframe. All values are little-endian.
+ *
+ * Clients send text messages back:
+ *   "ack <sequence>"   the frame was displayed; the server measures latency with it
+ *   "key"              the client lost track (e.g. checksum mismatch), send a keyframe
+ */
+constexpr uint8_t kStreamVersion = 1;
+constexpr uint8_t kStreamKeyframe = 1;
+
+struct StreamFrameHeader {
+    uint8_t version;             // kStreamVersion
+    uint8_t flags;               // kStreamKeyframe
+    uint16_t reserved;
+    uint32_t sequence;           // frame number, skipped numbers were dropped for this client
+    uint16_t width;
+    uint16_t height;
+    uint32_t checksum;           // streamChecksum() of the complete packed frame
+    uint32_t latencyMicros;      // latest ready-to-acknowledged time of this client, 0 if none
+    uint32_t queuedMicros;       // time the frame waited in the server before sending
+};
+
+static_assert(sizeof(StreamFrameHeader) == 24, "StreamFrameHeader layout changed");
+
+/**
+ * FNV-1a over the little-endian 32-bit words of a packed frame, zero padded to whole
+ * words. Lets a client verify that its delta-decoded frame matches the server's.
+ */
+uint32_t streamChecksum(const uint8_t* bits, size_t size);
+
+/**
+ * FrameServer - Streams edge masks to viewers over WebSocket on localhost
+ *
+ * Binds to 127.0.0.1 only; a desktop browser reaches the device through
+ * adb forward tcp:<port> tcp:<port>. One thread serves every client with non-blocking
+ * sockets and poll().
+ *
+ * publish() packs the mask on the caller's thread and hands it over as the newest
+ * frame, replacing one the server has not picked up yet. Each client gets the newest
+ * frame once it has acknowledged all but kMaxInFlight - 1 of the frames sent to it and
+ * the socket took the previous one: a client that decodes slowly, or a slow network,
+ * skips frames instead of building up a queue in the socket buffers, and its next
+ * frame is delta-coded against the last one it actually received.
+ */
+class FrameServer {
+public:
+    /**
+     * Counters, all monotonic except clients
+     */
+    struct Stats {
+        uint64_t clients;       // connected viewers
+        uint64_t published;     // frames handed to publish()
+        uint64_t sent;          // frames sent, summed over clients
+        uint64_t dropped;       // frames skipped for a client that was still busy
+        uint64_t keyframes;     // frames sent as keyframes
+        uint64_t bytesSent;     // WebSocket payload bytes of the sent frames
+        uint64_t maskBytes;     // the same frames as 8-bit masks, for the compression ratio
+    };
+
+    static constexpr int kDefaultPort = 8765;
+    static constexpr int kMaxClients = 8;
+    static constexpr int kMaxInFlight = 2;
+
+    FrameServer();
+
+    /**
+     * Destructor - stops the server
+     */
+    ~FrameServer();
+
+    FrameServer(const FrameServer&) = delete;
+    FrameServer& operator=(const FrameServer&) = delete;
+
+    /**
+     * Listen on 127.0.0.1 and start the server thread
+     *
+     * @param port TCP port, 0 picks a free one (see port())
+     * @return false if the port cannot be bound or the server already runs
+     */
+    bool start(int port = kDefaultPort);
+
+    /**
+     * Disconnect every client and stop the server thread
+     */
+    void stop();
+
+    bool isRunning() const {
+        return mRunning.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Get the port the server listens on
+     */
+    int port() const {
+        return mPort;
+    }
+
+    /**
+     * Publish a new edge mask. Meant for one producer thread; does nothing while the
+     * server is stopped or nobody is connected.
+     *
+     * @param edges The edge mask (CV_8UC1), at most 65535 pixels on each side
+     */
+    void publish(const cv::Mat& edges);
+
+    /**
+     * Read the counters
+     */
+    Stats stats() const;
+
+    /**
+     * Latency from publish() to the client's acknowledgement of the frame, which covers
+     * sending, decoding and displaying it
+     */
+    const LatencyHistogram& latency() const {
+        return mLatency;
+    }
+
+private:
+    struct Frame {
+        PackedEdges edges;
+        uint32_t sequence = 0;
+        uint32_t checksum = 0;
+        int64_t publishedNanos = 0;
+    };
+
+    struct Client;
+
+    std::atomic<bool> mRunning{false};
+    int mPort = 0;
+    int mListen = -1;
+    int mWake[2] = {-1, -1};      // pipe that wakes the server thread
+    std::thread mThread;
+
+    // Producer side
+    EdgeFormats mFormats;
+    Frame mStaging;
+    uint32_t mNextSequence = 0;
+
+    // Newest published frame, under mLock
+    std::mutex mLock;
+    Frame mLatest;
+
+    // Server thread only
+    EdgeFormats mCoder;
+    Frame mFrame;
+    std::vector<Client*> mClients;
+    std::vector<uint8_t> mScratch;
+
+    std::atomic<uint64_t> mClientCount{0};
+    std::atomic<uint64_t> mPublished{0};
+    std::atomic<uint64_t> mSent{0};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<uint64_t> mKeyframes{0};
+    std::atomic<uint64_t> mBytesSent{0};
+    std::atomic<uint64_t> mMaskBytes{0};
+    LatencyHistogram mLatency;
+
+    void run();
+    void accept();
+    bool receive(Client& client);
+    bool handshake(Client& client);
+    bool handleMessage(Client& client, int opcode, const uint8_t* payload, size_t size);
+    void sendFrame(Client& client);
+    bool flush(Client& client);
+    void queueMessage(Client& client, int opcode, const uint8_t* payload, size_t size);
+    void disconnect(Client* client);
+};
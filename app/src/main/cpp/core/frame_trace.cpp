@@ -0,0 +1,173 @@
+#include "frame_trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+
+#include "logger.h"
+
+#define LOG_TAG "FrameTrace"
+
+namespace {
+
+thread_local uint64_t tCurrentFrame = 0;
+thread_local uint32_t tThreadId = 0;
+std::atomic<uint32_t> gNextThreadId{1};
+
+// Chrome trace timestamps are microseconds
+void appendMicros(std::string& out, int64_t nanos) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%" PRId64 ".%03d", nanos / 1000,
+                  static_cast<int>(nanos % 1000));
+    out += text;
+}
+
+} // namespace
+
+FrameTrace& FrameTrace::global() {
+    static FrameTrace trace;
+    return trace;
+}
+
+void FrameTrace::setEnabled(bool enabled) {
+    if (enabled && !mEnabled.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < kCapacity; i++) {
+            mSlots[i].sequence.store(0, std::memory_order_relaxed);
+        }
+        mNext.store(0, std::memory_order_relaxed);
+    }
+    mEnabled.store(enabled, std::memory_order_release);
+}
+
+void FrameTrace::append(const char* name, uint64_t frame, int64_t beginNanos,
+                        int64_t endNanos, uint32_t thread) {
+    uint64_t index = mNext.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = mSlots[index % kCapacity];
+
+    // Odd while the fields change, so a reader copying them meanwhile discards the copy
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    slot.beginNanos.store(beginNanos, std::memory_order_relaxed);
+    slot.endNanos.store(endNanos, std::memory_order_relaxed);
+    slot.thread.store(thread, std::memory_order_relaxed);
+    slot.sequence.store(2 * index + 2, std::memory_order_release);
+}
+
+void FrameTrace::nameThread(const char* name) {
+    uint32_t thread = threadId();
+    std::lock_guard<std::mutex> guard(mNamesLock);
+    for (auto& entry : mThreadNames) {
+        if (entry.first == thread) {
+            entry.second = name;
+            return;
+        }
+    }
+    mThreadNames.emplace_back(thread, name);
+}
+
+void FrameTrace::snapshot(std::vector<Event>& events) const {
+    events.clear();
+    uint64_t end = mNext.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+    events.reserve(static_cast<size_t>(end - begin));
+
+    for (uint64_t index = begin; index < end; index++) {
+        const Slot& slot = mSlots[index % kCapacity];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * index + 2) {
+            continue;
+        }
+        Event event;
+        event.name = slot.name.load(std::memory_order_relaxed);
+        event.frame = slot.frame.load(std::memory_order_relaxed);
+        event.beginNanos = slot.beginNanos.load(std::memory_order_relaxed);
+        event.endNanos = slot.endNanos.load(std::memory_order_relaxed);
+        event.thread = slot.thread.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == sequence && event.name) {
+            events.push_back(event);
+        }
+    }
+}
+
+std::string FrameTrace::chromeJson() const {
+    std::vector<Event> events;
+    snapshot(events);
+    std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) {
+        return a.beginNanos < b.beginNanos;
+    });
+
+    std::string out;
+    out.reserve(128 * (events.size() + 8));
+    out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+    char text[128];
+    std::snprintf(text, sizeof(text),
+                  "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                  "\"args\":{\"name\":\"frames\"}}", kFrameTrack);
+    out += text;
+    {
+        std::lock_guard<std::mutex> guard(mNamesLock);
+        for (const auto& entry : mThreadNames) {
+            std::snprintf(text, sizeof(text),
+                          ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                          "\"args\":{\"name\":\"%s\"}}", entry.first, entry.second);
+            out += text;
+        }
+    }
+
+    for (const Event& event : events) {
+        out += ",\n{\"name\":\"";
+        out += event.name;
+        std::snprintf(text, sizeof(text), "\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":",
+                      event.thread);
+        out += text;
+        appendMicros(out, event.beginNanos);
+        out += ",\"dur\":";
+        appendMicros(out, std::max<int64_t>(0, event.endNanos - event.beginNanos));
+        std::snprintf(text, sizeof(text), ",\"args\":{\"frame\":%" PRIu64 "}}", event.frame);
+        out += text;
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool FrameTrace::save(const std::string& path) const {
+    std::string json = chromeJson();
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) {
+        CORE_LOGE(LOG_TAG, "Cannot write trace to %s", path.c_str());
+        return false;
+    }
+    bool written = std::fwrite(json.data(), 1, json.size(), file) == json.size();
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        CORE_LOGE(LOG_TAG, "Failed writing trace to %s", path.c_str());
+        return false;
+    }
+    CORE_LOGI(LOG_TAG, "Wrote %zu bytes of trace to %s", json.size(), path.c_str());
+    return true;
+}
+
+uint64_t FrameTrace::currentFrame() {
+    return tCurrentFrame;
+}
+
+void FrameTrace::setCurrentFrame(uint64_t frame) {
+    tCurrentFrame = frame;
+}
+
+uint32_t FrameTrace::threadId() {
+    if (tThreadId == 0) {
+        tThreadId = gNextThreadId.fetch_add(1, std::memory_order_relaxed);
+    }
+    return tThreadId;
+}
+
+int64_t FrameTrace::nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * FrameTrace - Per-frame event ring, exported as a Chrome / Perfetto JSON trace
+ *
+ * Histograms (StageStats) show how long stages take in aggregate; a trace shows
+ * where one particular frame spent its time between the camera and the screen, and
+ * which frames stalled. Every event is a named span on one thread, tagged with the
+ * frame it belongs to. Frames are identified by their camera timestamp on the
+ * steady clock, so a frame's id is also the moment its motion happened.
+ *
+ * Each thread has a current frame (setCurrentFrame()); ScopedStageTimer records its
+ * stage into the trace under it, so every EDGE_STAGE_TIMER scope shows up without
+ * further instrumentation. The pipeline moves the frame id from the camera thread to
+ * the processing and GL threads along with the frame.
+ *
+ * Recording is lock-free: a slot is claimed with one atomic increment and filled
+ * with relaxed stores, published by a per-slot sequence number that readers check
+ * before and after copying (a seqlock). The ring keeps the newest kCapacity events.
+ * While tracing is off, recording costs one relaxed load.
+ */
+class FrameTrace {
+public:
+    /**
+     * One span on one thread
+     */
+    struct Event {
+        const char* name;      // string literal, never freed
+        uint64_t frame;        // camera timestamp of the frame, 0 if none
+        int64_t beginNanos;    // steady clock
+        int64_t endNanos;
+        uint32_t thread;       // small per-process thread number, see threadId()
+    };
+
+    static constexpr size_t kCapacity = 1 << 14;
+
+    // Thread number of the per-frame "motion to photon" track
+    static constexpr uint32_t kFrameTrack = 0;
+
+    /**
+     * Get the trace shared by the whole native pipeline
+     */
+    static FrameTrace& global();
+
+    /**
+     * Start or stop recording. Starting clears the events of an earlier trace.
+     */
+    void setEnabled(bool enabled);
+
+    bool enabled() const {
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Record a span of the current frame on the calling thread
+     */
+    void record(const char* name, int64_t beginNanos, int64_t endNanos) {
+        if (enabled()) {
+            append(name, currentFrame(), beginNanos, endNanos, threadId());
+        }
+    }
+
+    /**
+     * Record a span of the given frame
+     *
+     * @param name String literal naming the span
+     * @param frame Frame id
+     * @param beginNanos Start on the steady clock
+     * @param endNanos End on the steady clock
+     * @param thread Thread number, kFrameTrack for the per-frame track
+     */
+    void record(const char* name, uint64_t frame, int64_t beginNanos, int64_t endNanos,
+                uint32_t thread) {
+        if (enabled()) {
+            append(name, frame, beginNanos, endNanos, thread);
+        }
+    }
+
+    /**
+     * Name the calling thread in exported traces
+     *
+     * @param name String literal
+     */
+    void nameThread(const char* name);
+
+    /**
+     * Copy the recorded events, oldest first. Events being written concurrently are
+     * skipped.
+     */
+    void snapshot(std::vector<Event>& events) const;
+
+    /**
+     * Render the recorded events as Chrome trace event JSON, loadable by
+     * chrome://tracing and ui.perfetto.dev
+     */
+    std::string chromeJson() const;
+
+    /**
+     * Write chromeJson() to a file
+     *
+     * @return false if the file cannot be written
+     */
+    bool save(const std::string& path) const;
+
+    /**
+     * Get or set the frame the calling thread works on
+     */
+    static uint64_t currentFrame();
+    static void setCurrentFrame(uint64_t frame);
+
+    /**
+     * Small number identifying the calling thread, assigned on first use from 1
+     */
+    static uint32_t threadId();
+
+    /**
+     * Now on the steady clock, in nanoseconds
+     */
+    static int64_t nowNanos();
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};    // 2 * index + 2 once written, odd while writing
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> frame{0};
+        std::atomic<int64_t> beginNanos{0};
+        std::atomic<int64_t> endNanos{0};
+        std::atomic<uint32_t> thread{0};
+    };
+
+    std::atomic<bool> mEnabled{false};
+    std::atomic<uint64_t> mNext{0};
+    std::unique_ptr<Slot[]> mSlots{new Slot[kCapacity]};
+
+    mutable std::mutex mNamesLock;
+    std::vector<std::pair<uint32_t, const char*>> mThreadNames;
+
+    void append(const char* name, uint64_t frame, int64_t beginNanos, int64_t endNanos,
+                uint32_t thread);
+};
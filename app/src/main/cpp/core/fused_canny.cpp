@@ -0,0 +1,242 @@
+#include "fused_canny.h"
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace {
+
+// tan(22.5 degrees) in Q15, the constant cv::Canny uses for its direction test
+constexpr int kTan22 = 13573;
+
+// BORDER_REFLECT_101 row index, the default border of GaussianBlur
+inline int reflect101(int row, int rows) {
+    if (row < 0) {
+        return -row;
+    }
+    if (row >= rows) {
+        return 2 * rows - 2 - row;
+    }
+    return row;
+}
+
+} // namespace
+
+FusedCanny::FusedCanny(const RowKernels& kernels) : mKernels(kernels) {
+    BufferPool::shared().attach(mSmallBlur);
+}
+
+void FusedCanny::allocate(int cols) {
+    if (cols == mCols) {
+        return;
+    }
+    mCols = cols;
+    mSource.assign(cols + 4, 0);
+    mHorizontal.assign(5 * cols, 0);
+    mBlurred.assign(3 * (cols + 2), 0);
+    mDx.assign(2 * cols, 0);
+    mDy.assign(2 * cols, 0);
+    mMag.assign(4 * (cols + 2), 0);
+}
+
+void FusedCanny::process(const cv::Mat& gray, cv::Mat& edges, double lowThreshold,
+                         double highThreshold) {
+    CV_Assert(gray.type() == CV_8UC1);
+
+    if (lowThreshold > highThreshold) {
+        std::swap(lowThreshold, highThreshold);
+    }
+
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    mRows = rows;
+
+    // The reflected borders need at least three rows and columns
+    if (rows < 3 || cols < 3) {
+        cv::GaussianBlur(gray, mSmallBlur, cv::Size(5, 5), 1.5, 1.5);
+        cv::Canny(mSmallBlur, edges, lowThreshold, highThreshold, 3);
+        return;
+    }
+
+    const int low = static_cast<int>(std::floor(lowThreshold));
+    const int high = static_cast<int>(std::floor(highThreshold));
+
+    allocate(cols);
+    edges.create(rows, cols, CV_8UC1);
+    mStack.clear();
+
+    const int magStep = cols + 2;
+    const int* zeroMag = &mMag[3 * magStep];
+
+    auto horizontalRow = [&](int row) { return &mHorizontal[(row % 5) * cols]; };
+    auto blurredRow = [&](int row) { return &mBlurred[(row % 3) * (cols + 2) + 1]; };
+    auto dxRow = [&](int row) { return &mDx[(row % 2) * cols]; };
+    auto dyRow = [&](int row) { return &mDy[(row % 2) * cols]; };
+    auto magRow = [&](int row) -> const int* {
+        return row < 0 || row >= rows ? zeroMag : &mMag[(row % 3) * magStep];
+    };
+
+    int nextHorizontal = 0;
+    int nextBlurred = 0;
+    int nextGradient = 0;
+
+    // Stage 1: horizontal blur of the next input row
+    auto filterHorizontal = [&]() {
+        const int row = nextHorizontal++;
+        const uint8_t* src = gray.ptr<uint8_t>(row);
+        uint8_t* padded = &mSource[2];
+        memcpy(padded, src, cols);
+        padded[-2] = src[2];
+        padded[-1] = src[1];
+        padded[cols] = src[cols - 2];
+        padded[cols + 1] = src[cols - 3];
+        mKernels.gaussianHorizontal(padded, horizontalRow(row), cols);
+    };
+
+    // Stage 2: vertical blur, needs horizontal rows up to two below
+    auto filterVertical = [&]() {
+        const int row = nextBlurred++;
+        const int last = std::min(row + 2, rows - 1);
+        while (nextHorizontal <= last) {
+            filterHorizontal();
+        }
+
+        const uint16_t* taps[5];
+        for (int t = 0; t < 5; t++) {
+            taps[t] = horizontalRow(reflect101(row - 2 + t, rows));
+        }
+        uint8_t* out = blurredRow(row);
+        mKernels.gaussianVertical(taps, out, cols);
+        out[-1] = out[0];
+        out[cols] = out[cols - 1];
+    };
+
+    // Stage 3: Sobel and magnitude, needs blurred rows up to one below
+    auto gradient = [&]() {
+        const int row = nextGradient++;
+        const int last = std::min(row + 1, rows - 1);
+        while (nextBlurred <= last) {
+            filterVertical();
+        }
+
+        int16_t* dx = dxRow(row);
+        int16_t* dy = dyRow(row);
+        mKernels.sobel3(blurredRow(std::max(row - 1, 0)), blurredRow(row),
+                        blurredRow(std::min(row + 1, rows - 1)), dx, dy, cols);
+
+        int* mag = &mMag[(row % 3) * magStep];
+        mag[0] = 0;
+        mag[cols + 1] = 0;
+        for (int j = 0; j < cols; j++) {
+            mag[j + 1] = std::abs(dx[j]) + std::abs(dy[j]);
+        }
+    };
+
+    // Stage 4: non-maximum suppression, needs gradients up to one row below
+    for (int i = 0; i < rows; i++) {
+        const int last = std::min(i + 1, rows - 1);
+        while (nextGradient <= last) {
+            gradient();
+        }
+
+        const int* magPrev = magRow(i - 1);
+        const int* magCur = magRow(i);
+        const int* magNext = magRow(i + 1);
+        const int16_t* dxCur = dxRow(i);
+        const int16_t* dyCur = dyRow(i);
+        uint8_t* state = edges.ptr<uint8_t>(i);
+
+        for (int j = 0; j < cols; j++) {
+            const int m = magCur[j + 1];
+            uint8_t value = 1;
+
+            if (m > low) {
+                const int xs = dxCur[j];
+                const int ys = dyCur[j];
+                const int x = std::abs(xs);
+                const int y = std::abs(ys) << 15;
+                const int tg22x = x * kTan22;
+                bool isMax;
+
+                if (y < tg22x) {
+                    isMax = m > magCur[j] && m >= magCur[j + 2];
+                } else {
+                    const int tg67x = tg22x + (x << 16);
+                    if (y > tg67x) {
+                        isMax = m > magPrev[j + 1] && m >= magNext[j + 1];
+                    } else {
+                        const int s = (xs ^ ys) < 0 ? -1 : 1;
+                        isMax = m > magPrev[j + 1 - s] && m > magNext[j + 1 + s];
+                    }
+                }
+
+                if (isMax) {
+                    value = m > high ? 2 : 0;
+                }
+            }
+
+            state[j] = value;
+            if (value == 2) {
+                mStack.push_back(i * cols + j);
+            }
+        }
+    }
+
+    // Hysteresis in place on the output mask
+    while (!mStack.empty()) {
+        const int index = mStack.back();
+        mStack.pop_back();
+        const int y = index / cols;
+        const int x = index - y * cols;
+
+        for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, rows - 1); ny++) {
+            uint8_t* state = edges.ptr<uint8_t>(ny);
+            for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, cols - 1); nx++) {
+                if (state[nx] == 0) {
+                    state[nx] = 2;
+                    mStack.push_back(ny * cols + nx);
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < rows; i++) {
+        uint8_t* state = edges.ptr<uint8_t>(i);
+        for (int j = 0; j < cols; j++) {
+            state[j] = state[j] == 2 ? 255 : 0;
+        }
+    }
+}
+
+FusedCanny::MemoryReport FusedCanny::footprint() const {
+    MemoryReport report;
+    report.workingSetBytes = mSource.size() +
+                             mHorizontal.size() * sizeof(uint16_t) +
+                             mBlurred.size() +
+                             (mDx.size() + mDy.size()) * sizeof(int16_t) +
+                             mMag.size() * sizeof(int) +
+                             mStack.capacity() * sizeof(int);
+
+    // Input read once, state written by suppression, then read and written by the
+    // final 0/255 pass; hysteresis only revisits the few pixels it grows into
+    const size_t pixels = static_cast<size_t>(mRows) * mCols;
+    report.trafficBytes = 4 * pixels;
+    return report;
+}
+
+FusedCanny::MemoryReport FusedCanny::threePassFootprint(int width, int height) {
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const size_t mapPixels = static_cast<size_t>(width + 2) * (height + 2);
+
+    MemoryReport report;
+    // Full blurred frame plus cv::Canny's bordered state map
+    report.workingSetBytes = pixels + mapPixels;
+    // Blur reads input and writes the blurred frame, Canny reads it back, writes and
+    // re-reads its map and writes the output
+    report.trafficBytes = 2 * pixels + pixels + 2 * mapPixels + pixels;
+    return report;
+}
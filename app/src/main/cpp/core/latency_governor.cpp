@@ -0,0 +1,78 @@
+#include "latency_governor.h"
+
+#include <algorithm>
+
+void LatencyGovernor::setBudget(int64_t nanos) {
+    mBudget = std::max<int64_t>(0, nanos);
+    mPublishedBudget.store(mBudget, std::memory_order_relaxed);
+    if (mBudget == 0) {
+        changeLevel(0);
+    }
+}
+
+void LatencyGovernor::setMaxLevel(int level) {
+    mMaxLevel = std::min(std::max(level, 0), kMaxLevel);
+    if (mLevel > mMaxLevel) {
+        changeLevel(mMaxLevel);
+    }
+}
+
+void LatencyGovernor::record(int64_t nanos) {
+    if (mBudget == 0) {
+        return;
+    }
+
+    // The first frame at a new level says nothing about the old one's average
+    mSmoothed = mFreshLevel ? nanos : mSmoothed + kSmoothing * (nanos - mSmoothed);
+    mFreshLevel = false;
+    mFramesAtLevel++;
+    mPublishedSmoothed.store(static_cast<int64_t>(mSmoothed), std::memory_order_relaxed);
+
+    if (nanos > mBudget) {
+        mOverBudget.fetch_add(1, std::memory_order_relaxed);
+        mOverStreak++;
+        mUnderStreak = 0;
+    } else {
+        mOverStreak = 0;
+        // The finer level has four times the pixels
+        mUnderStreak = mSmoothed * 4 < kUpHeadroom * mBudget ? mUnderStreak + 1 : 0;
+    }
+
+    if (mOverStreak >= kDownFrames && mLevel < mMaxLevel) {
+        if (mSteppedUp && mFramesAtLevel <= kFailedUpFrames) {
+            mUpWait = std::min(mUpWait * 2, kMaxUpFrames);
+        }
+        changeLevel(mLevel + 1);
+        mSteppedUp = false;
+    } else if (mUnderStreak >= mUpWait && mLevel > 0) {
+        changeLevel(mLevel - 1);
+        mSteppedUp = true;
+    } else if (mSteppedUp && mFramesAtLevel > kFailedUpFrames) {
+        // The step up held, earn back the short wait
+        mUpWait = kMinUpFrames;
+        mSteppedUp = false;
+    }
+}
+
+void LatencyGovernor::changeLevel(int level) {
+    if (level == mLevel) {
+        return;
+    }
+    mLevel = level;
+    mFreshLevel = true;
+    mOverStreak = 0;
+    mUnderStreak = 0;
+    mFramesAtLevel = 0;
+    mPublishedLevel.store(level, std::memory_order_relaxed);
+    mLevelChanges.fetch_add(1, std::memory_order_relaxed);
+}
+
+LatencyGovernor::Stats LatencyGovernor::stats() const {
+    return {
+        mPublishedLevel.load(std::memory_order_relaxed),
+        mPublishedSmoothed.load(std::memory_order_relaxed),
+        mPublishedBudget.load(std::memory_order_relaxed),
+        mLevelChanges.load(std::memory_order_relaxed),
+        mOverBudget.load(std::memory_order_relaxed)
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * LatencyGovernor - Picks the pyramid level that keeps frames within a time budget
+ *
+ * Level 0 processes frames at full resolution, every level above halves both sides
+ * (a quarter of the pixels). The governor smooths the measured processing times and
+ *  - steps one level down (coarser) once kDownFrames frames in a row ran over budget,
+ *  - steps one level up (finer) once the smoothed time, scaled by the four times as
+ *    many pixels of the finer level, stayed below kUpHeadroom of the budget for
+ *    mUpWait frames in a row.
+ * A step up that has to be taken back within a few frames doubles the wait before the
+ * next attempt, so a budget right at the edge of two levels settles on the coarser
+ * one instead of flipping back and forth.
+ *
+ * record() and level() belong to the thread processing the frames; stats() may be
+ * read from any thread.
+ */
+class LatencyGovernor {
+public:
+    static constexpr int kMaxLevel = 3;
+
+    /**
+     * Governor state
+     */
+    struct Stats {
+        int64_t level;            // current pyramid level, 0 = full resolution
+        int64_t smoothedNanos;    // smoothed processing time at the current level
+        int64_t budgetNanos;      // 0 when the governor is off
+        uint64_t levelChanges;    // level switches so far
+        uint64_t overBudget;      // frames that ran over budget
+    };
+
+    /**
+     * Set the time budget per frame
+     *
+     * @param nanos Budget in nanoseconds, 0 turns the governor off (always level 0)
+     */
+    void setBudget(int64_t nanos);
+
+    /**
+     * Limit how coarse the governor may go
+     *
+     * @param level Coarsest level, 0..kMaxLevel
+     */
+    void setMaxLevel(int level);
+
+    bool isEnabled() const {
+        return mBudget > 0;
+    }
+
+    /**
+     * Get the level the next frame should be processed at
+     */
+    int level() const {
+        return mLevel;
+    }
+
+    /**
+     * Account for a processed frame and pick the level of the next one
+     *
+     * @param nanos Processing time of the frame
+     */
+    void record(int64_t nanos);
+
+    /**
+     * Read the governor state
+     */
+    Stats stats() const;
+
+private:
+    static constexpr int kDownFrames = 3;
+    static constexpr int kMinUpFrames = 30;
+    static constexpr int kMaxUpFrames = 480;
+    static constexpr double kUpHeadroom = 0.8;
+    static constexpr double kSmoothing = 0.2;
+
+    // A step up taken back within this many frames counts as failed
+    static constexpr int kFailedUpFrames = 10;
+
+    int64_t mBudget = 0;
+    int mMaxLevel = kMaxLevel;
+    int mLevel = 0;
+    double mSmoothed = 0.0;
+    bool mFreshLevel = true;
+    int mOverStreak = 0;
+    int mUnderStreak = 0;
+    int mUpWait = kMinUpFrames;
+    int mFramesAtLevel = 0;
+    bool mSteppedUp = false;
+
+    // Published copies for stats()
+    std::atomic<int64_t> mPublishedLevel{0};
+    std::atomic<int64_t> mPublishedSmoothed{0};
+    std::atomic<int64_t> mPublishedBudget{0};
+    std::atomic<uint64_t> mLevelChanges{0};
+    std::atomic<uint64_t> mOverBudget{0};
+
+    void changeLevel(int level);
+};
@@ -0,0 +1,42 @@
+#include "logger.h"
+
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+
+void stderrSink(LogLevel level, const char* tag, const char* message) {
+    static const char kLevels[] = {'D', 'I', 'W', 'E'};
+    fprintf(stderr, "%c/%s: %s\n", kLevels[static_cast<int>(level)], tag, message);
+}
+
+std::atomic<LogSink> gSink{stderrSink};
+std::atomic<int> gMinLevel{static_cast<int>(LogLevel::Debug)};
+
+} // namespace
+
+void setLogSink(LogSink sink) {
+    gSink.store(sink ? sink : stderrSink, std::memory_order_release);
+}
+
+void setLogLevel(LogLevel level) {
+    gMinLevel.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void logMessage(LogLevel level, const char* tag, const char* format, ...) {
+    if (static_cast<int>(level) < gMinLevel.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    char message[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    gSink.load(std::memory_order_acquire)(level, tag, message);
+}
+
+void nullLogSink(LogLevel, const char*, const char*) {
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/**
+ * Logging for the platform-neutral core
+ *
+ * Core code logs through logMessage() and never includes a platform log header. The
+ * default sink prints to stderr; the Android glue installs one that forwards to
+ * logcat, tests and benchmarks can install their own or silence logging entirely.
+ */
+
+enum class LogLevel {
+    Debug = 0,
+    Info,
+    Warn,
+    Error
+};
+
+// Receives every formatted message; must be safe to call from any thread
+using LogSink = void (*)(LogLevel level, const char* tag, const char* message);
+
+/**
+ * Install the sink for all core log messages
+ *
+ * @param sink The new sink, or nullptr to restore the default stderr sink
+ */
+void setLogSink(LogSink sink);
+
+/**
+ * Drop messages below the given level before they are formatted (default Debug)
+ */
+void setLogLevel(LogLevel level);
+
+/**
+ * Format a message and hand it to the current sink
+ */
+void logMessage(LogLevel level, const char* tag, const char* format, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+/**
+ * A sink that drops everything, for benchmarks
+ */
+void nullLogSink(LogLevel level, const char* tag, const char* message);
+
+#define CORE_LOGD(tag, ...) logMessage(LogLevel::Debug, tag, __VA_ARGS__)
+#define CORE_LOGI(tag, ...) logMessage(LogLevel::Info, tag, __VA_ARGS__)
+#define CORE_LOGW(tag, ...) logMessage(LogLevel::Warn, tag, __VA_ARGS__)
+#define CORE_LOGE(tag, ...) logMessage(LogLevel::Error, tag, __VA_ARGS__)
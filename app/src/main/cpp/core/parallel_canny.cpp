@@ -0,0 +1,655 @@
+#include "parallel_canny.h"
+
+#include "buffer_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+// tan(22.5 degrees) in Q15, the constant cv::Canny uses for its direction test
+constexpr int kTan22 = 13573;
+
+// cos and sin of the orientation bin borders 20, 40, ..., 160 degrees in Q14
+constexpr int kBorderCos[ParallelCanny::kOrientationBins] = {
+    0, 15396, 12551, 8192, 2845, -2845, -8192, -12551, -15396
+};
+constexpr int kBorderSin[ParallelCanny::kOrientationBins] = {
+    0, 5604, 10531, 14189, 16135, 16135, 14189, 10531, 5604
+};
+
+// Orientation bin of a gradient: the number of bin borders its direction lies beyond
+// once folded into [0, 180) degrees, found by bisection without any trigonometry
+inline int orientationBin(int dx, int dy) {
+    if (dy < 0 || (dy == 0 && dx < 0)) {
+        dx = -dx;
+        dy = -dy;
+    }
+    // Beyond border k when the cross product of the border and the gradient is positive
+    auto beyond = [&](int k) {
+        return kBorderCos[k] * dy - kBorderSin[k] * dx > 0;
+    };
+    if (beyond(8)) {
+        return 8;
+    }
+    int bin = 0;
+    for (int step = 4; step > 0; step /= 2) {
+        if (beyond(bin + step)) {
+            bin += step;
+        }
+    }
+    return bin;
+}
+
+// Fill a magnitude row (with a zero on each side) from the Sobel output
+void magnitudeRow(const short* dx, const short* dy, int* mag, int cols) {
+    mag[0] = 0;
+    mag[cols + 1] = 0;
+    for (int j = 0; j < cols; j++) {
+        mag[j + 1] = std::abs(dx[j]) + std::abs(dy[j]);
+    }
+}
+
+// Push every weak neighbour of an edge pixel that lies inside [lo, hi)
+inline void growFrom(uchar* pixel, ptrdiff_t step, const uchar* lo, const uchar* hi,
+                     std::vector<uchar*>& stack) {
+    uchar* neighbours[8] = {
+        pixel - step - 1, pixel - step, pixel - step + 1,
+        pixel - 1, pixel + 1,
+        pixel + step - 1, pixel + step, pixel + step + 1
+    };
+    for (uchar* neighbour : neighbours) {
+        if (neighbour >= lo && neighbour < hi && *neighbour == 0) {
+            *neighbour = 2;
+            stack.push_back(neighbour);
+        }
+    }
+}
+
+} // namespace
+
+ParallelCanny::ParallelCanny(ThreadPool& pool) : mPool(pool) {
+    BufferPool::shared().attach(mMap);
+    BufferPool::shared().attach(mBlur);
+    BufferPool::shared().attach(mCandidates);
+    BufferPool::shared().attach(mSweepEdges);
+}
+
+void ParallelCanny::prepareMap(int rows, int cols) {
+    mMap.create(rows + 2, cols + 2, CV_8UC1);
+    std::fill_n(mMap.ptr<uchar>(0), mMap.cols, 1);
+    std::fill_n(mMap.ptr<uchar>(mMap.rows - 1), mMap.cols, 1);
+}
+
+void ParallelCanny::prepareGradients(Gradients& gradients, int rows, int cols) {
+    // Keeps every tile sum of saturated magnitudes within int32
+    CV_Assert(gradients.tileSize >= 1 && gradients.tileSize <= 128);
+
+    const int tile = gradients.tileSize;
+    gradients.magnitude.create(rows, cols, CV_16SC1);
+    gradients.orientation.create(rows, cols, CV_8UC1);
+    gradients.histograms.create((rows + tile - 1) / tile,
+                                (cols + tile - 1) / tile * kOrientationBins, CV_32SC1);
+
+    // Strips do not end on tile borders, so each one sums into its own tile rows
+    for (Strip& strip : mStrips) {
+        const int tileRows =
+            strip.end > strip.begin ? (strip.end - 1) / tile - strip.begin / tile + 1 : 0;
+        strip.histograms.assign(static_cast<size_t>(tileRows) * gradients.histograms.cols, 0);
+    }
+}
+
+void ParallelCanny::gradientRow(Strip& strip, Gradients& gradients, int i, const short* dx,
+                                const short* dy, const int* mag) {
+    const int cols = gradients.magnitude.cols;
+    const int tile = gradients.tileSize;
+    short* magnitude = gradients.magnitude.ptr<short>(i);
+    uchar* orientation = gradients.orientation.ptr<uchar>(i);
+    int* histogram = strip.histograms.data() +
+                     static_cast<size_t>(i / tile - strip.begin / tile) * gradients.histograms.cols;
+
+    for (int begin = 0; begin < cols; begin += tile, histogram += kOrientationBins) {
+        const int end = std::min(cols, begin + tile);
+        for (int j = begin; j < end; j++) {
+            const short m = cv::saturate_cast<short>(mag[j]);
+            const int bin = orientationBin(dx[j], dy[j]);
+            magnitude[j] = m;
+            orientation[j] = static_cast<uchar>(bin);
+            histogram[bin] += m;
+        }
+    }
+}
+
+void ParallelCanny::mergeHistograms(Gradients& gradients) {
+    const int tile = gradients.tileSize;
+    gradients.histograms.setTo(0);
+    for (const Strip& strip : mStrips) {
+        if (strip.end <= strip.begin) {
+            continue;
+        }
+        const int* partial = strip.histograms.data();
+        for (int r = strip.begin / tile; r <= (strip.end - 1) / tile; r++) {
+            int* out = gradients.histograms.ptr<int>(r);
+            for (int c = 0; c < gradients.histograms.cols; c++) {
+                out[c] += *partial++;
+            }
+        }
+    }
+}
+
+void ParallelCanny::blurGradients(Gradients& gradients) {
+    prepareGradients(gradients, mBlur.rows, mBlur.cols);
+    mPool.parallelFor(stripCount(), [&](int index) {
+        Strip& strip = mStrips[index];
+        if (strip.end <= strip.begin) {
+            return;
+        }
+        // Sobel reads the real rows around the strip, as in suppressStrip()
+        cv::Mat rows = mBlur.rowRange(strip.begin, strip.end);
+        cv::Sobel(rows, strip.dx, CV_16S, 1, 0, 7, 1, 0, cv::BORDER_REPLICATE);
+        cv::Sobel(rows, strip.dy, CV_16S, 0, 1, 7, 1, 0, cv::BORDER_REPLICATE);
+
+        strip.mag.resize(mBlur.cols);
+        for (int i = strip.begin; i < strip.end; i++) {
+            const short* dx = strip.dx.ptr<short>(i - strip.begin);
+            const short* dy = strip.dy.ptr<short>(i - strip.begin);
+            for (int j = 0; j < mBlur.cols; j++) {
+                strip.mag[j] = std::abs(dx[j]) + std::abs(dy[j]);
+            }
+            gradientRow(strip, gradients, i, dx, dy, strip.mag.data());
+        }
+    }, mMaxHelpers);
+    mergeHistograms(gradients);
+}
+
+void ParallelCanny::prepareDensity(EdgeDensity& density, int rows, int cols) {
+    // Keeps every tile sum of saturated magnitudes within int32
+    CV_Assert(density.tileSize >= 1 && density.tileSize <= 128);
+
+    const int tile = density.tileSize;
+    density.counts.create((rows + tile - 1) / tile, (cols + tile - 1) / tile, CV_32SC1);
+    density.strength.create(density.counts.rows, density.counts.cols, CV_32FC1);
+
+    for (Strip& strip : mStrips) {
+        const int tileRows =
+            strip.end > strip.begin ? (strip.end - 1) / tile - strip.begin / tile + 1 : 0;
+        strip.density.assign(static_cast<size_t>(tileRows) * density.counts.cols * 2, 0);
+    }
+}
+
+void ParallelCanny::densityRow(Strip& strip, EdgeDensity& density, int i, const uchar* edges,
+                               const ushort* magnitude, int cols) {
+    const int tile = density.tileSize;
+    int* sums = strip.density.data() +
+                static_cast<size_t>(i / tile - strip.begin / tile) * density.counts.cols * 2;
+
+    for (int begin = 0; begin < cols; begin += tile, sums += 2) {
+        const int end = std::min(cols, begin + tile);
+        int count = 0;
+        int strength = 0;
+        for (int j = begin; j < end; j++) {
+            if (edges[j]) {
+                count++;
+                strength += magnitude[j];
+            }
+        }
+        sums[0] += count;
+        sums[1] += strength;
+    }
+}
+
+void ParallelCanny::mergeDensity(EdgeDensity& density) {
+    const int tile = density.tileSize;
+    const int cols = density.counts.cols;
+    mDensitySums.assign(density.counts.total() * 2, 0);
+    for (const Strip& strip : mStrips) {
+        if (strip.end <= strip.begin) {
+            continue;
+        }
+        const int* partial = strip.density.data();
+        int64_t* out = mDensitySums.data() + static_cast<size_t>(strip.begin / tile) * cols * 2;
+        for (size_t k = 0; k < strip.density.size(); k++) {
+            out[k] += partial[k];
+        }
+    }
+
+    const int64_t* sums = mDensitySums.data();
+    for (int r = 0; r < density.counts.rows; r++) {
+        int* counts = density.counts.ptr<int>(r);
+        float* strength = density.strength.ptr<float>(r);
+        for (int c = 0; c < cols; c++, sums += 2) {
+            counts[c] = static_cast<int>(sums[0]);
+            strength[c] = sums[0] > 0 ? static_cast<float>(sums[1]) / sums[0] : 0.0f;
+        }
+    }
+}
+
+void ParallelCanny::blurDensity(const cv::Mat& edges, EdgeDensity& density) {
+    // The candidate magnitudes are not used at aperture 7, so they take the magnitudes
+    // of every pixel here
+    mCandidates.create(mBlur.rows, mBlur.cols, CV_16UC1);
+    prepareDensity(density, mBlur.rows, mBlur.cols);
+    mPool.parallelFor(stripCount(), [&](int index) {
+        Strip& strip = mStrips[index];
+        if (strip.end <= strip.begin) {
+            return;
+        }
+        cv::Mat rows = mBlur.rowRange(strip.begin, strip.end);
+        cv::Sobel(rows, strip.dx, CV_16S, 1, 0, 7, 1, 0, cv::BORDER_REPLICATE);
+        cv::Sobel(rows, strip.dy, CV_16S, 0, 1, 7, 1, 0, cv::BORDER_REPLICATE);
+
+        for (int i = strip.begin; i < strip.end; i++) {
+            const short* dx = strip.dx.ptr<short>(i - strip.begin);
+            const short* dy = strip.dy.ptr<short>(i - strip.begin);
+            ushort* magnitude = mCandidates.ptr<ushort>(i);
+            for (int j = 0; j < mBlur.cols; j++) {
+                magnitude[j] = cv::saturate_cast<ushort>(std::abs(dx[j]) + std::abs(dy[j]));
+            }
+            densityRow(strip, density, i, edges.ptr<uchar>(i), magnitude, mBlur.cols);
+        }
+    }, mMaxHelpers);
+    mergeDensity(density);
+}
+
+template <typename RowFn>
+void ParallelCanny::suppressStrip(Strip& strip, const cv::Mat& gray, int low, int apertureSize,
+                                  Gradients* gradients, RowFn&& row) {
+    const int rows = gray.rows;
+    const int cols = gray.cols;
+    const int radius = apertureSize / 2;
+
+    // Gradients are needed one row beyond the strip for non-maximum suppression,
+    // and the blur must cover the Sobel radius around those rows
+    const int gradBegin = std::max(0, strip.begin - 1);
+    const int gradEnd = std::min(rows, strip.end + 1);
+    const int blurBegin = std::max(0, gradBegin - radius);
+    const int blurEnd = std::min(rows, gradEnd + radius);
+
+    // Filtering a row range reads the real pixels around it, so the strip blur is
+    // identical to the same rows of a full-frame blur
+    cv::GaussianBlur(gray.rowRange(blurBegin, blurEnd), strip.blur, cv::Size(5, 5), 1.5, 1.5);
+
+    // Same reasoning for Sobel inside the blurred strip; the replicated border only
+    // kicks in at the real top and bottom of the frame, exactly as in cv::Canny
+    cv::Mat gradSrc = strip.blur.rowRange(gradBegin - blurBegin, gradEnd - blurBegin);
+    cv::Sobel(gradSrc, strip.dx, CV_16S, 1, 0, apertureSize, 1, 0, cv::BORDER_REPLICATE);
+    cv::Sobel(gradSrc, strip.dy, CV_16S, 0, 1, apertureSize, 1, 0, cv::BORDER_REPLICATE);
+
+    const int magStep = cols + 2;
+    strip.mag.assign(3 * magStep, 0);
+    strip.kept.resize(cols);
+    int* magPrev = strip.mag.data();
+    int* magCur = magPrev + magStep;
+    int* magNext = magCur + magStep;
+    int* kept = strip.kept.data();
+
+    if (strip.begin > 0) {
+        magnitudeRow(strip.dx.ptr<short>(0), strip.dy.ptr<short>(0), magPrev, cols);
+    }
+    magnitudeRow(strip.dx.ptr<short>(strip.begin - gradBegin),
+                 strip.dy.ptr<short>(strip.begin - gradBegin), magCur, cols);
+
+    for (int i = strip.begin; i < strip.end; i++) {
+        if (i + 1 < rows) {
+            magnitudeRow(strip.dx.ptr<short>(i + 1 - gradBegin),
+                         strip.dy.ptr<short>(i + 1 - gradBegin), magNext, cols);
+        } else {
+            std::fill_n(magNext, magStep, 0);
+        }
+
+        const short* dxRow = strip.dx.ptr<short>(i - gradBegin);
+        const short* dyRow = strip.dy.ptr<short>(i - gradBegin);
+
+        for (int j = 0; j < cols; j++) {
+            const int m = magCur[j + 1];
+            bool isMax = false;
+
+            if (m > low) {
+                // Same direction binning and tie breaking as cv::Canny
+                const int xs = dxRow[j];
+                const int ys = dyRow[j];
+                const int x = std::abs(xs);
+                const int y = std::abs(ys) << 15;
+                const int tg22x = x * kTan22;
+
+                if (y < tg22x) {
+                    isMax = m > magCur[j] && m >= magCur[j + 2];
+                } else {
+                    const int tg67x = tg22x + (x << 16);
+                    if (y > tg67x) {
+                        isMax = m > magPrev[j + 1] && m >= magNext[j + 1];
+                    } else {
+                        const int s = (xs ^ ys) < 0 ? -1 : 1;
+                        isMax = m > magPrev[j + 1 - s] && m > magNext[j + 1 + s];
+                    }
+                }
+            }
+
+            kept[j] = isMax ? m : 0;
+        }
+
+        if (gradients) {
+            gradientRow(strip, *gradients, i, dxRow, dyRow, magCur + 1);
+        }
+        row(i, static_cast<const int*>(kept));
+
+        std::swap(magPrev, magCur);
+        std::swap(magCur, magNext);
+    }
+}
+
+void ParallelCanny::process(const cv::Mat& gray, cv::Mat& edges, double lowThreshold,
+                            double highThreshold, int apertureSize, Gradients* gradients,
+                            EdgeDensity* density) {
+    CV_Assert(gray.type() == CV_8UC1);
+    CV_Assert(apertureSize == 3 || apertureSize == 5 || apertureSize == 7);
+
+    if (lowThreshold > highThreshold) {
+        std::swap(lowThreshold, highThreshold);
+    }
+
+    layoutStrips(gray.rows);
+
+    if (apertureSize == 7) {
+        blurOnly(gray);
+        if (gradients) {
+            blurGradients(*gradients);
+        }
+        cv::Canny(mBlur, edges, lowThreshold, highThreshold, apertureSize);
+        if (density) {
+            // Takes over the candidate magnitudes; the blurred frame stands in for them
+            blurDensity(edges, *density);
+            mCandidateAperture = 7;
+        }
+        return;
+    }
+
+    const int low = static_cast<int>(std::floor(lowThreshold));
+    const int high = static_cast<int>(std::floor(highThreshold));
+
+    prepareMap(gray.rows, gray.cols);
+    if (gradients) {
+        prepareGradients(*gradients, gray.rows, gray.cols);
+    }
+    if (density) {
+        // The density needs the magnitudes of the edges, which are exactly the
+        // candidates computeGradients() would keep for this low threshold
+        mCandidates.create(gray.rows, gray.cols, CV_16UC1);
+        mCandidateLow = low;
+        mCandidateAperture = apertureSize;
+    }
+
+    mPool.parallelFor(stripCount(), [&](int index) {
+        detectStrip(mStrips[index], gray, low, high, apertureSize, gradients, density != nullptr);
+    }, mMaxHelpers);
+
+    stitchStrips();
+    if (gradients) {
+        mergeHistograms(*gradients);
+    }
+
+    writeEdges(edges, density);
+}
+
+void ParallelCanny::writeEdges(cv::Mat& edges, EdgeDensity* density) {
+    const int rows = mMap.rows - 2;
+    const int cols = mMap.cols - 2;
+    edges.create(rows, cols, CV_8UC1);
+    if (density) {
+        prepareDensity(*density, rows, cols);
+    }
+
+    mPool.parallelFor(stripCount(), [&](int index) {
+        Strip& strip = mStrips[index];
+        for (int i = strip.begin; i < strip.end; i++) {
+            const uchar* state = mMap.ptr<uchar>(i + 1) + 1;
+            uchar* out = edges.ptr<uchar>(i);
+            for (int j = 0; j < cols; j++) {
+                out[j] = state[j] == 2 ? 255 : 0;
+            }
+            if (density) {
+                densityRow(strip, *density, i, out, mCandidates.ptr<ushort>(i), cols);
+            }
+        }
+    }, mMaxHelpers);
+
+    if (density) {
+        mergeDensity(*density);
+    }
+}
+
+void ParallelCanny::computeGradients(const cv::Mat& gray, double lowThreshold,
+                                     int apertureSize, Gradients* gradients) {
+    CV_Assert(gray.type() == CV_8UC1);
+    CV_Assert(apertureSize == 3 || apertureSize == 5 || apertureSize == 7);
+
+    layoutStrips(gray.rows);
+    mCandidateAperture = apertureSize;
+
+    if (apertureSize == 7) {
+        blurOnly(gray);
+        if (gradients) {
+            blurGradients(*gradients);
+        }
+        return;
+    }
+
+    mCandidateLow = static_cast<int>(std::floor(lowThreshold));
+    mCandidates.create(gray.rows, gray.cols, CV_16UC1);
+    if (gradients) {
+        prepareGradients(*gradients, gray.rows, gray.cols);
+    }
+
+    mPool.parallelFor(stripCount(), [&](int index) {
+        suppressStrip(mStrips[index], gray, mCandidateLow, apertureSize, gradients,
+                      [&](int i, const int* kept) {
+            ushort* out = mCandidates.ptr<ushort>(i);
+            for (int j = 0; j < gray.cols; j++) {
+                out[j] = static_cast<ushort>(std::min(kept[j], 65535));
+            }
+        });
+    }, mMaxHelpers);
+
+    if (gradients) {
+        mergeHistograms(*gradients);
+    }
+}
+
+void ParallelCanny::hysteresis(cv::Mat& edges, double lowThreshold, double highThreshold,
+                               EdgeDensity* density) {
+    CV_Assert(mCandidateAperture != 0);
+
+    if (lowThreshold > highThreshold) {
+        std::swap(lowThreshold, highThreshold);
+    }
+
+    if (mCandidateAperture == 7) {
+        cv::Canny(mBlur, edges, lowThreshold, highThreshold, mCandidateAperture);
+        if (density) {
+            blurDensity(edges, *density);
+        }
+        return;
+    }
+
+    const int low = static_cast<int>(std::floor(lowThreshold));
+    const int high = static_cast<int>(std::floor(highThreshold));
+    CV_Assert(low >= mCandidateLow);
+
+    prepareMap(mCandidates.rows, mCandidates.cols);
+    mPool.parallelFor(stripCount(), [&](int index) {
+        hysteresisStrip(mStrips[index], low, high);
+    }, mMaxHelpers);
+    stitchStrips();
+
+    writeEdges(edges, density);
+}
+
+void ParallelCanny::thresholdLevels(const std::vector<Thresholds>& thresholds, cv::Mat& levels) {
+    CV_Assert(mCandidateAperture != 0);
+    CV_Assert(thresholds.size() <= 255);
+
+    const cv::Size size = mCandidateAperture == 7 ? mBlur.size() : mCandidates.size();
+    levels.create(size, CV_8UC1);
+    levels.setTo(0);
+
+    for (const Thresholds& pair : thresholds) {
+        // Aperture 7 goes through cv::Canny whole, the others only through hysteresis
+        const bool viaMask = mCandidateAperture == 7;
+        if (viaMask) {
+            cv::Canny(mBlur, mSweepEdges, pair.low, pair.high, mCandidateAperture);
+        } else {
+            const int low = static_cast<int>(std::floor(std::min(pair.low, pair.high)));
+            const int high = static_cast<int>(std::floor(std::max(pair.low, pair.high)));
+            CV_Assert(low >= mCandidateLow);
+
+            prepareMap(size.height, size.width);
+            mPool.parallelFor(stripCount(), [&](int index) {
+                hysteresisStrip(mStrips[index], low, high);
+            }, mMaxHelpers);
+            stitchStrips();
+        }
+
+        mPool.parallelFor(stripCount(), [&](int index) {
+            const Strip& strip = mStrips[index];
+            for (int i = strip.begin; i < strip.end; i++) {
+                const uchar* edge = viaMask ? mSweepEdges.ptr<uchar>(i) : mMap.ptr<uchar>(i + 1) + 1;
+                const uchar mark = viaMask ? 255 : 2;
+                uchar* out = levels.ptr<uchar>(i);
+                for (int j = 0; j < size.width; j++) {
+                    out[j] += edge[j] == mark;
+                }
+            }
+        }, mMaxHelpers);
+    }
+}
+
+void ParallelCanny::layoutStrips(int rows) {
+    int wanted = mPool.threadCount() * kStripsPerThread;
+    int count = std::max(1, std::min(wanted, rows / kMinStripRows));
+
+    if (static_cast<int>(mStrips.size()) == count && mStrips.back().end == rows) {
+        return;
+    }
+
+    mStrips.resize(count);
+    for (int k = 0; k < count; k++) {
+        BufferPool::shared().attach(mStrips[k].blur);
+        BufferPool::shared().attach(mStrips[k].dx);
+        BufferPool::shared().attach(mStrips[k].dy);
+        mStrips[k].begin = static_cast<int>(static_cast<long>(rows) * k / count);
+        mStrips[k].end = static_cast<int>(static_cast<long>(rows) * (k + 1) / count);
+    }
+}
+
+void ParallelCanny::detectStrip(Strip& strip, const cv::Mat& gray, int low, int high,
+                                int apertureSize, Gradients* gradients, bool keepCandidates) {
+    const int cols = gray.cols;
+    strip.stack.clear();
+
+    // Candidates are above low, so any kept magnitude is nonzero
+    suppressStrip(strip, gray, low, apertureSize, gradients, [&](int i, const int* kept) {
+        uchar* map = mMap.ptr<uchar>(i + 1);
+        map[0] = 1;
+        map[cols + 1] = 1;
+        for (int j = 0; j < cols; j++) {
+            const uchar state = kept[j] > high ? 2 : kept[j] != 0 ? 0 : 1;
+            map[j + 1] = state;
+            if (state == 2) {
+                strip.stack.push_back(map + j + 1);
+            }
+        }
+        if (keepCandidates) {
+            ushort* out = mCandidates.ptr<ushort>(i);
+            for (int j = 0; j < cols; j++) {
+                out[j] = static_cast<ushort>(std::min(kept[j], 65535));
+            }
+        }
+    });
+
+    growStrip(strip);
+}
+
+void ParallelCanny::hysteresisStrip(Strip& strip, int low, int high) {
+    const int cols = mCandidates.cols;
+    strip.stack.clear();
+
+    for (int i = strip.begin; i < strip.end; i++) {
+        const ushort* kept = mCandidates.ptr<ushort>(i);
+        uchar* map = mMap.ptr<uchar>(i + 1);
+        map[0] = 1;
+        map[cols + 1] = 1;
+        for (int j = 0; j < cols; j++) {
+            // Zero marks a pixel that is no candidate at any threshold
+            const int m = kept[j];
+            const uchar state = m == 0 || m <= low ? 1 : m > high ? 2 : 0;
+            map[j + 1] = state;
+            if (state == 2) {
+                strip.stack.push_back(map + j + 1);
+            }
+        }
+    }
+
+    growStrip(strip);
+}
+
+void ParallelCanny::growStrip(Strip& strip) {
+    // Hysteresis restricted to the rows of this strip; crossings are stitched later
+    const ptrdiff_t mapStep = static_cast<ptrdiff_t>(mMap.step);
+    const uchar* lo = mMap.ptr<uchar>(strip.begin + 1);
+    const uchar* hi = mMap.ptr<uchar>(strip.end + 1);
+    while (!strip.stack.empty()) {
+        uchar* pixel = strip.stack.back();
+        strip.stack.pop_back();
+        growFrom(pixel, mapStep, lo, hi, strip.stack);
+    }
+}
+
+void ParallelCanny::stitchStrips() {
+    const ptrdiff_t mapStep = static_cast<ptrdiff_t>(mMap.step);
+    const int cols = mMap.cols - 2;
+    const uchar* lo = mMap.ptr<uchar>(0);
+    const uchar* hi = lo + mapStep * mMap.rows;
+
+    mStitchStack.clear();
+
+    for (size_t k = 1; k < mStrips.size(); k++) {
+        uchar* above = mMap.ptr<uchar>(mStrips[k].begin);
+        uchar* below = mMap.ptr<uchar>(mStrips[k].begin + 1);
+
+        auto markWeak = [&](uchar* row, int j) {
+            for (int d = -1; d <= 1; d++) {
+                if (row[j + d] == 0) {
+                    row[j + d] = 2;
+                    mStitchStack.push_back(row + j + d);
+                }
+            }
+        };
+
+        for (int j = 1; j <= cols; j++) {
+            if (above[j] == 2) {
+                markWeak(below, j);
+            }
+            if (below[j] == 2) {
+                markWeak(above, j);
+            }
+        }
+
+        // Follow everything reached across the border, wherever it leads
+        while (!mStitchStack.empty()) {
+            uchar* pixel = mStitchStack.back();
+            mStitchStack.pop_back();
+            growFrom(pixel, mapStep, lo, hi, mStitchStack);
+        }
+    }
+}
+
+void ParallelCanny::blurOnly(const cv::Mat& gray) {
+    mBlur.create(gray.rows, gray.cols, CV_8UC1);
+    mPool.parallelFor(stripCount(), [&](int index) {
+        const Strip& strip = mStrips[index];
+        cv::Mat dst = mBlur.rowRange(strip.begin, strip.end);
+        cv::GaussianBlur(gray.rowRange(strip.begin, strip.end), dst, cv::Size(5, 5), 1.5, 1.5);
+    }, mMaxHelpers);
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "thread_pool.h"
+
+/**
+ * ParallelCanny - Strip-parallel Gaussian blur + Canny edge detection
+ *
+ * The frame is split into horizontal strips that run on a ThreadPool. Each strip
+ * blurs its own rows plus a halo (the Sobel radius plus one row for non-maximum
+ * suppression), computes gradients, suppresses non-maxima and runs hysteresis
+ * inside the strip. Edges that continue across a strip border are then stitched
+ * in a short serial pass, so connectivity is global.
+ *
+ * The output matches cv::GaussianBlur(5x5, 1.5) followed by cv::Canny (L1 gradient)
+ * exactly for aperture sizes 3 and 5. Aperture 7 blurs in parallel and then hands
+ * the blurred frame to cv::Canny.
+ *
+ * Threshold sweeps: only hysteresis depends on the high threshold, and the low
+ * threshold only decides which local maxima become candidates. computeGradients()
+ * therefore blurs, differentiates and suppresses non-maxima once, keeping the
+ * magnitude of every local maximum above the lowest low threshold of the sweep;
+ * hysteresis() and thresholdLevels() then run only the hysteresis step per threshold
+ * pair, in strips with the same border stitching, and give the same edges as
+ * process() with those thresholds.
+ *
+ * Gradient output: given a Gradients, process() and computeGradients() also keep the
+ * Sobel result of every pixel as a magnitude plane and a quantized orientation plane,
+ * and sum the magnitudes per orientation bin for every tile of the frame, while each
+ * strip has its gradient rows at hand. Downstream orientation features then need no
+ * Sobel pass of their own. Aperture 7 differentiates the blurred frame for the
+ * planes, since cv::Canny keeps its gradients to itself.
+ *
+ * Edge density: given an EdgeDensity, process() and hysteresis() count the edge pixels
+ * of every tile and sum their candidate magnitudes while they write the mask, so
+ * frame analytics need no pass over the mask of their own. Aperture 7 differentiates
+ * the blurred frame for the magnitudes, as for gradient output.
+ */
+class ParallelCanny {
+public:
+    /**
+     * A pair of hysteresis thresholds
+     */
+    struct Thresholds {
+        double low;
+        double high;
+    };
+
+    // Orientation bins of 20 degrees over [0, 180), as in HOG
+    static constexpr int kOrientationBins = 9;
+
+    /**
+     * Gradient planes of a frame and their orientation histograms per tile
+     *
+     * Orientations are unsigned: the direction of (dx, dy), with y pointing down, folded
+     * into [0, 180) degrees; bin b covers 20 b to 20 (b + 1) degrees.
+     * The histogram of the tile in tile row r and tile column c is the magnitude sum per
+     * bin at histograms(r, c * kOrientationBins + bin); tiles on the right and bottom
+     * edges may be partial.
+     */
+    struct Gradients {
+        int tileSize = 16;      // histogram tile side in pixels (1 to 128), set by the caller
+        cv::Mat magnitude;      // CV_16SC1, |dx| + |dy| as thresholded by Canny
+        cv::Mat orientation;    // CV_8UC1, orientation bin
+        cv::Mat histograms;     // CV_32SC1, tile rows x (tile columns * kOrientationBins)
+    };
+
+    /**
+     * Edge pixels and their gradient strength per tile of a frame, tile (r, c) at row
+     * r and column c of both planes; tiles on the right and bottom edges may be partial
+     */
+    struct EdgeDensity {
+        int tileSize = 32;      // tile side in pixels (1 to 128), set by the caller
+        cv::Mat counts;         // CV_32SC1, edge pixels per tile
+        cv::Mat strength;       // CV_32FC1, mean L1 gradient magnitude of those, 0 if none
+    };
+
+    /**
+     * Constructor
+     *
+     * @param pool The pool running the strips
+     */
+    explicit ParallelCanny(ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * Blur and edge-detect a single channel 8-bit frame
+     *
+     * @param gray The input frame (CV_8UC1), may be a view into a larger buffer
+     * @param edges Receives the edge mask (CV_8UC1, 0 or 255)
+     * @param lowThreshold The low hysteresis threshold
+     * @param highThreshold The high hysteresis threshold
+     * @param apertureSize The Sobel aperture size (3, 5 or 7)
+     * @param gradients Also receives the gradient planes and histograms, unless null
+     * @param density Also receives the edge density per tile, unless null
+     */
+    void process(const cv::Mat& gray, cv::Mat& edges, double lowThreshold,
+                 double highThreshold, int apertureSize = 3, Gradients* gradients = nullptr,
+                 EdgeDensity* density = nullptr);
+
+    /**
+     * Blur, compute gradients and suppress non-maxima of a frame once, for any number
+     * of hysteresis() and thresholdLevels() calls
+     *
+     * @param gray The input frame (CV_8UC1), may be a view into a larger buffer
+     * @param lowThreshold The lowest low threshold the frame will be thresholded with
+     * @param apertureSize The Sobel aperture size (3, 5 or 7)
+     * @param gradients Also receives the gradient planes and histograms, unless null
+     */
+    void computeGradients(const cv::Mat& gray, double lowThreshold, int apertureSize = 3,
+                          Gradients* gradients = nullptr);
+
+    /**
+     * Edge-detect the frame of the last computeGradients() with one threshold pair
+     *
+     * @param edges Receives the edge mask (CV_8UC1, 0 or 255)
+     * @param lowThreshold The low hysteresis threshold, at least the one the gradients
+     *                     were computed for
+     * @param highThreshold The high hysteresis threshold
+     * @param density Also receives the edge density per tile, unless null
+     */
+    void hysteresis(cv::Mat& edges, double lowThreshold, double highThreshold,
+                    EdgeDensity* density = nullptr);
+
+    /**
+     * Count for every pixel of the frame of the last computeGradients() at how many of
+     * the threshold pairs it is an edge. When both thresholds grow from pair to pair,
+     * edge sets are nested and a pixel is an edge at pair i exactly if its count is
+     * above i, so the count is the number of the strictest pair that keeps it.
+     *
+     * @param thresholds Up to 255 pairs, each low at least the one the gradients were
+     *                   computed for
+     * @param levels Receives the counts (CV_8UC1)
+     */
+    void thresholdLevels(const std::vector<Thresholds>& thresholds, cv::Mat& levels);
+
+    /**
+     * Limit how many pool workers help with each frame, besides the calling thread
+     *
+     * @param helpers The worker limit, or -1 to use the whole pool (the default)
+     */
+    void setMaxHelpers(int helpers) {
+        mMaxHelpers = helpers;
+    }
+
+    /**
+     * Get the number of strips the last frame was split into
+     */
+    int stripCount() const {
+        return static_cast<int>(mStrips.size());
+    }
+
+private:
+    // Strips are never thinner than this, so the halo stays a small overhead
+    static constexpr int kMinStripRows = 16;
+    // Strips per thread, lets the pool balance uneven strips
+    static constexpr int kStripsPerThread = 4;
+
+    struct Strip {
+        int begin = 0;
+        int end = 0;
+        cv::Mat blur;
+        cv::Mat dx;
+        cv::Mat dy;
+        std::vector<int> mag;        // three rolling rows of gradient magnitude
+        std::vector<int> kept;       // candidate magnitudes of the current row
+        std::vector<uchar*> stack;   // hysteresis work list
+        std::vector<int> histograms; // tile histograms of the tile rows the strip touches
+        std::vector<int> density;    // edge count and magnitude sum per tile, likewise
+    };
+
+    ThreadPool& mPool;
+    int mMaxHelpers = -1;
+    std::vector<Strip> mStrips;
+    std::vector<uchar*> mStitchStack;
+
+    // Canny state per pixel with a one pixel border:
+    // 0 = candidate (weak), 1 = not an edge, 2 = edge
+    cv::Mat mMap;
+    cv::Mat mBlur;
+
+    // Gradient magnitude of the candidates found by computeGradients(), 0 elsewhere
+    // (CV_16UC1); aperture 7 keeps the blurred frame in mBlur instead
+    cv::Mat mCandidates;
+    int mCandidateLow = 0;
+    int mCandidateAperture = 0;
+    cv::Mat mSweepEdges;            // edges of one pair while sweeping at aperture 7
+    std::vector<int64_t> mDensitySums;
+
+    void layoutStrips(int rows);
+    void prepareMap(int rows, int cols);
+    void detectStrip(Strip& strip, const cv::Mat& gray, int low, int high, int apertureSize,
+                     Gradients* gradients, bool keepCandidates);
+    void writeEdges(cv::Mat& edges, EdgeDensity* density);
+    void hysteresisStrip(Strip& strip, int low, int high);
+    void growStrip(Strip& strip);
+    void stitchStrips();
+    void blurOnly(const cv::Mat& gray);
+
+    // Blurs and differentiates a strip, then calls row(i, kept) for each of its rows i,
+    // where kept[j] is the magnitude of pixel j if it is a candidate and 0 otherwise.
+    // Writes the gradient rows of the strip into gradients unless it is null.
+    template <typename RowFn>
+    void suppressStrip(Strip& strip, const cv::Mat& gray, int low, int apertureSize,
+                       Gradients* gradients, RowFn&& row);
+
+    // Gradient output: sizes the planes, writes one row of them, sums up the strips
+    void prepareGradients(Gradients& gradients, int rows, int cols);
+    void gradientRow(Strip& strip, Gradients& gradients, int i, const short* dx,
+                     const short* dy, const int* mag);
+    void mergeHistograms(Gradients& gradients);
+
+    // Gradient output at aperture 7, from the blurred frame in mBlur
+    void blurGradients(Gradients& gradients);
+
+    // Edge density: sizes the planes, counts one row of the mask, sums up the strips
+    void prepareDensity(EdgeDensity& density, int rows, int cols);
+    void densityRow(Strip& strip, EdgeDensity& density, int i, const uchar* edges,
+                    const ushort* magnitude, int cols);
+    void mergeDensity(EdgeDensity& density);
+
+    // Edge density at aperture 7, of a mask from cv::Canny on the blurred frame in mBlur
+    void blurDensity(const cv::Mat& edges, EdgeDensity& density);
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * On-disk layout of a frame recording (see FrameRecorder and RecordingReader)
+ *
+ * A recording is one preallocated file, written through a shared memory mapping:
+ *
+ *   [RecordingHeader, padded to kRecordingPageBytes]
+ *   [entryCount RecordingEntry records, padded to a page]
+ *   [data ring of dataBytes]
+ *
+ * Every frame is one entry plus one contiguous payload in the data ring: the input
+ * frame (NV21, or only its Y plane in luma-only mode), followed by the edge mask packed
+ * to one bit per pixel (rows of (edgeWidth + 7) / 8 bytes). Entry slots are reused
+ * round robin and the ring wraps around, so a recording always holds the newest
+ * frames that fit.
+ *
+ * An entry is valid when its sequence is nonzero. The recorder clears the sequence of
+ * every entry whose payload it is about to overwrite before touching the payload, and
+ * sets the sequence of a new entry only after its payload is complete, so a recording
+ * cut off at any point (crash, kill) still only holds complete frames. All values are
+ * little-endian.
+ */
+
+constexpr char kRecordingMagic[8] = {'E', 'D', 'G', 'E', 'R', 'E', 'C', '1'};
+constexpr uint32_t kRecordingVersion = 1;
+constexpr uint32_t kRecordingPageBytes = 4096;
+constexpr int kRecordingMaxRegions = 8;
+
+struct RecordingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entryBytes;          // sizeof(RecordingEntry)
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t indexOffset;         // file offset of the entries
+    uint64_t dataOffset;          // file offset of the data ring
+    uint64_t dataBytes;           // size of the data ring
+    uint64_t nextSequence;        // sequence the next frame will get, first frame is 1
+};
+
+struct RecordingEntry {
+    uint64_t sequence;            // 0 while empty or being rewritten
+    int64_t timestampNanos;       // steady clock when the frame was recorded
+    uint64_t dataOffset;          // payload offset in the data ring
+    uint32_t inputBytes;          // 0 when the input was not recorded
+    uint32_t edgeBytes;           // 0 when the edges were not recorded
+    int32_t width;                // input frame size
+    int32_t height;
+    int32_t edgeWidth;            // edge mask size, smaller than the frame at pyramid levels
+    int32_t edgeHeight;
+
+    // Detection parameters the frame was processed with
+    int32_t lowThreshold;
+    int32_t ratio;
+    int32_t kernelSize;
+    int32_t engine;
+    uint8_t lumaOnly;
+    uint8_t incremental;
+    uint8_t regionCount;
+    uint8_t reserved0;
+    float changeSensitivity;
+    int64_t frameBudgetNanos;
+    int32_t maxPyramidLevel;
+    int32_t regions[kRecordingMaxRegions][4];   // x, y, width, height
+    uint8_t reserved[44];
+};
+
+static_assert(sizeof(RecordingHeader) == 56, "RecordingHeader layout changed");
+static_assert(sizeof(RecordingEntry) == 256, "RecordingEntry layout changed");
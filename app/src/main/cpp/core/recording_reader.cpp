@@ -0,0 +1,206 @@
+#include "recording_reader.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "frame_trace.h"
+#include "logger.h"
+#include "row_kernels.h"
+
+#define LOG_TAG "RecordingReader"
+
+namespace {
+
+bool sameParameters(const SessionEngine::Parameters& a, const SessionEngine::Parameters& b) {
+    if (a.lowThreshold != b.lowThreshold || a.ratio != b.ratio || a.kernelSize != b.kernelSize ||
+        a.lumaOnly != b.lumaOnly || a.engine != b.engine || a.incremental != b.incremental ||
+        a.changeSensitivity != b.changeSensitivity || a.frameBudgetNanos != b.frameBudgetNanos ||
+        a.maxPyramidLevel != b.maxPyramidLevel || a.regionCount != b.regionCount) {
+        return false;
+    }
+    return std::equal(a.regions, a.regions + a.regionCount, b.regions);
+}
+
+} // namespace
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+bool RecordingReader::open(const std::string& path) {
+    close();
+
+    int file = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file < 0) {
+        CORE_LOGE(LOG_TAG, "Cannot open %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat info;
+    if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RecordingHeader)) {
+        CORE_LOGE(LOG_TAG, "%s is not a recording", path.c_str());
+        ::close(file);
+        return false;
+    }
+    void* map = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+    // The mapping keeps the file referenced
+    ::close(file);
+    if (map == MAP_FAILED) {
+        CORE_LOGE(LOG_TAG, "Cannot map %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    mMap = static_cast<const uint8_t*>(map);
+    mMapBytes = info.st_size;
+    mHeader = reinterpret_cast<const RecordingHeader*>(mMap);
+
+    const RecordingHeader& header = *mHeader;
+    const uint64_t indexEnd = header.indexOffset + static_cast<uint64_t>(header.entryCount) * header.entryBytes;
+    if (memcmp(header.magic, kRecordingMagic, sizeof(kRecordingMagic)) != 0 ||
+        header.version != kRecordingVersion || header.entryBytes != sizeof(RecordingEntry) ||
+        indexEnd > header.dataOffset || header.dataOffset + header.dataBytes > mMapBytes) {
+        CORE_LOGE(LOG_TAG, "%s is not a version %u recording", path.c_str(), kRecordingVersion);
+        close();
+        return false;
+    }
+    mEntries = reinterpret_cast<const RecordingEntry*>(mMap + header.indexOffset);
+    mData = mMap + header.dataOffset;
+
+    // Skip entries cut off or pointing outside the ring, then sort by sequence
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        const RecordingEntry& entry = mEntries[i];
+        const uint64_t end = entry.dataOffset + static_cast<uint64_t>(entry.inputBytes) + entry.edgeBytes;
+        const uint64_t edgeBytes = static_cast<uint64_t>((entry.edgeWidth + 7) / 8) * entry.edgeHeight;
+        if (entry.sequence == 0 || end > header.dataBytes || entry.width <= 0 || entry.height <= 0 ||
+            entry.regionCount > kRecordingMaxRegions || entry.edgeWidth < 0 || entry.edgeHeight < 0 ||
+            (entry.edgeBytes != 0 && entry.edgeBytes != edgeBytes)) {
+            continue;
+        }
+        mOrder.push_back(i);
+    }
+    std::sort(mOrder.begin(), mOrder.end(), [&](uint32_t a, uint32_t b) {
+        return mEntries[a].sequence < mEntries[b].sequence;
+    });
+
+    CORE_LOGI(LOG_TAG, "Opened %s: %zu frames", path.c_str(), mOrder.size());
+    return true;
+}
+
+void RecordingReader::close() {
+    if (mMap) {
+        munmap(const_cast<uint8_t*>(mMap), mMapBytes);
+    }
+    mMap = nullptr;
+    mMapBytes = 0;
+    mHeader = nullptr;
+    mEntries = nullptr;
+    mData = nullptr;
+    mOrder.clear();
+}
+
+void RecordingReader::read(size_t index, Frame& frame) const {
+    CV_Assert(index < mOrder.size());
+    const RecordingEntry& entry = mEntries[mOrder[index]];
+
+    frame.sequence = entry.sequence;
+    frame.timestampNanos = entry.timestampNanos;
+    frame.width = entry.width;
+    frame.height = entry.height;
+
+    SessionEngine::Parameters& p = frame.parameters;
+    p.lowThreshold = entry.lowThreshold;
+    p.ratio = entry.ratio;
+    p.kernelSize = entry.kernelSize;
+    p.engine = static_cast<EdgeDetector::Engine>(entry.engine);
+    p.lumaOnly = entry.lumaOnly != 0;
+    p.incremental = entry.incremental != 0;
+    p.changeSensitivity = entry.changeSensitivity;
+    p.frameBudgetNanos = entry.frameBudgetNanos;
+    p.maxPyramidLevel = entry.maxPyramidLevel;
+    p.regionCount = entry.regionCount;
+    for (int i = 0; i < SessionEngine::Parameters::kMaxRegions; i++) {
+        p.regions[i] = i < entry.regionCount
+            ? cv::Rect(entry.regions[i][0], entry.regions[i][1], entry.regions[i][2], entry.regions[i][3])
+            : cv::Rect();
+    }
+
+    // Both views point into the read-only mapping and must never be written
+    uint8_t* data = const_cast<uint8_t*>(mData + entry.dataOffset);
+    const uint64_t nv21Bytes = static_cast<uint64_t>(entry.width) * (entry.height + entry.height / 2);
+    frame.hasChroma = entry.inputBytes == nv21Bytes;
+    if (entry.inputBytes == 0) {
+        frame.input.release();
+    } else {
+        int rows = static_cast<int>(entry.inputBytes / entry.width);
+        frame.input = cv::Mat(rows, entry.width, CV_8UC1, data);
+    }
+
+    if (entry.edgeBytes == 0) {
+        frame.edges.release();
+        return;
+    }
+    const uint8_t* bits = data + entry.inputBytes;
+    const int stride = (entry.edgeWidth + 7) / 8;
+    const RowKernels& kernels = RowKernels::best();
+    frame.edges.create(entry.edgeHeight, entry.edgeWidth, CV_8UC1);
+    for (int y = 0; y < entry.edgeHeight; y++) {
+        kernels.unpackBits(bits + static_cast<size_t>(y) * stride, frame.edges.ptr<uint8_t>(y),
+                           entry.edgeWidth);
+    }
+}
+
+void RecordingReader::replay(SessionEngine& engine, SessionEngine::Handle session,
+                             ReplayStats& stats) const {
+    using Clock = std::chrono::steady_clock;
+
+    Frame frame;
+    SessionEngine::Parameters applied;
+    bool first = true;
+    cv::Mat edges;
+    cv::Mat difference;
+
+    for (size_t i = 0; i < mOrder.size(); i++) {
+        read(i, frame);
+        if (frame.input.empty()) {
+            continue;
+        }
+
+        // Every frame at full resolution, whatever the timing
+        SessionEngine::Parameters parameters = frame.parameters;
+        parameters.frameBudgetNanos = 0;
+        if (first || !sameParameters(parameters, applied)) {
+            engine.setParameters(session, parameters);
+            applied = parameters;
+            first = false;
+        }
+
+        // Traced stages of this frame carry its recorded timestamp
+        FrameTrace::setCurrentFrame(static_cast<uint64_t>(frame.timestampNanos));
+
+        Clock::time_point start = Clock::now();
+        if (frame.hasChroma) {
+            engine.processNv21(session, frame.input, edges);
+        } else {
+            engine.process(session, frame.input, edges);
+        }
+        stats.latency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start).count());
+        stats.frames++;
+
+        // Masks computed at a coarser pyramid level cannot be reproduced
+        if (frame.edges.empty() || frame.edges.size() != edges.size()) {
+            continue;
+        }
+        stats.compared++;
+        cv::compare(frame.edges, edges, difference, cv::CMP_NE);
+        int pixels = cv::countNonZero(difference);
+        if (pixels > 0) {
+            stats.mismatchedFrames++;
+            stats.mismatchedPixels += pixels;
+        }
+    }
+}
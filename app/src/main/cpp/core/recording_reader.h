@@ -0,0 +1,111 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "recording_format.h"
+#include "session_engine.h"
+#include "stage_stats.h"
+
+/**
+ * RecordingReader - Reads and replays a recording written by FrameRecorder
+ *
+ * The file is mapped read-only; frames are views into the mapping, so reading a frame
+ * copies nothing but the unpacked edge mask. Frames come in recording order, oldest
+ * first, whatever their place in the ring.
+ *
+ * Replaying runs the recorded input frames through a session with the recorded
+ * parameters, frame by frame, and compares the result with the recorded edge mask.
+ * The latency governor is turned off during replay, since the pyramid levels it picks
+ * depend on timing; frames it had processed at a coarser level are replayed but not
+ * compared. With the same engine and row kernels every other frame replays bit-exact,
+ * except in incremental mode, where tiles last computed before the oldest recorded
+ * frame may differ until they change.
+ */
+class RecordingReader {
+public:
+    /**
+     * One recorded frame
+     */
+    struct Frame {
+        uint64_t sequence = 0;
+        int64_t timestampNanos = 0;
+        SessionEngine::Parameters parameters;
+        int width = 0;
+        int height = 0;
+        cv::Mat input;      // NV21 or Y plane view into the recording, empty if not recorded
+        bool hasChroma = false;
+        cv::Mat edges;      // unpacked edge mask, empty if not recorded
+    };
+
+    /**
+     * Outcome of a replay
+     */
+    struct ReplayStats {
+        uint64_t frames = 0;            // frames processed
+        uint64_t compared = 0;          // frames compared with their recorded edges
+        uint64_t mismatchedFrames = 0;  // compared frames that differ
+        uint64_t mismatchedPixels = 0;  // differing pixels across those frames
+        LatencyHistogram latency;       // processing time per frame
+    };
+
+    RecordingReader() = default;
+
+    /**
+     * Destructor - unmaps the recording
+     */
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    /**
+     * Map a recording and index its frames
+     *
+     * @return false if the file cannot be read or is not a recording
+     */
+    bool open(const std::string& path);
+
+    /**
+     * Unmap the recording
+     */
+    void close();
+
+    /**
+     * Get the number of frames in the recording
+     */
+    size_t frameCount() const {
+        return mOrder.size();
+    }
+
+    /**
+     * Read a frame, in recording order
+     *
+     * @param index 0 for the oldest frame up to frameCount() - 1
+     * @param frame Receives the frame; its input stays valid until the reader is closed
+     */
+    void read(size_t index, Frame& frame) const;
+
+    /**
+     * Run every recorded input frame through a session and compare the results with
+     * the recorded edge masks. The session's parameters are replaced.
+     *
+     * @param engine The engine the session lives in
+     * @param session A session of engine, best a fresh one
+     * @param stats Receives the outcome; latencies are added to its histogram
+     */
+    void replay(SessionEngine& engine, SessionEngine::Handle session, ReplayStats& stats) const;
+
+private:
+    const uint8_t* mMap = nullptr;
+    size_t mMapBytes = 0;
+    const RecordingHeader* mHeader = nullptr;
+    const RecordingEntry* mEntries = nullptr;
+    const uint8_t* mData = nullptr;
+
+    // Entry indices of the valid frames by sequence
+    std::vector<uint32_t> mOrder;
+};
@@ -0,0 +1,99 @@
+#include "region_layout.h"
+
+#include <algorithm>
+
+namespace {
+
+int alignDown(int value, int align) {
+    return value / align * align;
+}
+
+int alignUp(int value, int align) {
+    return (value + align - 1) / align * align;
+}
+
+} // namespace
+
+void RegionLayout::setRegions(const cv::Rect* regions, int count) {
+    if (static_cast<int>(mRegions.size()) == count &&
+        std::equal(mRegions.begin(), mRegions.end(), regions)) {
+        return;
+    }
+    mRegions.assign(regions, regions + count);
+    mLevel = -1;
+}
+
+cv::Size RegionLayout::levelSize(cv::Size frame, int level) {
+    for (int i = 0; i < level; i++) {
+        frame = cv::Size((frame.width + 1) / 2, (frame.height + 1) / 2);
+    }
+    return frame;
+}
+
+const std::vector<RegionLayout::Input>& RegionLayout::layout(cv::Size frame, int level) {
+    if (level == mLevel && frame == mFrame) {
+        return mInputs;
+    }
+    mFrame = frame;
+    mLevel = level;
+    mInputs.clear();
+
+    const int scale = 1 << level;
+    const int align = std::max(2, scale);
+    const int grow = kHalo * scale;
+    const cv::Rect bounds(0, 0, frame.width, frame.height);
+    const cv::Size levelFrame = levelSize(frame, level);
+
+    for (const cv::Rect& region : mRegions) {
+        cv::Rect clipped = region & bounds;
+        if (clipped.empty()) {
+            continue;
+        }
+        int x0 = alignDown(std::max(0, clipped.x - grow), align);
+        int y0 = alignDown(std::max(0, clipped.y - grow), align);
+        int x1 = std::min(frame.width, alignUp(clipped.x + clipped.width + grow, align));
+        int y1 = std::min(frame.height, alignUp(clipped.y + clipped.height + grow, align));
+
+        int ox0 = clipped.x / scale;
+        int oy0 = clipped.y / scale;
+        int ox1 = std::min(levelFrame.width, (clipped.x + clipped.width + scale - 1) / scale);
+        int oy1 = std::min(levelFrame.height, (clipped.y + clipped.height + scale - 1) / scale);
+
+        Input input;
+        input.source = cv::Rect(x0, y0, x1 - x0, y1 - y0);
+        input.outputs.push_back(cv::Rect(ox0, oy0, ox1 - ox0, oy1 - oy0));
+        mInputs.push_back(std::move(input));
+    }
+
+    // Share inputs that overlap enough to be cheaper in one piece
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < mInputs.size() && !merged; i++) {
+            for (size_t j = i + 1; j < mInputs.size() && !merged; j++) {
+                const cv::Rect& a = mInputs[i].source;
+                const cv::Rect& b = mInputs[j].source;
+                cv::Rect both = a | b;
+                if ((a & b).empty() || both.area() > a.area() + b.area()) {
+                    continue;
+                }
+                mInputs[i].source = both;
+                mInputs[i].outputs.insert(mInputs[i].outputs.end(),
+                                          mInputs[j].outputs.begin(), mInputs[j].outputs.end());
+                mInputs.erase(mInputs.begin() + j);
+                merged = true;
+            }
+        }
+    }
+
+    for (Input& input : mInputs) {
+        // Sources start on multiples of the scale, so their pyrDown'ed size ends where
+        // the pyrDown'ed frame's pixels do
+        cv::Size end = levelSize(cv::Size(input.source.x + input.source.width,
+                                          input.source.y + input.source.height), level);
+        int x = input.source.x / scale;
+        int y = input.source.y / scale;
+        input.level = cv::Rect(x, y, end.width - x, end.height - y);
+    }
+    return mInputs;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+/**
+ * RegionLayout - Plans which parts of a frame to edge-detect for a set of regions
+ *
+ * Regions of interest are given in frame coordinates. Each one is detected from an
+ * input rectangle that grows it by kHalo pixels on every side, so the blur, Sobel
+ * and non-maximum suppression of the region see the same pixels as in a full frame;
+ * only the region itself is written to the output. Inputs are aligned to even
+ * coordinates (NV21 chroma pairs) and, at pyramid level n, to multiples of 2^n, so a
+ * pyrDown'ed input lines up with the pyrDown'ed frame.
+ *
+ * Regions whose inputs overlap are detected from one shared input when their
+ * bounding box is no larger than the two inputs together; otherwise each keeps its
+ * own input and the overlap is simply detected twice.
+ *
+ * As with bands of the incremental mode, hysteresis is not local: an edge chain
+ * leaving a region loses the strong pixels outside it, so a region's edges match the
+ * full frame's except along such chains.
+ */
+class RegionLayout {
+public:
+    static constexpr int kHalo = 8;
+
+    /**
+     * Pixels to detect and the regions they feed
+     */
+    struct Input {
+        cv::Rect source;                 // frame coordinates at level 0
+        cv::Rect level;                  // the same area at the pyramid level
+        std::vector<cv::Rect> outputs;   // regions at the pyramid level, frame coordinates
+    };
+
+    /**
+     * Replace the regions of interest
+     *
+     * @param regions Regions in frame coordinates, clipped to the frame when laid out
+     * @param count Number of regions, 0 processes full frames again
+     */
+    void setRegions(const cv::Rect* regions, int count);
+
+    bool empty() const {
+        return mRegions.empty();
+    }
+
+    const std::vector<cv::Rect>& regions() const {
+        return mRegions;
+    }
+
+    /**
+     * Lay out the inputs for a frame; cached until the regions, size or level change
+     *
+     * @param frame Size of the frame at level 0
+     * @param level Pyramid level the inputs are detected at
+     */
+    const std::vector<Input>& layout(cv::Size frame, int level);
+
+    /**
+     * Size of a frame after level pyrDown steps
+     */
+    static cv::Size levelSize(cv::Size frame, int level);
+
+private:
+    std::vector<cv::Rect> mRegions;
+    std::vector<Input> mInputs;
+    cv::Size mFrame;
+    int mLevel = -1;
+};
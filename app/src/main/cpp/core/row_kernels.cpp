@@ -0,0 +1,89 @@
+#include "row_kernels.h"
+
+#include <cstdlib>
+
+namespace {
+
+void gaussianHorizontalScalar(const uint8_t* src, uint16_t* dst, int width) {
+    for (int x = 0; x < width; x++) {
+        dst[x] = static_cast<uint16_t>(kGaussianTaps[0] * (src[x - 2] + src[x + 2]) +
+                                       kGaussianTaps[1] * (src[x - 1] + src[x + 1]) +
+                                       kGaussianTaps[2] * src[x]);
+    }
+}
+
+void gaussianVerticalScalar(const uint16_t* const rows[5], uint8_t* dst, int width) {
+    for (int x = 0; x < width; x++) {
+        uint32_t sum = kGaussianTaps[0] * (static_cast<uint32_t>(rows[0][x]) + rows[4][x]) +
+                       kGaussianTaps[1] * (static_cast<uint32_t>(rows[1][x]) + rows[3][x]) +
+                       kGaussianTaps[2] * static_cast<uint32_t>(rows[2][x]);
+        dst[x] = static_cast<uint8_t>((sum + (1u << 15)) >> 16);
+    }
+}
+
+void sobel3Scalar(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                  int16_t* dx, int16_t* dy, int width) {
+    for (int x = 0; x < width; x++) {
+        dx[x] = static_cast<int16_t>((above[x + 1] - above[x - 1]) +
+                                     2 * (row[x + 1] - row[x - 1]) +
+                                     (below[x + 1] - below[x - 1]));
+        dy[x] = static_cast<int16_t>((below[x - 1] + 2 * below[x] + below[x + 1]) -
+                                     (above[x - 1] + 2 * above[x] + above[x + 1]));
+    }
+}
+
+uint32_t sadScalar(const uint8_t* a, const uint8_t* b, int width) {
+    uint32_t sum = 0;
+    for (int x = 0; x < width; x++) {
+        sum += static_cast<uint32_t>(std::abs(a[x] - b[x]));
+    }
+    return sum;
+}
+
+void packBitsScalar(const uint8_t* mask, uint8_t* bits, int width) {
+    for (int x = 0; x < width; x += 8) {
+        const int count = width - x < 8 ? width - x : 8;
+        uint8_t byte = 0;
+        for (int k = 0; k < count; k++) {
+            byte |= static_cast<uint8_t>((mask[x + k] != 0) << k);
+        }
+        bits[x >> 3] = byte;
+    }
+}
+
+void unpackBitsScalar(const uint8_t* bits, uint8_t* mask, int width) {
+    for (int x = 0; x < width; x++) {
+        mask[x] = (bits[x >> 3] >> (x & 7)) & 1 ? 255 : 0;
+    }
+}
+
+} // namespace
+
+const RowKernels& RowKernels::scalar() {
+    static const RowKernels kernels = {
+        gaussianHorizontalScalar,
+        gaussianVerticalScalar,
+        sobel3Scalar,
+        sadScalar,
+        packBitsScalar,
+        unpackBitsScalar,
+        "scalar"
+    };
+    return kernels;
+}
+
+const RowKernels& RowKernels::best() {
+    static const RowKernels& chosen = []() -> const RowKernels& {
+        if (const RowKernels* kernels = avx2()) {
+            return *kernels;
+        }
+        if (const RowKernels* kernels = sse41()) {
+            return *kernels;
+        }
+        if (const RowKernels* kernels = neon()) {
+            return *kernels;
+        }
+        return scalar();
+    }();
+    return chosen;
+}
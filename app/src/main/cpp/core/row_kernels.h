@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * RowKernels - Row-at-a-time building blocks of the blur and gradient stages
+ *
+ * The Gaussian is the 5x5, sigma 1.5 kernel the pipeline has always used, in the same
+ * separable Q8 fixed point as OpenCV's bit-exact GaussianBlur for 8-bit images:
+ * taps {31, 60, 74, 60, 31} / 256 per direction, rounded once after the vertical pass.
+ * The Sobel kernel is the 3x3 aperture cv::Canny uses by default. The SAD kernel
+ * compares rows of consecutive frames, the bit kernels convert edge mask rows to and
+ * from one bit per pixel.
+ *
+ * Callers handle the frame borders by padding rows; the kernels only ever read the
+ * documented number of padding pixels left and right of each row.
+ *
+ * Besides the scalar reference there are NEON (ARM), SSE4.1 and AVX2 (x86)
+ * implementations. The x86 ones are compiled with per-function target attributes, so
+ * one binary carries all of them and best() picks the widest the CPU supports at
+ * runtime. Every implementation produces exactly the scalar reference output.
+ */
+struct RowKernels {
+    /**
+     * Horizontal 5-tap Gaussian
+     *
+     * @param src Source row with 2 readable padding pixels on each side
+     * @param dst Receives the unrounded Q8 sums
+     * @param width Number of output pixels
+     */
+    void (*gaussianHorizontal)(const uint8_t* src, uint16_t* dst, int width);
+
+    /**
+     * Vertical 5-tap Gaussian over horizontally filtered rows, rounded back to 8 bits
+     *
+     * @param rows Five horizontally filtered rows, top to bottom
+     * @param dst Receives the blurred row
+     * @param width Number of output pixels
+     */
+    void (*gaussianVertical)(const uint16_t* const rows[5], uint8_t* dst, int width);
+
+    /**
+     * 3x3 Sobel derivatives
+     *
+     * @param above Row above, with 1 readable padding pixel on each side
+     * @param row Center row, with 1 readable padding pixel on each side
+     * @param below Row below, with 1 readable padding pixel on each side
+     * @param dx Receives the horizontal derivative
+     * @param dy Receives the vertical derivative
+     * @param width Number of output pixels
+     */
+    void (*sobel3)(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                   int16_t* dx, int16_t* dy, int width);
+
+    /**
+     * Sum of absolute differences of two rows, for frame-to-frame change detection
+     *
+     * @param a First row
+     * @param b Second row
+     * @param width Number of pixels
+     */
+    uint32_t (*sad)(const uint8_t* a, const uint8_t* b, int width);
+
+    /**
+     * Pack a mask row into one bit per pixel, least significant bit first
+     *
+     * @param mask Mask row, any nonzero value counts as set
+     * @param bits Receives (width + 7) / 8 bytes; bits past width are cleared
+     * @param width Number of pixels
+     */
+    void (*packBits)(const uint8_t* mask, uint8_t* bits, int width);
+
+    /**
+     * Expand a packed row back to a mask of 0 and 255
+     *
+     * @param bits Packed row, least significant bit first
+     * @param mask Receives the mask row
+     * @param width Number of pixels
+     */
+    void (*unpackBits)(const uint8_t* bits, uint8_t* mask, int width);
+
+    // Name of the implementation, for logs and benchmarks
+    const char* name;
+
+    /**
+     * Get the portable reference implementation
+     */
+    static const RowKernels& scalar();
+
+    /**
+     * Get the NEON implementation, or nullptr when not built for ARM with NEON
+     */
+    static const RowKernels* neon();
+
+    /**
+     * Get the SSE4.1 implementation, or nullptr when the CPU does not support it
+     */
+    static const RowKernels* sse41();
+
+    /**
+     * Get the AVX2 implementation, or nullptr when the CPU does not support it
+     */
+    static const RowKernels* avx2();
+
+    /**
+     * Get the widest implementation available on this CPU, chosen once
+     */
+    static const RowKernels& best();
+};
+
+// Gaussian taps in Q8, shared by every implementation
+static constexpr int kGaussianTaps[5] = {31, 60, 74, 60, 31};
@@ -0,0 +1,148 @@
+#include "row_kernels.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+#include <arm_neon.h>
+
+namespace {
+
+void gaussianHorizontalNeon(const uint8_t* src, uint16_t* dst, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        // Sums stay below 65536, so wrapping 16-bit arithmetic is exact
+        uint16x8_t outer = vaddl_u8(vld1_u8(src + x - 2), vld1_u8(src + x + 2));
+        uint16x8_t inner = vaddl_u8(vld1_u8(src + x - 1), vld1_u8(src + x + 1));
+        uint16x8_t sum = vmulq_n_u16(outer, kGaussianTaps[0]);
+        sum = vmlaq_n_u16(sum, inner, kGaussianTaps[1]);
+        sum = vmlaq_n_u16(sum, vmovl_u8(vld1_u8(src + x)), kGaussianTaps[2]);
+        vst1q_u16(dst + x, sum);
+    }
+    if (x < width) {
+        RowKernels::scalar().gaussianHorizontal(src + x, dst + x, width - x);
+    }
+}
+
+void gaussianVerticalNeon(const uint16_t* const rows[5], uint8_t* dst, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        uint16x8_t r0 = vld1q_u16(rows[0] + x);
+        uint16x8_t r1 = vld1q_u16(rows[1] + x);
+        uint16x8_t r2 = vld1q_u16(rows[2] + x);
+        uint16x8_t r3 = vld1q_u16(rows[3] + x);
+        uint16x8_t r4 = vld1q_u16(rows[4] + x);
+
+        uint32x4_t low = vmulq_n_u32(vaddl_u16(vget_low_u16(r0), vget_low_u16(r4)), kGaussianTaps[0]);
+        low = vmlaq_n_u32(low, vaddl_u16(vget_low_u16(r1), vget_low_u16(r3)), kGaussianTaps[1]);
+        low = vmlal_n_u16(low, vget_low_u16(r2), kGaussianTaps[2]);
+
+        uint32x4_t high = vmulq_n_u32(vaddl_u16(vget_high_u16(r0), vget_high_u16(r4)), kGaussianTaps[0]);
+        high = vmlaq_n_u32(high, vaddl_u16(vget_high_u16(r1), vget_high_u16(r3)), kGaussianTaps[1]);
+        high = vmlal_n_u16(high, vget_high_u16(r2), kGaussianTaps[2]);
+
+        // Rounding narrow by 16 bits is exactly (sum + 2^15) >> 16
+        uint16x8_t words = vcombine_u16(vrshrn_n_u32(low, 16), vrshrn_n_u32(high, 16));
+        vst1_u8(dst + x, vqmovn_u16(words));
+    }
+    if (x < width) {
+        const uint16_t* tail[5] = {rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x, rows[4] + x};
+        RowKernels::scalar().gaussianVertical(tail, dst + x, width - x);
+    }
+}
+
+inline int16x8_t loadWiden(const uint8_t* src) {
+    return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(src)));
+}
+
+void sobel3Neon(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                int16_t* dx, int16_t* dy, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        int16x8_t aL = loadWiden(above + x - 1);
+        int16x8_t aC = loadWiden(above + x);
+        int16x8_t aR = loadWiden(above + x + 1);
+        int16x8_t rL = loadWiden(row + x - 1);
+        int16x8_t rR = loadWiden(row + x + 1);
+        int16x8_t bL = loadWiden(below + x - 1);
+        int16x8_t bC = loadWiden(below + x);
+        int16x8_t bR = loadWiden(below + x + 1);
+
+        int16x8_t gx = vaddq_s16(vsubq_s16(aR, aL), vsubq_s16(bR, bL));
+        gx = vaddq_s16(gx, vshlq_n_s16(vsubq_s16(rR, rL), 1));
+        int16x8_t bottom = vaddq_s16(vaddq_s16(bL, bR), vshlq_n_s16(bC, 1));
+        int16x8_t top = vaddq_s16(vaddq_s16(aL, aR), vshlq_n_s16(aC, 1));
+
+        vst1q_s16(dx + x, gx);
+        vst1q_s16(dy + x, vsubq_s16(bottom, top));
+    }
+    if (x < width) {
+        RowKernels::scalar().sobel3(above + x, row + x, below + x, dx + x, dy + x, width - x);
+    }
+}
+
+uint32_t sadNeon(const uint8_t* a, const uint8_t* b, int width) {
+    uint32x4_t sum = vdupq_n_u32(0);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t diff = vabdq_u8(vld1q_u8(a + x), vld1q_u8(b + x));
+        sum = vpadalq_u16(sum, vpaddlq_u8(diff));
+    }
+    uint32_t total = vgetq_lane_u32(sum, 0) + vgetq_lane_u32(sum, 1) +
+                     vgetq_lane_u32(sum, 2) + vgetq_lane_u32(sum, 3);
+    return total + RowKernels::scalar().sad(a + x, b + x, width - x);
+}
+
+// Bit weights of one packed byte, repeated for both halves of a 16 pixel vector
+const uint8_t kBitWeights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+
+void packBitsNeon(const uint8_t* mask, uint8_t* bits, int width) {
+    const uint8x16_t weights = vld1q_u8(kBitWeights);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t pixels = vld1q_u8(mask + x);
+        uint8x16_t set = vandq_u8(vtstq_u8(pixels, pixels), weights);
+        // Three pairwise adds sum each half of eight weights into one byte
+        uint8x8_t sum = vpadd_u8(vget_low_u8(set), vget_high_u8(set));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        bits[x >> 3] = vget_lane_u8(sum, 0);
+        bits[(x >> 3) + 1] = vget_lane_u8(sum, 1);
+    }
+    if (x < width) {
+        RowKernels::scalar().packBits(mask + x, bits + (x >> 3), width - x);
+    }
+}
+
+void unpackBitsNeon(const uint8_t* bits, uint8_t* mask, int width) {
+    const uint8x16_t weights = vld1q_u8(kBitWeights);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint8x16_t bytes = vcombine_u8(vdup_n_u8(bits[x >> 3]), vdup_n_u8(bits[(x >> 3) + 1]));
+        vst1q_u8(mask + x, vtstq_u8(bytes, weights));
+    }
+    if (x < width) {
+        RowKernels::scalar().unpackBits(bits + (x >> 3), mask + x, width - x);
+    }
+}
+
+} // namespace
+
+const RowKernels* RowKernels::neon() {
+    static const RowKernels kernels = {
+        gaussianHorizontalNeon,
+        gaussianVerticalNeon,
+        sobel3Neon,
+        sadNeon,
+        packBitsNeon,
+        unpackBitsNeon,
+        "neon"
+    };
+    return &kernels;
+}
+
+#else
+
+const RowKernels* RowKernels::neon() {
+    return nullptr;
+}
+
+#endif
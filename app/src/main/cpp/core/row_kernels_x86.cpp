@@ -0,0 +1,318 @@
+#include "row_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <cstring>
+
+// Each function carries its own target attribute, so this file builds without any
+// -m flags and the CPU is only checked at runtime before the wider code is used.
+#define EDGE_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define EDGE_TARGET_AVX2 __attribute__((target("avx2")))
+
+namespace {
+
+// ---- SSE4.1 -------------------------------------------------------------------
+
+EDGE_TARGET_SSE41
+inline __m128i loadWidenU8(const uint8_t* src) {
+    return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)));
+}
+
+EDGE_TARGET_SSE41
+void gaussianHorizontalSse41(const uint8_t* src, uint16_t* dst, int width) {
+    const __m128i tap0 = _mm_set1_epi16(kGaussianTaps[0]);
+    const __m128i tap1 = _mm_set1_epi16(kGaussianTaps[1]);
+    const __m128i tap2 = _mm_set1_epi16(kGaussianTaps[2]);
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        // Sums stay below 65536, so wrapping 16-bit arithmetic is exact
+        __m128i outer = _mm_add_epi16(loadWidenU8(src + x - 2), loadWidenU8(src + x + 2));
+        __m128i inner = _mm_add_epi16(loadWidenU8(src + x - 1), loadWidenU8(src + x + 1));
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(outer, tap0),
+                                    _mm_add_epi16(_mm_mullo_epi16(inner, tap1),
+                                                  _mm_mullo_epi16(loadWidenU8(src + x), tap2)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), sum);
+    }
+    if (x < width) {
+        RowKernels::scalar().gaussianHorizontal(src + x, dst + x, width - x);
+    }
+}
+
+EDGE_TARGET_SSE41
+inline __m128i verticalSum4(const uint16_t* const rows[5], int x, bool high) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i taps[5];
+    for (int t = 0; t < 5; t++) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x));
+        taps[t] = high ? _mm_unpackhi_epi16(v, zero) : _mm_unpacklo_epi16(v, zero);
+    }
+    __m128i sum = _mm_mullo_epi32(_mm_add_epi32(taps[0], taps[4]), _mm_set1_epi32(kGaussianTaps[0]));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(_mm_add_epi32(taps[1], taps[3]),
+                                             _mm_set1_epi32(kGaussianTaps[1])));
+    sum = _mm_add_epi32(sum, _mm_mullo_epi32(taps[2], _mm_set1_epi32(kGaussianTaps[2])));
+    return _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(1 << 15)), 16);
+}
+
+EDGE_TARGET_SSE41
+void gaussianVerticalSse41(const uint16_t* const rows[5], uint8_t* dst, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i packed = _mm_packus_epi32(verticalSum4(rows, x, false), verticalSum4(rows, x, true));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(packed, packed));
+    }
+    if (x < width) {
+        const uint16_t* tail[5] = {rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x, rows[4] + x};
+        RowKernels::scalar().gaussianVertical(tail, dst + x, width - x);
+    }
+}
+
+EDGE_TARGET_SSE41
+void sobel3Sse41(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                 int16_t* dx, int16_t* dy, int width) {
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i aL = loadWidenU8(above + x - 1);
+        __m128i aC = loadWidenU8(above + x);
+        __m128i aR = loadWidenU8(above + x + 1);
+        __m128i rL = loadWidenU8(row + x - 1);
+        __m128i rR = loadWidenU8(row + x + 1);
+        __m128i bL = loadWidenU8(below + x - 1);
+        __m128i bC = loadWidenU8(below + x);
+        __m128i bR = loadWidenU8(below + x + 1);
+
+        __m128i centerDiff = _mm_sub_epi16(rR, rL);
+        __m128i gx = _mm_add_epi16(_mm_add_epi16(_mm_sub_epi16(aR, aL), _mm_sub_epi16(bR, bL)),
+                                   _mm_add_epi16(centerDiff, centerDiff));
+        __m128i bottom = _mm_add_epi16(_mm_add_epi16(bL, bR), _mm_add_epi16(bC, bC));
+        __m128i top = _mm_add_epi16(_mm_add_epi16(aL, aR), _mm_add_epi16(aC, aC));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dx + x), gx);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dy + x), _mm_sub_epi16(bottom, top));
+    }
+    if (x < width) {
+        RowKernels::scalar().sobel3(above + x, row + x, below + x, dx + x, dy + x, width - x);
+    }
+}
+
+// ---- AVX2 ---------------------------------------------------------------------
+
+EDGE_TARGET_AVX2
+inline __m256i loadWidenU8x16(const uint8_t* src) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src)));
+}
+
+EDGE_TARGET_AVX2
+void gaussianHorizontalAvx2(const uint8_t* src, uint16_t* dst, int width) {
+    const __m256i tap0 = _mm256_set1_epi16(kGaussianTaps[0]);
+    const __m256i tap1 = _mm256_set1_epi16(kGaussianTaps[1]);
+    const __m256i tap2 = _mm256_set1_epi16(kGaussianTaps[2]);
+
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i outer = _mm256_add_epi16(loadWidenU8x16(src + x - 2), loadWidenU8x16(src + x + 2));
+        __m256i inner = _mm256_add_epi16(loadWidenU8x16(src + x - 1), loadWidenU8x16(src + x + 1));
+        __m256i sum = _mm256_add_epi16(
+            _mm256_mullo_epi16(outer, tap0),
+            _mm256_add_epi16(_mm256_mullo_epi16(inner, tap1),
+                             _mm256_mullo_epi16(loadWidenU8x16(src + x), tap2)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), sum);
+    }
+    if (x < width) {
+        gaussianHorizontalSse41(src + x, dst + x, width - x);
+    }
+}
+
+EDGE_TARGET_AVX2
+inline __m256i verticalSum8(const uint16_t* const rows[5], int x) {
+    __m256i taps[5];
+    for (int t = 0; t < 5; t++) {
+        taps[t] = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[t] + x)));
+    }
+    __m256i sum = _mm256_mullo_epi32(_mm256_add_epi32(taps[0], taps[4]),
+                                     _mm256_set1_epi32(kGaussianTaps[0]));
+    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(_mm256_add_epi32(taps[1], taps[3]),
+                                                   _mm256_set1_epi32(kGaussianTaps[1])));
+    sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(taps[2], _mm256_set1_epi32(kGaussianTaps[2])));
+    return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(1 << 15)), 16);
+}
+
+EDGE_TARGET_AVX2
+void gaussianVerticalAvx2(const uint16_t* const rows[5], uint8_t* dst, int width) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        // packus works per 128-bit lane; the permute restores pixel order
+        __m256i words = _mm256_packus_epi32(verticalSum8(rows, x), verticalSum8(rows, x + 8));
+        words = _mm256_permute4x64_epi64(words, 0xD8);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words),
+                                         _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), bytes);
+    }
+    if (x < width) {
+        const uint16_t* tail[5] = {rows[0] + x, rows[1] + x, rows[2] + x, rows[3] + x, rows[4] + x};
+        gaussianVerticalSse41(tail, dst + x, width - x);
+    }
+}
+
+EDGE_TARGET_AVX2
+void sobel3Avx2(const uint8_t* above, const uint8_t* row, const uint8_t* below,
+                int16_t* dx, int16_t* dy, int width) {
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i aL = loadWidenU8x16(above + x - 1);
+        __m256i aC = loadWidenU8x16(above + x);
+        __m256i aR = loadWidenU8x16(above + x + 1);
+        __m256i rL = loadWidenU8x16(row + x - 1);
+        __m256i rR = loadWidenU8x16(row + x + 1);
+        __m256i bL = loadWidenU8x16(below + x - 1);
+        __m256i bC = loadWidenU8x16(below + x);
+        __m256i bR = loadWidenU8x16(below + x + 1);
+
+        __m256i centerDiff = _mm256_sub_epi16(rR, rL);
+        __m256i gx = _mm256_add_epi16(
+            _mm256_add_epi16(_mm256_sub_epi16(aR, aL), _mm256_sub_epi16(bR, bL)),
+            _mm256_add_epi16(centerDiff, centerDiff));
+        __m256i bottom = _mm256_add_epi16(_mm256_add_epi16(bL, bR), _mm256_add_epi16(bC, bC));
+        __m256i top = _mm256_add_epi16(_mm256_add_epi16(aL, aR), _mm256_add_epi16(aC, aC));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dx + x), gx);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dy + x), _mm256_sub_epi16(bottom, top));
+    }
+    if (x < width) {
+        sobel3Sse41(above + x, row + x, below + x, dx + x, dy + x, width - x);
+    }
+}
+
+EDGE_TARGET_SSE41
+uint32_t sadSse41(const uint8_t* a, const uint8_t* b, int width) {
+    __m128i sum = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x));
+        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x));
+        sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+    }
+    uint32_t total = static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2));
+    return total + RowKernels::scalar().sad(a + x, b + x, width - x);
+}
+
+EDGE_TARGET_AVX2
+uint32_t sadAvx2(const uint8_t* a, const uint8_t* b, int width) {
+    __m256i sum = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x));
+        sum = _mm256_add_epi64(sum, _mm256_sad_epu8(va, vb));
+    }
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    uint32_t total = static_cast<uint32_t>(_mm_cvtsi128_si32(half) + _mm_extract_epi32(half, 2));
+    return total + sadSse41(a + x, b + x, width - x);
+}
+
+EDGE_TARGET_SSE41
+void packBitsSse41(const uint8_t* mask, uint8_t* bits, int width) {
+    const __m128i zero = _mm_setzero_si128();
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + x));
+        uint16_t set = static_cast<uint16_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(pixels, zero)));
+        memcpy(bits + (x >> 3), &set, sizeof(set));
+    }
+    if (x < width) {
+        RowKernels::scalar().packBits(mask + x, bits + (x >> 3), width - x);
+    }
+}
+
+EDGE_TARGET_SSE41
+void unpackBitsSse41(const uint8_t* bits, uint8_t* mask, int width) {
+    // Byte k of the output tests bit k % 8 of packed byte k / 8
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i select = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        uint16_t packed;
+        memcpy(&packed, bits + (x >> 3), sizeof(packed));
+        __m128i bytes = _mm_shuffle_epi8(_mm_cvtsi32_si128(packed), spread);
+        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(bytes, select), select);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(mask + x), set);
+    }
+    if (x < width) {
+        RowKernels::scalar().unpackBits(bits + (x >> 3), mask + x, width - x);
+    }
+}
+
+EDGE_TARGET_AVX2
+void packBitsAvx2(const uint8_t* mask, uint8_t* bits, int width) {
+    const __m256i zero = _mm256_setzero_si256();
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(mask + x));
+        uint32_t set = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(pixels, zero)));
+        memcpy(bits + (x >> 3), &set, sizeof(set));
+    }
+    if (x < width) {
+        packBitsSse41(mask + x, bits + (x >> 3), width - x);
+    }
+}
+
+EDGE_TARGET_AVX2
+void unpackBitsAvx2(const uint8_t* bits, uint8_t* mask, int width) {
+    // The shuffle stays within 128-bit lanes, each lane spreads its own two bytes
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i select = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                            1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        uint32_t packed;
+        memcpy(&packed, bits + (x >> 3), sizeof(packed));
+        __m256i bytes = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(packed)), spread);
+        __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, select), select);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mask + x), set);
+    }
+    if (x < width) {
+        unpackBitsSse41(bits + (x >> 3), mask + x, width - x);
+    }
+}
+
+} // namespace
+
+const RowKernels* RowKernels::sse41() {
+    static const RowKernels kernels = {
+        gaussianHorizontalSse41,
+        gaussianVerticalSse41,
+        sobel3Sse41,
+        sadSse41,
+        packBitsSse41,
+        unpackBitsSse41,
+        "sse4.1"
+    };
+    return __builtin_cpu_supports("sse4.1") ? &kernels : nullptr;
+}
+
+const RowKernels* RowKernels::avx2() {
+    static const RowKernels kernels = {
+        gaussianHorizontalAvx2,
+        gaussianVerticalAvx2,
+        sobel3Avx2,
+        sadAvx2,
+        packBitsAvx2,
+        unpackBitsAvx2,
+        "avx2"
+    };
+    return __builtin_cpu_supports("avx2") ? &kernels : nullptr;
+}
+
+#else
+
+const RowKernels* RowKernels::sse41() {
+    return nullptr;
+}
+
+const RowKernels* RowKernels::avx2() {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,215 @@
+#include "session_engine.h"
+
+#include <algorithm>
+
+SessionEngine::SessionEngine(ThreadPool& pool) : mPool(pool) {}
+
+SessionEngine::~SessionEngine() {
+    std::lock_guard<std::mutex> guard(mLock);
+    mSessions.clear();
+}
+
+SessionEngine::Handle SessionEngine::create() {
+    auto session = std::make_shared<Session>(mPool);
+
+    std::lock_guard<std::mutex> guard(mLock);
+    Handle handle = mNextHandle++;
+    mSessions.emplace(handle, std::move(session));
+    return handle;
+}
+
+bool SessionEngine::destroy(Handle handle) {
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto found = mSessions.find(handle);
+        if (found == mSessions.end()) {
+            return false;
+        }
+        session = std::move(found->second);
+        mSessions.erase(found);
+    }
+    // A frame in flight holds its own reference; the session dies after it
+    return true;
+}
+
+std::shared_ptr<SessionEngine::Session> SessionEngine::find(Handle handle) const {
+    std::lock_guard<std::mutex> guard(mLock);
+    auto found = mSessions.find(handle);
+    return found == mSessions.end() ? nullptr : found->second;
+}
+
+template <typename Fn>
+bool SessionEngine::runFrame(Handle handle, Fn&& body) {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> frame(session->frameLock);
+
+    // Lock-free; only copies when a change was staged since or a pending one is due
+    const uint64_t number = session->frames.load(std::memory_order_relaxed);
+    Parameters p;
+    if (session->parameters.acquire(number, p)) {
+        session->detector.updateParameters(p.lowThreshold, p.ratio, p.kernelSize);
+        session->detector.setLumaOnly(p.lumaOnly);
+        session->detector.setEngine(p.engine);
+        session->detector.setIncremental(p.incremental);
+        session->detector.setChangeSensitivity(p.changeSensitivity);
+        session->detector.setFrameBudget(p.frameBudgetNanos, p.maxPyramidLevel);
+        session->detector.setRegions(p.regions, p.regionCount);
+        session->detector.setEdgeLinking(p.linkEdges, p.simplifyEpsilon, p.minContourPixels);
+        session->detector.setGradientOutput(p.gradientOutput, p.gradientTile);
+        session->detector.setEdgeDensity(p.edgeDensity, p.densityTile);
+        session->detector.setThresholdSweep(
+            std::vector<ParallelCanny::Thresholds>(p.sweep, p.sweep + p.sweepCount));
+        session->applied.store(p);
+    }
+
+    // Fair share of the workers among all frames in flight, rounded up. The calling
+    // thread always takes part as well.
+    int inFlight = mInFlight.fetch_add(1, std::memory_order_relaxed) + 1;
+    int workers = mPool.threadCount() - 1;
+    session->detector.setMaxHelpers((workers + inFlight - 1) / inFlight);
+
+    body(session->detector);
+    session->frames.store(number + 1, std::memory_order_relaxed);
+
+    mInFlight.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool SessionEngine::process(Handle handle, const cv::Mat& gray, cv::Mat& edges) {
+    return runFrame(handle, [&](EdgeDetector& detector) {
+        detector.processLuma(gray, edges);
+    });
+}
+
+bool SessionEngine::processRgba(Handle handle, const cv::Mat& rgba, cv::Mat& edges) {
+    return runFrame(handle, [&](EdgeDetector& detector) {
+        detector.processFrame(rgba, edges);
+    });
+}
+
+bool SessionEngine::processNv21(Handle handle, const cv::Mat& nv21, cv::Mat& edges) {
+    return runFrame(handle, [&](EdgeDetector& detector) {
+        detector.processNv21(nv21, edges);
+    });
+}
+
+bool SessionEngine::setParameters(Handle handle, const Parameters& parameters, uint64_t frame) {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    return session->parameters.stage(parameters, frame);
+}
+
+bool SessionEngine::setRegions(Handle handle, const cv::Rect* regions, int count) {
+    if (count < 0 || count > Parameters::kMaxRegions) {
+        return false;
+    }
+    return modifyParameters(handle, [&](Parameters& parameters) {
+        std::copy(regions, regions + count, parameters.regions);
+        parameters.regionCount = count;
+    });
+}
+
+bool SessionEngine::getParameters(Handle handle, Parameters& parameters) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    session->parameters.latest(parameters);
+    return true;
+}
+
+bool SessionEngine::appliedParameters(Handle handle, Parameters& parameters) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    parameters = session->applied.load();
+    return true;
+}
+
+bool SessionEngine::frameCount(Handle handle, uint64_t& frames) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    frames = session->frames.load(std::memory_order_relaxed);
+    return true;
+}
+
+bool SessionEngine::thresholdLevels(Handle handle, cv::Mat& levels) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> frame(session->frameLock);
+    session->detector.thresholdLevels().copyTo(levels);
+    return true;
+}
+
+bool SessionEngine::contours(Handle handle, EdgeContours& contours) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> frame(session->frameLock);
+    contours = session->detector.contours();
+    return true;
+}
+
+bool SessionEngine::gradients(Handle handle, ParallelCanny::Gradients& gradients) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> frame(session->frameLock);
+    const ParallelCanny::Gradients& latest = session->detector.gradients();
+    gradients.tileSize = latest.tileSize;
+    latest.magnitude.copyTo(gradients.magnitude);
+    latest.orientation.copyTo(gradients.orientation);
+    latest.histograms.copyTo(gradients.histograms);
+    return true;
+}
+
+bool SessionEngine::edgeDensity(Handle handle, ParallelCanny::EdgeDensity& density) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    std::lock_guard<std::mutex> frame(session->frameLock);
+    const ParallelCanny::EdgeDensity& latest = session->detector.edgeDensity();
+    density.tileSize = latest.tileSize;
+    latest.counts.copyTo(density.counts);
+    latest.strength.copyTo(density.strength);
+    return true;
+}
+
+bool SessionEngine::temporalStats(Handle handle, TemporalEdgeCache::Stats& stats) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    // The counters are atomics, no need to wait for a frame in flight
+    stats = session->detector.temporalStats();
+    return true;
+}
+
+bool SessionEngine::governorStats(Handle handle, LatencyGovernor::Stats& stats) const {
+    std::shared_ptr<Session> session = find(handle);
+    if (!session) {
+        return false;
+    }
+    stats = session->detector.governorStats();
+    return true;
+}
+
+size_t SessionEngine::sessionCount() const {
+    std::lock_guard<std::mutex> guard(mLock);
+    return mSessions.size();
+}
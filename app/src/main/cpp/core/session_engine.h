@@ -0,0 +1,275 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+#include "edge_detector.h"
+#include "staged_snapshots.h"
+#include "thread_pool.h"
+
+/**
+ * SessionEngine - Several independent edge detection streams on one worker pool
+ *
+ * Every stream (front and back camera, decoded video feeds, ...) is a session with
+ * its own EdgeDetector, buffers and parameters, addressed by an opaque handle.
+ * Handles are never reused, so a stale handle is simply rejected.
+ *
+ * All sessions run on one shared ThreadPool. Each frame takes part with its calling
+ * thread and borrows at most its fair share of the pool's workers, i.e. the workers
+ * divided by the number of frames in flight across all sessions, rounded up. One
+ * stream on its own still gets the whole pool; several streams cannot starve each
+ * other, and the pool's FIFO stealing serves their strips in arrival order.
+ *
+ * Different sessions may process concurrently from different threads. Frames of one
+ * session are serialized. Parameter changes never wait for a frame in flight: they
+ * are staged, optionally for a given frame number, and a frame picks up the complete
+ * parameters in effect when it starts without taking any lock (see StagedSnapshots).
+ * A frame therefore never sees half of a change, nor one staged for a later frame.
+ */
+class SessionEngine {
+public:
+    using Handle = uint64_t;
+
+    static constexpr Handle kInvalidHandle = 0;
+
+    /**
+     * Parameters of one session
+     */
+    struct Parameters {
+        static constexpr int kMaxRegions = 8;
+        static constexpr int kMaxSweep = 16;
+
+        int lowThreshold = 50;
+        int ratio = 3;
+        int kernelSize = 3;
+        bool lumaOnly = true;
+        EdgeDetector::Engine engine = EdgeDetector::ENGINE_PARALLEL;
+        bool incremental = false;          // recompute changed tiles only
+        double changeSensitivity = 0.0;    // mean abs difference a reused tile may show
+        int64_t frameBudgetNanos = 0;      // 0 keeps full resolution
+        int maxPyramidLevel = LatencyGovernor::kMaxLevel;
+        int regionCount = 0;               // 0 processes full frames
+        cv::Rect regions[kMaxRegions];     // regions of interest, frame coordinates
+        bool linkEdges = false;            // trace every mask into polylines
+        double simplifyEpsilon = 0.0;      // Douglas-Peucker tolerance, 0 keeps every pixel
+        int minContourPixels = 2;          // shorter chains are dropped
+        int sweepCount = 0;                // 0 computes no threshold level map
+        ParallelCanny::Thresholds sweep[kMaxSweep] = {};  // threshold sweep pairs
+        bool gradientOutput = false;       // keep gradient planes and tile histograms
+        int gradientTile = 16;             // histogram tile side in pixels
+        bool edgeDensity = false;          // count edge pixels per tile
+        int densityTile = 32;              // edge density tile side in pixels
+    };
+
+    /**
+     * Constructor
+     *
+     * @param pool The pool shared by all sessions
+     */
+    explicit SessionEngine(ThreadPool& pool = ThreadPool::shared());
+
+    /**
+     * Destructor - destroys all sessions; no frame may be in flight
+     */
+    ~SessionEngine();
+
+    SessionEngine(const SessionEngine&) = delete;
+    SessionEngine& operator=(const SessionEngine&) = delete;
+
+    /**
+     * Create a session with default parameters
+     *
+     * @return The handle of the new session, never kInvalidHandle
+     */
+    Handle create();
+
+    /**
+     * Destroy a session. A frame it is processing right now still completes.
+     *
+     * @return false if the handle is unknown
+     */
+    bool destroy(Handle handle);
+
+    /**
+     * Edge-detect a single channel frame (gray, or the Y plane in luma-only mode)
+     *
+     * @param handle The session
+     * @param gray The input frame (CV_8UC1), only read
+     * @param edges Receives the edge mask (CV_8UC1, 0 or 255)
+     * @return false if the handle is unknown
+     */
+    bool process(Handle handle, const cv::Mat& gray, cv::Mat& edges);
+
+    /**
+     * Edge-detect an RGBA frame
+     *
+     * @return false if the handle is unknown
+     */
+    bool processRgba(Handle handle, const cv::Mat& rgba, cv::Mat& edges);
+
+    /**
+     * Edge-detect an NV21 frame (height * 3 / 2 rows) in the session's mode
+     *
+     * @return false if the handle is unknown
+     */
+    bool processNv21(Handle handle, const cv::Mat& nv21, cv::Mat& edges);
+
+    /**
+     * Stage new parameters for the session's next frame, or for a later one
+     *
+     * @param handle The session
+     * @param parameters The complete parameters
+     * @param frame Number of the first frame they apply to (see frameCount()); 0 or a
+     *              frame already started means the next frame, with changes staged for
+     *              later frames still taking effect on top of them
+     * @return false if the handle is unknown or too many later frames have changes
+     *         waiting
+     */
+    bool setParameters(Handle handle, const Parameters& parameters, uint64_t frame = 0);
+
+    /**
+     * Stage a change to some of the session's parameters, keeping changes made
+     * concurrently from other threads. fn edits the parameters in effect from the
+     * change's frame on and every change staged for a later frame, so it may be called
+     * several times.
+     *
+     * @param handle The session
+     * @param fn Called with the parameters to edit; when frame is a later frame it is
+     *           kept until then, so it must capture by value
+     * @param frame Number of the first frame the change applies to, as in setParameters()
+     * @return false if the handle is unknown or too many later frames have changes
+     *         waiting
+     */
+    template <typename Fn>
+    bool modifyParameters(Handle handle, Fn&& fn, uint64_t frame = 0) {
+        std::shared_ptr<Session> session = find(handle);
+        if (!session) {
+            return false;
+        }
+        return session->parameters.modify(std::forward<Fn>(fn), frame);
+    }
+
+    /**
+     * Stage the regions of interest for the session's next frame, keeping its other
+     * parameters. Only the regions plus the filter halo around them are processed, the
+     * rest of the edge mask is cleared.
+     *
+     * @param handle The session
+     * @param regions Rectangles in frame coordinates
+     * @param count Number of regions, 0 goes back to full frames
+     * @return false if the handle is unknown or count exceeds Parameters::kMaxRegions
+     */
+    bool setRegions(Handle handle, const cv::Rect* regions, int count);
+
+    /**
+     * Read the parameters the session's next frame will run with, including changes
+     * staged for it but not those waiting for a later frame
+     *
+     * @return false if the handle is unknown
+     */
+    bool getParameters(Handle handle, Parameters& parameters) const;
+
+    /**
+     * Read the parameters the session's latest frame was processed with, leaving out
+     * changes staged since
+     *
+     * @return false if the handle is unknown
+     */
+    bool appliedParameters(Handle handle, Parameters& parameters) const;
+
+    /**
+     * Copy the threshold level map of the session's latest frame (see
+     * EdgeDetector::thresholdLevels()); waits for a frame in flight
+     *
+     * @return false if the handle is unknown
+     */
+    bool thresholdLevels(Handle handle, cv::Mat& levels) const;
+
+    /**
+     * Copy the polylines of the session's latest frame; waits for a frame in flight
+     *
+     * @return false if the handle is unknown
+     */
+    bool contours(Handle handle, EdgeContours& contours) const;
+
+    /**
+     * Copy the gradient planes and tile histograms of the session's latest frame (see
+     * EdgeDetector::gradients()); waits for a frame in flight
+     *
+     * @return false if the handle is unknown
+     */
+    bool gradients(Handle handle, ParallelCanny::Gradients& gradients) const;
+
+    /**
+     * Copy the edge density grid of the session's latest frame (see
+     * EdgeDetector::edgeDensity()); waits for a frame in flight
+     *
+     * @return false if the handle is unknown
+     */
+    bool edgeDensity(Handle handle, ParallelCanny::EdgeDensity& density) const;
+
+    /**
+     * Get the number of frames the session processed, which is also the number the
+     * next frame will have
+     *
+     * @return false if the handle is unknown
+     */
+    bool frameCount(Handle handle, uint64_t& frames) const;
+
+    /**
+     * Read the tile reuse counters of the session's incremental mode
+     *
+     * @return false if the handle is unknown
+     */
+    bool temporalStats(Handle handle, TemporalEdgeCache::Stats& stats) const;
+
+    /**
+     * Read the latency governor state of the session, including its pyramid level
+     *
+     * @return false if the handle is unknown
+     */
+    bool governorStats(Handle handle, LatencyGovernor::Stats& stats) const;
+
+    /**
+     * Get the number of live sessions
+     */
+    size_t sessionCount() const;
+
+    /**
+     * Get the number of frames being processed right now, across all sessions
+     */
+    int framesInFlight() const {
+        return mInFlight.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Session {
+        explicit Session(ThreadPool& pool) : detector(pool) {
+            parameters.stage(Parameters());
+        }
+
+        mutable std::mutex frameLock;    // serializes the session's frames
+        EdgeDetector detector;           // only touched under frameLock
+
+        StagedSnapshots<Parameters> parameters;  // staged by any thread, taken by frames
+        Seqlock<Parameters> applied;             // parameters of the latest frame
+
+        std::atomic<uint64_t> frames{0};
+    };
+
+    template <typename Fn>
+    bool runFrame(Handle handle, Fn&& body);
+
+    std::shared_ptr<Session> find(Handle handle) const;
+
+    ThreadPool& mPool;
+    mutable std::mutex mLock;
+    std::unordered_map<Handle, std::shared_ptr<Session>> mSessions;
+    Handle mNextHandle = 1;
+    std::atomic<int> mInFlight{0};
+};
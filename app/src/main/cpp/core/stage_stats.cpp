@@ -0,0 +1,140 @@
+#include "stage_stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+int LatencyHistogram::bucketOf(uint64_t nanos) {
+    // Values below kSubBuckets map linearly, each further power of two gets
+    // kSubBuckets buckets indexed by the bits right below the leading one
+    if (nanos < kSubBuckets) {
+        return static_cast<int>(nanos);
+    }
+    int magnitude = 63 - __builtin_clzll(nanos);
+    int shift = magnitude - kSubBucketBits;
+    int sub = static_cast<int>((nanos >> shift) & (kSubBuckets - 1));
+    return (shift + 1) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::upperBound(int bucket) {
+    if (bucket < kSubBuckets) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int shift = bucket / kSubBuckets - 1;
+    uint64_t sub = static_cast<uint64_t>(bucket % kSubBuckets);
+    uint64_t lower = (static_cast<uint64_t>(kSubBuckets) + sub) << shift;
+    return lower + ((1ull << shift) - 1);
+}
+
+void LatencyHistogram::record(uint64_t nanos) {
+    mBuckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+    mCount.fetch_add(1, std::memory_order_relaxed);
+    mTotal.fetch_add(nanos, std::memory_order_relaxed);
+
+    uint64_t seen = mMax.load(std::memory_order_relaxed);
+    while (nanos > seen &&
+           !mMax.compare_exchange_weak(seen, nanos, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t LatencyHistogram::percentile(double quantile) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    quantile = std::min(1.0, std::max(0.0, quantile));
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(quantile * total)));
+
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < kBucketCount; bucket++) {
+        seen += mBuckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // Never report more than the largest value actually recorded
+            return std::min(upperBound(bucket), max());
+        }
+    }
+    return max();
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : mBuckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mTotal.store(0, std::memory_order_relaxed);
+    mMax.store(0, std::memory_order_relaxed);
+}
+
+StageStats& StageStats::global() {
+    static StageStats stats;
+    return stats;
+}
+
+StageStats::Summary StageStats::summary(Stage stage) const {
+    const LatencyHistogram& histogram = this->histogram(stage);
+    return {
+        histogram.count(),
+        histogram.percentile(0.50),
+        histogram.percentile(0.95),
+        histogram.percentile(0.99),
+        histogram.max()
+    };
+}
+
+void StageStats::flatten(int64_t* out) const {
+    for (int i = 0; i < static_cast<int>(Stage::Count); i++) {
+        Summary stage = summary(static_cast<Stage>(i));
+        out[0] = static_cast<int64_t>(stage.count);
+        out[1] = static_cast<int64_t>(stage.p50);
+        out[2] = static_cast<int64_t>(stage.p95);
+        out[3] = static_cast<int64_t>(stage.p99);
+        out[4] = static_cast<int64_t>(stage.max);
+        out += kSummaryFields;
+    }
+}
+
+void StageStats::reset() {
+    for (auto& histogram : mHistograms) {
+        histogram.reset();
+    }
+}
+
+const char* StageStats::name(Stage stage) {
+    switch (stage) {
+        case Stage::Ingest: return "ingest";
+        case Stage::YuvToRgba: return "yuv2rgba";
+        case Stage::Gray: return "gray";
+        case Stage::Blur: return "blur";
+        case Stage::Canny: return "canny";
+        case Stage::EdgeDetect: return "edges";
+        case Stage::Frame: return "frame";
+        case Stage::Upload: return "upload";
+        case Stage::Draw: return "draw";
+        case Stage::Link: return "link";
+        case Stage::Sweep: return "sweep";
+        default: return "?";
+    }
+}
+
+uint64_t StageStats::timerOverheadNanos() {
+#if EDGE_ENABLE_STATS
+    // Time a batch of empty scopes into a private instance so the pipeline's
+    // histograms and the frame trace are left alone; the cost does not change
+    // while running, so it is measured once
+    static const uint64_t overhead = [] {
+        static constexpr int kIterations = 4096;
+        static StageStats scratch;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kIterations; i++) {
+            ScopedStageTimer timer(Stage::Frame, scratch);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) / kIterations;
+    }();
+    return overhead;
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_trace.h"
+
+/**
+ * Per-stage latency histograms for the native pipeline
+ *
+ * Every stage owns a lock-free log-linear (HDR style) histogram of nanosecond
+ * durations: each power of two is split into 16 linear sub-buckets, so any recorded
+ * value is reported within ~6% over a range of 1 ns to a minute. Recording is a
+ * handful of relaxed atomic adds and never allocates or locks, so it is safe from the
+ * camera, processing, pool and GL threads at once.
+ *
+ * Timing is compiled in when EDGE_ENABLE_STATS is 1 (the default). With 0, the
+ * EDGE_STAGE_TIMER macro expands to nothing and the histograms stay empty, which is
+ * how the instrumentation overhead can be measured against an uninstrumented build;
+ * timerOverheadNanos() gives the per-scope cost of an instrumented one.
+ *
+ * While FrameTrace::global() is enabled, every timed scope is also recorded there as
+ * a span of the thread's current frame.
+ */
+
+#ifndef EDGE_ENABLE_STATS
+#define EDGE_ENABLE_STATS 1
+#endif
+
+enum class Stage {
+    Ingest = 0,   // handing a camera frame to the pipeline input slot
+    YuvToRgba,    // YUV -> RGBA conversion (RGBA mode only)
+    Gray,         // RGBA -> gray conversion (RGBA mode only)
+    Blur,         // Gaussian blur (OpenCV engine only, the others fuse it with Canny)
+    Canny,        // cv::Canny (OpenCV engine only)
+    EdgeDetect,   // blur + Canny with any engine
+    Frame,        // a whole frame on the processing thread, conversions included
+    Upload,       // edge mask texture upload
+    Draw,         // drawFrame on the GL thread (CPU side of the GL calls)
+    Link,         // linking the edge mask into polylines (when enabled)
+    Sweep,        // hysteresis of threshold sweep pairs on shared gradients (when enabled)
+    Count
+};
+
+/**
+ * LatencyHistogram - Lock-free log-linear histogram of nanosecond durations
+ */
+class LatencyHistogram {
+public:
+    /**
+     * Add one duration
+     *
+     * @param nanos The duration in nanoseconds
+     */
+    void record(uint64_t nanos);
+
+    /**
+     * Get the value below which the given fraction of recorded durations fall
+     *
+     * @param quantile The fraction, between 0 and 1
+     * @return The upper bound of the bucket holding that quantile, 0 when empty
+     */
+    uint64_t percentile(double quantile) const;
+
+    uint64_t count() const {
+        return mCount.load(std::memory_order_relaxed);
+    }
+
+    uint64_t max() const {
+        return mMax.load(std::memory_order_relaxed);
+    }
+
+    uint64_t totalNanos() const {
+        return mTotal.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * Forget all recorded durations. Records racing with the reset may be lost.
+     */
+    void reset();
+
+private:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kBucketCount = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+    std::atomic<uint64_t> mBuckets[kBucketCount] = {};
+    std::atomic<uint64_t> mCount{0};
+    std::atomic<uint64_t> mTotal{0};
+    std::atomic<uint64_t> mMax{0};
+
+    static int bucketOf(uint64_t nanos);
+    static uint64_t upperBound(int bucket);
+};
+
+/**
+ * StageStats - One latency histogram per pipeline stage
+ */
+class StageStats {
+public:
+    /**
+     * Latency summary of one stage, in nanoseconds
+     */
+    struct Summary {
+        uint64_t count;
+        uint64_t p50;
+        uint64_t p95;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    // Number of values per stage in flatten()
+    static constexpr int kSummaryFields = 5;
+
+    /**
+     * Get the statistics shared by the whole native pipeline
+     */
+    static StageStats& global();
+
+    void record(Stage stage, uint64_t nanos) {
+        mHistograms[static_cast<int>(stage)].record(nanos);
+    }
+
+    const LatencyHistogram& histogram(Stage stage) const {
+        return mHistograms[static_cast<int>(stage)];
+    }
+
+    /**
+     * Summarize one stage
+     */
+    Summary summary(Stage stage) const;
+
+    /**
+     * Write [count, p50, p95, p99, max] of every stage, in Stage order
+     *
+     * @param out Receives kSummaryFields * Stage::Count values
+     */
+    void flatten(int64_t* out) const;
+
+    /**
+     * Reset every histogram
+     */
+    void reset();
+
+    /**
+     * Get the display name of a stage
+     */
+    static const char* name(Stage stage);
+
+    /**
+     * Get the cost of one timed scope (two clock reads and a record) in nanoseconds,
+     * measured once on the thread of the first call. 0 when stats are compiled out.
+     */
+    static uint64_t timerOverheadNanos();
+
+private:
+    LatencyHistogram mHistograms[static_cast<int>(Stage::Count)];
+};
+
+/**
+ * ScopedStageTimer - Records the lifetime of a scope into a stage histogram, and into
+ * the frame trace while it is enabled if the histogram is the pipeline's
+ */
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(Stage stage, StageStats& stats = StageStats::global())
+        : mStats(stats), mStage(stage), mStart(std::chrono::steady_clock::now()) {}
+
+    ~ScopedStageTimer() {
+        auto end = std::chrono::steady_clock::now();
+        mStats.record(mStage, static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - mStart).count()));
+
+        // Private instances (calibration, benchmarks) stay out of the trace
+        FrameTrace& trace = FrameTrace::global();
+        if (trace.enabled() && &mStats == &StageStats::global()) {
+            trace.record(StageStats::name(mStage), toNanos(mStart), toNanos(end));
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    StageStats& mStats;
+    Stage mStage;
+    std::chrono::steady_clock::time_point mStart;
+
+    static int64_t toNanos(std::chrono::steady_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            time.time_since_epoch()).count();
+    }
+};
+
+#define EDGE_STAGE_TIMER_CONCAT2(a, b) a##b
+#define EDGE_STAGE_TIMER_CONCAT(a, b) EDGE_STAGE_TIMER_CONCAT2(a, b)
+
+#if EDGE_ENABLE_STATS
+// Time the rest of the enclosing scope as the given Stage
+#define EDGE_STAGE_TIMER(stage) \
+    ScopedStageTimer EDGE_STAGE_TIMER_CONCAT(edgeStageTimer, __LINE__)(stage)
+#else
+#define EDGE_STAGE_TIMER(stage) do { } while (0)
+#endif
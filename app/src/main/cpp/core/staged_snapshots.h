@@ -0,0 +1,326 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Seqlock - A value written by one thread at a time and read by any number of threads
+ * without locks
+ *
+ * The value is stored as atomic words behind a sequence number that is odd while a
+ * write is in progress. Readers copy the words and check that the sequence did not
+ * change meanwhile, retrying otherwise; they never block the writer. The words are
+ * ordered by release stores and acquire loads of their own rather than by fences,
+ * which ThreadSanitizer does not model. T must be trivially copyable.
+ */
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+public:
+    Seqlock() {
+        store(T());
+    }
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    /**
+     * Replace the value; concurrent writers must be serialized by the caller
+     */
+    void store(const T& value) {
+        uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        const uint64_t sequence = mSequence.load(std::memory_order_relaxed);
+        mSequence.store(sequence + 1, std::memory_order_relaxed);
+        for (size_t i = 0; i < kWords; i++) {
+            // A reader that sees this word also sees the odd sequence
+            mWords[i].store(words[i], std::memory_order_release);
+        }
+        mSequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * Copy the value unless a write is in progress
+     *
+     * @return false if the copy may be torn; value is left unchanged then
+     */
+    bool tryLoad(T& value) const {
+        const uint64_t sequence = mSequence.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            return false;
+        }
+        uint64_t words[kWords];
+        for (size_t i = 0; i < kWords; i++) {
+            words[i] = mWords[i].load(std::memory_order_acquire);
+        }
+        if (mSequence.load(std::memory_order_relaxed) != sequence) {
+            return false;
+        }
+        std::memcpy(&value, words, sizeof(T));
+        return true;
+    }
+
+    /**
+     * Copy the value, retrying while writes are in progress
+     */
+    T load() const {
+        T value;
+        while (!tryLoad(value)) {
+        }
+        return value;
+    }
+
+private:
+    static constexpr size_t kWords = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    std::atomic<uint64_t> mSequence{0};
+    std::atomic<uint64_t> mWords[kWords];
+};
+
+/**
+ * StagedSnapshots - A configuration changed by any number of writer threads, with
+ * changes that may wait for a given frame, handed to one frame loop without locking
+ * the frame loop
+ *
+ * Writers either replace the whole configuration (stage()) or edit some of it
+ * (modify()), each change tagged with the first frame it applies to. Writes take a
+ * writer-only mutex, so writers never race each other and the edits of modify() are
+ * atomic read-modify-writes.
+ *
+ * An untagged change (frame 0, or a frame already started) applies from the next
+ * frame on, on top of the configuration in effect and of every change still waiting
+ * for a later frame: those keep their own values and take effect on top of it when
+ * their frame comes. A tagged change waits in its own pending snapshot, which starts
+ * out as the configuration in effect at its frame; it never leaks into earlier frames
+ * and later writes never drop it. Tagged edits are kept until their frame starts, to
+ * be replayed if the whole configuration is staged meanwhile.
+ *
+ * After every write the configuration in effect and the pending snapshots are
+ * published together as a table, one of a few seqlocked tables used in turn. The
+ * frame loop calls acquire() once per frame. It never locks: it reads the generation
+ * counter and, only when a new table was published or the next pending frame has come,
+ * copies the snapshot for its frame out of the table. A change therefore takes effect
+ * as a whole, at a frame boundary.
+ *
+ * At most kPending frames may have changes waiting at a time; a change for one more
+ * frame is refused.
+ */
+template <typename T, size_t kPending = 8>
+class StagedSnapshots {
+public:
+    StagedSnapshots() = default;
+
+    StagedSnapshots(const StagedSnapshots&) = delete;
+    StagedSnapshots& operator=(const StagedSnapshots&) = delete;
+
+    /**
+     * Stage a complete configuration (any thread)
+     *
+     * @param value The complete configuration
+     * @param frame First frame it applies to; 0 or a frame already started means the
+     *              next one, keeping changes staged for later frames on top of value
+     * @return false if kPending other frames already have changes waiting
+     */
+    bool stage(const T& value, uint64_t frame = 0) {
+        std::lock_guard<std::mutex> guard(mWriteLock);
+        settleLocked();
+        if (isUntagged(frame)) {
+            mCurrent = value;
+            for (Pending& pending : mPending) {
+                pending.value = value;
+                for (const TaggedEdit& edit : mEdits) {
+                    if (edit.frame <= pending.frame) {
+                        edit.fn(pending.value);
+                    }
+                }
+            }
+        } else if (!modifyTaggedLocked([value](T& target) { target = value; }, frame)) {
+            return false;
+        }
+        publishLocked();
+        return true;
+    }
+
+    /**
+     * Edit the configuration (any thread)
+     *
+     * @param fn Called under the writer lock with each snapshot to edit: the one in
+     *           effect and every pending one from frame on. A tagged change keeps a copy
+     *           of fn to replay, so it must not capture anything by reference.
+     * @param frame First frame the edit applies to, as in stage()
+     * @return false if kPending other frames already have changes waiting
+     */
+    template <typename Fn>
+    bool modify(Fn&& fn, uint64_t frame = 0) {
+        std::lock_guard<std::mutex> guard(mWriteLock);
+        settleLocked();
+        if (isUntagged(frame)) {
+            fn(mCurrent);
+            for (Pending& pending : mPending) {
+                fn(pending.value);
+            }
+        } else if (!modifyTaggedLocked(std::function<void(T&)>(std::forward<Fn>(fn)), frame)) {
+            return false;
+        }
+        publishLocked();
+        return true;
+    }
+
+    /**
+     * Copy the configuration in effect from the next frame on, leaving out changes
+     * waiting for later frames (any thread; takes the writer lock)
+     */
+    void latest(T& value) {
+        std::lock_guard<std::mutex> guard(mWriteLock);
+        settleLocked();
+        value = mCurrent;
+    }
+
+    /**
+     * Take the snapshot in effect at a frame, if it changed (frame loop only). Frames
+     * must not go backwards.
+     *
+     * @param frame The frame about to be processed
+     * @param value Receives the snapshot if it changed
+     * @return true if value was replaced, which it also is after writes that only
+     *         touched later frames
+     */
+    bool acquire(uint64_t frame, T& value) {
+        mStarted.store(frame + 1, std::memory_order_relaxed);
+
+        uint64_t generation = mGeneration.load(std::memory_order_acquire);
+        if (generation == 0 || (generation == mSeen && frame < mNextFrame)) {
+            return false;
+        }
+
+        Table& table = mScratch;
+        while (!tableFor(generation).tryLoad(table) || table.generation != generation) {
+            // Overwritten by newer generations while being copied
+            generation = mGeneration.load(std::memory_order_acquire);
+        }
+
+        size_t index = 0;
+        while (index + 1 < table.count && table.frames[index + 1] <= frame) {
+            index++;
+        }
+        const bool changed = generation != mSeen || index != mIndex;
+        mSeen = generation;
+        mIndex = index;
+        mNextFrame = index + 1 < table.count ? table.frames[index + 1] : UINT64_MAX;
+        if (changed) {
+            value = table.values[index];
+        }
+        return changed;
+    }
+
+    /**
+     * Get the number of tables published so far, one per write (any thread)
+     */
+    uint64_t generation() const {
+        return mGeneration.load(std::memory_order_acquire);
+    }
+
+private:
+    static constexpr size_t kTables = 4;
+
+    // Configuration in effect, then one snapshot per pending frame in frame order
+    struct Table {
+        uint64_t generation = 0;
+        size_t count = 0;
+        uint64_t frames[kPending + 1] = {};
+        T values[kPending + 1];
+    };
+
+    struct Pending {
+        uint64_t frame;
+        T value;
+    };
+
+    struct TaggedEdit {
+        uint64_t frame;
+        std::function<void(T&)> fn;
+    };
+
+    // Writer state, under mWriteLock
+    std::mutex mWriteLock;
+    T mCurrent = T();
+    std::vector<Pending> mPending;       // in frame order
+    std::vector<TaggedEdit> mEdits;      // tagged edits of mPending, in staging order
+    Table mTable;
+
+    std::atomic<uint64_t> mGeneration{0};
+    std::atomic<uint64_t> mStarted{0};   // frames the frame loop started
+    Seqlock<Table> mTables[kTables];
+
+    // Frame loop state
+    alignas(64) uint64_t mSeen = 0;
+    size_t mIndex = 0;
+    uint64_t mNextFrame = 0;
+    Table mScratch;
+
+    Seqlock<Table>& tableFor(uint64_t generation) {
+        return mTables[generation % kTables];
+    }
+
+    bool isUntagged(uint64_t frame) const {
+        return frame == 0 || frame < mStarted.load(std::memory_order_relaxed);
+    }
+
+    // Fold pending snapshots whose frame started into the configuration in effect
+    void settleLocked() {
+        const uint64_t started = mStarted.load(std::memory_order_relaxed);
+        size_t settled = 0;
+        while (settled < mPending.size() && mPending[settled].frame < started) {
+            settled++;
+        }
+        if (settled == 0) {
+            return;
+        }
+        mCurrent = mPending[settled - 1].value;
+        mPending.erase(mPending.begin(), mPending.begin() + settled);
+        mEdits.erase(std::remove_if(mEdits.begin(), mEdits.end(),
+                                    [started](const TaggedEdit& edit) { return edit.frame < started; }),
+                     mEdits.end());
+    }
+
+    bool modifyTaggedLocked(std::function<void(T&)> fn, uint64_t frame) {
+        auto at = std::lower_bound(mPending.begin(), mPending.end(), frame,
+                                   [](const Pending& pending, uint64_t f) { return pending.frame < f; });
+        if (at == mPending.end() || at->frame != frame) {
+            if (mPending.size() == kPending) {
+                return false;
+            }
+            // Starts out as the configuration in effect at its frame
+            const T& base = at == mPending.begin() ? mCurrent : (at - 1)->value;
+            at = mPending.insert(at, Pending{frame, base});
+        }
+        for (; at != mPending.end(); ++at) {
+            fn(at->value);
+        }
+        mEdits.push_back(TaggedEdit{frame, std::move(fn)});
+        return true;
+    }
+
+    void publishLocked() {
+        const uint64_t generation = mGeneration.load(std::memory_order_relaxed) + 1;
+        mTable.generation = generation;
+        mTable.count = mPending.size() + 1;
+        mTable.frames[0] = 0;
+        mTable.values[0] = mCurrent;
+        for (size_t i = 0; i < mPending.size(); i++) {
+            mTable.frames[i + 1] = mPending[i].frame;
+            mTable.values[i + 1] = mPending[i].value;
+        }
+        tableFor(generation).store(mTable);
+        mGeneration.store(generation, std::memory_order_release);
+    }
+};
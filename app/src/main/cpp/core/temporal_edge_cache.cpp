@@ -0,0 +1,149 @@
+#include "temporal_edge_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "buffer_pool.h"
+
+TemporalEdgeCache::TemporalEdgeCache(const RowKernels& kernels) : mKernels(kernels) {
+    BufferPool& buffers = BufferPool::shared();
+    buffers.attach(mReference);
+    buffers.attach(mEdges);
+    buffers.attach(mBandEdges);
+}
+
+void TemporalEdgeCache::setSensitivity(double meanAbsDifference) {
+    mSensitivity = std::max(0.0, meanAbsDifference);
+}
+
+TemporalEdgeCache::Stats TemporalEdgeCache::stats() const {
+    return {
+        mFrames.load(std::memory_order_relaxed),
+        mSkippedFrames.load(std::memory_order_relaxed),
+        mTiles.load(std::memory_order_relaxed),
+        mReusedTiles.load(std::memory_order_relaxed)
+    };
+}
+
+void TemporalEdgeCache::resetStats() {
+    mFrames.store(0, std::memory_order_relaxed);
+    mSkippedFrames.store(0, std::memory_order_relaxed);
+    mTiles.store(0, std::memory_order_relaxed);
+    mReusedTiles.store(0, std::memory_order_relaxed);
+}
+
+cv::Rect TemporalEdgeCache::tileRect(int tileRow, int tileCol, int grow) const {
+    int x0 = std::max(0, tileCol * kTileSize - grow);
+    int y0 = std::max(0, tileRow * kTileSize - grow);
+    int x1 = std::min(mReference.cols, (tileCol + 1) * kTileSize + grow);
+    int y1 = std::min(mReference.rows, (tileRow + 1) * kTileSize + grow);
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool TemporalEdgeCache::tileChanged(const cv::Mat& gray, int tileRow, int tileCol,
+                                    uint32_t limit) const {
+    cv::Rect tile = tileRect(tileRow, tileCol, 0);
+    uint32_t sum = 0;
+    for (int y = tile.y; y < tile.y + tile.height; y++) {
+        sum += mKernels.sad(gray.ptr<uint8_t>(y) + tile.x, mReference.ptr<uint8_t>(y) + tile.x,
+                            tile.width);
+        // Most changed tiles give themselves away long before their last row
+        if (sum > limit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TemporalEdgeCache::findChanges(const cv::Mat& gray, double low, double high,
+                                    int apertureSize) {
+    CV_Assert(gray.type() == CV_8UC1);
+    mFrames.fetch_add(1, std::memory_order_relaxed);
+
+    bool resized = gray.rows != mReference.rows || gray.cols != mReference.cols;
+    if (resized) {
+        mReference.create(gray.rows, gray.cols, CV_8UC1);
+        mEdges.create(gray.rows, gray.cols, CV_8UC1);
+        mBandEdges.create(std::min(gray.rows, kTileSize + 4 * kHalo), gray.cols, CV_8UC1);
+        mTileRows = (gray.rows + kTileSize - 1) / kTileSize;
+        mTileCols = (gray.cols + kTileSize - 1) / kTileSize;
+        mChanged.assign(static_cast<size_t>(mTileRows) * mTileCols, 0);
+        mBands.reserve(mTileRows);
+    }
+
+    const uint64_t tileCount = static_cast<uint64_t>(mTileRows) * mTileCols;
+    mTiles.fetch_add(tileCount, std::memory_order_relaxed);
+    mBands.clear();
+
+    if (resized || !mValid || low != mLow || high != mHigh || apertureSize != mApertureSize) {
+        mValid = true;
+        mLow = low;
+        mHigh = high;
+        mApertureSize = apertureSize;
+        mFullFrame = true;
+        std::fill(mChanged.begin(), mChanged.end(), 1);
+        return true;
+    }
+
+    const uint32_t limit = static_cast<uint32_t>(
+        std::floor(mSensitivity * kTileSize * kTileSize));
+    uint64_t changedTiles = 0;
+
+    for (int tileRow = 0; tileRow < mTileRows; tileRow++) {
+        uint8_t* changed = &mChanged[static_cast<size_t>(tileRow) * mTileCols];
+        int first = -1;
+        int last = -1;
+        for (int tileCol = 0; tileCol < mTileCols; tileCol++) {
+            changed[tileCol] = tileChanged(gray, tileRow, tileCol, limit) ? 1 : 0;
+            if (changed[tileCol]) {
+                first = first < 0 ? tileCol : first;
+                last = tileCol;
+                changedTiles++;
+            }
+        }
+        if (first >= 0) {
+            // One band from the first to the last changed tile of the row
+            cv::Rect input = tileRect(tileRow, first, 2 * kHalo) | tileRect(tileRow, last, 2 * kHalo);
+            mBands.push_back({tileRow, input});
+        }
+    }
+
+    mReusedTiles.fetch_add(tileCount - changedTiles, std::memory_order_relaxed);
+    if (changedTiles == 0) {
+        mSkippedFrames.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    mFullFrame = false;
+    return true;
+}
+
+void TemporalEdgeCache::writeBack(const Band& band, const cv::Mat& bandEdges) {
+    const uint8_t* changed = &mChanged[static_cast<size_t>(band.tileRow) * mTileCols];
+    for (int tileCol = 0; tileCol < mTileCols; tileCol++) {
+        if (!changed[tileCol]) {
+            continue;
+        }
+        // Everything the change can reach, in frame and in band coordinates
+        cv::Rect target = tileRect(band.tileRow, tileCol, kHalo);
+        cv::Rect source = target - band.input.tl();
+        cv::Mat destination = mEdges(target);
+        bandEdges(source).copyTo(destination);
+    }
+}
+
+void TemporalEdgeCache::updateReference(const cv::Mat& gray) {
+    if (mFullFrame) {
+        gray.copyTo(mReference);
+        return;
+    }
+    for (int tileRow = 0; tileRow < mTileRows; tileRow++) {
+        const uint8_t* changed = &mChanged[static_cast<size_t>(tileRow) * mTileCols];
+        for (int tileCol = 0; tileCol < mTileCols; tileCol++) {
+            if (changed[tileCol]) {
+                cv::Rect tile = tileRect(tileRow, tileCol, 0);
+                cv::Mat destination = mReference(tile);
+                gray(tile).copyTo(destination);
+            }
+        }
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "row_kernels.h"
+
+/**
+ * TemporalEdgeCache - Recomputes edges only where the scene changed
+ *
+ * The frame is split into 32x32 tiles. Each tile of the incoming gray frame is
+ * compared with the frame its cached edges were computed from, using the SAD row
+ * kernel. Changed tiles are edge-detected again from a band around them, every other
+ * tile keeps its cached edges, and a frame without any changed tile skips detection
+ * entirely. New parameters or a new frame size recompute the whole frame.
+ *
+ * Around every changed tile the edges are rewritten kHalo pixels further, because
+ * blur, Sobel and non-maximum suppression let a change reach that far. The detection
+ * band reaches another kHalo pixels out, so its own border handling never shows.
+ * Hysteresis is not local: an edge chain that continues from a changed tile into a
+ * static one keeps the static part's previous state. The incremental result therefore
+ * matches a full recomputation except along such chains.
+ *
+ * Sensitivity is the mean absolute difference per pixel a tile may show and still
+ * count as unchanged. 0 reuses only bit-identical tiles; a few levels absorb sensor
+ * noise. Reused tiles are compared with the frame they were computed from, not with
+ * the previous frame, so slow drifts still trigger a recomputation eventually.
+ */
+class TemporalEdgeCache {
+public:
+    static constexpr int kTileSize = 32;
+    static constexpr int kHalo = 8;
+
+    /**
+     * Reuse counters, readable from any thread
+     */
+    struct Stats {
+        uint64_t frames;          // frames seen
+        uint64_t skippedFrames;   // frames without any changed tile
+        uint64_t tiles;           // tiles compared
+        uint64_t reusedTiles;     // tiles whose cached edges were kept
+    };
+
+    /**
+     * Constructor
+     *
+     * @param kernels Row kernels for the tile comparison
+     */
+    explicit TemporalEdgeCache(const RowKernels& kernels = RowKernels::best());
+
+    /**
+     * Edge-detect a frame, recomputing only changed tiles
+     *
+     * @param gray The input frame (CV_8UC1), only read
+     * @param edges Receives the edge mask
+     * @param low Low Canny threshold
+     * @param high High Canny threshold
+     * @param apertureSize Sobel aperture
+     * @param detect Called as detect(region, regionEdges) for the whole frame or for
+     *               bands of it; must write the edges of region into regionEdges
+     */
+    template <typename Detect>
+    void process(const cv::Mat& gray, cv::Mat& edges, double low, double high,
+                 int apertureSize, Detect&& detect);
+
+    /**
+     * Set how much a tile may differ and still reuse its cached edges
+     *
+     * @param meanAbsDifference Mean absolute difference per pixel, 0 for exact matches
+     */
+    void setSensitivity(double meanAbsDifference);
+
+    double getSensitivity() const {
+        return mSensitivity;
+    }
+
+    /**
+     * Drop the cache, the next frame is computed in full
+     */
+    void invalidate() {
+        mValid = false;
+    }
+
+    /**
+     * Read the reuse counters
+     */
+    Stats stats() const;
+
+    /**
+     * Clear the reuse counters
+     */
+    void resetStats();
+
+private:
+    // A tile row with changed tiles and the region detected for it
+    struct Band {
+        int tileRow;
+        cv::Rect input;
+    };
+
+    const RowKernels& mKernels;
+    double mSensitivity = 0.0;
+    bool mValid = false;
+    double mLow = 0.0;
+    double mHigh = 0.0;
+    int mApertureSize = 0;
+
+    int mTileRows = 0;
+    int mTileCols = 0;
+    std::vector<uint8_t> mChanged;   // per tile
+    std::vector<Band> mBands;        // reserved for every tile row, filled per frame
+    bool mFullFrame = true;
+
+    cv::Mat mReference;   // gray pixels the cached edges of each tile come from
+    cv::Mat mEdges;       // cached edges of the whole frame
+    cv::Mat mBandEdges;   // band output, sized for the widest band once
+
+    std::atomic<uint64_t> mFrames{0};
+    std::atomic<uint64_t> mSkippedFrames{0};
+    std::atomic<uint64_t> mTiles{0};
+    std::atomic<uint64_t> mReusedTiles{0};
+
+    // Compare with the reference and lay out the bands; false if nothing changed
+    bool findChanges(const cv::Mat& gray, double low, double high, int apertureSize);
+    bool tileChanged(const cv::Mat& gray, int tileRow, int tileCol, uint32_t limit) const;
+    cv::Rect tileRect(int tileRow, int tileCol, int grow) const;
+    void writeBack(const Band& band, const cv::Mat& bandEdges);
+    void updateReference(const cv::Mat& gray);
+};
+
+template <typename Detect>
+void TemporalEdgeCache::process(const cv::Mat& gray, cv::Mat& edges, double low, double high,
+                                int apertureSize, Detect&& detect) {
+    if (findChanges(gray, low, high, apertureSize)) {
+        if (mFullFrame) {
+            detect(gray, mEdges);
+        } else {
+            for (const Band& band : mBands) {
+                // A view of the right size, so the detector writes in place
+                cv::Mat bandEdges = mBandEdges(cv::Rect(0, 0, band.input.width, band.input.height));
+                detect(gray(band.input), bandEdges);
+                writeBack(band, bandEdges);
+            }
+        }
+        updateReference(gray);
+    }
+
+    if (&edges != &mEdges) {
+        mEdges.copyTo(edges);
+    }
+}
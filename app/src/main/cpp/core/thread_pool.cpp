@@ -0,0 +1,267 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace {
+
+// Identifies the pool and queue of the current thread when it is a worker
+thread_local ThreadPool* tPool = nullptr;
+thread_local int tWorkerIndex = -1;
+
+// Read the maximum frequency of a CPU in kHz, 0 when cpufreq is not available
+long readMaxFrequency(int cpu) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+
+    long frequency = 0;
+    if (fscanf(file, "%ld", &frequency) != 1) {
+        frequency = 0;
+    }
+    fclose(file);
+    return frequency;
+}
+
+void pinToCpu(int cpu) {
+#ifdef __linux__
+    if (cpu < 0) {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+} // namespace
+
+ThreadPool::ThreadPool(int threadCount) {
+    std::vector<int> cores;
+    if (threadCount <= 0) {
+        cores = bigCores();
+        threadCount = static_cast<int>(cores.size());
+    }
+
+    // The thread calling parallelFor is the last participant
+    int workerCount = std::max(0, threadCount - 1);
+    mWorkers.reserve(workerCount);
+    for (int i = 0; i < workerCount; i++) {
+        mWorkers.push_back(new Worker());
+    }
+    for (int i = 0; i < workerCount; i++) {
+        int cpu = cores.empty() ? -1 : cores[i % cores.size()];
+        mWorkers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i, cpu);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> guard(mSleepLock);
+        mStopping = true;
+    }
+    mWake.notify_all();
+
+    // Workers still running may steal from any queue, so none is freed before all joined
+    for (Worker* worker : mWorkers) {
+        worker->thread.join();
+    }
+    for (Worker* worker : mWorkers) {
+        delete worker;
+    }
+}
+
+void ThreadPool::submit(Task task) {
+    if (mWorkers.empty()) {
+        task.run(task.arg);
+        return;
+    }
+
+    // Workers push to their own queue, other threads spread tasks round robin
+    size_t index = tPool == this
+        ? static_cast<size_t>(tWorkerIndex)
+        : mNextQueue.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    Worker& worker = *mWorkers[index];
+
+    bool queued = false;
+    mQueued.fetch_add(1, std::memory_order_acq_rel);
+    {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.size < kQueueCapacity) {
+            worker.tasks[(worker.head + worker.size) % kQueueCapacity] = task;
+            worker.size++;
+            queued = true;
+        }
+    }
+
+    if (!queued) {
+        mQueued.fetch_sub(1, std::memory_order_acq_rel);
+        task.run(task.arg);
+        return;
+    }
+
+    // Taking the lock orders the push against a worker about to go to sleep
+    {
+        std::lock_guard<std::mutex> guard(mSleepLock);
+    }
+    mWake.notify_one();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(0);
+    return pool;
+}
+
+std::vector<int> ThreadPool::bigCores() {
+    int cpuCount = std::max(1u, std::thread::hardware_concurrency());
+
+    std::vector<long> frequencies(cpuCount);
+    long slowest = 0;
+    long fastest = 0;
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        frequencies[cpu] = readMaxFrequency(cpu);
+        if (frequencies[cpu] > 0) {
+            slowest = slowest == 0 ? frequencies[cpu] : std::min(slowest, frequencies[cpu]);
+            fastest = std::max(fastest, frequencies[cpu]);
+        }
+    }
+
+    // Heterogeneous (big.LITTLE) system: leave out the efficiency cluster
+    std::vector<int> cores;
+    for (int cpu = 0; cpu < cpuCount; cpu++) {
+        if (fastest == slowest || frequencies[cpu] > slowest) {
+            cores.push_back(cpu);
+        }
+    }
+    return cores;
+}
+
+void ThreadPool::workerLoop(int index, int cpu) {
+    tPool = this;
+    tWorkerIndex = index;
+    pinToCpu(cpu);
+
+    for (;;) {
+        if (tryRunOne(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepLock);
+        mWake.wait(lock, [this] {
+            return mStopping || mQueued.load(std::memory_order_acquire) > 0;
+        });
+        if (mStopping && mQueued.load(std::memory_order_acquire) <= 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popLocal(int index, Task& task) {
+    Worker& worker = *mWorkers[index];
+    std::lock_guard<std::mutex> guard(worker.lock);
+    if (worker.size == 0) {
+        return false;
+    }
+    worker.size--;
+    task = worker.tasks[(worker.head + worker.size) % kQueueCapacity];
+    return true;
+}
+
+bool ThreadPool::steal(int thief, Task& task) {
+    size_t count = mWorkers.size();
+    for (size_t offset = 1; offset < count; offset++) {
+        Worker& victim = *mWorkers[(thief + offset) % count];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (victim.size == 0) {
+            continue;
+        }
+        task = victim.tasks[victim.head];
+        victim.head = (victim.head + 1) % kQueueCapacity;
+        victim.size--;
+        return true;
+    }
+    return false;
+}
+
+bool ThreadPool::tryRunOne(int index) {
+    Task task;
+    if (!popLocal(index, task) && !steal(index, task)) {
+        return false;
+    }
+    mQueued.fetch_sub(1, std::memory_order_acq_rel);
+    task.run(task.arg);
+    return true;
+}
+
+void ThreadPool::runBatch(Batch& batch) {
+    int helpers = std::min(batch.count - 1, static_cast<int>(mWorkers.size()));
+    if (batch.maxHelpers >= 0) {
+        helpers = std::min(helpers, batch.maxHelpers);
+    }
+    batch.helpers.store(helpers, std::memory_order_relaxed);
+    for (int i = 0; i < helpers; i++) {
+        submit({&ThreadPool::runHelper, &batch});
+    }
+
+    drain(batch);
+
+    // Helpers nobody picked up yet would only find an empty batch; take them back
+    // so the caller does not wait on workers busy with unrelated tasks
+    size_t reclaimed = reclaim(&batch);
+    if (reclaimed > 0) {
+        batch.helpers.fetch_sub(static_cast<int>(reclaimed), std::memory_order_acq_rel);
+    }
+
+    while (batch.helpers.load(std::memory_order_acquire) > 0) {
+        std::this_thread::yield();
+    }
+}
+
+size_t ThreadPool::reclaim(void* arg) {
+    size_t removed = 0;
+    for (Worker* worker : mWorkers) {
+        std::lock_guard<std::mutex> guard(worker->lock);
+        size_t kept = 0;
+        for (size_t i = 0; i < worker->size; i++) {
+            const Task& task = worker->tasks[(worker->head + i) % kQueueCapacity];
+            if (task.arg == arg) {
+                removed++;
+                continue;
+            }
+            worker->tasks[(worker->head + kept) % kQueueCapacity] = task;
+            kept++;
+        }
+        worker->size = kept;
+    }
+    if (removed > 0) {
+        mQueued.fetch_sub(static_cast<long>(removed), std::memory_order_acq_rel);
+    }
+    return removed;
+}
+
+void ThreadPool::runHelper(void* arg) {
+    Batch& batch = *static_cast<Batch*>(arg);
+    drain(batch);
+    batch.helpers.fetch_sub(1, std::memory_order_release);
+}
+
+void ThreadPool::drain(Batch& batch) {
+    for (;;) {
+        int index = batch.next.fetch_add(1, std::memory_order_relaxed);
+        if (index >= batch.count) {
+            return;
+        }
+        batch.body(batch.context, index);
+    }
+}
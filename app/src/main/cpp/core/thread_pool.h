@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * ThreadPool - Persistent work-stealing pool for the native pipeline
+ *
+ * Every worker owns a bounded task queue. Workers pop their own queue LIFO and steal
+ * FIFO from the others when it runs dry. Tasks are plain function pointers, so
+ * submitting work never allocates.
+ *
+ * parallelFor() lets the calling thread take part in the loop. A pool created with
+ * N threads therefore runs N - 1 workers, and a pool of 1 runs everything inline.
+ */
+class ThreadPool {
+public:
+    struct Task {
+        void (*run)(void* arg);
+        void* arg;
+    };
+
+    /**
+     * Constructor
+     *
+     * @param threadCount Total threads taking part in parallelFor, including the caller.
+     *                    0 sizes the pool to the big cores of the device.
+     */
+    explicit ThreadPool(int threadCount = 0);
+
+    /**
+     * Destructor - finishes queued tasks and joins the workers
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Get the number of threads taking part in parallelFor, including the caller
+     */
+    int threadCount() const {
+        return static_cast<int>(mWorkers.size()) + 1;
+    }
+
+    /**
+     * Queue a task. Runs it inline when the pool has no workers or the queue is full.
+     */
+    void submit(Task task);
+
+    /**
+     * Run fn(index) for every index in [0, count) and wait for all of them.
+     * The caller claims indices alongside the workers, so this never deadlocks even
+     * when every worker is busy, and it may be called from inside a pool task.
+     *
+     * maxHelpers caps how many workers join the loop (-1 for all of them). Callers
+     * sharing the pool between several streams use it to split the workers fairly.
+     */
+    template <typename Fn>
+    void parallelFor(int count, Fn&& fn, int maxHelpers = -1) {
+        if (count <= 0) {
+            return;
+        }
+        if (count == 1 || mWorkers.empty() || maxHelpers == 0) {
+            for (int i = 0; i < count; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        using Body = typename std::remove_reference<Fn>::type;
+        Batch batch;
+        batch.count = count;
+        batch.maxHelpers = maxHelpers;
+        batch.context = &fn;
+        batch.body = [](void* context, int index) { (*static_cast<Body*>(context))(index); };
+        runBatch(batch);
+    }
+
+    /**
+     * Get the pool shared by the whole native pipeline, sized to the big cores
+     */
+    static ThreadPool& shared();
+
+    /**
+     * Get the CPU ids of the fastest core cluster (all CPUs on homogeneous systems)
+     */
+    static std::vector<int> bigCores();
+
+private:
+    static constexpr size_t kQueueCapacity = 256;
+
+    // A parallelFor in flight; lives on the stack of the calling thread
+    struct Batch {
+        std::atomic<int> next{0};
+        std::atomic<int> helpers{0};
+        int count = 0;
+        int maxHelpers = -1;
+        void* context = nullptr;
+        void (*body)(void* context, int index) = nullptr;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        Task tasks[kQueueCapacity];
+        size_t head = 0;   // oldest task, stolen from here
+        size_t size = 0;
+        std::thread thread;
+    };
+
+    std::vector<Worker*> mWorkers;
+    std::atomic<long> mQueued{0};
+    std::atomic<size_t> mNextQueue{0};
+    std::mutex mSleepLock;
+    std::condition_variable mWake;
+    bool mStopping = false;
+
+    void workerLoop(int index, int cpu);
+    bool popLocal(int index, Task& task);
+    bool steal(int thief, Task& task);
+    bool tryRunOne(int index);
+    void runBatch(Batch& batch);
+    size_t reclaim(void* arg);
+
+    static void runHelper(void* arg);
+    static void drain(Batch& batch);
+};
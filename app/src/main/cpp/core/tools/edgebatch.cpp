@@ -0,0 +1,457 @@
+/**
+ * edgebatch - Offline edge detection over recorded footage
+ *
+ * Runs the EdgeDetector pipeline over a video file (read with cv::VideoCapture) or a
+ * directory of images and writes the edge masks as numbered PNG files or as a video.
+ *
+ * Frames are processed in parallel, one frame per worker thread: each worker owns an
+ * EdgeDetector whose engine runs inline, and OpenCV's own threading is turned off, so
+ * workers never compete for cores and throughput grows with the worker count until
+ * input decoding becomes the bottleneck. Image directories are decoded by the workers
+ * themselves; a video can only be decoded in order, by the main thread.
+ *
+ * At most --in-flight frames are between reading and writing at any time, which
+ * bounds memory. Frames complete out of order but are written strictly in order.
+ *
+ * Reports frames per second and percentiles of the per-frame processing latency
+ * (decode excluded) and of the end-to-end latency (read to written).
+ *
+ *   ./edgebatch -j 8 -o edges.avi footage.mp4
+ *   ./edgebatch -o out/ --engine parallel frames/
+ */
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "edge_detector.h"
+#include "logger.h"
+#include "stage_stats.h"
+#include "thread_pool.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string input;
+    std::string output;
+    int threads = 0;
+    int inFlight = 0;
+    EdgeDetector::Engine engine = EdgeDetector::ENGINE_FUSED;
+    int lowThreshold = 50;
+    int ratio = 3;
+    int kernelSize = 3;
+    long maxFrames = -1;
+};
+
+// One frame between reading and writing
+struct Slot {
+    long index = -1;
+    std::string path;        // image to decode, empty for video frames
+    cv::Mat frame;           // decoded BGR frame, for video input
+    cv::Mat gray;
+    cv::Mat edges;
+    Clock::time_point read;
+    bool done = false;
+    bool failed = false;
+};
+
+void printUsage(const char* program) {
+    std::fprintf(stderr,
+        "Usage: %s [options] <video file | image directory>\n"
+        "  -o, --output PATH    directory for numbered PNG edge frames, or a video file\n"
+        "                       (.avi, .mp4, .mkv); nothing is written without it\n"
+        "  -j, --threads N      worker threads (default: all cores)\n"
+        "  --in-flight N        frames between reading and writing (default: 2 x threads)\n"
+        "  --engine NAME        opencv, parallel or fused (default: fused)\n"
+        "  --low N              low Canny threshold (default: 50)\n"
+        "  --ratio N            high to low threshold ratio (default: 3)\n"
+        "  --kernel N           Sobel aperture, 3, 5 or 7 (default: 3)\n"
+        "  --max-frames N       stop after N frames\n",
+        program);
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        if (arg[0] != '-') {
+            options.input = arg;
+            continue;
+        }
+
+        const char* text = value();
+        if (!text) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        if (arg == "-o" || arg == "--output") {
+            options.output = text;
+        } else if (arg == "-j" || arg == "--threads") {
+            options.threads = std::atoi(text);
+        } else if (arg == "--in-flight") {
+            options.inFlight = std::atoi(text);
+        } else if (arg == "--engine") {
+            std::string name = text;
+            if (name == "opencv") {
+                options.engine = EdgeDetector::ENGINE_OPENCV;
+            } else if (name == "parallel") {
+                options.engine = EdgeDetector::ENGINE_PARALLEL;
+            } else if (name == "fused") {
+                options.engine = EdgeDetector::ENGINE_FUSED;
+            } else {
+                std::fprintf(stderr, "Unknown engine %s\n", text);
+                return false;
+            }
+        } else if (arg == "--low") {
+            options.lowThreshold = std::atoi(text);
+        } else if (arg == "--ratio") {
+            options.ratio = std::atoi(text);
+        } else if (arg == "--kernel") {
+            options.kernelSize = std::atoi(text);
+        } else if (arg == "--max-frames") {
+            options.maxFrames = std::atol(text);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return !options.input.empty();
+}
+
+bool isImageFile(const std::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    static const char* kExtensions[] = {".png", ".jpg", ".jpeg", ".bmp", ".tif", ".tiff", ".pgm", ".ppm"};
+    for (const char* known : kExtensions) {
+        if (extension == known) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isVideoFile(const std::string& path) {
+    std::string extension = std::filesystem::path(path).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".avi" || extension == ".mp4" || extension == ".mkv";
+}
+
+double toMillis(uint64_t nanos) {
+    return nanos / 1e6;
+}
+
+void printLatency(const char* name, const LatencyHistogram& histogram) {
+    std::printf("%-12s p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n", name,
+                toMillis(histogram.percentile(0.50)), toMillis(histogram.percentile(0.90)),
+                toMillis(histogram.percentile(0.99)), toMillis(histogram.max()));
+}
+
+/**
+ * BatchRunner - Reads, processes and writes the frames of one batch run
+ */
+class BatchRunner {
+public:
+    explicit BatchRunner(const Options& options) : mOptions(options) {}
+
+    int run();
+
+private:
+    const Options& mOptions;
+
+    // Input: a sorted image list or an open video
+    std::vector<std::string> mImages;
+    cv::VideoCapture mCapture;
+    double mFps = 30.0;
+
+    // Output: PNG directory or video
+    bool mWriteImages = false;
+    cv::VideoWriter mWriter;
+
+    // Engines of the workers run inline, the frames are what runs in parallel
+    ThreadPool mInlinePool{1};
+
+    std::mutex mLock;
+    std::condition_variable mWorkReady;
+    std::condition_variable mFrameDone;
+    std::deque<Slot*> mQueue;
+    std::vector<Slot> mSlots;
+    bool mStopping = false;
+
+    LatencyHistogram mProcessLatency;
+    LatencyHistogram mEndToEndLatency;
+    long mFailed = 0;
+
+    bool openInput();
+    bool readNext(long index, Slot& slot);
+    bool openOutput(cv::Size size);
+    void write(Slot& slot);
+    void worker();
+};
+
+bool BatchRunner::openInput() {
+    namespace fs = std::filesystem;
+    std::error_code error;
+    if (fs::is_directory(mOptions.input, error)) {
+        for (const fs::directory_entry& entry : fs::directory_iterator(mOptions.input, error)) {
+            if (entry.is_regular_file() && isImageFile(entry.path())) {
+                mImages.push_back(entry.path().string());
+            }
+        }
+        std::sort(mImages.begin(), mImages.end());
+        if (mImages.empty()) {
+            std::fprintf(stderr, "No images in %s\n", mOptions.input.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    if (!mCapture.open(mOptions.input)) {
+        std::fprintf(stderr, "Cannot open %s\n", mOptions.input.c_str());
+        return false;
+    }
+    double fps = mCapture.get(cv::CAP_PROP_FPS);
+    if (fps > 0) {
+        mFps = fps;
+    }
+    return true;
+}
+
+bool BatchRunner::readNext(long index, Slot& slot) {
+    if (mOptions.maxFrames >= 0 && index >= mOptions.maxFrames) {
+        return false;
+    }
+    slot.path.clear();
+    if (!mImages.empty()) {
+        if (index >= static_cast<long>(mImages.size())) {
+            return false;
+        }
+        // Decoded by the worker, in parallel with the other frames
+        slot.path = mImages[index];
+    } else if (!mCapture.read(slot.frame)) {
+        return false;
+    }
+    slot.index = index;
+    slot.read = Clock::now();
+    slot.done = false;
+    slot.failed = false;
+    return true;
+}
+
+bool BatchRunner::openOutput(cv::Size size) {
+    if (mOptions.output.empty() || mWriteImages || mWriter.isOpened()) {
+        return true;
+    }
+    if (isVideoFile(mOptions.output)) {
+        std::string extension = std::filesystem::path(mOptions.output).extension().string();
+        int fourcc = extension == ".avi" ? cv::VideoWriter::fourcc('M', 'J', 'P', 'G')
+                                         : cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+        if (!mWriter.open(mOptions.output, fourcc, mFps, size, false)) {
+            std::fprintf(stderr, "Cannot write %s\n", mOptions.output.c_str());
+            return false;
+        }
+        return true;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(mOptions.output, error);
+    if (error) {
+        std::fprintf(stderr, "Cannot create %s: %s\n", mOptions.output.c_str(),
+                     error.message().c_str());
+        return false;
+    }
+    mWriteImages = true;
+    return true;
+}
+
+void BatchRunner::write(Slot& slot) {
+    // PNG output is already written by the workers, only a video needs the order
+    if (mWriter.isOpened()) {
+        mWriter.write(slot.edges);
+    }
+}
+
+void BatchRunner::worker() {
+    EdgeDetector detector(mInlinePool);
+    detector.setEngine(mOptions.engine);
+    detector.updateParameters(mOptions.lowThreshold, mOptions.ratio, mOptions.kernelSize);
+    detector.setMaxHelpers(0);
+
+    for (;;) {
+        Slot* slot;
+        {
+            std::unique_lock<std::mutex> guard(mLock);
+            mWorkReady.wait(guard, [&]() { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty()) {
+                return;
+            }
+            slot = mQueue.front();
+            mQueue.pop_front();
+        }
+
+        if (!slot->path.empty()) {
+            slot->gray = cv::imread(slot->path, cv::IMREAD_GRAYSCALE);
+        } else if (slot->frame.channels() == 1) {
+            slot->gray = slot->frame;
+        } else {
+            cv::cvtColor(slot->frame, slot->gray, cv::COLOR_BGR2GRAY);
+        }
+
+        if (slot->gray.empty()) {
+            slot->failed = true;
+        } else {
+            Clock::time_point start = Clock::now();
+            detector.processGray(slot->gray, slot->edges);
+            mProcessLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - start).count());
+
+            // Numbered files can be written in any order, so workers encode them
+            if (mWriteImages) {
+                char name[32];
+                std::snprintf(name, sizeof(name), "edges_%06ld.png", slot->index);
+                if (!cv::imwrite((std::filesystem::path(mOptions.output) / name).string(), slot->edges)) {
+                    slot->failed = true;
+                }
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            slot->done = true;
+        }
+        mFrameDone.notify_one();
+    }
+}
+
+int BatchRunner::run() {
+    if (!openInput()) {
+        return 1;
+    }
+    // Image output needs no frame size, open it before the workers write into it
+    if (!mOptions.output.empty() && !isVideoFile(mOptions.output) && !openOutput(cv::Size())) {
+        return 1;
+    }
+
+    // One frame per core; OpenCV's own threads would only compete with the workers
+    cv::setNumThreads(1);
+    const int threads = mOptions.threads > 0
+        ? mOptions.threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const int inFlight = std::max(threads, mOptions.inFlight > 0 ? mOptions.inFlight : 2 * threads);
+    mSlots.resize(inFlight);
+
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back([this]() { worker(); });
+    }
+
+    Clock::time_point begin = Clock::now();
+    long nextRead = 0;
+    long nextWrite = 0;
+    bool inputLeft = true;
+    bool outputFailed = false;
+
+    while (!outputFailed) {
+        // Retire finished frames in order
+        Slot* oldest = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            if (nextWrite < nextRead && mSlots[nextWrite % inFlight].done) {
+                oldest = &mSlots[nextWrite % inFlight];
+            }
+        }
+        if (oldest) {
+            if (oldest->failed) {
+                std::fprintf(stderr, "Frame %ld failed\n", oldest->index);
+                mFailed++;
+            } else if (isVideoFile(mOptions.output) && !openOutput(oldest->edges.size())) {
+                outputFailed = true;
+            } else {
+                write(*oldest);
+            }
+            mEndToEndLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - oldest->read).count());
+            nextWrite++;
+            continue;
+        }
+
+        // Read ahead while there is a free slot
+        if (inputLeft && nextRead - nextWrite < inFlight) {
+            Slot& slot = mSlots[nextRead % inFlight];
+            if (readNext(nextRead, slot)) {
+                {
+                    std::lock_guard<std::mutex> guard(mLock);
+                    mQueue.push_back(&slot);
+                }
+                mWorkReady.notify_one();
+                nextRead++;
+            } else {
+                inputLeft = false;
+            }
+            continue;
+        }
+
+        if (!inputLeft && nextWrite == nextRead) {
+            break;
+        }
+
+        std::unique_lock<std::mutex> guard(mLock);
+        mFrameDone.wait(guard, [&]() { return mSlots[nextWrite % inFlight].done; });
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mStopping = true;
+        mQueue.clear();
+    }
+    mWorkReady.notify_all();
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+    if (outputFailed) {
+        return 1;
+    }
+    mWriter.release();
+
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+    std::printf("%ld frames in %.2f s: %.1f frames/s with %d threads, %d in flight\n",
+                nextWrite, seconds, seconds > 0 ? nextWrite / seconds : 0.0, threads, inFlight);
+    printLatency("processing", mProcessLatency);
+    printLatency("end-to-end", mEndToEndLatency);
+    if (mFailed > 0) {
+        std::printf("%ld frames failed\n", mFailed);
+    }
+    return mFailed > 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    // One detector per worker, their creation messages are noise here
+    setLogLevel(LogLevel::Warn);
+
+    BatchRunner runner(options);
+    return runner.run();
+}
@@ -0,0 +1,415 @@
+/**
+ * edgestream - Serves or watches the WebSocket edge stream of FrameServer
+ *
+ * As a headless client it connects to a running stream (the app's, reached through
+ * adb forward tcp:8765 tcp:8765, or one started with --serve), decodes every frame
+ * like the web viewer does, checks it against the frame checksum and acknowledges it.
+ * It reports bytes per frame against the packed and 8-bit mask sizes, the frames the
+ * server dropped for it, and percentiles of the latency the server measured from the
+ * acknowledgements. --delay makes it a slow client, to watch frames being dropped
+ * instead of queued.
+ *
+ * With --serve it runs a FrameServer that streams edges of a synthetic moving scene,
+ * for testing the viewer and the client without a device.
+ *
+ *   ./edgestream --serve --size 1280x720 --fps 30
+ *   ./edgestream --frames 300 --delay 50
+ */
+
+#include <opencv2/opencv.hpp>
+#include <arpa/inet.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "edge_detector.h"
+#include "edge_formats.h"
+#include "frame_server.h"
+#include "logger.h"
+#include "stage_stats.h"
+
+namespace {
+
+struct Options {
+    bool serve = false;
+    std::string host = "127.0.0.1";
+    int port = FrameServer::kDefaultPort;
+    long frames = -1;
+    int delayMillis = 0;
+    int width = 640;
+    int height = 480;
+    int fps = 30;
+    int seconds = 0;
+};
+
+void printUsage(const char* program) {
+    std::fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -p, --port N         port of the stream (default: %d)\n"
+        "  --host ADDRESS       address of the stream (default: 127.0.0.1)\n"
+        "  --frames N           stop after N frames\n"
+        "  --delay MS           wait before acknowledging each frame, a slow client\n"
+        "  --serve              serve a synthetic stream instead of watching one\n"
+        "  --size WxH           frame size when serving (default: 640x480)\n"
+        "  --fps N              frame rate when serving (default: 30)\n"
+        "  --seconds N          stop serving after N seconds (default: never)\n",
+        program, FrameServer::kDefaultPort);
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help") {
+            return false;
+        }
+        if (arg == "--serve") {
+            options.serve = true;
+            continue;
+        }
+
+        const char* text = i + 1 < argc ? argv[++i] : nullptr;
+        if (!text) {
+            std::fprintf(stderr, "Missing value for %s\n", arg.c_str());
+            return false;
+        }
+        if (arg == "-p" || arg == "--port") {
+            options.port = std::atoi(text);
+        } else if (arg == "--host") {
+            options.host = text;
+        } else if (arg == "--frames") {
+            options.frames = std::atol(text);
+        } else if (arg == "--delay") {
+            options.delayMillis = std::atoi(text);
+        } else if (arg == "--size") {
+            if (std::sscanf(text, "%dx%d", &options.width, &options.height) != 2) {
+                std::fprintf(stderr, "Bad size %s\n", text);
+                return false;
+            }
+        } else if (arg == "--fps") {
+            options.fps = std::atoi(text);
+        } else if (arg == "--seconds") {
+            options.seconds = std::atoi(text);
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return false;
+        }
+    }
+    return options.fps > 0 && options.width > 0 && options.height > 0;
+}
+
+double toMillis(uint64_t nanos) {
+    return nanos / 1e6;
+}
+
+// Gradient background with a few rectangles moving across it
+void drawScene(cv::Mat& gray, long frame) {
+    for (int y = 0; y < gray.rows; y++) {
+        uint8_t* row = gray.ptr<uint8_t>(y);
+        for (int x = 0; x < gray.cols; x++) {
+            row[x] = static_cast<uint8_t>((x + y) * 128 / (gray.cols + gray.rows));
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        int size = gray.rows / (4 + i);
+        int x = static_cast<int>((frame * (i + 1) * 3 + i * gray.cols / 4) % (gray.cols + size)) - size;
+        int y = (i + 1) * gray.rows / 6;
+        cv::Rect box = cv::Rect(x, y, size, size) & cv::Rect(0, 0, gray.cols, gray.rows);
+        for (int r = box.y; r < box.y + box.height; r++) {
+            memset(gray.ptr<uint8_t>(r) + box.x, 180 + i * 20, box.width);
+        }
+    }
+}
+
+int serve(const Options& options) {
+    FrameServer server;
+    if (!server.start(options.port)) {
+        return 1;
+    }
+    std::printf("Serving %dx%d at %d frames/s on ws://127.0.0.1:%d\n", options.width,
+                options.height, options.fps, server.port());
+
+    EdgeDetector detector;
+    cv::Mat gray(options.height, options.width, CV_8UC1);
+    cv::Mat edges;
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::nanoseconds(1000000000LL / options.fps);
+    Clock::time_point begin = Clock::now();
+    Clock::time_point next = begin;
+    long frame = 0;
+    for (;;) {
+        drawScene(gray, frame);
+        detector.processGray(gray, edges);
+        server.publish(edges);
+        frame++;
+
+        if (frame % options.fps == 0) {
+            FrameServer::Stats stats = server.stats();
+            std::printf("%ld frames: %llu viewers, %llu sent, %llu dropped, %.1f KB/frame\n", frame,
+                        static_cast<unsigned long long>(stats.clients),
+                        static_cast<unsigned long long>(stats.sent),
+                        static_cast<unsigned long long>(stats.dropped),
+                        stats.sent > 0 ? stats.bytesSent / 1024.0 / stats.sent : 0.0);
+            std::fflush(stdout);
+        }
+        if (options.seconds > 0 && Clock::now() - begin >= std::chrono::seconds(options.seconds)) {
+            break;
+        }
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+    server.stop();
+    return 0;
+}
+
+/**
+ * StreamClient - A blocking WebSocket client for the edge stream
+ */
+class StreamClient {
+public:
+    ~StreamClient() {
+        if (mSocket >= 0) {
+            close(mSocket);
+        }
+    }
+
+    bool connect(const std::string& host, int port);
+
+    // Receive the next binary message; false when the stream ended
+    bool receive(std::vector<uint8_t>& message);
+
+    // Send a text message, masked as clients must
+    bool sendText(const std::string& text);
+
+private:
+    int mSocket = -1;
+
+    bool readFully(void* data, size_t size);
+    bool writeFully(const void* data, size_t size);
+};
+
+bool StreamClient::connect(const std::string& host, int port) {
+    mSocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (mSocket < 0 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 ||
+        ::connect(mSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::fprintf(stderr, "Cannot connect to %s:%d: %s\n", host.c_str(), port, strerror(errno));
+        return false;
+    }
+    int noDelay = 1;
+    setsockopt(mSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    std::string request = "GET / HTTP/1.1\r\n"
+                          "Host: " + host + ":" + std::to_string(port) + "\r\n"
+                          "Upgrade: websocket\r\n"
+                          "Connection: Upgrade\r\n"
+                          "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                          "Sec-WebSocket-Version: 13\r\n\r\n";
+    if (!writeFully(request.data(), request.size())) {
+        return false;
+    }
+    std::string response;
+    char c;
+    while (response.size() < 4 || response.compare(response.size() - 4, 4, "\r\n\r\n") != 0) {
+        if (!readFully(&c, 1) || response.size() > 8192) {
+            std::fprintf(stderr, "No WebSocket handshake from %s:%d\n", host.c_str(), port);
+            return false;
+        }
+        response.push_back(c);
+    }
+    if (response.compare(0, 12, "HTTP/1.1 101") != 0) {
+        std::fprintf(stderr, "Handshake refused: %s\n", response.substr(0, response.find('\r')).c_str());
+        return false;
+    }
+    return true;
+}
+
+bool StreamClient::receive(std::vector<uint8_t>& message) {
+    for (;;) {
+        uint8_t header[2];
+        if (!readFully(header, 2)) {
+            return false;
+        }
+        const int opcode = header[0] & 0x0f;
+        uint64_t size = header[1] & 0x7f;
+        if (size >= 126) {
+            uint8_t extended[8];
+            const int bytes = size == 126 ? 2 : 8;
+            if (!readFully(extended, bytes)) {
+                return false;
+            }
+            size = 0;
+            for (int i = 0; i < bytes; i++) {
+                size = (size << 8) | extended[i];
+            }
+        }
+        message.resize(size);
+        if (size > 0 && !readFully(message.data(), size)) {
+            return false;
+        }
+        if (opcode == 2) {
+            return true;
+        }
+        if (opcode == 8) {
+            return false;
+        }
+    }
+}
+
+bool StreamClient::sendText(const std::string& text) {
+    // Short messages only; the mask is fixed, it exists for proxies, not for secrecy
+    const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    std::vector<uint8_t> frame = {0x81, static_cast<uint8_t>(0x80 | text.size())};
+    frame.insert(frame.end(), mask, mask + 4);
+    for (size_t i = 0; i < text.size(); i++) {
+        frame.push_back(static_cast<uint8_t>(text[i] ^ mask[i & 3]));
+    }
+    return writeFully(frame.data(), frame.size());
+}
+
+bool StreamClient::readFully(void* data, size_t size) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t count = recv(mSocket, bytes, size, 0);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+bool StreamClient::writeFully(const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t count = send(mSocket, bytes, size, MSG_NOSIGNAL);
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += count;
+        size -= count;
+    }
+    return true;
+}
+
+int watch(const Options& options) {
+    StreamClient client;
+    if (!client.connect(options.host, options.port)) {
+        return 1;
+    }
+    std::printf("Watching ws://%s:%d\n", options.host.c_str(), options.port);
+
+    EdgeFormats formats;
+    PackedEdges frame;
+    std::vector<uint8_t> message;
+    LatencyHistogram latency;
+    LatencyHistogram queued;
+    uint64_t received = 0;
+    uint64_t keyframes = 0;
+    uint64_t skipped = 0;
+    uint64_t corrupt = 0;
+    uint64_t messageBytes = 0;
+    uint64_t packedBytes = 0;
+    uint64_t maskBytes = 0;
+    uint32_t lastSequence = 0;
+
+    while ((options.frames < 0 || static_cast<long>(received) < options.frames) &&
+           client.receive(message)) {
+        StreamFrameHeader header;
+        if (message.size() < sizeof(header)) {
+            std::fprintf(stderr, "Short message of %zu bytes\n", message.size());
+            return 1;
+        }
+        memcpy(&header, message.data(), sizeof(header));
+        if (header.version != kStreamVersion) {
+            std::fprintf(stderr, "Unknown stream version %d\n", header.version);
+            return 1;
+        }
+
+        const bool keyframe = header.flags & kStreamKeyframe;
+        if (keyframe) {
+            frame.width = header.width;
+            frame.height = header.height;
+            frame.stride = (frame.width + 7) / 8;
+            frame.bits.assign(frame.bytes(), 0);
+            keyframes++;
+        }
+        if (frame.width != header.width || frame.height != header.height ||
+            !formats.applyDelta(message.data() + sizeof(header), message.size() - sizeof(header), frame) ||
+            streamChecksum(frame.bits.data(), frame.bytes()) != header.checksum) {
+            // Start over from the next keyframe
+            corrupt++;
+            frame = PackedEdges();
+            client.sendText("key");
+            continue;
+        }
+
+        received++;
+        if (lastSequence != 0 && header.sequence > lastSequence + 1) {
+            skipped += header.sequence - lastSequence - 1;
+        }
+        lastSequence = header.sequence;
+        messageBytes += message.size();
+        packedBytes += frame.bytes();
+        maskBytes += static_cast<uint64_t>(frame.width) * frame.height;
+        if (header.latencyMicros > 0) {
+            latency.record(header.latencyMicros * 1000ull);
+        }
+        queued.record(header.queuedMicros * 1000ull);
+
+        if (options.delayMillis > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(options.delayMillis));
+        }
+        if (!client.sendText("ack " + std::to_string(header.sequence))) {
+            break;
+        }
+    }
+
+    if (received == 0) {
+        std::printf("No frames received\n");
+        return 1;
+    }
+    std::printf("%llu frames, %llu keyframes, %llu dropped by the server, %llu failed to decode\n",
+                static_cast<unsigned long long>(received), static_cast<unsigned long long>(keyframes),
+                static_cast<unsigned long long>(skipped), static_cast<unsigned long long>(corrupt));
+    std::printf("%.1f KB/frame: %.1fx smaller than packed, %.1fx smaller than 8-bit masks\n",
+                messageBytes / 1024.0 / received, static_cast<double>(packedBytes) / messageBytes,
+                static_cast<double>(maskBytes) / messageBytes);
+    if (latency.count() > 0) {
+        std::printf("latency      p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+                    toMillis(latency.percentile(0.50)), toMillis(latency.percentile(0.90)),
+                    toMillis(latency.percentile(0.99)), toMillis(latency.max()));
+    }
+    std::printf("queued       p50 %7.2f ms  p90 %7.2f ms  p99 %7.2f ms  max %7.2f ms\n",
+                toMillis(queued.percentile(0.50)), toMillis(queued.percentile(0.90)),
+                toMillis(queued.percentile(0.99)), toMillis(queued.max()));
+    return corrupt > 0 ? 1 : 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    setLogLevel(LogLevel::Warn);
+    return options.serve ? serve(options) : watch(options);
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * TripleBuffer - Lock-free single producer / single consumer "latest wins" handoff
+ *
+ * Three slots rotate between the producer (back), the consumer (front) and a shared
+ * middle slot. publish() swaps the back slot into the middle, acquire() swaps the
+ * middle slot into the front when it holds something new. Neither side ever waits for
+ * the other: a producer faster than its consumer simply overwrites the middle slot,
+ * and the consumer always picks up the newest one.
+ *
+ * Slots are reused forever, so buffers kept inside T (cv::Mat, vectors) are allocated
+ * once and written in place afterwards.
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * Get the slot the producer fills next (producer only)
+     */
+    T& writeBuffer() {
+        return mSlots[mBack];
+    }
+
+    /**
+     * Hand the filled write buffer to the consumer (producer only)
+     *
+     * @return true if this replaced a slot the consumer never acquired
+     */
+    bool publish() {
+        uint8_t previous = mMiddle.exchange(static_cast<uint8_t>(mBack | kFresh));
+        mBack = previous & kIndexMask;
+        return (previous & kFresh) != 0;
+    }
+
+    /**
+     * Check whether a published slot is waiting for the consumer (any thread)
+     */
+    bool hasFresh() const {
+        return (mMiddle.load() & kFresh) != 0;
+    }
+
+    /**
+     * Take the newest published slot as the read buffer (consumer only)
+     *
+     * @return true if the read buffer changed, false if nothing new was published
+     */
+    bool acquire() {
+        // Only the producer sets the flag and only this thread clears it
+        if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0) {
+            return false;
+        }
+        uint8_t previous = mMiddle.exchange(static_cast<uint8_t>(mFront));
+        mFront = previous & kIndexMask;
+        return true;
+    }
+
+    /**
+     * Get the slot acquired last (consumer only)
+     */
+    T& readBuffer() {
+        return mSlots[mFront];
+    }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFresh = 0x4;
+
+    T mSlots[3];
+
+    // Producer, shared and consumer state live on separate cache lines
+    alignas(64) int mBack = 0;
+    alignas(64) std::atomic<uint8_t> mMiddle{1};
+    alignas(64) int mFront = 2;
+};
@@ -3,72 +3,690 @@
 #include <opencv2/opencv.hpp>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "core/buffer_pool.h"
+#include "core/edge_formats.h"
+#include "core/frame_pipeline.h"
+#include "core/frame_recorder.h"
+#include "core/frame_server.h"
+#include "core/frame_trace.h"
+#include "core/logger.h"
+#include "core/session_engine.h"
+#include "core/stage_stats.h"
+#include "core/triple_buffer.h"
+#include "gl_renderer.h"
 
 #define LOG_TAG "EdgeDetector"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
+// Forward log messages of the platform-neutral core to logcat
+static void androidLogSink(LogLevel level, const char* tag, const char* message) {
+    static const int kPriorities[] = {
+        ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR
+    };
+    __android_log_write(kPriorities[static_cast<int>(level)], tag, message);
+}
+
+// Edge detection sessions, all sharing the native thread pool
+SessionEngine* gEngine = nullptr;
+
+// Session of the camera preview, driven by the existing single-stream calls
+SessionEngine::Handle gCameraSession = SessionEngine::kInvalidHandle;
+
 /**
- * Edge Detector class that applies Canny edge detection to camera frames using OpenCV
+ * OpenGL texture an edge mask stream is uploaded into. Only touched on the GL thread.
  */
-class EdgeDetector {
-private:
-    // OpenCV edge detection parameters
-    int lowThreshold = 50;
-    int ratio = 3;
-    int kernelSize = 3;
-    cv::Mat grayMat;
-    cv::Mat edgeMat;
+struct StreamTexture {
+    GLuint id = 0;
+    int width = 0;    // size of the storage currently allocated for id
+    int height = 0;
+};
+
+// Texture of the camera session
+StreamTexture gCameraTexture;
 
-public:
-    EdgeDetector() {
-        LOGI("EdgeDetector created");
+/**
+ * Edge mask of a session frame, with the width of the frame it was detected in
+ */
+struct SessionResult {
+    cv::Mat mask;
+    int sourceWidth = 0;
+};
+
+/**
+ * Output of a session created through createSession(). Frames are processed on the
+ * caller's thread into the triple buffer; the GL thread picks up the newest one and
+ * draws it with the stream's own orientation.
+ */
+struct SessionStream {
+    std::mutex producerLock;          // one writer per triple buffer, whatever the caller
+    TripleBuffer<SessionResult> results;
+    StreamTexture texture;
+    std::atomic<int> rotation{0};     // set with setSessionOrientation()
+    std::atomic<bool> mirrored{false};
+};
+
+std::mutex gStreamsLock;
+std::unordered_map<SessionEngine::Handle, std::shared_ptr<SessionStream>> gStreams;
+
+// Textures of destroyed sessions, deleted by the next upload on the GL thread
+std::vector<GLuint> gRetiredTextures;
+
+/**
+ * Counters for the edge mask upload. Written on the GL thread, read from any thread
+ * through getUploadStats().
+ */
+struct UploadStats {
+    std::atomic<uint64_t> uploads{0};         // frames uploaded
+    std::atomic<uint64_t> totalBytes{0};      // bytes handed to glTexSubImage2D
+    std::atomic<uint64_t> lastFrameBytes{0};  // bytes of the most recent upload
+    std::atomic<uint64_t> totalNanos{0};      // CPU time spent in the upload calls
+    std::atomic<uint64_t> allocations{0};     // texture storage (re)allocations
+};
+
+UploadStats gUploadStats;
+
+/**
+ * Counters describing how camera frames entered the native pipeline.
+ * Written on the thread handing frames in, read from any thread through getIngestStats().
+ */
+struct IngestStats {
+    std::atomic<uint64_t> frames{0};          // camera frames handed in, by any entry point
+    std::atomic<uint64_t> zeroCopyFrames{0};  // frames edge-detected straight from the camera planes
+    std::atomic<uint64_t> copiedBytes{0};     // bytes copied or repacked before reaching the edge kernel
+    std::atomic<uint64_t> allocations{0};     // (re)allocations of input slots and chroma scratch
+};
+
+IngestStats gIngestStats;
+
+// Compact camera edge formats, as selected through setEdgeOutputFormat()
+enum EdgeOutputFormat {
+    EDGE_OUTPUT_OFF = -1,
+    EDGE_OUTPUT_PACKED = 0,
+    EDGE_OUTPUT_RUNS = 1,
+    EDGE_OUTPUT_POINTS = 2
+};
+
+/**
+ * A serialized output of the newest camera frame, read from any thread through its
+ * getter while enabled. Built on the one thread that publishes it (the thread that
+ * processed the frame for the session outputs, the GL thread for EdgeOutput) into a
+ * staging buffer that is swapped in, which keeps the capacity of both, so steady state
+ * never allocates.
+ */
+struct PublishedBlob {
+    std::atomic<bool> enabled{false};
+
+    std::vector<uint8_t> staging;     // publishing thread only
+    std::mutex lock;
+    std::vector<uint8_t> latest;      // serialized newest frame, under lock
+
+    // Serialize the newest frame with fill(out) while enabled; fill returns false if the
+    // frame has nothing to publish, keeping the previous output (publishing thread)
+    template <typename Fill>
+    void publish(Fill&& fill) {
+        if (!enabled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        staging.clear();
+        if (!fill(staging)) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        // Disabled meanwhile: clear() may already have run
+        if (enabled.load(std::memory_order_relaxed)) {
+            latest.swap(staging);
+        }
+    }
+
+    // Start or stop publishing; stopping drops the newest output
+    void setEnabled(bool on) {
+        enabled.store(on, std::memory_order_relaxed);
+        if (!on) {
+            clear();
+        }
+    }
+
+    // Drop the newest output
+    void clear() {
+        std::lock_guard<std::mutex> guard(lock);
+        latest.clear();
     }
 
-    ~EdgeDetector() {
-        LOGI("EdgeDetector destroyed");
+    // Copy the newest output into a new byte array, or null if there is none yet
+    jbyteArray toJava(JNIEnv* env) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (latest.empty()) {
+            return nullptr;
+        }
+        
+        jsize length = (jsize)latest.size();
+        jbyteArray result = env->NewByteArray(length);
+        if (result) {
+            env->SetByteArrayRegion(result, 0, length, (const jbyte*)latest.data());
+        }
+        return result;
+    }
+};
+
+/**
+ * The newest camera edge mask in a compact format, for consumers that do not need the
+ * texture. Encoded on the GL thread right before the upload, read from any thread
+ * through getEdgeOutput().
+ */
+struct EdgeOutput {
+    std::atomic<int> format{EDGE_OUTPUT_OFF};
+
+    // GL thread only
+    EdgeFormats formats;
+    PackedEdges packed;
+    EdgeRuns runs;
+    EdgePoints points;
+
+    PublishedBlob blob;
+};
+
+EdgeOutput gEdgeOutput;
+
+// What the camera session keeps of its newest frame besides the mask, while enabled:
+// polylines (setEdgeLinking, getContours), the threshold level map (setThresholdSweep,
+// getThresholdLevels), gradient planes and tile histograms (setGradientOutput,
+// getGradients) and the edge density grid (setEdgeDensity, getEdgeDensity)
+PublishedBlob gContourOutput;
+PublishedBlob gSweepOutput;
+PublishedBlob gGradientOutput;
+PublishedBlob gDensityOutput;
+
+// Copied out of the camera session to serialize them; processing thread only
+EdgeContours gContours;
+cv::Mat gThresholdLevels;
+ParallelCanny::Gradients gGradients;
+ParallelCanny::EdgeDensity gEdgeDensity;
+
+// Interleaved VU scratch, only used in RGBA mode for planar (pixel stride 1) chroma
+cv::Mat gChromaScratch;
+
+// Processing thread between the camera and the GL thread
+FramePipeline* gPipeline = nullptr;
+
+// Closing camera images whose planes the pipeline borrowed, from any thread
+JavaVM* gJavaVM = nullptr;
+jmethodID gCloseMethod = nullptr;     // AutoCloseable.close()
+pthread_key_t gDetachKey;             // detaches threads attached to close images
+
+// Records the camera frames processed on the pipeline thread, see startRecording()
+FrameRecorder gRecorder;
+
+// Streams the camera edge masks to web viewers, see startFrameServer()
+FrameServer gFrameServer;
+
+// Whether the camera session's next frame is processed from luma only. Only a read:
+// changes go through modifyParameters(), so no concurrent change is overwritten.
+static bool cameraLumaOnly() {
+    SessionEngine::Parameters parameters;
+    gEngine->getParameters(gCameraSession, parameters);
+    return parameters.lumaOnly;
+}
+
+// Append raw values to a serialized edge output
+template <typename T>
+static void appendValues(std::vector<uint8_t>& out, const T* values, size_t count) {
+    size_t offset = out.size();
+    out.resize(offset + count * sizeof(T));
+    if (count > 0) {
+        memcpy(&out[offset], values, count * sizeof(T));
     }
+}
 
-    // Processes the input frame with Canny edge detection
-    cv::Mat processFrame(const cv::Mat& inputFrame) {
-        // Convert input frame to grayscale
-        cv::cvtColor(inputFrame, grayMat, cv::COLOR_RGBA2GRAY);
+// Serialize the polylines of the camera session's newest mask and publish them. The
+// layout is four int32 (width, height, contour count, point count) followed by
+// contour count + 1 uint32 point starts and (x, y) uint16 pairs, all little-endian.
+static void publishContours() {
+    gContourOutput.publish([](std::vector<uint8_t>& out) {
+        EdgeContours& contours = gContours;
+        gEngine->contours(gCameraSession, contours);
         
-        // Apply Gaussian blur to reduce noise
-        cv::GaussianBlur(grayMat, grayMat, cv::Size(5, 5), 1.5, 1.5);
+        int32_t header[4] = {contours.width, contours.height, (int32_t)contours.contourCount(),
+                             (int32_t)contours.pointCount()};
+        appendValues(out, header, 4);
+        appendValues(out, contours.start.data(), contours.start.size());
+        appendValues(out, contours.xy.data(), contours.xy.size());
+        return true;
+    });
+}
+
+// Serialize the threshold level map of the camera session's newest frame and publish
+// it. The layout is three int32 (width, height, pair count) followed by one byte per
+// pixel, row by row.
+static void publishThresholdLevels() {
+    gSweepOutput.publish([](std::vector<uint8_t>& out) {
+        cv::Mat& levels = gThresholdLevels;
+        gEngine->thresholdLevels(gCameraSession, levels);
+        if (levels.empty()) {
+            // Region or incremental frames have no level map
+            return false;
+        }
         
-        // Apply Canny edge detection
-        cv::Canny(grayMat, edgeMat, lowThreshold, lowThreshold * ratio, kernelSize);
+        SessionEngine::Parameters applied;
+        gEngine->appliedParameters(gCameraSession, applied);
         
-        // Convert back to RGBA format for OpenGL rendering
-        cv::cvtColor(edgeMat, edgeMat, cv::COLOR_GRAY2RGBA);
+        int32_t header[3] = {levels.cols, levels.rows, applied.sweepCount};
+        appendValues(out, header, 3);
+        for (int y = 0; y < levels.rows; y++) {
+            appendValues(out, levels.ptr<uint8_t>(y), (size_t)levels.cols);
+        }
+        return true;
+    });
+}
+
+// Serialize the gradient planes and tile histograms of the camera session's newest
+// frame and publish them. The layout is six int32 (width, height, tile size, tile
+// columns, tile rows, bin count) followed by the int16 magnitudes and the uint8
+// orientation bins row by row, then the int32 histograms of the tiles in raster order
+// with bin count sums each, all little-endian.
+static void publishGradients() {
+    gGradientOutput.publish([](std::vector<uint8_t>& out) {
+        ParallelCanny::Gradients& gradients = gGradients;
+        gEngine->gradients(gCameraSession, gradients);
+        if (gradients.magnitude.empty()) {
+            // Region or incremental frames have no gradient planes
+            return false;
+        }
         
-        return edgeMat;
+        const cv::Mat& magnitude = gradients.magnitude;
+        const cv::Mat& orientation = gradients.orientation;
+        const cv::Mat& histograms = gradients.histograms;
+        int32_t header[6] = {magnitude.cols, magnitude.rows, gradients.tileSize,
+                             histograms.cols / ParallelCanny::kOrientationBins, histograms.rows,
+                             ParallelCanny::kOrientationBins};
+        appendValues(out, header, 6);
+        for (int y = 0; y < magnitude.rows; y++) {
+            appendValues(out, magnitude.ptr<int16_t>(y), (size_t)magnitude.cols);
+        }
+        for (int y = 0; y < orientation.rows; y++) {
+            appendValues(out, orientation.ptr<uint8_t>(y), (size_t)orientation.cols);
+        }
+        for (int y = 0; y < histograms.rows; y++) {
+            appendValues(out, histograms.ptr<int32_t>(y), (size_t)histograms.cols);
+        }
+        return true;
+    });
+}
+
+// Serialize the edge density grid of the camera session's newest frame and publish it.
+// The layout is three int32 (tile size, tile columns, tile rows) followed by the int32
+// edge pixel count of every tile in raster order, then the float32 mean gradient
+// magnitude of those pixels per tile, all little-endian.
+static void publishEdgeDensity() {
+    gDensityOutput.publish([](std::vector<uint8_t>& out) {
+        ParallelCanny::EdgeDensity& density = gEdgeDensity;
+        gEngine->edgeDensity(gCameraSession, density);
+        if (density.counts.empty()) {
+            // Region or incremental frames have no density grid
+            return false;
+        }
+        
+        int32_t header[3] = {density.tileSize, density.counts.cols, density.counts.rows};
+        appendValues(out, header, 3);
+        for (int y = 0; y < density.counts.rows; y++) {
+            appendValues(out, density.counts.ptr<int32_t>(y), (size_t)density.counts.cols);
+        }
+        for (int y = 0; y < density.strength.rows; y++) {
+            appendValues(out, density.strength.ptr<float>(y), (size_t)density.strength.cols);
+        }
+        return true;
+    });
+}
+
+// Publish the frame the camera session just processed: what the session keeps of it
+// besides the mask, the mask to connected viewers, and input and mask to a recording in
+// progress. Every path that processes camera frames calls this once per frame, input
+// being the NV21 frame (height * 3 / 2 rows) or its Y plane (height rows).
+static void publishFrameOutputs(const cv::Mat& input, int height, const cv::Mat& mask) {
+    publishContours();
+    publishThresholdLevels();
+    publishGradients();
+    publishEdgeDensity();
+    
+    // Only packs the mask while a viewer is connected
+    gFrameServer.publish(mask);
+    
+    if (gRecorder.isRecording()) {
+        SessionEngine::Parameters parameters;
+        gEngine->appliedParameters(gCameraSession, parameters);
+        int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        gRecorder.record(input, height, mask, now, parameters);
+    }
+}
+
+// Lay out the chroma planes of a YUV_420_888 frame as one two channel plane: a view of
+// them when they interleave in one allocation (pixel stride 2), otherwise a copy
+// interleaved as VU into scratch. Returns true if chroma is ordered U, V.
+static bool interleaveChroma(const uint8_t* uData, const uint8_t* vData, int rowStride,
+                             int pixelStride, int width, int height, cv::Mat& scratch,
+                             cv::Mat& chroma) {
+    if (pixelStride == 2 && (vData + 1 == uData || uData + 1 == vData)) {
+        bool vuOrder = vData + 1 == uData;
+        chroma = cv::Mat(height, width, CV_8UC2, const_cast<uint8_t*>(vuOrder ? vData : uData),
+                         rowStride);
+        return !vuOrder;
     }
     
-    // Update the edge detection parameters
-    void updateParameters(int low, int highRatio, int kernel) {
-        lowThreshold = low;
-        ratio = highRatio;
-        kernelSize = kernel;
+    // Planar chroma: OpenCV has no three-plane conversion
+    if (scratch.rows != height || scratch.cols != width) {
+        BufferPool::shared().attach(scratch);
+        scratch.create(height, width, CV_8UC2);
+        gIngestStats.allocations.fetch_add(1, std::memory_order_relaxed);
     }
-};
+    for (int row = 0; row < height; row++) {
+        const uint8_t* uRow = uData + (size_t)row * rowStride;
+        const uint8_t* vRow = vData + (size_t)row * rowStride;
+        uint8_t* vuRow = scratch.ptr<uint8_t>(row);
+        for (int col = 0; col < width; col++) {
+            vuRow[2 * col] = vRow[col * pixelStride];
+            vuRow[2 * col + 1] = uRow[col * pixelStride];
+        }
+    }
+    gIngestStats.copiedBytes.fetch_add((uint64_t)scratch.total() * 2, std::memory_order_relaxed);
+    chroma = scratch;
+    return false;
+}
+
+// Edge-detect the camera session's frame from its Y plane and interleaved chroma
+// (empty in luma-only mode)
+static void detectPlanes(const cv::Mat& luma, const cv::Mat& chroma, bool chromaUv,
+                         cv::Mat& mask) {
+    if (chroma.empty()) {
+        gEngine->process(gCameraSession, luma, mask);
+        return;
+    }
+    
+    cv::Mat rgbaMat;
+    BufferPool::shared().attach(rgbaMat);
+    {
+        EDGE_STAGE_TIMER(Stage::YuvToRgba);
+        cv::cvtColorTwoPlane(luma, chroma, rgbaMat,
+                             chromaUv ? cv::COLOR_YUV2RGBA_NV12 : cv::COLOR_YUV2RGBA_NV21);
+    }
+    gEngine->processRgba(gCameraSession, rgbaMat, mask);
+}
+
+// Detach a thread attached by closeCameraImage() when it exits
+static void detachThread(void*) {
+    gJavaVM->DetachCurrentThread();
+}
+
+// Runs on the pipeline or camera thread: close the camera image a pipeline frame
+// borrowed its planes from, once they are processed or the frame was dropped
+static void closeCameraImage(void* owner) {
+    JNIEnv* env = nullptr;
+    if (gJavaVM->GetEnv((void**)&env, JNI_VERSION_1_6) != JNI_OK) {
+        if (gJavaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+            LOGE("Cannot attach thread to close a camera image");
+            return;
+        }
+        pthread_setspecific(gDetachKey, env);
+    }
+    
+    jobject image = (jobject)owner;
+    env->CallVoidMethod(image, gCloseMethod);
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        LOGE("Closing a camera image failed");
+    }
+    env->DeleteGlobalRef(image);
+}
+
+// Runs on the pipeline thread: edge-detect one queued frame into its result mask
+static void processQueuedFrame(const FramePipeline::InputFrame& frame, cv::Mat& mask) {
+    EDGE_STAGE_TIMER(Stage::Frame);
+    
+    if (frame.owner) {
+        // Planes borrowed from the camera image, closed once this returns
+        detectPlanes(frame.luma, frame.chroma, frame.chromaUv, mask);
+        publishFrameOutputs(frame.luma, frame.height, mask);
+        return;
+    }
+    
+    if (!frame.hasChroma) {
+        gEngine->process(gCameraSession, frame.yuv, mask);
+    } else {
+        // The session converts to RGBA itself, only inside its regions of interest if it has any
+        gEngine->processNv21(gCameraSession, frame.yuv, mask);
+    }
+    
+    publishFrameOutputs(frame.yuv, frame.height, mask);
+}
+
+// Look up the output of a session created through createSession()
+static std::shared_ptr<SessionStream> findStream(jlong handle) {
+    std::lock_guard<std::mutex> guard(gStreamsLock);
+    auto found = gStreams.find(static_cast<SessionEngine::Handle>(handle));
+    return found == gStreams.end() ? nullptr : found->second;
+}
+
+// Generate a texture configured for edge masks; storage is allocated by the first upload
+static GLuint createEdgeTexture() {
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    
+    glBindTexture(GL_TEXTURE_2D, id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return id;
+}
 
-// Global pointer to our edge detector
-EdgeDetector* gEdgeDetector = nullptr;
+// Runs on the GL thread: delete the textures of destroyed sessions
+static void deleteRetiredTextures() {
+    std::vector<GLuint> retired;
+    {
+        std::lock_guard<std::mutex> guard(gStreamsLock);
+        retired.swap(gRetiredTextures);
+    }
+    if (!retired.empty()) {
+        glDeleteTextures((GLsizei)retired.size(), retired.data());
+        for (GLuint id : retired) {
+            forgetMaskLayout(id);
+        }
+    }
+}
 
-// Texture ID for OpenGL
-GLuint gTextureId = 0;
+// Describe the camera frame going into the next pipeline input slot
+static FramePipeline::InputFrame& nextInput(int width, int height, int rotation,
+                                            bool withChroma) {
+    FramePipeline::InputFrame& frame = gPipeline->inputBuffer();
+    frame.width = width;
+    frame.height = height;
+    frame.rotation = rotation;
+    frame.hasChroma = withChroma;
+    
+    // Frames without a camera timestamp (beginCameraFrame) are identified by their arrival
+    uint64_t timestamp = FrameTrace::currentFrame();
+    frame.timestampNanos = timestamp != 0 ? (int64_t)timestamp : FrameTrace::nowNanos();
+    return frame;
+}
+
+// Make the next pipeline input slot hold a copied frame of the given size, in NV21
+// layout when chroma is needed. Slots keep their storage, so this only allocates on a
+// size or mode change.
+static FramePipeline::InputFrame& prepareInput(int width, int height, int rotation,
+                                               bool withChroma) {
+    FramePipeline::InputFrame& frame = nextInput(width, height, rotation, withChroma);
+    int rows = withChroma ? height + height / 2 : height;
+    if (frame.yuv.rows != rows || frame.yuv.cols != width) {
+        BufferPool::shared().attach(frame.yuv);
+        frame.yuv.create(rows, width, CV_8UC1);
+        gIngestStats.allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    return frame;
+}
+
+// Upload an edge mask (CV_8UC1) into a stream's texture and return its ID.
+// The texture is single channel (GL_LUMINANCE), its storage is only allocated when the
+// frame size changes and every frame streams into it with glTexSubImage2D.
+static jint uploadFrame(StreamTexture& texture, const cv::Mat& edgeMask) {
+    EDGE_STAGE_TIMER(Stage::Upload);
+    auto start = std::chrono::steady_clock::now();
+    
+    glBindTexture(GL_TEXTURE_2D, texture.id);
+    
+    // Mask rows are tightly packed, whatever their width
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    
+    if (edgeMask.cols != texture.width || edgeMask.rows != texture.height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, edgeMask.cols, edgeMask.rows, 0,
+                    GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+        texture.width = edgeMask.cols;
+        texture.height = edgeMask.rows;
+        gUploadStats.allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, edgeMask.cols, edgeMask.rows,
+                    GL_LUMINANCE, GL_UNSIGNED_BYTE, edgeMask.data);
+    
+    uint64_t bytes = (uint64_t)edgeMask.cols * edgeMask.rows;
+    uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    gUploadStats.uploads.fetch_add(1, std::memory_order_relaxed);
+    gUploadStats.totalBytes.fetch_add(bytes, std::memory_order_relaxed);
+    gUploadStats.lastFrameBytes.store(bytes, std::memory_order_relaxed);
+    gUploadStats.totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+    
+    return texture.id;
+}
+
+// Map an engine ID from Java (0 = OpenCV, 1 = strip-parallel, 2 = fused) to the enum
+static EdgeDetector::Engine toEngine(jint engine) {
+    switch (engine) {
+        case EdgeDetector::ENGINE_OPENCV:
+            return EdgeDetector::ENGINE_OPENCV;
+        case EdgeDetector::ENGINE_FUSED:
+            return EdgeDetector::ENGINE_FUSED;
+        default:
+            return EdgeDetector::ENGINE_PARALLEL;
+    }
+}
+
+// Encode a camera edge mask in the selected compact format and publish it. The layout
+// is four int32 (format, width, height, element count) followed by the payload, all
+// little-endian: packed rows of (width + 7) / 8 bytes, or height + 1 uint32 run starts
+// and (x, length) uint16 pairs, or (x, y) uint16 pairs.
+static void encodeEdgeOutput(const cv::Mat& edgeMask) {
+    gEdgeOutput.blob.publish([&](std::vector<uint8_t>& out) {
+        int format = gEdgeOutput.format.load(std::memory_order_relaxed);
+        int32_t header[4] = {format, edgeMask.cols, edgeMask.rows, 0};
+        appendValues(out, header, 4);
+        
+        switch (format) {
+            case EDGE_OUTPUT_PACKED:
+                gEdgeOutput.formats.pack(edgeMask, gEdgeOutput.packed);
+                header[3] = (int32_t)gEdgeOutput.packed.bytes();
+                appendValues(out, gEdgeOutput.packed.bits.data(), gEdgeOutput.packed.bytes());
+                break;
+            case EDGE_OUTPUT_RUNS:
+                gEdgeOutput.formats.encodeRuns(edgeMask, gEdgeOutput.runs);
+                header[3] = (int32_t)gEdgeOutput.runs.runCount();
+                appendValues(out, gEdgeOutput.runs.rowStart.data(), gEdgeOutput.runs.rowStart.size());
+                appendValues(out, gEdgeOutput.runs.runs.data(), gEdgeOutput.runs.runs.size());
+                break;
+            default:
+                gEdgeOutput.formats.listPoints(edgeMask, gEdgeOutput.points);
+                header[3] = (int32_t)gEdgeOutput.points.count();
+                appendValues(out, gEdgeOutput.points.xy.data(), gEdgeOutput.points.xy.size());
+                break;
+        }
+        memcpy(&out[3 * sizeof(int32_t)], &header[3], sizeof(int32_t));
+        return true;
+    });
+}
+
+// Layout an edge mask is drawn with: how much smaller than its frame it is, when the
+// governor processed a coarser pyramid level, and how to rotate and mirror it
+static MaskLayout maskLayout(const cv::Mat& edgeMask, int frameWidth, int rotation, bool mirror) {
+    MaskLayout layout;
+    layout.width = edgeMask.cols;
+    layout.height = edgeMask.rows;
+    layout.rotation = rotation;
+    layout.mirror = mirror;
+    layout.scale = edgeMask.cols > 0 && frameWidth > edgeMask.cols
+                   ? (float)frameWidth / edgeMask.cols : 1.0f;
+    return layout;
+}
+
+// Upload an edge mask of the camera session and tell the renderer how to draw it
+static jint uploadCameraFrame(const cv::Mat& edgeMask, int frameWidth, int rotation) {
+    encodeEdgeOutput(edgeMask);
+    jint id = uploadFrame(gCameraTexture, edgeMask);
+    setMaskLayout(gCameraTexture.id,
+                  maskLayout(edgeMask, frameWidth, rotation, isPreviewMirrored()));
+    return id;
+}
+
+// Stage x, y, width, height quadruples as the regions of interest of a session
+static bool setRegions(JNIEnv* env, SessionEngine::Handle handle, jintArray rects) {
+    jsize length = rects ? env->GetArrayLength(rects) : 0;
+    int count = length / 4;
+    if (length % 4 != 0 || count > SessionEngine::Parameters::kMaxRegions) {
+        LOGE("Regions must be at most %d x, y, width, height quadruples",
+             SessionEngine::Parameters::kMaxRegions);
+        return false;
+    }
+    
+    jint values[4 * SessionEngine::Parameters::kMaxRegions];
+    cv::Rect regions[SessionEngine::Parameters::kMaxRegions];
+    if (count > 0) {
+        env->GetIntArrayRegion(rects, 0, length, values);
+    }
+    for (int i = 0; i < count; i++) {
+        regions[i] = cv::Rect(values[4 * i], values[4 * i + 1], values[4 * i + 2], values[4 * i + 3]);
+    }
+    return gEngine->setRegions(handle, regions, count);
+}
+
+// Check that a direct buffer holds rows x cols samples laid out with the given strides
+static bool planeFits(jlong capacity, int rows, int cols, int rowStride, int pixelStride) {
+    if (capacity < 0 || rows <= 0 || cols <= 0) {
+        return false;
+    }
+    int64_t needed = (int64_t)(rows - 1) * rowStride + (int64_t)(cols - 1) * pixelStride + 1;
+    return needed <= capacity;
+}
 
 extern "C" {
 
 // Initialize native resources
 JNIEXPORT void JNICALL
 Java_com_example_edgedetection_NativeWrapper_initNative(JNIEnv* env, jobject thiz) {
-    if (!gEdgeDetector) {
-        gEdgeDetector = new EdgeDetector();
+    if (!gEngine) {
+        setLogSink(androidLogSink);
+        gEngine = new SessionEngine();
+        gCameraSession = gEngine->create();
+        BufferPool::shared().attach(gChromaScratch);
+        
+        env->GetJavaVM(&gJavaVM);
+        pthread_key_create(&gDetachKey, detachThread);
+        jclass closeable = env->FindClass("java/lang/AutoCloseable");
+        gCloseMethod = env->GetMethodID(closeable, "close", "()V");
+        env->DeleteLocalRef(closeable);
+        
+        gPipeline = new FramePipeline(processQueuedFrame, closeCameraImage);
+        gPipeline->start();
         LOGI("Native resources initialized");
     }
 }
@@ -78,7 +696,7 @@ JNIEXPORT jint JNICALL
 Java_com_example_edgedetection_NativeWrapper_processFrame(JNIEnv* env, jobject thiz,
                                                       jbyteArray input, jint width, jint height,
                                                       jint rotation) {
-    if (!gEdgeDetector) {
+    if (!gEngine) {
         LOGE("Edge detector not initialized");
         return -1;
     }
@@ -91,43 +709,754 @@ Java_com_example_edgedetection_NativeWrapper_processFrame(JNIEnv* env, jobject t
         return -1;
     }
     
-    // Create an OpenCV Mat from the input byte array
-    cv::Mat inputMat(height + height/2, width, CV_8UC1, inputBuffer);
-    
-    // Convert YUV to RGBA
-    cv::Mat rgbaMat;
-    cv::cvtColor(inputMat, rgbaMat, cv::COLOR_YUV2RGBA_NV21);
+    cv::Mat processedFrame;
+    BufferPool::shared().attach(processedFrame);
     
-    // Process the frame using our edge detector
-    cv::Mat processedFrame = gEdgeDetector->processFrame(rgbaMat);
+    if (cameraLumaOnly()) {
+        // The first width*height bytes of NV21 are the Y plane - use them as the gray image
+        cv::Mat lumaMat(height, width, CV_8UC1, inputBuffer);
+        gEngine->process(gCameraSession, lumaMat, processedFrame);
+        publishFrameOutputs(lumaMat, height, processedFrame);
+    } else {
+        // Create an OpenCV Mat from the input byte array
+        cv::Mat inputMat(height + height/2, width, CV_8UC1, inputBuffer);
+        
+        // Convert to RGBA (only the regions of interest, if set) and edge-detect
+        gEngine->processNv21(gCameraSession, inputMat, processedFrame);
+        publishFrameOutputs(inputMat, height, processedFrame);
+    }
     
-    // Release the byte array
-    env->ReleaseByteArrayElements(input, inputBuffer, 0);
+    // Release the byte array - it was only read, so skip the copy back into the Java array
+    env->ReleaseByteArrayElements(input, inputBuffer, JNI_ABORT);
     
     // Update the OpenGL texture with the processed frame
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, processedFrame.cols, processedFrame.rows, 0,
-                GL_RGBA, GL_UNSIGNED_BYTE, processedFrame.data);
+    return uploadCameraFrame(processedFrame, width, rotation);
+}
+
+// Process a camera frame straight from its YUV_420_888 plane buffers.
+// The planes must be direct ByteBuffers; they are wrapped as cv::Mat views using the
+// real row and pixel strides, so padded rows never need repacking.
+JNIEXPORT jint JNICALL
+Java_com_example_edgedetection_NativeWrapper_processFramePlanes(JNIEnv* env, jobject thiz,
+                                                            jobject yPlane, jobject uPlane,
+                                                            jobject vPlane, jint yRowStride,
+                                                            jint uvRowStride, jint uvPixelStride,
+                                                            jint width, jint height,
+                                                            jint rotation) {
+    if (!gEngine) {
+        LOGE("Edge detector not initialized");
+        return -1;
+    }
+    
+    // Non-direct buffers have no stable address, the caller falls back to processFrame
+    uint8_t* yData = static_cast<uint8_t*>(env->GetDirectBufferAddress(yPlane));
+    if (!yData || !planeFits(env->GetDirectBufferCapacity(yPlane), height, width, yRowStride, 1)) {
+        LOGE("Y plane is not a direct buffer of the expected size");
+        return -1;
+    }
+    
+    gIngestStats.frames.fetch_add(1, std::memory_order_relaxed);
+    
+    cv::Mat yMat(height, width, CV_8UC1, yData, yRowStride);
+    cv::Mat chroma;
+    bool chromaUv = false;
+    
+    // Chroma is never touched in luma-only mode
+    if (!cameraLumaOnly()) {
+        uint8_t* uData = static_cast<uint8_t*>(env->GetDirectBufferAddress(uPlane));
+        uint8_t* vData = static_cast<uint8_t*>(env->GetDirectBufferAddress(vPlane));
+        int chromaWidth = width / 2;
+        int chromaHeight = height / 2;
+        if (!uData || !vData ||
+            !planeFits(env->GetDirectBufferCapacity(uPlane), chromaHeight, chromaWidth,
+                       uvRowStride, uvPixelStride) ||
+            !planeFits(env->GetDirectBufferCapacity(vPlane), chromaHeight, chromaWidth,
+                       uvRowStride, uvPixelStride)) {
+            LOGE("Chroma planes are not direct buffers of the expected size");
+            return -1;
+        }
+        chromaUv = interleaveChroma(uData, vData, uvRowStride, uvPixelStride, chromaWidth,
+                                    chromaHeight, gChromaScratch, chroma);
+    }
+    bool copied = !chroma.empty() && chroma.data == gChromaScratch.data;
+    if (!copied) {
+        gIngestStats.zeroCopyFrames.fetch_add(1, std::memory_order_relaxed);
+    }
     
-    return gTextureId;
+    cv::Mat processedFrame;
+    BufferPool::shared().attach(processedFrame);
+    detectPlanes(yMat, chroma, chromaUv, processedFrame);
+    // The chroma planes are separate buffers, recordings keep the Y plane of these frames
+    publishFrameOutputs(yMat, height, processedFrame);
+    return uploadCameraFrame(processedFrame, width, rotation);
+}
+
+// Queue a camera frame for the processing thread straight from its YUV_420_888 planes.
+// The pipeline's input slot borrows views of the planes instead of copying them (only
+// planar chroma is interleaved into the slot) and keeps the camera image until the
+// processing thread is done with it, or a newer frame replaces it, then closes it.
+// Returns false, leaving the image to the caller, if the planes are not direct buffers
+// of the expected size and the frame has to go through submitFrame.
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_submitFramePlanes(JNIEnv* env, jobject thiz,
+                                                           jobject image, jobject yPlane,
+                                                           jobject uPlane, jobject vPlane,
+                                                           jint yRowStride, jint uvRowStride,
+                                                           jint uvPixelStride, jint width,
+                                                           jint height, jint rotation) {
+    if (!gEngine || !gPipeline) {
+        LOGE("Edge detector not initialized");
+        return JNI_FALSE;
+    }
+    
+    const uint8_t* yData = static_cast<const uint8_t*>(env->GetDirectBufferAddress(yPlane));
+    if (!yData || !planeFits(env->GetDirectBufferCapacity(yPlane), height, width, yRowStride, 1)) {
+        return JNI_FALSE;
+    }
+    
+    bool withChroma = !cameraLumaOnly();
+    const uint8_t* uData = nullptr;
+    const uint8_t* vData = nullptr;
+    int chromaWidth = width / 2;
+    int chromaHeight = height / 2;
+    if (withChroma) {
+        uData = static_cast<const uint8_t*>(env->GetDirectBufferAddress(uPlane));
+        vData = static_cast<const uint8_t*>(env->GetDirectBufferAddress(vPlane));
+        if (!uData || !vData ||
+            !planeFits(env->GetDirectBufferCapacity(uPlane), chromaHeight, chromaWidth,
+                       uvRowStride, uvPixelStride) ||
+            !planeFits(env->GetDirectBufferCapacity(vPlane), chromaHeight, chromaWidth,
+                       uvRowStride, uvPixelStride)) {
+            return JNI_FALSE;
+        }
+    }
+    
+    EDGE_STAGE_TIMER(Stage::Ingest);
+    gIngestStats.frames.fetch_add(1, std::memory_order_relaxed);
+    FramePipeline::InputFrame& frame = nextInput(width, height, rotation, withChroma);
+    
+    frame.luma = cv::Mat(height, width, CV_8UC1, const_cast<uint8_t*>(yData), yRowStride);
+    frame.chroma.release();
+    frame.chromaUv = false;
+    bool copied = false;
+    if (withChroma) {
+        frame.chromaUv = interleaveChroma(uData, vData, uvRowStride, uvPixelStride, chromaWidth,
+                                          chromaHeight, frame.chromaCopy, frame.chroma);
+        copied = frame.chroma.data == frame.chromaCopy.data;
+    }
+    if (!copied) {
+        gIngestStats.zeroCopyFrames.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    // Closed by closeCameraImage() once the pipeline is done with the planes
+    frame.owner = env->NewGlobalRef(image);
+    gPipeline->submit();
+    return JNI_TRUE;
+}
+
+// Queue an NV21 frame for the processing thread. The frame is copied, so the array is
+// free for reuse as soon as this returns.
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_submitFrame(JNIEnv* env, jobject thiz,
+                                                     jbyteArray input, jint width, jint height,
+                                                     jint rotation) {
+    if (!gEngine || !gPipeline) {
+        LOGE("Edge detector not initialized");
+        return JNI_FALSE;
+    }
+    
+    bool withChroma = !cameraLumaOnly();
+    int rows = withChroma ? height + height / 2 : height;
+    if (env->GetArrayLength(input) < (jsize)rows * width) {
+        LOGE("NV21 array is smaller than a %dx%d frame", width, height);
+        return JNI_FALSE;
+    }
+    
+    EDGE_STAGE_TIMER(Stage::Ingest);
+    gIngestStats.frames.fetch_add(1, std::memory_order_relaxed);
+    FramePipeline::InputFrame& frame = prepareInput(width, height, rotation, withChroma);
+    
+    // NV21 is the slot layout already, one region copy fills it
+    env->GetByteArrayRegion(input, 0, rows * width, reinterpret_cast<jbyte*>(frame.yuv.data));
+    gIngestStats.copiedBytes.fetch_add((uint64_t)rows * width, std::memory_order_relaxed);
+    
+    gPipeline->submit();
+    return JNI_TRUE;
+}
+
+// Runs on the GL thread: upload the newest edge mask if the processing thread finished
+// one since the last call. Never waits for processing; returns the texture ID either way.
+JNIEXPORT jint JNICALL
+Java_com_example_edgedetection_NativeWrapper_uploadLatestFrame(JNIEnv* env, jobject thiz) {
+    if (!gPipeline) {
+        return gCameraTexture.id;
+    }
+    
+    const FramePipeline::ResultFrame* result = gPipeline->acquireResult();
+    if (result && !result->mask.empty()) {
+        return uploadCameraFrame(result->mask, result->sourceWidth, result->rotation);
+    }
+    return gCameraTexture.id;
+}
+
+// Create an edge detection session for one more stream, with default parameters.
+// Returns its handle, or 0 if the native side is not initialized.
+JNIEXPORT jlong JNICALL
+Java_com_example_edgedetection_NativeWrapper_createSession(JNIEnv* env, jobject thiz) {
+    if (!gEngine) {
+        LOGE("Edge detector not initialized");
+        return 0;
+    }
+    
+    SessionEngine::Handle handle = gEngine->create();
+    {
+        std::lock_guard<std::mutex> guard(gStreamsLock);
+        gStreams.emplace(handle, std::make_shared<SessionStream>());
+    }
+    LOGI("Created session %llu", (unsigned long long)handle);
+    return (jlong)handle;
+}
+
+// Destroy a session. Its texture is deleted by the next upload on the GL thread.
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_destroySession(JNIEnv* env, jobject thiz,
+                                                        jlong handle) {
+    if (!gEngine || !gEngine->destroy(static_cast<SessionEngine::Handle>(handle))) {
+        return;
+    }
+    
+    std::lock_guard<std::mutex> guard(gStreamsLock);
+    auto found = gStreams.find(static_cast<SessionEngine::Handle>(handle));
+    if (found != gStreams.end()) {
+        if (found->second->texture.id != 0) {
+            gRetiredTextures.push_back(found->second->texture.id);
+        }
+        gStreams.erase(found);
+    }
+}
+
+// Edge-detect an NV21 frame of a session on the calling thread. Sessions process in
+// parallel on the shared pool; the result waits for uploadSession on the GL thread.
+// Returns false if the handle is unknown or the array is too small.
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_processSession(JNIEnv* env, jobject thiz,
+                                                        jlong handle, jbyteArray input,
+                                                        jint width, jint height) {
+    std::shared_ptr<SessionStream> stream = findStream(handle);
+    if (!gEngine || !stream) {
+        return JNI_FALSE;
+    }
+    if (env->GetArrayLength(input) < (jsize)(height + height / 2) * width) {
+        LOGE("NV21 array is smaller than a %dx%d frame", width, height);
+        return JNI_FALSE;
+    }
+    
+    jbyte* inputBuffer = env->GetByteArrayElements(input, NULL);
+    if (!inputBuffer) {
+        LOGE("Failed to get byte array elements");
+        return JNI_FALSE;
+    }
+    
+    bool processed;
+    {
+        std::lock_guard<std::mutex> guard(stream->producerLock);
+        cv::Mat nv21(height + height / 2, width, CV_8UC1, inputBuffer);
+        SessionResult& result = stream->results.writeBuffer();
+        BufferPool::shared().attach(result.mask);
+        processed = gEngine->processNv21(static_cast<SessionEngine::Handle>(handle), nv21,
+                                         result.mask);
+        if (processed) {
+            result.sourceWidth = width;
+            stream->results.publish();
+        }
+    }
+    
+    env->ReleaseByteArrayElements(input, inputBuffer, JNI_ABORT);
+    return processed ? JNI_TRUE : JNI_FALSE;
+}
+
+// Runs on the GL thread: upload the newest edge mask of a session into its own texture,
+// created on first use, and tell the renderer to draw it with the session's orientation.
+// Returns the texture ID, 0 before the first frame or for an unknown handle.
+JNIEXPORT jint JNICALL
+Java_com_example_edgedetection_NativeWrapper_uploadSession(JNIEnv* env, jobject thiz,
+                                                       jlong handle) {
+    deleteRetiredTextures();
+    
+    std::shared_ptr<SessionStream> stream = findStream(handle);
+    if (!stream) {
+        return 0;
+    }
+    
+    if (stream->results.acquire() && !stream->results.readBuffer().mask.empty()) {
+        if (stream->texture.id == 0) {
+            stream->texture.id = createEdgeTexture();
+        }
+        uploadFrame(stream->texture, stream->results.readBuffer().mask);
+    }
+    
+    // Every call, so that orientation changes apply before the session's next frame
+    if (stream->texture.id != 0) {
+        const SessionResult& result = stream->results.readBuffer();
+        setMaskLayout(stream->texture.id,
+                      maskLayout(result.mask, result.sourceWidth,
+                                 stream->rotation.load(std::memory_order_relaxed),
+                                 stream->mirrored.load(std::memory_order_relaxed)));
+    }
+    return stream->texture.id;
+}
+
+// Set how a session's frames are drawn: the clockwise rotation that turns them upright
+// and whether to mirror them. Returns false if the handle is unknown.
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_setSessionOrientation(JNIEnv* env, jobject thiz,
+                                                               jlong handle, jint rotation,
+                                                               jboolean mirrored) {
+    std::shared_ptr<SessionStream> stream = findStream(handle);
+    if (!stream) {
+        return JNI_FALSE;
+    }
+    stream->rotation.store(rotation, std::memory_order_relaxed);
+    stream->mirrored.store(mirrored == JNI_TRUE, std::memory_order_relaxed);
+    return JNI_TRUE;
+}
+
+// Update the parameters of a session; they apply from its next frame on
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_updateSessionParameters(JNIEnv* env, jobject thiz,
+                                                                 jlong handle,
+                                                                 jint lowThreshold, jint ratio,
+                                                                 jint kernelSize,
+                                                                 jboolean lumaOnly,
+                                                                 jint engine) {
+    if (!gEngine || !findStream(handle)) {
+        return JNI_FALSE;
+    }
+    
+    // Edits the staged parameters in place, so regions, sweeps or linking changed
+    // meanwhile from another thread are kept
+    EdgeDetector::Engine detectorEngine = toEngine(engine);
+    bool staged = gEngine->modifyParameters(static_cast<SessionEngine::Handle>(handle),
+                                            [=](SessionEngine::Parameters& parameters) {
+        parameters.lowThreshold = lowThreshold;
+        parameters.ratio = ratio;
+        parameters.kernelSize = kernelSize;
+        parameters.lumaOnly = lumaOnly == JNI_TRUE;
+        parameters.engine = detectorEngine;
+    });
+    return staged ? JNI_TRUE : JNI_FALSE;
+}
+
+// Restrict a session to regions of interest, given as x, y, width, height quadruples in
+// frame coordinates; an empty array goes back to full frames. Only the regions plus the
+// filter halo are processed, the rest of the edge mask stays clear.
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_setSessionRegions(JNIEnv* env, jobject thiz,
+                                                           jlong handle, jintArray rects) {
+    if (!gEngine || !findStream(handle)) {
+        return JNI_FALSE;
+    }
+    return setRegions(env, static_cast<SessionEngine::Handle>(handle), rects) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Read the processing thread counters: submitted, dropped before processing, processed,
+// dropped before display, displayed
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getPipelineStats(JNIEnv* env, jobject thiz) {
+    FramePipeline::Stats stats = {};
+    if (gPipeline) {
+        stats = gPipeline->stats();
+    }
+    
+    jlong values[5] = {
+        (jlong)stats.submitted,
+        (jlong)stats.droppedInputs,
+        (jlong)stats.processed,
+        (jlong)stats.droppedResults,
+        (jlong)stats.displayed
+    };
+    
+    jlongArray result = env->NewLongArray(5);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 5, values);
+    }
+    return result;
+}
+
+// Read the per-stage latency summaries: [count, p50, p95, p99, max] in nanoseconds for
+// every stage in Stage order, followed by the cost of one timed scope in nanoseconds.
+// All zero when the native library is built with EDGE_ENABLE_STATS=0.
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getStats(JNIEnv* env, jobject thiz) {
+    constexpr int kStageValues = StageStats::kSummaryFields * static_cast<int>(Stage::Count);
+    jlong values[kStageValues + 1];
+    
+    int64_t summaries[kStageValues];
+    StageStats::global().flatten(summaries);
+    for (int i = 0; i < kStageValues; i++) {
+        values[i] = (jlong)summaries[i];
+    }
+    values[kStageValues] = (jlong)StageStats::timerOverheadNanos();
+    
+    jlongArray result = env->NewLongArray(kStageValues + 1);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, kStageValues + 1, values);
+    }
+    return result;
+}
+
+// Forget all recorded stage latencies
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_resetStats(JNIEnv* env, jobject thiz) {
+    StageStats::global().reset();
+}
+
+// Read the frame ingestion counters: frames, zero-copy frames, copied bytes, allocations
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getIngestStats(JNIEnv* env, jobject thiz) {
+    jlong values[4] = {
+        (jlong)gIngestStats.frames.load(std::memory_order_relaxed),
+        (jlong)gIngestStats.zeroCopyFrames.load(std::memory_order_relaxed),
+        (jlong)gIngestStats.copiedBytes.load(std::memory_order_relaxed),
+        (jlong)gIngestStats.allocations.load(std::memory_order_relaxed)
+    };
+    
+    jlongArray result = env->NewLongArray(4);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 4, values);
+    }
+    return result;
+}
+
+// Also publish every camera edge mask in a compact format: -1 = off (default),
+// 0 = packed bits, 1 = row runs, 2 = point list
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setEdgeOutputFormat(JNIEnv* env, jobject thiz,
+                                                             jint format) {
+    if (format < EDGE_OUTPUT_OFF || format > EDGE_OUTPUT_POINTS) {
+        LOGE("Unknown edge output format %d", format);
+        return;
+    }
+    gEdgeOutput.format.store(format, std::memory_order_relaxed);
+    gEdgeOutput.blob.setEnabled(format != EDGE_OUTPUT_OFF);
+}
+
+// Copy out the newest camera edge mask in the format selected by setEdgeOutputFormat,
+// or null if there is none yet
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getEdgeOutput(JNIEnv* env, jobject thiz) {
+    return gEdgeOutput.blob.toJava(env);
+}
+
+// Also link every camera edge mask into polylines, simplified to within epsilon pixels
+// (0 keeps every pixel), dropping chains of fewer than minPixels pixels
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setEdgeLinking(JNIEnv* env, jobject thiz,
+                                                        jboolean enabled, jfloat epsilon,
+                                                        jint minPixels) {
+    if (!gEngine) {
+        return;
+    }
+    bool linking = enabled == JNI_TRUE;
+    gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+        parameters.linkEdges = linking;
+        parameters.simplifyEpsilon = std::max(0.0f, (float)epsilon);
+        parameters.minContourPixels = std::max(1, (int)minPixels);
+    });
+    
+    gContourOutput.setEnabled(linking);
+}
+
+// Copy out the polylines of the newest camera edge mask, or null if there are none yet
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getContours(JNIEnv* env, jobject thiz) {
+    return gContourOutput.toJava(env);
+}
+
+// Also compute a threshold level map of every camera frame for the (low, high) pairs in
+// thresholds, interleaved; null or empty turns the sweep off
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setThresholdSweep(JNIEnv* env, jobject thiz,
+                                                           jintArray thresholds) {
+    if (!gEngine) {
+        return;
+    }
+    jsize length = thresholds ? env->GetArrayLength(thresholds) : 0;
+    if (length % 2 != 0 || length / 2 > SessionEngine::Parameters::kMaxSweep) {
+        LOGE("Threshold sweep needs up to %d (low, high) pairs", SessionEngine::Parameters::kMaxSweep);
+        return;
+    }
+    
+    jint values[2 * SessionEngine::Parameters::kMaxSweep];
+    if (length > 0) {
+        env->GetIntArrayRegion(thresholds, 0, length, values);
+    }
+    gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+        parameters.sweepCount = length / 2;
+        for (int i = 0; i < parameters.sweepCount; i++) {
+            parameters.sweep[i] = {(double)values[2 * i], (double)values[2 * i + 1]};
+        }
+    });
+    
+    gSweepOutput.setEnabled(length > 0);
+}
+
+// Copy out the threshold level map of the newest camera frame, or null if there is none yet
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getThresholdLevels(JNIEnv* env, jobject thiz) {
+    return gSweepOutput.toJava(env);
+}
+
+// Also keep the gradient magnitude and orientation planes of every camera frame with
+// orientation histograms over tiles of tileSize pixels
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setGradientOutput(JNIEnv* env, jobject thiz,
+                                                           jboolean enabled, jint tileSize) {
+    if (!gEngine) {
+        return;
+    }
+    if (tileSize < 1 || tileSize > 128) {
+        LOGE("Gradient histogram tiles must be 1 to 128 pixels, not %d", (int)tileSize);
+        return;
+    }
+    
+    bool output = enabled == JNI_TRUE;
+    gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+        parameters.gradientOutput = output;
+        parameters.gradientTile = tileSize;
+    });
+    
+    gGradientOutput.setEnabled(output);
+}
+
+// Copy out the gradient planes and tile histograms of the newest camera frame, or null
+// if there are none yet
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getGradients(JNIEnv* env, jobject thiz) {
+    return gGradientOutput.toJava(env);
+}
+
+// Also count the edge pixels of every camera frame and their mean gradient magnitude
+// over tiles of tileSize pixels, while its mask is written
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setEdgeDensity(JNIEnv* env, jobject thiz,
+                                                        jboolean enabled, jint tileSize) {
+    if (!gEngine) {
+        return;
+    }
+    if (tileSize < 1 || tileSize > 128) {
+        LOGE("Edge density tiles must be 1 to 128 pixels, not %d", (int)tileSize);
+        return;
+    }
+    
+    bool output = enabled == JNI_TRUE;
+    gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+        parameters.edgeDensity = output;
+        parameters.densityTile = tileSize;
+    });
+    
+    gDensityOutput.setEnabled(output);
+}
+
+// Copy out the edge density grid of the newest camera frame, or null if there is none yet
+JNIEXPORT jbyteArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getEdgeDensity(JNIEnv* env, jobject thiz) {
+    return gDensityOutput.toJava(env);
+}
+
+// Record the camera frames going through the pipelined path into a ring file of
+// capacityMb megabytes; content is 1 = input frames, 2 = edge masks, 3 = both
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_startRecording(JNIEnv* env, jobject thiz,
+                                                        jstring path, jint capacityMb,
+                                                        jint content) {
+    if (!path || capacityMb <= 0) {
+        return JNI_FALSE;
+    }
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    if (!chars) {
+        return JNI_FALSE;
+    }
+    std::string file(chars);
+    env->ReleaseStringUTFChars(path, chars);
+    
+    return gRecorder.start(file, (uint64_t)capacityMb << 20, content) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Stop recording and write the ring file back
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_stopRecording(JNIEnv* env, jobject thiz) {
+    gRecorder.stop();
+}
+
+// Read the recorder counters: recording (0 or 1), frames, bytes, overwritten frames,
+// dropped frames
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getRecorderStats(JNIEnv* env, jobject thiz) {
+    FrameRecorder::Stats stats = gRecorder.stats();
+    jlong values[5] = {
+        gRecorder.isRecording() ? 1 : 0,
+        (jlong)stats.frames,
+        (jlong)stats.bytes,
+        (jlong)stats.overwritten,
+        (jlong)stats.dropped
+    };
+    
+    jlongArray result = env->NewLongArray(5);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 5, values);
+    }
+    return result;
+}
+
+// Stream the camera edge masks to web viewers on ws://127.0.0.1:port; forward the port
+// with adb to view them on a desktop
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_startFrameServer(JNIEnv* env, jobject thiz,
+                                                          jint port) {
+    return gFrameServer.start(port) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Disconnect all viewers and stop streaming
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_stopFrameServer(JNIEnv* env, jobject thiz) {
+    gFrameServer.stop();
+}
+
+// Read the frame server counters: viewers, frames published, frames sent, frames
+// dropped for busy viewers, keyframes, bytes sent, 8-bit mask bytes of the sent frames,
+// p50 and p99 publish-to-acknowledged latency in nanoseconds
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getFrameServerStats(JNIEnv* env, jobject thiz) {
+    FrameServer::Stats stats = gFrameServer.stats();
+    const LatencyHistogram& latency = gFrameServer.latency();
+    jlong values[9] = {
+        (jlong)stats.clients,
+        (jlong)stats.published,
+        (jlong)stats.sent,
+        (jlong)stats.dropped,
+        (jlong)stats.keyframes,
+        (jlong)stats.bytesSent,
+        (jlong)stats.maskBytes,
+        (jlong)latency.percentile(0.50),
+        (jlong)latency.percentile(0.99)
+    };
+    
+    jlongArray result = env->NewLongArray(9);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 9, values);
+    }
+    return result;
+}
+
+// Runs on the camera thread before its frame is submitted: make the frame's camera
+// timestamp (steady clock nanoseconds) its trace id, and trace its way from the sensor
+// to here while tracing
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_beginCameraFrame(JNIEnv* env, jobject thiz,
+                                                          jlong timestampNanos) {
+    static thread_local bool named = false;
+    
+    FrameTrace::setCurrentFrame((uint64_t)timestampNanos);
+    FrameTrace& trace = FrameTrace::global();
+    if (trace.enabled()) {
+        if (!named) {
+            trace.nameThread("camera");
+            named = true;
+        }
+        trace.record("acquire", timestampNanos, FrameTrace::nowNanos());
+    }
+}
+
+// Record a span measured in Java/Kotlin (System.nanoTime) for the current camera frame
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_traceSpan(JNIEnv* env, jobject thiz, jint phase,
+                                                   jlong beginNanos, jlong endNanos) {
+    static const char* const kPhaseNames[] = {"pack nv21"};
+    if (phase >= 0 && phase < (jint)(sizeof(kPhaseNames) / sizeof(kPhaseNames[0]))) {
+        FrameTrace::global().record(kPhaseNames[phase], beginNanos, endNanos);
+    }
+}
+
+// Start collecting per-frame trace events, dropping those of an earlier trace
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_startTrace(JNIEnv* env, jobject thiz) {
+    FrameTrace::global().setEnabled(true);
+}
+
+// Stop collecting trace events; they stay available to dumpTrace
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_stopTrace(JNIEnv* env, jobject thiz) {
+    FrameTrace::global().setEnabled(false);
+}
+
+// Write the newest trace events to a file as Chrome / Perfetto JSON
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_dumpTrace(JNIEnv* env, jobject thiz, jstring path) {
+    if (!path) {
+        return JNI_FALSE;
+    }
+    const char* chars = env->GetStringUTFChars(path, nullptr);
+    if (!chars) {
+        return JNI_FALSE;
+    }
+    std::string file(chars);
+    env->ReleaseStringUTFChars(path, chars);
+    
+    return FrameTrace::global().save(file) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Read the upload counters: uploads, total bytes, bytes of the last frame,
+// total upload time in nanoseconds, texture storage allocations
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getUploadStats(JNIEnv* env, jobject thiz) {
+    jlong values[5] = {
+        (jlong)gUploadStats.uploads.load(std::memory_order_relaxed),
+        (jlong)gUploadStats.totalBytes.load(std::memory_order_relaxed),
+        (jlong)gUploadStats.lastFrameBytes.load(std::memory_order_relaxed),
+        (jlong)gUploadStats.totalNanos.load(std::memory_order_relaxed),
+        (jlong)gUploadStats.allocations.load(std::memory_order_relaxed)
+    };
+    
+    jlongArray result = env->NewLongArray(5);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 5, values);
+    }
+    return result;
+}
+
+// Read the frame buffer pool counters: allocations, reuses, frees, live bytes,
+// idle bytes, peak bytes
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getBufferPoolStats(JNIEnv* env, jobject thiz) {
+    BufferPool::Stats stats = BufferPool::shared().stats();
+    jlong values[6] = {
+        (jlong)stats.allocations,
+        (jlong)stats.reuses,
+        (jlong)stats.frees,
+        (jlong)stats.liveBytes,
+        (jlong)stats.idleBytes,
+        (jlong)stats.peakBytes
+    };
+    
+    jlongArray result = env->NewLongArray(6);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 6, values);
+    }
+    return result;
 }
 
 // Create an OpenGL texture to hold our processed frame
 JNIEXPORT jint JNICALL
 Java_com_example_edgedetection_NativeWrapper_createTexture(JNIEnv* env, jobject thiz) {
-    // Generate a new texture ID
-    glGenTextures(1, &gTextureId);
+    // Generate a new texture ID; storage is allocated by the first upload
+    gCameraTexture.id = createEdgeTexture();
+    gCameraTexture.width = 0;
+    gCameraTexture.height = 0;
     
-    // Configure texture parameters
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    
-    LOGI("Created texture with ID: %d", gTextureId);
+    LOGI("Created texture with ID: %d", gCameraTexture.id);
     
-    return gTextureId;
+    return gCameraTexture.id;
 }
 
 // Update edge detector parameters
@@ -135,22 +1464,189 @@ JNIEXPORT void JNICALL
 Java_com_example_edgedetection_NativeWrapper_updateParameters(JNIEnv* env, jobject thiz,
                                                          jint lowThreshold, jint ratio, 
                                                          jint kernelSize) {
-    if (gEdgeDetector) {
-        gEdgeDetector->updateParameters(lowThreshold, ratio, kernelSize);
+    if (gEngine) {
+        gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+            parameters.lowThreshold = lowThreshold;
+            parameters.ratio = ratio;
+            parameters.kernelSize = kernelSize;
+        });
+    }
+}
+
+// Update edge detector parameters from a given camera frame on, counting frames processed
+// by the camera session from 0 (see getFrameCount); frames already started mean the next
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_updateParametersAt(JNIEnv* env, jobject thiz,
+                                                           jint lowThreshold, jint ratio,
+                                                           jint kernelSize, jlong frame) {
+    if (!gEngine) {
+        return;
+    }
+    bool staged = gEngine->modifyParameters(gCameraSession, [=](SessionEngine::Parameters& parameters) {
+        parameters.lowThreshold = lowThreshold;
+        parameters.ratio = ratio;
+        parameters.kernelSize = kernelSize;
+    }, (uint64_t)std::max<jlong>(0, frame));
+    if (!staged) {
+        LOGE("Too many frames have parameter changes waiting, frame %lld refused", (long long)frame);
+    }
+}
+
+// Number of frames the camera session has processed, the number of the next frame
+JNIEXPORT jlong JNICALL
+Java_com_example_edgedetection_NativeWrapper_getFrameCount(JNIEnv* env, jobject thiz) {
+    uint64_t frames = 0;
+    if (gEngine) {
+        gEngine->frameCount(gCameraSession, frames);
+    }
+    return (jlong)frames;
+}
+
+// Switch between the luma-only and the RGBA pipeline
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setLumaOnly(JNIEnv* env, jobject thiz,
+                                                    jboolean enabled) {
+    if (gEngine) {
+        gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+            parameters.lumaOnly = enabled == JNI_TRUE;
+        });
+    }
+}
+
+// Select the blur + Canny engine (0 = OpenCV, 1 = strip-parallel, 2 = fused)
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setEngine(JNIEnv* env, jobject thiz, jint engine) {
+    if (gEngine) {
+        gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+            parameters.engine = toEngine(engine);
+        });
+    }
+}
+
+// Restrict the camera session to regions of interest, see setSessionRegions
+JNIEXPORT jboolean JNICALL
+Java_com_example_edgedetection_NativeWrapper_setRegions(JNIEnv* env, jobject thiz,
+                                                    jintArray rects) {
+    if (!gEngine) {
+        return JNI_FALSE;
+    }
+    return setRegions(env, gCameraSession, rects) ? JNI_TRUE : JNI_FALSE;
+}
+
+// Only recompute the tiles of the camera frame that changed. sensitivity is the mean
+// absolute difference per pixel a tile may show and still reuse its cached edges.
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setIncremental(JNIEnv* env, jobject thiz,
+                                                        jboolean enabled, jfloat sensitivity) {
+    if (gEngine) {
+        gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+            parameters.incremental = enabled == JNI_TRUE;
+            parameters.changeSensitivity = sensitivity;
+        });
+    }
+}
+
+// Read the tile reuse counters of the camera session: frames, frames skipped entirely,
+// tiles compared, tiles reused
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getTemporalStats(JNIEnv* env, jobject thiz) {
+    TemporalEdgeCache::Stats stats = {};
+    if (gEngine) {
+        gEngine->temporalStats(gCameraSession, stats);
+    }
+    
+    jlong values[4] = {
+        (jlong)stats.frames,
+        (jlong)stats.skippedFrames,
+        (jlong)stats.tiles,
+        (jlong)stats.reusedTiles
+    };
+    
+    jlongArray result = env->NewLongArray(4);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 4, values);
+    }
+    return result;
+}
+
+// Keep each camera frame within a processing time budget by dropping to coarser
+// pyramid levels (at most maxLevel) when it runs late. 0 ms always processes at full
+// resolution.
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setFrameBudget(JNIEnv* env, jobject thiz,
+                                                        jfloat budgetMs, jint maxLevel) {
+    if (gEngine) {
+        gEngine->modifyParameters(gCameraSession, [&](SessionEngine::Parameters& parameters) {
+            parameters.frameBudgetNanos = (int64_t)(budgetMs * 1000000.0f);
+            parameters.maxPyramidLevel = maxLevel;
+        });
+    }
+}
+
+// Read the latency governor of the camera session: pyramid level, smoothed processing
+// time and budget in nanoseconds, level changes, frames over budget
+JNIEXPORT jlongArray JNICALL
+Java_com_example_edgedetection_NativeWrapper_getGovernorStats(JNIEnv* env, jobject thiz) {
+    LatencyGovernor::Stats stats = {};
+    if (gEngine) {
+        gEngine->governorStats(gCameraSession, stats);
+    }
+    
+    jlong values[5] = {
+        (jlong)stats.level,
+        (jlong)stats.smoothedNanos,
+        (jlong)stats.budgetNanos,
+        (jlong)stats.levelChanges,
+        (jlong)stats.overBudget
+    };
+    
+    jlongArray result = env->NewLongArray(5);
+    if (result) {
+        env->SetLongArrayRegion(result, 0, 5, values);
     }
+    return result;
 }
 
 // Clean up native resources
 JNIEXPORT void JNICALL
 Java_com_example_edgedetection_NativeWrapper_cleanupNative(JNIEnv* env, jobject thiz) {
-    if (gEdgeDetector) {
-        delete gEdgeDetector;
-        gEdgeDetector = nullptr;
+    // The processing thread uses the camera session, stop it first
+    if (gPipeline) {
+        gPipeline->stop();
+        delete gPipeline;
+        gPipeline = nullptr;
+    }
+    gRecorder.stop();
+    gFrameServer.stop();
+    
+    {
+        std::lock_guard<std::mutex> guard(gStreamsLock);
+        for (auto& entry : gStreams) {
+            if (entry.second->texture.id != 0) {
+                gRetiredTextures.push_back(entry.second->texture.id);
+            }
+        }
+        gStreams.clear();
+    }
+    deleteRetiredTextures();
+    
+    if (gEngine) {
+        delete gEngine;
+        gEngine = nullptr;
+        gCameraSession = SessionEngine::kInvalidHandle;
     }
     
-    if (gTextureId != 0) {
-        glDeleteTextures(1, &gTextureId);
-        gTextureId = 0;
+    if (gCameraTexture.id != 0) {
+        glDeleteTextures(1, &gCameraTexture.id);
+    }
+    gCameraTexture = StreamTexture();
+    
+    gChromaScratch.release();
+    
+    gEdgeOutput.format.store(EDGE_OUTPUT_OFF, std::memory_order_relaxed);
+    for (PublishedBlob* output : {&gEdgeOutput.blob, &gContourOutput, &gSweepOutput,
+                                  &gGradientOutput, &gDensityOutput}) {
+        output->setEnabled(false);
     }
     
     LOGI("Native resources cleaned up");
@@ -1,30 +1,50 @@
-#include <jni.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
-#include <android/log.h>
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <unordered_map>
 
+#include "core/display_transform.h"
+#include "core/frame_trace.h"
+#include "core/logger.h"
+#include "core/stage_stats.h"
+#include "gl_renderer.h"
+
+// No JNI or Android headers here (the entry points are in gl_renderer_jni.cpp), so the
+// renderer also builds against desktop GLES2 for gltest/
 #define LOG_TAG "GLRenderer"
-#define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) CORE_LOGI(LOG_TAG, __VA_ARGS__)
+#define LOGE(...) CORE_LOGE(LOG_TAG, __VA_ARGS__)
 
-// Shader source code
+// Shader source code. uTransform rotates, mirrors and letterboxes the quad
+// (see DisplayTransform), so the mask is never reoriented on the CPU.
 static const char gVertexShader[] = 
     "attribute vec4 aPosition;\n"
     "attribute vec2 aTexCoord;\n"
+    "uniform mat4 uTransform;\n"
     "varying vec2 vTexCoord;\n"
     "void main() {\n"
-    "  gl_Position = aPosition;\n"
+    "  gl_Position = uTransform * aPosition;\n"
     "  vTexCoord = aTexCoord;\n"
     "}\n";
 
+// The texture holds the single channel edge mask (GL_LUMINANCE), colorize it here.
+// A mask from a coarser pyramid level is upscaled by the bilinear sampler, which
+// smears every edge texel into a soft ramp; smoothstep pulls it back to a crisp line.
 static const char gFragmentShader[] = 
     "precision mediump float;\n"
     "varying vec2 vTexCoord;\n"
     "uniform sampler2D uTexture;\n"
+    "uniform vec4 uEdgeColor;\n"
+    "uniform vec4 uBackgroundColor;\n"
+    "uniform float uMaskScale;\n"
     "void main() {\n"
-    "  gl_FragColor = texture2D(uTexture, vTexCoord);\n"
+    "  float edge = texture2D(uTexture, vTexCoord).r;\n"
+    "  if (uMaskScale > 1.0) {\n"
+    "    edge = smoothstep(0.25, 0.75, edge);\n"
+    "  }\n"
+    "  gl_FragColor = mix(uBackgroundColor, uEdgeColor, edge);\n"
     "}\n";
 
 // Program and shader handles
@@ -37,7 +57,26 @@ static GLint gPositionHandle = -1;
 static GLint gTexCoordHandle = -1;
 
 // Uniform handles
+static GLint gTransformUniform = -1;
 static GLint gTextureUniform = -1;
+static GLint gEdgeColorUniform = -1;
+static GLint gBackgroundColorUniform = -1;
+static GLint gMaskScaleUniform = -1;
+
+// Layout of the newest mask in each stream's texture, and the viewport they are drawn into
+static std::unordered_map<GLuint, MaskLayout> gMaskLayouts;
+static int gViewWidth = 0;
+static int gViewHeight = 0;
+
+// Mirror the camera preview horizontally (front camera); set from the UI thread
+static std::atomic<bool> gMirror{false};
+
+// Camera frame drawn last, to trace each frame's first draw
+static uint64_t gDrawnFrame = 0;
+
+// Colors for edge and non-edge pixels (RGBA, 0..1)
+static GLfloat gEdgeColor[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+static GLfloat gBackgroundColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
 
 // VBO handles
 static GLuint gPositionVBO = 0;
@@ -98,14 +137,25 @@ static GLuint loadShader(GLenum type, const char* shaderSource) {
     return shader;
 }
 
-extern "C" {
+void setMaskLayout(unsigned int texture, const MaskLayout& layout) {
+    gMaskLayouts[texture] = layout;
+}
+
+void forgetMaskLayout(unsigned int texture) {
+    gMaskLayouts.erase(texture);
+}
+
+bool isPreviewMirrored() {
+    return gMirror.load(std::memory_order_relaxed);
+}
 
-// Initialize the OpenGL renderer
-JNIEXPORT void JNICALL
-Java_com_example_edgedetection_NativeWrapper_initGL(JNIEnv* env, jobject thiz) {
+bool initRenderer() {
     // Load the vertex and fragment shaders
     gVShader = loadShader(GL_VERTEX_SHADER, gVertexShader);
     gFShader = loadShader(GL_FRAGMENT_SHADER, gFragmentShader);
+    if (gVShader == 0 || gFShader == 0) {
+        return false;
+    }
     
     // Create the program and attach the shaders
     gProgram = glCreateProgram();
@@ -131,15 +181,22 @@ Java_com_example_edgedetection_NativeWrapper_initGL(JNIEnv* env, jobject thiz) {
         }
         
         glDeleteProgram(gProgram);
-        return;
+        gProgram = 0;
+        return false;
     }
     
     // Get handle to vertex shader attributes
     gPositionHandle = glGetAttribLocation(gProgram, "aPosition");
     gTexCoordHandle = glGetAttribLocation(gProgram, "aTexCoord");
     
+    // Get handle to vertex shader uniforms
+    gTransformUniform = glGetUniformLocation(gProgram, "uTransform");
+    
     // Get handle to fragment shader uniforms
     gTextureUniform = glGetUniformLocation(gProgram, "uTexture");
+    gEdgeColorUniform = glGetUniformLocation(gProgram, "uEdgeColor");
+    gBackgroundColorUniform = glGetUniformLocation(gProgram, "uBackgroundColor");
+    gMaskScaleUniform = glGetUniformLocation(gProgram, "uMaskScale");
     
     // Generate VBOs
     glGenBuffers(1, &gPositionVBO);
@@ -156,12 +213,38 @@ Java_com_example_edgedetection_NativeWrapper_initGL(JNIEnv* env, jobject thiz) {
     // Disable depth test - we're rendering a 2D texture
     glDisable(GL_DEPTH_TEST);
     
+    FrameTrace::global().nameThread("gl");
+    
     LOGI("GL initialization complete");
+    return true;
+}
+
+void setRendererViewport(int width, int height) {
+    glViewport(0, 0, width, height);
+    gViewWidth = width;
+    gViewHeight = height;
 }
 
-// Render the processed frame texture
-JNIEXPORT void JNICALL
-Java_com_example_edgedetection_NativeWrapper_drawFrame(JNIEnv* env, jobject thiz, jint textureId) {
+void setPreviewMirrored(bool mirrored) {
+    gMirror.store(mirrored, std::memory_order_relaxed);
+}
+
+void setEdgeColors(uint32_t edgeColor, uint32_t backgroundColor) {
+    const uint32_t colors[2] = {edgeColor, backgroundColor};
+    GLfloat* targets[2] = {gEdgeColor, gBackgroundColor};
+    
+    for (int i = 0; i < 2; i++) {
+        targets[i][0] = ((colors[i] >> 16) & 0xFF) / 255.0f;
+        targets[i][1] = ((colors[i] >> 8) & 0xFF) / 255.0f;
+        targets[i][2] = (colors[i] & 0xFF) / 255.0f;
+        targets[i][3] = ((colors[i] >> 24) & 0xFF) / 255.0f;
+    }
+}
+
+void drawMask(unsigned int texture) {
+    // CPU time of issuing the draw; the GPU work itself completes asynchronously
+    EDGE_STAGE_TIMER(Stage::Draw);
+    
     // Clear the color buffer
     glClear(GL_COLOR_BUFFER_BIT);
     
@@ -172,11 +255,28 @@ Java_com_example_edgedetection_NativeWrapper_drawFrame(JNIEnv* env, jobject thiz
     glActiveTexture(GL_TEXTURE0);
     
     // Bind the texture
-    glBindTexture(GL_TEXTURE_2D, textureId);
+    glBindTexture(GL_TEXTURE_2D, texture);
     
     // Set the texture sampler to texture unit 0
     glUniform1i(gTextureUniform, 0);
     
+    // Layout of the mask in this texture
+    MaskLayout layout;
+    auto found = gMaskLayouts.find(texture);
+    if (found != gMaskLayouts.end()) {
+        layout = found->second;
+    }
+    
+    // Colors the edge mask is mapped to
+    glUniform4fv(gEdgeColorUniform, 1, gEdgeColor);
+    glUniform4fv(gBackgroundColorUniform, 1, gBackgroundColor);
+    glUniform1f(gMaskScaleUniform, layout.scale);
+    
+    // Orientation and letterboxing of the quad
+    DisplayTransform transform = DisplayTransform::compute(
+        layout.width, layout.height, layout.rotation, layout.mirror, gViewWidth, gViewHeight);
+    glUniformMatrix4fv(gTransformUniform, 1, GL_FALSE, transform.matrix);
+    
     // Bind and enable position VBO
     glBindBuffer(GL_ARRAY_BUFFER, gPositionVBO);
     glVertexAttribPointer(gPositionHandle, 2, GL_FLOAT, GL_FALSE, 0, 0);
@@ -193,11 +293,18 @@ Java_com_example_edgedetection_NativeWrapper_drawFrame(JNIEnv* env, jobject thiz
     // Disable vertex arrays
     glDisableVertexAttribArray(gPositionHandle);
     glDisableVertexAttribArray(gTexCoordHandle);
+    
+    // The first draw of a camera frame ends its way from the sensor to the screen
+    // (up to the buffer swap, which GLSurfaceView does after this returns)
+    uint64_t frame = FrameTrace::currentFrame();
+    if (frame != gDrawnFrame) {
+        gDrawnFrame = frame;
+        FrameTrace::global().record("motion to photon", frame, (int64_t)frame,
+                                    FrameTrace::nowNanos(), FrameTrace::kFrameTrack);
+    }
 }
 
-// Clean up the GL resources
-JNIEXPORT void JNICALL
-Java_com_example_edgedetection_NativeWrapper_cleanupGL(JNIEnv* env, jobject thiz) {
+void releaseRenderer() {
     // Delete program and shaders
     if (gProgram) {
         glDeleteProgram(gProgram);
@@ -227,5 +334,3 @@ Java_com_example_edgedetection_NativeWrapper_cleanupGL(JNIEnv* env, jobject thiz
     
     LOGI("GL resources cleaned up");
 }
-
-}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * GL renderer for the edge mask: draws a texture holding a single channel mask as a
+ * colored, rotated and letterboxed quad. Plain GLES2, no JNI; NativeWrapper reaches it
+ * through gl_renderer_jni.cpp and gltest/ drives it in an offscreen EGL context.
+ */
+
+/**
+ * How the edge mask in a texture is drawn
+ */
+struct MaskLayout {
+    int width = 0;        // size of the mask
+    int height = 0;
+    int rotation = 0;     // clockwise rotation (0, 90, 180 or 270) that turns its frame upright
+    bool mirror = false;  // mirror the upright image horizontally
+    float scale = 1.0f;   // frame size over mask size per side, 2^level below full resolution
+};
+
+/**
+ * Compile the shaders and create the quad buffers in the current GL context. GL thread only.
+ *
+ * @return false if the shaders do not compile or link (logged)
+ */
+bool initRenderer();
+
+/**
+ * Set the viewport to the surface size; the quad is letterboxed inside it. GL thread only.
+ */
+void setRendererViewport(int width, int height);
+
+/**
+ * Clear the viewport and draw the mask in a texture with its layout. GL thread only.
+ */
+void drawMask(unsigned int texture);
+
+/**
+ * Delete what initRenderer() created. GL thread only.
+ */
+void releaseRenderer();
+
+/**
+ * Set the colors of edge and non-edge pixels, both as ARGB. GL thread only.
+ */
+void setEdgeColors(uint32_t edgeColor, uint32_t backgroundColor);
+
+/**
+ * Tell the renderer how to draw the mask in a texture: drawFrame() rotates, mirrors and
+ * letterboxes it (see DisplayTransform) and the shader scales a coarser pyramid level
+ * back up. Every stream's texture keeps its own layout; textures without one are drawn
+ * unrotated at full scale. GL thread only.
+ */
+void setMaskLayout(unsigned int texture, const MaskLayout& layout);
+
+/**
+ * Forget the layout of a deleted texture. GL thread only.
+ */
+void forgetMaskLayout(unsigned int texture);
+
+/**
+ * Mirror the camera preview horizontally, for a front camera; applies from its next
+ * frame. Any thread.
+ */
+void setPreviewMirrored(bool mirrored);
+
+/**
+ * Whether the camera preview is mirrored (NativeWrapper.setMirrored). Any thread.
+ */
+bool isPreviewMirrored();
@@ -0,0 +1,49 @@
+#include <jni.h>
+
+#include "gl_renderer.h"
+
+// NativeWrapper entry points of the renderer, called from GLRenderer on the GL thread
+// (setMirrored from the UI thread)
+
+extern "C" {
+
+// Initialize the OpenGL renderer
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_initGL(JNIEnv* env, jobject thiz) {
+    initRenderer();
+}
+
+// Render the processed frame texture
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_drawFrame(JNIEnv* env, jobject thiz, jint textureId) {
+    drawMask((unsigned int)textureId);
+}
+
+// Set the viewport to the surface size; the quad is letterboxed inside it
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setViewport(JNIEnv* env, jobject thiz,
+                                                     jint width, jint height) {
+    setRendererViewport(width, height);
+}
+
+// Mirror the camera preview horizontally, for a front camera; applies from its next frame
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setMirrored(JNIEnv* env, jobject thiz,
+                                                     jboolean mirrored) {
+    setPreviewMirrored(mirrored == JNI_TRUE);
+}
+
+// Set the colors of edge and non-edge pixels, both as ARGB ints
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_setEdgeColors(JNIEnv* env, jobject thiz,
+                                                       jint edgeColor, jint backgroundColor) {
+    setEdgeColors((uint32_t)edgeColor, (uint32_t)backgroundColor);
+}
+
+// Clean up the GL resources
+JNIEXPORT void JNICALL
+Java_com_example_edgedetection_NativeWrapper_cleanupGL(JNIEnv* env, jobject thiz) {
+    releaseRenderer();
+}
+
+}
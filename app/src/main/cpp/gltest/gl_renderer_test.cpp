@@ -0,0 +1,328 @@
+/**
+ * gl_renderer_test - checks the orientation of the drawn edge mask on a real GL driver
+ *
+ * Creates an offscreen EGL pbuffer (the surfaceless platform where Mesa offers it, so
+ * llvmpipe runs without a display), uploads an asymmetric mask the way the app does and
+ * draws it through drawMask() for every rotation, with and without mirroring, at full
+ * and at a coarser pyramid scale. Each corner of the viewport must show the mask corner
+ * that rotating and mirroring the frame puts there, in the edge color mix the shader
+ * computes, so uTransform, uMaskScale and the per-texture MaskLayout lookup are all on
+ * the checked path. It also checks the letterbox bars of a mismatched viewport and that
+ * textures keep their own layouts: a second texture keeps its layout while the first
+ * one's changes, and a texture without one (or after forgetMaskLayout) is drawn
+ * unrotated.
+ *
+ * Exits with 1 and prints every mismatch; with 77 (skipped, for ctest) if no EGL
+ * display or GLES2 context is available.
+ */
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "gl_renderer.h"
+#include "logger.h"
+
+namespace {
+
+constexpr int kSurfaceSize = 64;
+
+// The mask: 8x4, only its top-left texel fully lit and its top-right one dimmed, so
+// each of the 8 rotation and mirror combinations puts them in a different pair of corners
+constexpr int kMaskWidth = 8;
+constexpr int kMaskHeight = 4;
+constexpr uint8_t kTopLeft = 255;
+constexpr uint8_t kTopRight = 96;
+
+// Red edges on a blue background; the clear color (bars) is black
+constexpr uint32_t kEdgeColor = 0xFFFF0000;
+constexpr uint32_t kBackgroundColor = 0xFF0000FF;
+
+// Rounding of the 8 bit mask through mediump float and back
+constexpr int kTolerance = 3;
+
+struct OffscreenContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+
+    ~OffscreenContext() {
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            if (surface != EGL_NO_SURFACE) {
+                eglDestroySurface(display, surface);
+            }
+            eglTerminate(display);
+        }
+    }
+};
+
+/**
+ * The surfaceless display where the client extensions offer one, else the default one
+ */
+EGLDisplay openDisplay() {
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (extensions && strstr(extensions, "EGL_MESA_platform_surfaceless")) {
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        if (getPlatformDisplay) {
+            EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                                    EGL_DEFAULT_DISPLAY, nullptr);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+                return display;
+            }
+        }
+    }
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+/**
+ * Make a GLES2 context on a kSurfaceSize square pbuffer current
+ */
+bool createContext(OffscreenContext& gl) {
+    gl.display = openDisplay();
+    if (gl.display == EGL_NO_DISPLAY) {
+        fprintf(stderr, "No EGL display\n");
+        return false;
+    }
+
+    const EGLint configAttributes[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configs = 0;
+    if (!eglChooseConfig(gl.display, configAttributes, &config, 1, &configs) || configs == 0) {
+        fprintf(stderr, "No RGBA8 pbuffer config for GLES2\n");
+        return false;
+    }
+
+    const EGLint surfaceAttributes[] = {EGL_WIDTH, kSurfaceSize, EGL_HEIGHT, kSurfaceSize, EGL_NONE};
+    gl.surface = eglCreatePbufferSurface(gl.display, config, surfaceAttributes);
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+    const EGLint contextAttributes[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+    gl.context = eglCreateContext(gl.display, config, EGL_NO_CONTEXT, contextAttributes);
+
+    if (gl.surface == EGL_NO_SURFACE || gl.context == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(gl.display, gl.surface, gl.surface, gl.context)) {
+        fprintf(stderr, "Cannot make a GLES2 pbuffer context current (0x%x)\n", eglGetError());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Upload the mask like uploadFrame() in edge_detector.cpp does
+ */
+GLuint createMaskTexture(const std::vector<uint8_t>& mask) {
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, kMaskWidth, kMaskHeight, 0,
+                 GL_LUMINANCE, GL_UNSIGNED_BYTE, mask.data());
+    return texture;
+}
+
+/**
+ * The mask value at a corner of the upright, mirrored image (x and y are 0 or 1, y down)
+ */
+int expectedMask(int x, int y, int rotation, bool mirror) {
+    // Undo the mirroring, then each clockwise quarter turn: upright (x, y) came from (y, 1 - x)
+    if (mirror) {
+        x = 1 - x;
+    }
+    for (int turns = rotation / 90; turns > 0; turns--) {
+        int maskX = y;
+        int maskY = 1 - x;
+        x = maskX;
+        y = maskY;
+    }
+
+    if (y != 0) {
+        return 0;
+    }
+    return x == 0 ? kTopLeft : kTopRight;
+}
+
+/**
+ * What the fragment shader makes of a mask value: red edge weight, blue the rest
+ */
+void expectedColor(int mask, float scale, int& red, int& blue) {
+    float edge = mask / 255.0f;
+    if (scale > 1.0f) {
+        float t = std::min(std::max((edge - 0.25f) / 0.5f, 0.0f), 1.0f);
+        edge = t * t * (3.0f - 2.0f * t);
+    }
+    red = (int)std::lround(edge * 255.0f);
+    blue = 255 - red;
+}
+
+struct Pixel {
+    int red, green, blue;
+};
+
+/**
+ * Read a pixel of the viewport, y counted from the top like the mask rows
+ */
+Pixel readPixel(int x, int y, int viewHeight) {
+    uint8_t rgba[4] = {0, 0, 0, 0};
+    glReadPixels(x, viewHeight - 1 - y, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+    return Pixel{rgba[0], rgba[1], rgba[2]};
+}
+
+bool near(const Pixel& pixel, int red, int green, int blue) {
+    return std::abs(pixel.red - red) <= kTolerance &&
+           std::abs(pixel.green - green) <= kTolerance &&
+           std::abs(pixel.blue - blue) <= kTolerance;
+}
+
+int gFailures = 0;
+
+void expectPixel(const char* what, const Pixel& pixel, int red, int green, int blue) {
+    if (!near(pixel, red, green, blue)) {
+        fprintf(stderr, "FAIL %s: got (%d, %d, %d), expected (%d, %d, %d)\n",
+                what, pixel.red, pixel.green, pixel.blue, red, green, blue);
+        gFailures++;
+    }
+}
+
+/**
+ * Draw a texture into a viewport the shape of its upright mask and check all four corners
+ */
+void checkCorners(GLuint texture, int rotation, bool mirror, float scale, const char* label) {
+    bool sideways = rotation == 90 || rotation == 270;
+    int viewWidth = kSurfaceSize;
+    int viewHeight = kSurfaceSize * kMaskHeight / kMaskWidth;
+    if (sideways) {
+        std::swap(viewWidth, viewHeight);
+    }
+
+    setRendererViewport(viewWidth, viewHeight);
+    drawMask(texture);
+
+    static const char* kCorners[] = {"top-left", "top-right", "bottom-left", "bottom-right"};
+    for (int corner = 0; corner < 4; corner++) {
+        int x = corner & 1;
+        int y = corner >> 1;
+        int red, blue;
+        expectedColor(expectedMask(x, y, rotation, mirror), scale, red, blue);
+
+        char what[128];
+        snprintf(what, sizeof(what), "%s, rotation %d%s, scale %g, %s corner",
+                 label, rotation, mirror ? " mirrored" : "", scale, kCorners[corner]);
+        expectPixel(what, readPixel(x * (viewWidth - 1), y * (viewHeight - 1), viewHeight),
+                    red, 0, blue);
+    }
+}
+
+} // namespace
+
+int main() {
+    setLogLevel(LogLevel::Warn);
+
+    OffscreenContext gl;
+    if (!createContext(gl)) {
+        return 77;
+    }
+    if (!initRenderer()) {
+        fprintf(stderr, "FAIL: the renderer's shaders do not build\n");
+        return 1;
+    }
+    setEdgeColors(kEdgeColor, kBackgroundColor);
+
+    std::vector<uint8_t> mask(kMaskWidth * kMaskHeight, 0);
+    mask[0] = kTopLeft;
+    mask[kMaskWidth - 1] = kTopRight;
+
+    GLuint rotated = createMaskTexture(mask);
+    GLuint fixed = createMaskTexture(mask);
+    GLuint plain = createMaskTexture(mask);
+
+    // Set once, must survive every layout change of the other texture
+    MaskLayout fixedLayout;
+    fixedLayout.width = kMaskWidth;
+    fixedLayout.height = kMaskHeight;
+    fixedLayout.rotation = 180;
+    fixedLayout.mirror = true;
+    setMaskLayout(fixed, fixedLayout);
+
+    for (float scale : {1.0f, 2.0f}) {
+        for (int rotation = 0; rotation < 360; rotation += 90) {
+            for (bool mirror : {false, true}) {
+                MaskLayout layout;
+                layout.width = kMaskWidth;
+                layout.height = kMaskHeight;
+                layout.rotation = rotation;
+                layout.mirror = mirror;
+                layout.scale = scale;
+                setMaskLayout(rotated, layout);
+
+                checkCorners(rotated, rotation, mirror, scale, "texture");
+                checkCorners(fixed, 180, true, 1.0f, "second texture");
+            }
+        }
+    }
+
+    // Without a layout the mask fills the viewport as it is
+    checkCorners(plain, 0, false, 1.0f, "texture without layout");
+    forgetMaskLayout(fixed);
+    checkCorners(fixed, 0, false, 1.0f, "forgotten layout");
+
+    // A square viewport letterboxes the 2:1 mask: black bars above and below it
+    MaskLayout layout;
+    layout.width = kMaskWidth;
+    layout.height = kMaskHeight;
+    setMaskLayout(rotated, layout);
+    setRendererViewport(kSurfaceSize, kSurfaceSize);
+    drawMask(rotated);
+    int bar = kSurfaceSize / 4;
+    expectPixel("letterbox, top bar", readPixel(0, bar - 1, kSurfaceSize), 0, 0, 0);
+    expectPixel("letterbox, bottom bar", readPixel(kSurfaceSize - 1, kSurfaceSize - bar, kSurfaceSize),
+                0, 0, 0);
+    expectPixel("letterbox, mask top-left", readPixel(0, bar, kSurfaceSize), kTopLeft, 0, 255 - kTopLeft);
+    expectPixel("letterbox, mask bottom-right",
+                readPixel(kSurfaceSize - 1, kSurfaceSize - bar - 1, kSurfaceSize), 0, 0, 255);
+
+    GLenum error = glGetError();
+    if (error != GL_NO_ERROR) {
+        fprintf(stderr, "FAIL: GL error 0x%x\n", error);
+        gFailures++;
+    }
+
+    GLuint textures[] = {rotated, fixed, plain};
+    glDeleteTextures(3, textures);
+    releaseRenderer();
+
+    if (gFailures > 0) {
+        fprintf(stderr, "%d checks failed\n", gFailures);
+        return 1;
+    }
+    printf("All rotation, mirror, scale and layout checks passed\n");
+    return 0;
+}
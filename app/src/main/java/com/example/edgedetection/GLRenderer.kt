@@ -27,14 +27,17 @@ class GLRenderer : GLSurfaceView.Renderer {
      * Called when the surface changes size
      */
     override fun onSurfaceChanged(gl: GL10?, width: Int, height: Int) {
-        // Set the viewport
-        gl?.glViewport(0, 0, width, height)
+        // Set the viewport; the frame is rotated and letterboxed inside it when drawn
+        nativeWrapper.setViewport(width, height)
     }
 
     /**
      * Called to draw the current frame
      */
     override fun onDrawFrame(gl: GL10?) {
+        // Pick up the newest edge mask from the processing thread, if one is ready
+        updateTextureId(nativeWrapper.uploadLatestFrame())
+
         // Draw the frame using the current texture
         nativeWrapper.drawFrame(textureId)
     }
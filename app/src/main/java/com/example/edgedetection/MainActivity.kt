@@ -4,6 +4,7 @@ import android.Manifest
 import android.content.pm.PackageManager
 import android.graphics.ImageFormat
 import android.os.Bundle
+import android.os.SystemClock
 import android.util.Log
 import android.widget.Toast
 import androidx.appcompat.app.AppCompatActivity
@@ -29,11 +30,17 @@ class MainActivity : AppCompatActivity() {
     private var frameCount = 0
     private var lastFpsUpdateTime = System.currentTimeMillis()
     private var fps = 0
+    private var lastStatsLogTime = System.currentTimeMillis()
+
+    // Frames that had to be packed into a fresh NV21 array (non-direct plane buffers)
+    @Volatile
+    private var nv21Allocations = 0L
 
     companion object {
         private const val TAG = "MainActivity"
         private const val REQUEST_CODE_CAMERA = 10
         private const val FPS_UPDATE_INTERVAL = 1000 // 1 second
+        private const val STATS_LOG_INTERVAL = 10000 // 10 seconds, debug builds only
     }
 
     override fun onCreate(savedInstanceState: Bundle?) {
@@ -107,6 +114,9 @@ class MainActivity : AppCompatActivity() {
             // Select back camera as a default
             val cameraSelector = CameraSelector.DEFAULT_BACK_CAMERA
 
+            // Front camera images are shown mirrored, like a mirror
+            nativeWrapper.setMirrored(cameraSelector == CameraSelector.DEFAULT_FRONT_CAMERA)
+
             try {
                 // Unbind use cases before rebinding
                 cameraProvider.unbindAll()
@@ -130,18 +140,12 @@ class MainActivity : AppCompatActivity() {
             return
         }
 
-        val data = imageProxy.toNv21ByteArray()
         val width = imageProxy.width
         val height = imageProxy.height
-        val rotation = imageProxy.imageInfo.rotationDegrees
-
-        imageProxy.close()
 
-        // Queue the native processing and texture update on the GL thread.
-        binding.glSurfaceView.queueEvent {
-            val textureId = nativeWrapper.processFrame(data, width, height, rotation)
-            glRenderer.updateTextureId(textureId)
-        }
+        // Hand the frame to the native processing thread; the GL thread only uploads
+        // its results, so rendering never waits for edge detection
+        submitImage(imageProxy)
 
         // Update FPS counter
         frameCount++
@@ -157,6 +161,98 @@ class MainActivity : AppCompatActivity() {
                 binding.resolutionTextView.text = getString(R.string.resolution_text, width, height)
             }
         }
+
+        // Native counters and stage latencies, in debug builds only and far less often
+        // than the FPS readout: collecting them costs a few JNI array copies
+        if (BuildConfig.DEBUG && currentTime - lastStatsLogTime >= STATS_LOG_INTERVAL) {
+            lastStatsLogTime = currentTime
+            logNativeStats()
+        }
+    }
+
+    /**
+     * Log the native ingest, pipeline, upload, buffer and governor counters and the
+     * p50/p95/p99/max of every native stage that ran (microseconds), as one message
+     */
+    private fun logNativeStats() {
+        val ingest = nativeWrapper.getIngestStats()
+        val pipeline = nativeWrapper.getPipelineStats()
+        val upload = nativeWrapper.getUploadStats()
+        val buffers = nativeWrapper.getBufferPoolStats()
+        val governor = nativeWrapper.getGovernorStats()
+
+        val message = StringBuilder()
+        message.append("Ingest: frames=${ingest[0]} zeroCopy=${ingest[1]} " +
+                "copiedBytes=${ingest[2]} nativeAllocs=${ingest[3]} nv21Allocs=$nv21Allocations")
+        message.append("\nPipeline: submitted=${pipeline[0]} droppedInput=${pipeline[1]} " +
+                "processed=${pipeline[2]} droppedResult=${pipeline[3]} displayed=${pipeline[4]}")
+        if (upload[0] > 0) {
+            message.append("\nUpload: bytes/frame=${upload[2]} " +
+                    "avgMicros=${upload[3] / upload[0] / 1000} allocs=${upload[4]}")
+        }
+        message.append("\nBuffers: allocs=${buffers[0]} reuses=${buffers[1]} frees=${buffers[2]} " +
+                "liveKB=${buffers[3] / 1024} idleKB=${buffers[4] / 1024} peakKB=${buffers[5] / 1024}")
+        if (governor[2] > 0) {
+            message.append("\nGovernor: level=${governor[0]} smoothedMs=${governor[1] / 1000000.0} " +
+                    "budgetMs=${governor[2] / 1000000.0} changes=${governor[3]} late=${governor[4]}")
+        }
+
+        val stats = nativeWrapper.getStats()
+        val fields = NativeWrapper.STATS_FIELDS
+        message.append("\nStages (us p50/p95/p99/max):")
+        for ((index, name) in NativeWrapper.STAGE_NAMES.withIndex()) {
+            val base = index * fields
+            if (stats[base] == 0L) {
+                continue
+            }
+            message.append(" $name=${stats[base + 1] / 1000}/${stats[base + 2] / 1000}/" +
+                    "${stats[base + 3] / 1000}/${stats[base + 4] / 1000}")
+        }
+        message.append(" timerNanos=${stats[stats.size - 1]}")
+        Log.d(TAG, message.toString())
+    }
+
+    /**
+     * Lend the frame's planes to the native input slot, which closes the image once
+     * processed. CameraX keeps only the newest frame until then.
+     */
+    private fun submitImage(image: ImageProxy) {
+        var queued = false
+        try {
+            nativeWrapper.beginCameraFrame(toMonotonicNanos(image.imageInfo.timestamp))
+
+            val planes = image.planes
+            val rotation = image.imageInfo.rotationDegrees
+            queued = nativeWrapper.submitFramePlanes(
+                image, planes[0].buffer, planes[1].buffer, planes[2].buffer,
+                planes[0].rowStride, planes[1].rowStride, planes[1].pixelStride,
+                image.width, image.height, rotation
+            )
+
+            if (!queued) {
+                // Planes are not direct buffers, pack them into an NV21 array instead
+                nv21Allocations++
+                val packStart = System.nanoTime()
+                val data = image.toNv21ByteArray()
+                nativeWrapper.traceSpan(NativeWrapper.TRACE_PACK_NV21, packStart, System.nanoTime())
+                nativeWrapper.submitFrame(data, image.width, image.height, rotation)
+            }
+        } finally {
+            if (!queued) {
+                image.close()
+            }
+        }
+    }
+
+    /**
+     * Camera timestamps count from boot on most devices (timestamp source REALTIME),
+     * native traces use the monotonic clock of System.nanoTime. The two only differ by
+     * the time spent in deep sleep, so a timestamp ahead of the monotonic clock is a
+     * boot time one.
+     */
+    private fun toMonotonicNanos(timestamp: Long): Long {
+        val now = System.nanoTime()
+        return if (timestamp > now) timestamp - (SystemClock.elapsedRealtimeNanos() - now) else timestamp
     }
 
     private fun ImageProxy.toNv21ByteArray(): ByteArray {
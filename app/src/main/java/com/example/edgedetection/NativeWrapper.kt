@@ -1,5 +1,7 @@
 package com.example.edgedetection
 
+import java.nio.ByteBuffer
+
 /**
  * Wrapper class for JNI native methods
  */
@@ -9,6 +11,48 @@ class NativeWrapper {
         init {
             System.loadLibrary("edgedetection")
         }
+
+        /** Blur and Canny through OpenCV on the calling thread */
+        const val ENGINE_OPENCV = 0
+
+        /** Blur and Canny in strips on the native thread pool (default) */
+        const val ENGINE_PARALLEL = 1
+
+        /** Blur, gradients and suppression fused into one cache-resident sweep */
+        const val ENGINE_FUSED = 2
+
+        /** No compact edge output (default) */
+        const val EDGE_OUTPUT_OFF = -1
+
+        /** One bit per pixel, rows of (width + 7) / 8 bytes, least significant bit first */
+        const val EDGE_OUTPUT_PACKED = 0
+
+        /** Per row runs of edge pixels: height + 1 int32 run starts, then (x, length) uint16 pairs */
+        const val EDGE_OUTPUT_RUNS = 1
+
+        /** Coordinates of every edge pixel as (x, y) uint16 pairs */
+        const val EDGE_OUTPUT_POINTS = 2
+
+        /** Record the input frames (NV21 from NV21 arrays, otherwise only the Y plane) */
+        const val RECORD_INPUT = 1
+
+        /** Record the edge masks, one bit per pixel */
+        const val RECORD_EDGES = 2
+
+        /** Port of the edge stream the web viewer connects to by default */
+        const val FRAME_SERVER_PORT = 8765
+
+        /** [traceSpan] phase: packing camera planes into an NV21 array */
+        const val TRACE_PACK_NV21 = 0
+
+        /** Native pipeline stages, in the order [getStats] reports them */
+        val STAGE_NAMES = arrayOf(
+            "ingest", "yuv2rgba", "gray", "blur", "canny", "edges", "frame", "upload", "draw",
+            "link", "sweep"
+        )
+
+        /** Values per stage in [getStats]: count, p50, p95, p99, max */
+        const val STATS_FIELDS = 5
     }
 
     /**
@@ -27,6 +71,375 @@ class NativeWrapper {
      */
     external fun processFrame(data: ByteArray, width: Int, height: Int, rotation: Int): Int
 
+    /**
+     * Process a camera frame straight from its YUV_420_888 planes without copying
+     *
+     * @param yPlane Direct buffer of the Y plane
+     * @param uPlane Direct buffer of the U plane
+     * @param vPlane Direct buffer of the V plane
+     * @param yRowStride Row stride of the Y plane in bytes
+     * @param uvRowStride Row stride of the U and V planes in bytes
+     * @param uvPixelStride Pixel stride of the U and V planes (2 for semi-planar layouts)
+     * @param width The width of the image
+     * @param height The height of the image
+     * @param rotation The rotation of the image
+     * @return The texture ID for rendering the processed frame, or -1 if the planes
+     *         are not direct buffers and the frame has to go through [processFrame]
+     */
+    external fun processFramePlanes(
+        yPlane: ByteBuffer, uPlane: ByteBuffer, vPlane: ByteBuffer,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int,
+        width: Int, height: Int, rotation: Int
+    ): Int
+
+    /**
+     * Queue a camera frame for the native processing thread, straight from its
+     * YUV_420_888 planes. The planes are not copied: when this returns true the native
+     * side owns the image and closes it once the processing thread is done with it, or
+     * when a newer frame replaces it before processing. Planar chroma (pixel stride 1)
+     * is the only part copied.
+     *
+     * @param image The camera image the planes belong to
+     * @param yPlane Direct buffer of the Y plane
+     * @param uPlane Direct buffer of the U plane
+     * @param vPlane Direct buffer of the V plane
+     * @param yRowStride Row stride of the Y plane in bytes
+     * @param uvRowStride Row stride of the U and V planes in bytes
+     * @param uvPixelStride Pixel stride of the U and V planes (2 for semi-planar layouts)
+     * @param width The width of the image
+     * @param height The height of the image
+     * @param rotation The rotation of the image
+     * @return false if the planes are not direct buffers and the frame has to go
+     *         through [submitFrame]; the caller still owns and closes the image then
+     */
+    external fun submitFramePlanes(
+        image: AutoCloseable, yPlane: ByteBuffer, uPlane: ByteBuffer, vPlane: ByteBuffer,
+        yRowStride: Int, uvRowStride: Int, uvPixelStride: Int,
+        width: Int, height: Int, rotation: Int
+    ): Boolean
+
+    /**
+     * Queue an NV21 frame for the native processing thread. The data is copied before
+     * this returns.
+     *
+     * @param data The NV21 image data
+     * @param width The width of the image
+     * @param height The height of the image
+     * @param rotation The rotation of the image
+     * @return false if the frame could not be queued
+     */
+    external fun submitFrame(data: ByteArray, width: Int, height: Int, rotation: Int): Boolean
+
+    /**
+     * Upload the newest edge mask finished by the processing thread, if there is one.
+     * Must be called on the GL thread; never waits for processing.
+     *
+     * @return The texture ID holding the newest edge mask
+     */
+    external fun uploadLatestFrame(): Int
+
+    /**
+     * Create an edge detection session for one more stream (a second camera, a decoded
+     * video, ...). Every session has its own buffers, parameters and texture; all of
+     * them share the native thread pool.
+     *
+     * @return The session handle, 0 if the native side is not initialized
+     */
+    external fun createSession(): Long
+
+    /**
+     * Destroy a session created by [createSession]
+     *
+     * @param handle The session
+     */
+    external fun destroySession(handle: Long)
+
+    /**
+     * Edge-detect an NV21 frame of a session on the calling thread. Several sessions may
+     * be processed from different threads at the same time.
+     *
+     * @param handle The session
+     * @param data The NV21 image data
+     * @param width The width of the image
+     * @param height The height of the image
+     * @return false if the handle is unknown or the data is too small
+     */
+    external fun processSession(handle: Long, data: ByteArray, width: Int, height: Int): Boolean
+
+    /**
+     * Upload the newest edge mask of a session into its texture. Must be called on the
+     * GL thread.
+     *
+     * @param handle The session
+     * @return The session's texture ID, 0 before its first frame
+     */
+    external fun uploadSession(handle: Long): Int
+
+    /**
+     * Set how the frames of a session are drawn; every session keeps its own orientation
+     *
+     * @param handle The session
+     * @param rotation Clockwise rotation in degrees that turns its frames upright
+     * @param mirrored Whether to mirror them horizontally
+     * @return false if the handle is unknown
+     */
+    external fun setSessionOrientation(handle: Long, rotation: Int, mirrored: Boolean): Boolean
+
+    /**
+     * Update the parameters of a session; they apply from its next frame on
+     *
+     * @param handle The session
+     * @param lowThreshold The low threshold for Canny edge detection
+     * @param ratio The ratio of high threshold to low threshold
+     * @param kernelSize The kernel size for Canny edge detection
+     * @param lumaOnly true to detect on the Y plane only
+     * @param engine [ENGINE_OPENCV], [ENGINE_PARALLEL] or [ENGINE_FUSED]
+     * @return false if the handle is unknown
+     */
+    external fun updateSessionParameters(
+        handle: Long, lowThreshold: Int, ratio: Int, kernelSize: Int,
+        lumaOnly: Boolean, engine: Int
+    ): Boolean
+
+    /**
+     * Restrict a session to regions of interest. Only the regions, plus the few pixels
+     * of filter context around them, are converted and edge-detected; the rest of the
+     * edge mask stays clear. Applies from the session's next frame on.
+     *
+     * @param handle The session
+     * @param rects Up to 8 regions as x, y, width, height quadruples in frame
+     *              coordinates; an empty array processes full frames again
+     * @return false if the handle is unknown or the array is malformed
+     */
+    external fun setSessionRegions(handle: Long, rects: IntArray): Boolean
+
+    /**
+     * Read the native processing thread counters
+     *
+     * @return [submitted, droppedBeforeProcessing, processed, droppedBeforeDisplay, displayed]
+     */
+    external fun getPipelineStats(): LongArray
+
+    /**
+     * Read the per-stage latency histograms of the native pipeline
+     *
+     * @return [STATS_FIELDS] values per stage in [STAGE_NAMES] order (count, then
+     *         p50, p95, p99 and max in nanoseconds), followed by the cost of one timed
+     *         scope in nanoseconds. All zero when stats are compiled out.
+     */
+    external fun getStats(): LongArray
+
+    /**
+     * Clear the per-stage latency histograms
+     */
+    external fun resetStats()
+
+    /**
+     * Read the native frame ingestion counters
+     *
+     * @return [frames, zeroCopyFrames, copiedBytes, allocations]
+     */
+    external fun getIngestStats(): LongArray
+
+    /**
+     * Also publish every camera edge mask in a compact format, 8x to 32x smaller than
+     * the mask and its RGBA expansion
+     *
+     * @param format [EDGE_OUTPUT_OFF], [EDGE_OUTPUT_PACKED], [EDGE_OUTPUT_RUNS] or
+     *               [EDGE_OUTPUT_POINTS]
+     */
+    external fun setEdgeOutputFormat(format: Int)
+
+    /**
+     * Get the newest camera edge mask in the format chosen with [setEdgeOutputFormat].
+     * Little-endian: four int32 (format, width, height, element count), then the payload
+     * described at the format constants; the element count is bytes, runs or points.
+     *
+     * @return The encoded frame, or null before the first frame or when output is off
+     */
+    external fun getEdgeOutput(): ByteArray?
+
+    /**
+     * Also link every camera edge mask into polylines, traced in parallel on the
+     * native thread pool
+     *
+     * @param enabled Whether to link edges
+     * @param epsilon Douglas-Peucker tolerance in mask pixels, 0 keeps every edge pixel
+     * @param minPixels Chains of fewer edge pixels are dropped
+     */
+    external fun setEdgeLinking(enabled: Boolean, epsilon: Float, minPixels: Int)
+
+    /**
+     * Get the polylines of the newest camera edge mask, in mask coordinates. Little-endian:
+     * four int32 (width, height, contour count, point count), then contour count + 1
+     * uint32 indices of the first point of each polyline, then (x, y) uint16 pairs.
+     * A closed contour repeats its first point.
+     *
+     * @return The encoded polylines, or null before the first frame or when linking is off
+     */
+    external fun getContours(): ByteArray?
+
+    /**
+     * Also threshold every camera frame with a sweep of hysteresis threshold pairs.
+     * Blur, gradients and non-maximum suppression are shared with the frame's own edges,
+     * so each pair only costs a hysteresis pass.
+     *
+     * @param thresholds Up to 16 (low, high) pairs, interleaved, in the units of
+     *                   [updateParameters]; null or empty turns the sweep off
+     */
+    external fun setThresholdSweep(thresholds: IntArray?)
+
+    /**
+     * Get the threshold level map of the newest camera frame. Little-endian: three int32
+     * (width, height, pair count), then one byte per pixel, row by row, counting the
+     * sweep pairs the pixel is an edge at. With pairs ordered from loosest to strictest,
+     * the pixel is an edge at pair i exactly when its count is above i.
+     *
+     * @return The encoded map, or null before the first frame or when the sweep is off
+     */
+    external fun getThresholdLevels(): ByteArray?
+
+    /**
+     * Also keep the Sobel gradients of every camera frame, from the same pass that
+     * detects its edges, with an orientation histogram per tile. Orientations fall into
+     * nine unsigned bins of 20 degrees over [0, 180), as in HOG.
+     *
+     * @param enabled true to keep the gradients, false to stop
+     * @param tileSize Side of the histogram tiles in pixels, 1 to 128
+     */
+    external fun setGradientOutput(enabled: Boolean, tileSize: Int)
+
+    /**
+     * Get the gradients of the newest camera frame. Little-endian: six int32 (width,
+     * height, tile size, tile columns, tile rows, bin count), then the int16 L1 gradient
+     * magnitude and the uint8 orientation bin of every pixel, row by row, then for every
+     * tile in raster order the int32 magnitude sum per bin.
+     *
+     * @return The encoded gradients, or null before the first frame or when the output
+     *         is off
+     */
+    external fun getGradients(): ByteArray?
+
+    /**
+     * Also count the edge pixels of every camera frame per tile, with their mean gradient
+     * magnitude, while the edge mask is written; for scene change detection and focus
+     * scoring without another pass over the frame
+     *
+     * @param enabled true to keep the grid, false to stop
+     * @param tileSize Side of the tiles in edge mask pixels, 1 to 128
+     */
+    external fun setEdgeDensity(enabled: Boolean, tileSize: Int)
+
+    /**
+     * Get the edge density grid of the newest camera frame. Little-endian: three int32
+     * (tile size, tile columns, tile rows), then the int32 edge pixel count of every tile
+     * in raster order, then the float32 mean gradient magnitude of those pixels per tile
+     * (0 for tiles without edges).
+     *
+     * @return The encoded grid, or null before the first frame or when it is off
+     */
+    external fun getEdgeDensity(): ByteArray?
+
+    /**
+     * Record the frames of the pipelined camera path, with their timestamps and
+     * parameters, into a memory-mapped ring file that keeps the newest frames that fit.
+     * Replay it on a host with the edgereplay tool.
+     *
+     * @param path The recording file, replaced if it exists
+     * @param capacityMb Size of the frame data ring in megabytes
+     * @param content [RECORD_INPUT], [RECORD_EDGES] or both combined
+     * @return false if the file cannot be created
+     */
+    external fun startRecording(path: String, capacityMb: Int, content: Int): Boolean
+
+    /**
+     * Stop recording and write the recording file back
+     */
+    external fun stopRecording()
+
+    /**
+     * Read the recorder counters of the current or last recording
+     *
+     * @return [recording (0 or 1), frames, bytes, overwrittenFrames, droppedFrames]
+     */
+    external fun getRecorderStats(): LongArray
+
+    /**
+     * Stream the camera edge masks to web viewers over WebSocket on localhost, delta
+     * coded against the previous frame. View them on a desktop after
+     * `adb forward tcp:<port> tcp:<port>`; slow viewers skip frames.
+     *
+     * @param port TCP port on 127.0.0.1, usually [FRAME_SERVER_PORT]
+     * @return false if the port cannot be bound or the server already runs
+     */
+    external fun startFrameServer(port: Int): Boolean
+
+    /**
+     * Disconnect all viewers and stop streaming
+     */
+    external fun stopFrameServer()
+
+    /**
+     * Read the frame server counters
+     *
+     * @return [viewers, published, sent, dropped, keyframes, bytesSent, maskBytes,
+     *          latencyP50Nanos, latencyP99Nanos]
+     */
+    external fun getFrameServerStats(): LongArray
+
+    /**
+     * Tag the frame about to be submitted from this thread with its camera timestamp.
+     * The timestamp identifies the frame in traces, and while tracing the time from
+     * the sensor to this call is recorded as its acquisition.
+     *
+     * @param timestampNanos Camera timestamp on the System.nanoTime clock
+     */
+    external fun beginCameraFrame(timestampNanos: Long)
+
+    /**
+     * Record a span of the current camera frame measured on this side
+     *
+     * @param phase What the span covers, e.g. [TRACE_PACK_NV21]
+     * @param beginNanos Start, from System.nanoTime
+     * @param endNanos End, from System.nanoTime
+     */
+    external fun traceSpan(phase: Int, beginNanos: Long, endNanos: Long)
+
+    /**
+     * Start tracing every frame through acquisition, queues, native stages, upload
+     * and draw into a ring that keeps the newest events
+     */
+    external fun startTrace()
+
+    /**
+     * Stop tracing; the collected events can still be dumped
+     */
+    external fun stopTrace()
+
+    /**
+     * Write the collected trace as Chrome trace JSON, to open in ui.perfetto.dev or
+     * chrome://tracing
+     *
+     * @param path File to write
+     * @return false if the file cannot be written
+     */
+    external fun dumpTrace(path: String): Boolean
+
+    /**
+     * Read the edge mask upload counters
+     *
+     * @return [uploads, totalBytes, lastFrameBytes, totalUploadNanos, storageAllocations]
+     */
+    external fun getUploadStats(): LongArray
+
+    /**
+     * Read the native frame buffer pool counters. allocations stops growing once every
+     * resolution in use has been seen.
+     *
+     * @return [allocations, reuses, frees, liveBytes, idleBytes, peakBytes]
+     */
+    external fun getBufferPoolStats(): LongArray
+
     /**
      * Create an OpenGL texture for rendering processed frames
      *
@@ -43,6 +456,82 @@ class NativeWrapper {
      */
     external fun updateParameters(lowThreshold: Int, ratio: Int, kernelSize: Int)
 
+    /**
+     * Update the edge detection parameters from a given frame on. The change takes effect
+     * as a whole at the start of that frame, together with other changes staged for it.
+     *
+     * @param lowThreshold The low threshold for Canny edge detection
+     * @param ratio The ratio of high threshold to low threshold
+     * @param kernelSize The kernel size for Canny edge detection
+     * @param frame Number of the first frame to use them, see [getFrameCount]; a frame
+     *              that has already started means the next one
+     */
+    external fun updateParametersAt(lowThreshold: Int, ratio: Int, kernelSize: Int, frame: Long)
+
+    /**
+     * Get the number of camera frames processed so far, the number of the next frame
+     */
+    external fun getFrameCount(): Long
+
+    /**
+     * Select the native pipeline mode
+     *
+     * @param enabled true to run edge detection straight on the Y plane of the NV21 frame
+     *                (the default), false to go through a full RGBA conversion first
+     */
+    external fun setLumaOnly(enabled: Boolean)
+
+    /**
+     * Select the engine running blur and Canny
+     *
+     * @param engine [ENGINE_OPENCV], [ENGINE_PARALLEL] or [ENGINE_FUSED]; all produce the same edges
+     */
+    external fun setEngine(engine: Int)
+
+    /**
+     * Only recompute the edges of tiles that changed, for fixed cameras watching a
+     * mostly static scene
+     *
+     * @param enabled true to enable incremental mode (off by default)
+     * @param sensitivity Mean absolute difference per pixel a tile may show and still
+     *                    reuse its previous edges; 0 reuses only identical tiles
+     */
+    external fun setIncremental(enabled: Boolean, sensitivity: Float)
+
+    /**
+     * Read the tile reuse counters of incremental mode
+     *
+     * @return [frames, skippedFrames, tiles, reusedTiles]
+     */
+    external fun getTemporalStats(): LongArray
+
+    /**
+     * Restrict the camera stream to regions of interest, see [setSessionRegions]
+     *
+     * @param rects Up to 8 regions as x, y, width, height quadruples in camera frame
+     *              coordinates; an empty array processes full frames again
+     * @return false if the array is malformed
+     */
+    external fun setRegions(rects: IntArray): Boolean
+
+    /**
+     * Keep the processing time of each frame within a budget. When frames run late the
+     * native side processes a downscaled pyramid level instead (half the width and
+     * height per level) and the renderer scales the edges back up; it returns to finer
+     * levels once there is headroom again.
+     *
+     * @param budgetMs Budget per frame in milliseconds, 0 to always process full frames
+     * @param maxLevel Coarsest pyramid level allowed (0..3)
+     */
+    external fun setFrameBudget(budgetMs: Float, maxLevel: Int)
+
+    /**
+     * Read the latency governor state
+     *
+     * @return [level, smoothedNanos, budgetNanos, levelChanges, framesOverBudget]
+     */
+    external fun getGovernorStats(): LongArray
+
     /**
      * Clean up native resources
      */
@@ -60,6 +549,30 @@ class NativeWrapper {
      */
     external fun drawFrame(textureId: Int)
 
+    /**
+     * Set the viewport to the surface size. The frame is drawn upright, rotated by the
+     * rotation passed with it, and letterboxed to its aspect ratio inside the viewport.
+     *
+     * @param width Width of the surface in pixels
+     * @param height Height of the surface in pixels
+     */
+    external fun setViewport(width: Int, height: Int)
+
+    /**
+     * Mirror the camera preview horizontally, as expected for a front camera
+     *
+     * @param mirrored Whether to mirror
+     */
+    external fun setMirrored(mirrored: Boolean)
+
+    /**
+     * Set the colors the edge mask is drawn with
+     *
+     * @param edgeColor ARGB color of edge pixels
+     * @param backgroundColor ARGB color of everything else
+     */
+    external fun setEdgeColors(edgeColor: Int, backgroundColor: Int)
+
     /**
      * Clean up OpenGL resources
      */
@@ -2,21 +2,34 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <cstddef>
 
 /**
  * Texture - Helper class for creating and managing OpenGL textures
+ *
+ * Storage is allocated once per size; update() streams new pixels into it with
+ * glTexSubImage2D. Single channel formats (GL_LUMINANCE, GL_ALPHA) upload a quarter of
+ * the bytes of GL_RGBA, which is all an edge mask needs.
  */
 class Texture {
 private:
     GLuint mTextureId;
     int mWidth;
     int mHeight;
+    GLenum mFormat;
+    
+    /**
+     * Get the number of bytes per pixel of a texture format
+     */
+    static int bytesPerPixel(GLenum format) {
+        return (format == GL_LUMINANCE || format == GL_ALPHA) ? 1 : 4;
+    }
     
 public:
     /**
      * Constructor
      */
-    Texture() : mTextureId(0), mWidth(0), mHeight(0) {}
+    Texture() : mTextureId(0), mWidth(0), mHeight(0), mFormat(GL_RGBA) {}
     
     /**
      * Destructor
@@ -32,9 +45,10 @@ public:
      * 
      * @param width The width of the texture
      * @param height The height of the texture
+     * @param format GL_RGBA, or GL_LUMINANCE / GL_ALPHA for single channel data
      * @return true if creation is successful, false otherwise
      */
-    bool create(int width, int height) {
+    bool create(int width, int height, GLenum format = GL_RGBA) {
         // Delete existing texture if any
         if (mTextureId != 0) {
             glDeleteTextures(1, &mTextureId);
@@ -49,6 +63,7 @@ public:
         
         mWidth = width;
         mHeight = height;
+        mFormat = format;
         
         // Configure texture parameters
         glBindTexture(GL_TEXTURE_2D, mTextureId);
@@ -58,7 +73,7 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
         
         // Allocate empty texture data
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, nullptr);
         
         return true;
     }
@@ -66,7 +81,7 @@ public:
     /**
      * Update texture data from buffer
      * 
-     * @param data Pointer to the texture data (RGBA)
+     * @param data Pointer to the texture data, in the format the texture was created with
      * @param width Width of the data
      * @param height Height of the data
      */
@@ -77,12 +92,15 @@ public:
         
         // If dimensions have changed, recreate the texture
         if (width != mWidth || height != mHeight) {
-            create(width, height);
+            create(width, height, mFormat);
         }
         
+        // Single channel rows are tightly packed, whatever their width
+        glPixelStorei(GL_UNPACK_ALIGNMENT, bytesPerPixel(mFormat));
+        
         // Update the texture data
         glBindTexture(GL_TEXTURE_2D, mTextureId);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, mFormat, GL_UNSIGNED_BYTE, data);
     }
     
     /**
@@ -112,6 +130,24 @@ public:
         return mHeight;
     }
     
+    /**
+     * Get the texture format
+     * 
+     * @return GL_RGBA, GL_LUMINANCE or GL_ALPHA
+     */
+    GLenum getFormat() const {
+        return mFormat;
+    }
+    
+    /**
+     * Get the number of bytes one update() uploads
+     * 
+     * @return The upload size in bytes
+     */
+    size_t getUploadBytes() const {
+        return (size_t)mWidth * mHeight * bytesPerPixel(mFormat);
+    }
+    
     /**
      * Bind the texture to the current texture unit
      */
@@ -4,6 +4,8 @@
 #include <opencv2/opencv.hpp>
 #include <GLES2/gl2.h>
 
+#include "buffer_pool.h"
+
 /**
  * JNIBridge - A utility class for JNI operations
  */
@@ -17,23 +19,15 @@ public:
      * @param width The width of the image
      * @param height The height of the image
      * @param channels The number of channels (1 for grayscale, 3 for RGB, 4 for RGBA)
-     * @return An OpenCV Mat containing the image data
+     * @return An OpenCV Mat containing the image data, backed by the shared buffer pool
      */
     static cv::Mat byteArrayToMat(JNIEnv* env, jbyteArray byteArray, int width, int height, int channels = 4) {
-        jbyte* data = env->GetByteArrayElements(byteArray, 0);
-        cv::Mat mat;
-        
-        if (channels == 1) {
-            mat = cv::Mat(height, width, CV_8UC1, data);
-        } else if (channels == 3) {
-            mat = cv::Mat(height, width, CV_8UC3, data);
-        } else {
-            mat = cv::Mat(height, width, CV_8UC4, data);
-        }
+        int type = channels == 1 ? CV_8UC1 : channels == 3 ? CV_8UC3 : CV_8UC4;
         
-        // Create a deep copy so we can release the Java byte array
-        cv::Mat result = mat.clone();
-        env->ReleaseByteArrayElements(byteArray, data, 0);
+        // Copy straight from the Java array into a recycled buffer, no intermediate clone
+        cv::Mat result = BufferPool::shared().create(height, width, type);
+        env->GetByteArrayRegion(byteArray, 0, (jsize)(result.total() * result.elemSize()),
+                                reinterpret_cast<jbyte*>(result.data));
         
         return result;
     }
@@ -45,7 +39,7 @@ public:
      * @param yuv The Java byte array containing YUV_NV21 data
      * @param width The width of the image
      * @param height The height of the image
-     * @return An OpenCV Mat in RGBA format
+     * @return An OpenCV Mat in RGBA format, backed by the shared buffer pool
      */
     static cv::Mat yuv2Rgba(JNIEnv* env, jbyteArray yuv, int width, int height) {
         jbyte* yuvData = env->GetByteArrayElements(yuv, 0);
@@ -53,10 +47,11 @@ public:
         // YUV_NV21 format has Y plane followed by interleaved VU plane
         cv::Mat yuvMat(height + height/2, width, CV_8UC1, yuvData);
         cv::Mat rgbaMat;
+        BufferPool::shared().attach(rgbaMat);
         cv::cvtColor(yuvMat, rgbaMat, cv::COLOR_YUV2RGBA_NV21);
         
-        // Release Java byte array
-        env->ReleaseByteArrayElements(yuv, yuvData, 0);
+        // Release Java byte array - it was only read, skip the copy back
+        env->ReleaseByteArrayElements(yuv, yuvData, JNI_ABORT);
         
         return rgbaMat;
     }
@@ -64,7 +59,10 @@ public:
     /**
      * Upload an OpenCV Mat directly to an OpenGL texture
      * 
-     * @param mat The OpenCV Mat containing RGBA data
+     * Single channel Mats (e.g. edge masks) are uploaded as GL_LUMINANCE without
+     * expanding them to RGBA first.
+     * 
+     * @param mat The OpenCV Mat containing RGBA, RGB or single channel data
      * @param textureId The OpenGL texture ID
      * @return true if successful, false otherwise
      */
@@ -73,8 +71,18 @@ public:
             return false;
         }
         
+        // Single channel data goes up as is, a quarter of the RGBA bytes
+        if (mat.channels() == 1 && mat.isContinuous()) {
+            glBindTexture(GL_TEXTURE_2D, textureId);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, mat.cols, mat.rows, 0,
+                         GL_LUMINANCE, GL_UNSIGNED_BYTE, mat.data);
+            return true;
+        }
+        
         // Ensure mat is in RGBA format
         cv::Mat rgbaMat;
+        BufferPool::shared().attach(rgbaMat);
         if (mat.channels() == 4) {
             rgbaMat = mat;
         } else if (mat.channels() == 3) {
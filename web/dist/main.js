@@ -8,6 +8,49 @@ var __awaiter = (this && this.__awaiter) || function (thisArg, _arguments, P, ge
         step((generator = generator.apply(thisArg, _arguments || [])).next());
     });
 };
+const STREAM_URL = 'ws://localhost:8765';
+const STREAM_VERSION = 1;
+const STREAM_KEYFRAME = 1;
+const STREAM_HEADER_BYTES = 24;
+function applyDelta(code, frame) {
+    let i = 0;
+    let position = 0;
+    const readCount = () => {
+        let value = 0;
+        for (let shift = 0; i < code.length && shift < 35; shift += 7) {
+            const byte = code[i++];
+            value += (byte & 0x7f) * Math.pow(2, shift);
+            if ((byte & 0x80) === 0)
+                return value;
+        }
+        return -1;
+    };
+    while (i < code.length) {
+        const zeros = readCount();
+        const literal = readCount();
+        if (zeros < 0 || literal < 0 || position + zeros + literal > frame.length || i + literal > code.length) {
+            return false;
+        }
+        position += zeros;
+        for (let j = 0; j < literal; j++) {
+            frame[position + j] ^= code[i + j];
+        }
+        i += literal;
+        position += literal;
+    }
+    return true;
+}
+function streamChecksum(bits) {
+    let hash = 2166136261;
+    for (let i = 0; i < bits.length; i += 4) {
+        let word = 0;
+        for (let j = 0; j < 4 && i + j < bits.length; j++) {
+            word |= bits[i + j] << (8 * j);
+        }
+        hash = Math.imul(hash ^ word, 16777619);
+    }
+    return hash >>> 0;
+}
 class EdgeViewer {
     constructor() {
         this.image = null;
@@ -16,6 +59,12 @@ class EdgeViewer {
         this.webcamActive = false;
         this.frameCount = 0;
         this.lastFpsTime = 0;
+        this.socket = null;
+        this.streamBits = null;
+        this.streamImage = null;
+        this.streamFrames = 0;
+        this.streamBytes = 0;
+        this.streamLatencyMicros = 0;
         this.canvas = document.getElementById('viewerCanvas');
         this.ctx = this.canvas.getContext('2d');
         this.tempCanvas = document.createElement('canvas');
@@ -28,8 +77,9 @@ class EdgeViewer {
     setupEventListeners() {
         const loadBtn = document.getElementById('loadSampleBtn');
         const captureBtn = document.getElementById('captureBtn');
+        const streamBtn = document.getElementById('streamBtn');
         const uploadInput = document.getElementById('imageUpload');
-        console.log('Setting up event listeners...', { loadBtn, captureBtn, uploadInput });
+        console.log('Setting up event listeners...', { loadBtn, captureBtn, streamBtn, uploadInput });
         if (loadBtn) {
             loadBtn.addEventListener('click', () => {
                 console.log('Load Sample button clicked');
@@ -42,6 +92,12 @@ class EdgeViewer {
                 this.toggleWebcam();
             });
         }
+        if (streamBtn) {
+            streamBtn.addEventListener('click', () => {
+                console.log('Stream button clicked');
+                this.toggleStream();
+            });
+        }
         if (uploadInput) {
             uploadInput.addEventListener('change', (e) => {
                 console.log('File upload input changed');
@@ -52,6 +108,7 @@ class EdgeViewer {
     loadSample() {
         console.log('Loading sample image...');
         this.stopWebcam();
+        this.stopStream();
         const img = new Image();
         img.onload = () => {
             console.log('Sample loaded:', img.width, 'x', img.height);
@@ -69,6 +126,7 @@ class EdgeViewer {
     handleFileUpload(event) {
         var _a;
         this.stopWebcam();
+        this.stopStream();
         const input = event.target;
         const file = (_a = input.files) === null || _a === void 0 ? void 0 : _a[0];
         if (!file)
@@ -105,6 +163,7 @@ class EdgeViewer {
     startWebcam() {
         return __awaiter(this, void 0, void 0, function* () {
             console.log('Starting webcam...');
+            this.stopStream();
             try {
                 this.stream = yield navigator.mediaDevices.getUserMedia({
                     video: {
@@ -156,6 +215,107 @@ class EdgeViewer {
         if (btn)
             btn.textContent = '📷 Use Webcam';
     }
+    toggleStream() {
+        if (this.socket) {
+            this.stopStream();
+        }
+        else {
+            this.startStream();
+        }
+    }
+    startStream() {
+        this.stopWebcam();
+        this.image = null;
+        const url = new URLSearchParams(window.location.search).get('stream') || STREAM_URL;
+        console.log('Connecting to edge stream', url);
+        const socket = new WebSocket(url);
+        socket.binaryType = 'arraybuffer';
+        socket.onopen = () => {
+            console.log('Edge stream connected');
+            const btn = document.getElementById('streamBtn');
+            if (btn)
+                btn.textContent = '⏹️ Disconnect';
+        };
+        socket.onmessage = (event) => {
+            if (event.data instanceof ArrayBuffer) {
+                this.handleStreamFrame(event.data);
+            }
+        };
+        socket.onclose = () => {
+            console.log('Edge stream closed');
+            if (this.socket === socket) {
+                this.stopStream();
+            }
+        };
+        socket.onerror = () => {
+            console.error('Edge stream error, is the app streaming and the port forwarded?');
+        };
+        this.socket = socket;
+    }
+    stopStream() {
+        if (this.socket) {
+            const socket = this.socket;
+            this.socket = null;
+            socket.close();
+        }
+        this.streamBits = null;
+        this.streamImage = null;
+        this.updateStreamStats(0);
+        const btn = document.getElementById('streamBtn');
+        if (btn)
+            btn.textContent = '📡 Connect to App';
+    }
+    handleStreamFrame(data) {
+        if (!this.socket || data.byteLength < STREAM_HEADER_BYTES)
+            return;
+        const view = new DataView(data);
+        if (view.getUint8(0) !== STREAM_VERSION) {
+            console.error('Unknown edge stream version', view.getUint8(0));
+            this.stopStream();
+            return;
+        }
+        const keyframe = (view.getUint8(1) & STREAM_KEYFRAME) !== 0;
+        const sequence = view.getUint32(4, true);
+        const width = view.getUint16(8, true);
+        const height = view.getUint16(10, true);
+        const checksum = view.getUint32(12, true);
+        const stride = (width + 7) >> 3;
+        if (keyframe) {
+            if (!this.streamImage || this.streamImage.width !== width || this.streamImage.height !== height) {
+                this.canvas.width = width;
+                this.canvas.height = height;
+                this.streamImage = this.ctx.createImageData(width, height);
+                this.updateResolution();
+            }
+            this.streamBits = new Uint8Array(stride * height);
+        }
+        else if (!this.streamBits || !this.streamImage ||
+            this.streamImage.width !== width || this.streamImage.height !== height) {
+            this.socket.send('key');
+            return;
+        }
+        const bits = this.streamBits;
+        if (!applyDelta(new Uint8Array(data, STREAM_HEADER_BYTES), bits) || streamChecksum(bits) !== checksum) {
+            console.warn('Edge stream frame', sequence, 'did not decode, requesting a keyframe');
+            this.streamBits = null;
+            this.socket.send('key');
+            return;
+        }
+        const image = this.streamImage;
+        const pixels = new Uint32Array(image.data.buffer);
+        for (let y = 0; y < height; y++) {
+            const row = y * stride;
+            const out = y * width;
+            for (let x = 0; x < width; x++) {
+                pixels[out + x] = (bits[row + (x >> 3)] >> (x & 7)) & 1 ? 0xffffffff : 0xff000000;
+            }
+        }
+        this.ctx.putImageData(image, 0, 0);
+        this.socket.send(`ack ${sequence}`);
+        this.streamFrames++;
+        this.streamBytes += data.byteLength;
+        this.streamLatencyMicros = view.getUint32(16, true);
+    }
     applyEdgeDetection(source) {
         this.tempCtx.drawImage(source, 0, 0, this.tempCanvas.width, this.tempCanvas.height);
         const imageData = this.tempCtx.getImageData(0, 0, this.tempCanvas.width, this.tempCanvas.height);
@@ -213,7 +373,7 @@ class EdgeViewer {
         this.ctx.fillText('Click buttons above to get started', this.canvas.width / 2, this.canvas.height / 2 + 10);
         this.ctx.font = '14px Arial';
         this.ctx.fillStyle = '#888888';
-        this.ctx.fillText('Load Sample • Upload Image • Use Webcam', this.canvas.width / 2, this.canvas.height / 2 + 40);
+        this.ctx.fillText('Load Sample • Upload Image • Use Webcam • Connect to App', this.canvas.width / 2, this.canvas.height / 2 + 40);
     }
     startAnimationLoop() {
         this.lastFpsTime = performance.now();
@@ -222,6 +382,7 @@ class EdgeViewer {
             if (currentTime - this.lastFpsTime >= 1000) {
                 const fps = Math.round(this.frameCount * 1000 / (currentTime - this.lastFpsTime));
                 this.updateFPS(fps);
+                this.updateStreamStats(currentTime - this.lastFpsTime);
                 this.frameCount = 0;
                 this.lastFpsTime = currentTime;
             }
@@ -244,6 +405,28 @@ class EdgeViewer {
             fpsElement.textContent = fps.toString();
         }
     }
+    updateStreamStats(elapsedMillis) {
+        const bandwidthElement = document.getElementById('bandwidth');
+        const latencyElement = document.getElementById('latency');
+        if (this.socket && this.streamFrames > 0) {
+            const kbPerFrame = this.streamBytes / this.streamFrames / 1024;
+            const frameRate = this.streamFrames * 1000 / elapsedMillis;
+            if (bandwidthElement) {
+                bandwidthElement.textContent = `${kbPerFrame.toFixed(1)} KB/frame @ ${frameRate.toFixed(0)} fps`;
+            }
+            if (latencyElement) {
+                latencyElement.textContent = `${(this.streamLatencyMicros / 1000).toFixed(1)} ms`;
+            }
+        }
+        else {
+            if (bandwidthElement)
+                bandwidthElement.textContent = '-';
+            if (latencyElement)
+                latencyElement.textContent = '-';
+        }
+        this.streamFrames = 0;
+        this.streamBytes = 0;
+    }
     updateResolution() {
         const resElement = document.getElementById('res');
         if (resElement) {
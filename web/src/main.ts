@@ -1,5 +1,57 @@
 // Real-Time Edge Detection Viewer
-// Supports: Static images, file upload, and live webcam
+// Supports: Static images, file upload, live webcam, and the app's native edge stream
+
+// Edge stream of the app's FrameServer (see core/frame_server.h), reached on a desktop
+// after `adb forward tcp:8765 tcp:8765`; ?stream=ws://host:port overrides the address
+const STREAM_URL = 'ws://localhost:8765';
+const STREAM_VERSION = 1;
+const STREAM_KEYFRAME = 1;
+const STREAM_HEADER_BYTES = 24;
+
+// Applies a delta code (LEB128 zero byte count, literal byte count, literal bytes, ...)
+// to the packed frame by XOR. Returns false if the code is malformed.
+function applyDelta(code: Uint8Array, frame: Uint8Array): boolean {
+    let i = 0;
+    let position = 0;
+    
+    const readCount = (): number => {
+        let value = 0;
+        for (let shift = 0; i < code.length && shift < 35; shift += 7) {
+            const byte = code[i++];
+            value += (byte & 0x7f) * Math.pow(2, shift);
+            if ((byte & 0x80) === 0) return value;
+        }
+        return -1;
+    };
+    
+    while (i < code.length) {
+        const zeros = readCount();
+        const literal = readCount();
+        if (zeros < 0 || literal < 0 || position + zeros + literal > frame.length || i + literal > code.length) {
+            return false;
+        }
+        position += zeros;
+        for (let j = 0; j < literal; j++) {
+            frame[position + j] ^= code[i + j];
+        }
+        i += literal;
+        position += literal;
+    }
+    return true;
+}
+
+// FNV-1a over the little-endian 32-bit words of a packed frame, as the server computes it
+function streamChecksum(bits: Uint8Array): number {
+    let hash = 2166136261;
+    for (let i = 0; i < bits.length; i += 4) {
+        let word = 0;
+        for (let j = 0; j < 4 && i + j < bits.length; j++) {
+            word |= bits[i + j] << (8 * j);
+        }
+        hash = Math.imul(hash ^ word, 16777619);
+    }
+    return hash >>> 0;
+}
 
 class EdgeViewer {
     private canvas: HTMLCanvasElement;
@@ -12,6 +64,12 @@ class EdgeViewer {
     private tempCtx: CanvasRenderingContext2D;
     private frameCount = 0;
     private lastFpsTime = 0;
+    private socket: WebSocket | null = null;
+    private streamBits: Uint8Array | null = null;
+    private streamImage: ImageData | null = null;
+    private streamFrames = 0;
+    private streamBytes = 0;
+    private streamLatencyMicros = 0;
 
     constructor() {
         this.canvas = document.getElementById('viewerCanvas') as HTMLCanvasElement;
@@ -29,9 +87,10 @@ class EdgeViewer {
     private setupEventListeners(): void {
         const loadBtn = document.getElementById('loadSampleBtn');
         const captureBtn = document.getElementById('captureBtn');
+        const streamBtn = document.getElementById('streamBtn');
         const uploadInput = document.getElementById('imageUpload') as HTMLInputElement;
 
-        console.log('Setting up event listeners...', { loadBtn, captureBtn, uploadInput });
+        console.log('Setting up event listeners...', { loadBtn, captureBtn, streamBtn, uploadInput });
 
         if (loadBtn) {
             loadBtn.addEventListener('click', () => {
@@ -47,6 +106,13 @@ class EdgeViewer {
             });
         }
 
+        if (streamBtn) {
+            streamBtn.addEventListener('click', () => {
+                console.log('Stream button clicked');
+                this.toggleStream();
+            });
+        }
+
         if (uploadInput) {
             uploadInput.addEventListener('change', (e) => {
                 console.log('File upload input changed');
@@ -58,6 +124,7 @@ class EdgeViewer {
     private loadSample(): void {
         console.log('Loading sample image...');
         this.stopWebcam();
+        this.stopStream();
         
         const img = new Image();
         
@@ -79,6 +146,7 @@ class EdgeViewer {
 
     private handleFileUpload(event: Event): void {
         this.stopWebcam();
+        this.stopStream();
         
         const input = event.target as HTMLInputElement;
         const file = input.files?.[0];
@@ -124,6 +192,7 @@ class EdgeViewer {
 
     private async startWebcam(): Promise<void> {
         console.log('Starting webcam...');
+        this.stopStream();
         
         try {
             this.stream = await navigator.mediaDevices.getUserMedia({
@@ -186,6 +255,123 @@ class EdgeViewer {
         if (btn) btn.textContent = '📷 Use Webcam';
     }
 
+    private toggleStream(): void {
+        if (this.socket) {
+            this.stopStream();
+        } else {
+            this.startStream();
+        }
+    }
+
+    private startStream(): void {
+        this.stopWebcam();
+        this.image = null;
+        
+        const url = new URLSearchParams(window.location.search).get('stream') || STREAM_URL;
+        console.log('Connecting to edge stream', url);
+        
+        const socket = new WebSocket(url);
+        socket.binaryType = 'arraybuffer';
+        
+        socket.onopen = () => {
+            console.log('Edge stream connected');
+            const btn = document.getElementById('streamBtn');
+            if (btn) btn.textContent = '⏹️ Disconnect';
+        };
+        
+        socket.onmessage = (event) => {
+            if (event.data instanceof ArrayBuffer) {
+                this.handleStreamFrame(event.data);
+            }
+        };
+        
+        socket.onclose = () => {
+            console.log('Edge stream closed');
+            if (this.socket === socket) {
+                this.stopStream();
+            }
+        };
+        
+        socket.onerror = () => {
+            console.error('Edge stream error, is the app streaming and the port forwarded?');
+        };
+        
+        this.socket = socket;
+    }
+
+    private stopStream(): void {
+        if (this.socket) {
+            const socket = this.socket;
+            this.socket = null;
+            socket.close();
+        }
+        
+        this.streamBits = null;
+        this.streamImage = null;
+        this.updateStreamStats(0);
+        
+        const btn = document.getElementById('streamBtn');
+        if (btn) btn.textContent = '📡 Connect to App';
+    }
+
+    private handleStreamFrame(data: ArrayBuffer): void {
+        if (!this.socket || data.byteLength < STREAM_HEADER_BYTES) return;
+        
+        const view = new DataView(data);
+        if (view.getUint8(0) !== STREAM_VERSION) {
+            console.error('Unknown edge stream version', view.getUint8(0));
+            this.stopStream();
+            return;
+        }
+        const keyframe = (view.getUint8(1) & STREAM_KEYFRAME) !== 0;
+        const sequence = view.getUint32(4, true);
+        const width = view.getUint16(8, true);
+        const height = view.getUint16(10, true);
+        const checksum = view.getUint32(12, true);
+        const stride = (width + 7) >> 3;
+        
+        if (keyframe) {
+            if (!this.streamImage || this.streamImage.width !== width || this.streamImage.height !== height) {
+                this.canvas.width = width;
+                this.canvas.height = height;
+                this.streamImage = this.ctx.createImageData(width, height);
+                this.updateResolution();
+            }
+            this.streamBits = new Uint8Array(stride * height);
+        } else if (!this.streamBits || !this.streamImage ||
+                   this.streamImage.width !== width || this.streamImage.height !== height) {
+            // Lost track of the stream, wait for a keyframe
+            this.socket.send('key');
+            return;
+        }
+        
+        const bits = this.streamBits!;
+        if (!applyDelta(new Uint8Array(data, STREAM_HEADER_BYTES), bits) || streamChecksum(bits) !== checksum) {
+            console.warn('Edge stream frame', sequence, 'did not decode, requesting a keyframe');
+            this.streamBits = null;
+            this.socket.send('key');
+            return;
+        }
+        
+        // One bit per pixel, least significant bit first: white edges on black
+        const image = this.streamImage!;
+        const pixels = new Uint32Array(image.data.buffer);
+        for (let y = 0; y < height; y++) {
+            const row = y * stride;
+            const out = y * width;
+            for (let x = 0; x < width; x++) {
+                pixels[out + x] = (bits[row + (x >> 3)] >> (x & 7)) & 1 ? 0xffffffff : 0xff000000;
+            }
+        }
+        this.ctx.putImageData(image, 0, 0);
+        
+        // The server measures latency up to this acknowledgement and reports it back
+        this.socket.send(`ack ${sequence}`);
+        this.streamFrames++;
+        this.streamBytes += data.byteLength;
+        this.streamLatencyMicros = view.getUint32(16, true);
+    }
+
     private applyEdgeDetection(source: HTMLImageElement | HTMLVideoElement): void {
         // Draw source to temp canvas
         this.tempCtx.drawImage(source, 0, 0, this.tempCanvas.width, this.tempCanvas.height);
@@ -266,7 +452,7 @@ class EdgeViewer {
         
         this.ctx.font = '14px Arial';
         this.ctx.fillStyle = '#888888';
-        this.ctx.fillText('Load Sample • Upload Image • Use Webcam', this.canvas.width / 2, this.canvas.height / 2 + 40);
+        this.ctx.fillText('Load Sample • Upload Image • Use Webcam • Connect to App', this.canvas.width / 2, this.canvas.height / 2 + 40);
     }
 
     private startAnimationLoop(): void {
@@ -279,6 +465,7 @@ class EdgeViewer {
             if (currentTime - this.lastFpsTime >= 1000) {
                 const fps = Math.round(this.frameCount * 1000 / (currentTime - this.lastFpsTime));
                 this.updateFPS(fps);
+                this.updateStreamStats(currentTime - this.lastFpsTime);
                 this.frameCount = 0;
                 this.lastFpsTime = currentTime;
             }
@@ -309,6 +496,28 @@ class EdgeViewer {
         }
     }
 
+    private updateStreamStats(elapsedMillis: number): void {
+        const bandwidthElement = document.getElementById('bandwidth');
+        const latencyElement = document.getElementById('latency');
+        
+        if (this.socket && this.streamFrames > 0) {
+            const kbPerFrame = this.streamBytes / this.streamFrames / 1024;
+            const frameRate = this.streamFrames * 1000 / elapsedMillis;
+            if (bandwidthElement) {
+                bandwidthElement.textContent = `${kbPerFrame.toFixed(1)} KB/frame @ ${frameRate.toFixed(0)} fps`;
+            }
+            if (latencyElement) {
+                latencyElement.textContent = `${(this.streamLatencyMicros / 1000).toFixed(1)} ms`;
+            }
+        } else {
+            if (bandwidthElement) bandwidthElement.textContent = '-';
+            if (latencyElement) latencyElement.textContent = '-';
+        }
+        
+        this.streamFrames = 0;
+        this.streamBytes = 0;
+    }
+
     private updateResolution(): void {
         const resElement = document.getElementById('res');
         if (resElement) {